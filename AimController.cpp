@@ -0,0 +1,126 @@
+#include "AimController.h"
+#include <math.h>
+
+namespace SniperBot
+{
+    static const double MIN_DT = 0.001;  // seconds, so a repeated frame doesn't blow up the derivative
+    static const double MAX_DT = 0.2;  // seconds, so a stalled frame doesn't wind up the integral
+    static const double SERVO_PERIOD = 0.005;  // seconds between the Arduino's servo updates
+
+    // Constructor
+    AimController::AimController()
+    {
+        // About 10.7 pixels a degree, so a full correction would be 0.09 degrees a pixel. About
+        // half of that leaves room for the frames the servo takes to get there. A step is about
+        // 21 pixels, so the dead zone is half a step plus room for the detector's noise.
+        this->kp = 0.05;
+        this->ki = 0.05;
+        this->kd = 0;
+        this->deadZone = 16;
+        this->maxSteps = 10;
+        this->pixelsPerDegree = 640 / 60.0;
+        reset();
+    }
+
+    void AimController::setGains(double kp, double ki, double kd)
+    {
+        this->kp = kp;
+        this->ki = ki;
+        this->kd = kd;
+    }
+
+    // getDeadZone function
+    double AimController::getDeadZone() { return deadZone; }
+
+    // setDeadZone function
+    void AimController::setDeadZone(double pixels) { this->deadZone = pixels; }
+
+    // setPixelsPerDegree function
+    void AimController::setPixelsPerDegree(double pixels) { this->pixelsPerDegree = pixels; }
+
+    // setMaxSteps function
+    void AimController::setMaxSteps(int steps) { this->maxSteps = steps; }
+
+    void AimController::reset()
+    {
+        integral[YAW] = integral[PITCH] = 0;
+        lastError[YAW] = lastError[PITCH] = 0;
+        pending[YAW] = pending[PITCH] = 0;
+        speed[YAW] = speed[PITCH] = 0;
+        hasLast = false;
+    }
+
+    void AimController::update(double errorX, double errorY, double dt, int &yawSteps,
+        int &pitchSteps)
+    {
+        dt = dt < MIN_DT ? MIN_DT : dt > MAX_DT ? MAX_DT : dt;
+
+        yawSteps = updateAxis(YAW, errorX, dt);
+        pitchSteps = updateAxis(PITCH, errorY, dt);
+        hasLast = true;
+    }
+
+    void AimController::predictServo(int axis, double dt)
+    {
+        // Step the profile the way the Arduino does, with the pending turn as the distance left
+        for(double t = 0; t < dt; t += SERVO_PERIOD)
+        {
+            double distance = fabs(pending[axis]);
+            double accel = SERVO_ACCEL * SERVO_PERIOD;  // the speed change in one update
+
+            if(distance <= accel * SERVO_PERIOD && fabs(speed[axis]) <= accel)
+            {
+                pending[axis] = 0;
+                speed[axis] = 0;
+                return;
+            }
+            if(speed[axis] > 0 && speed[axis] * (speed[axis] + accel) >= 2 * SERVO_ACCEL * distance)
+                speed[axis] -= accel;
+            else
+                speed[axis] = fmin(speed[axis] + accel, SERVO_MAX_SPEED);
+            speed[axis] = fmin(speed[axis], distance / SERVO_PERIOD);
+
+            pending[axis] -= pending[axis] > 0 ? speed[axis] * SERVO_PERIOD : -speed[axis] * SERVO_PERIOD;
+        }
+    }
+
+    int AimController::updateAxis(int axis, double error, double dt)
+    {
+        double limit = maxSteps * STEP_DEGREES;  // the most degrees in one frame
+
+        // Take off the part of the last turns the servo hasn't done yet, which the frame doesn't show
+        predictServo(axis, dt);
+        error -= pending[axis] * pixelsPerDegree;
+
+        // Inside the dead zone the target is centered, and nothing is left to integrate
+        if(fabs(error) <= deadZone)
+        {
+            error = 0;
+            integral[axis] = 0;
+        }
+
+        double derivative = hasLast ? (error - lastError[axis]) / dt : 0;
+        lastError[axis] = error;
+
+        // Only keep the new integral if it doesn't push an output that is already at its limit
+        double candidate = integral[axis] + error * dt;
+        double output = kp * error + ki * candidate + kd * derivative;
+        if(fabs(output) <= limit || output * error < 0)
+            integral[axis] = candidate;
+        else
+            output = kp * error + ki * integral[axis] + kd * derivative;
+
+        if(output > limit)
+            output = limit;
+        else if(output < -limit)
+            output = -limit;
+
+        // A step is bigger than the dead zone, so a target outside it always gets at least one
+        int steps = (int)lround(output / STEP_DEGREES);
+        if(!steps && error)
+            steps = error > 0 ? 1 : -1;
+
+        pending[axis] += steps * STEP_DEGREES;
+        return steps;
+    }
+}
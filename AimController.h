@@ -0,0 +1,113 @@
+#ifndef AIMCONTROLLER_H
+#define	AIMCONTROLLER_H
+
+namespace SniperBot
+{
+    /** AimController Class
+     * Purpose: Turns how far the target is from the middle of the camera's view into camera
+     * steps, once per frame, with a PID controller on each axis. A far target gets several
+     * steps in one frame and a near one gets none, so the camera turns straight to the target
+     * instead of one step a frame. The servos take a few frames to finish a turn, so the
+     * controller follows each turn it asked for with a model of the Arduino's velocity profile
+     * and takes the part not done yet off the error, instead of asking for it again. The
+     * integral only builds while the output is not at its limit, so a long turn does not wind
+     * it up, and it is cleared inside the dead zone.
+     */
+    class AimController
+    {
+    public:
+        /** The degrees the camera turns for one look command, which must match SniperBot.cpp */
+        static const int STEP_DEGREES = 2;
+
+        /** The yaw axis, where positive steps turn the camera left */
+        static const int YAW = 0;
+
+        /** The pitch axis, where positive steps turn the camera up */
+        static const int PITCH = 1;
+
+        // The Arduino's camera velocity profile, which must match SniperBot.cpp
+        static const int SERVO_MAX_SPEED = 300;  // degrees a second
+        static const int SERVO_ACCEL = 4000;  // degrees a second squared
+
+    private:
+        double kp;  // degrees to turn for each pixel of error
+        double ki;  // degrees to turn for each pixel second of integrated error
+        double kd;  // degrees to turn for each pixel per second the error changes
+        double deadZone;  // pixels from the middle of the view that count as centered
+        int maxSteps;  // the most steps on one axis in one frame
+        double pixelsPerDegree;  // how far the view moves when the camera turns one degree
+        double pending[2];  // degrees of each axis's turns that the servo has not done yet
+        double speed[2];  // degrees a second each servo is turning toward its pending turn
+        double integral[2];  // the integrated error of each axis, in pixel seconds
+        double lastError[2];  // the error of each axis in the last frame
+        bool hasLast;  // is lastError from the last frame
+
+        /** Runs one axis's controller for one frame
+         * @param axis YAW or PITCH
+         * @param error pixels from the middle of the view to the target, positive when the
+         * camera has to turn left or up
+         * @param dt seconds since the last frame
+         * @return the steps to turn, positive for left or up
+         */
+        int updateAxis(int axis, double error, double dt);
+
+        /** Moves one axis's model of the servo forward by the time between frames
+         * @param axis YAW or PITCH
+         * @param dt seconds since the last frame
+         */
+        void predictServo(int axis, double dt);
+
+    public:
+
+        /** Constructor to create an AimController object with gains for a 640x480 camera with
+         * about a 60 degree field of view
+         */
+        AimController();
+
+        /** Sets the gains of both axes
+         * @param kp degrees to turn for each pixel of error
+         * @param ki degrees to turn for each pixel second of integrated error
+         * @param kd degrees to turn for each pixel per second the error changes
+         */
+        void setGains(double kp, double ki, double kd);
+
+        /** Gets the dead zone
+         * @return the pixels from the middle of the view that count as centered
+         */
+        double getDeadZone();
+
+        /** Sets the dead zone. A target this close to the middle on an axis gets no steps on
+         * that axis. It should be at least half a step's pixels, or the camera hunts around the
+         * middle.
+         * @param pixels the pixels from the middle of the view that count as centered
+         */
+        void setDeadZone(double pixels);
+
+        /** Sets how far the view moves when the camera turns one degree
+         * @param pixels the pixels per degree, the frame's width over the camera's horizontal
+         * field of view
+         */
+        void setPixelsPerDegree(double pixels);
+
+        /** Sets the most steps on one axis in one frame
+         * @param steps the most steps
+         */
+        void setMaxSteps(int steps);
+
+        /** Forgets the integral and the last error, for aiming at a new target */
+        void reset();
+
+        /** Runs the controller for one frame
+         * @param errorX pixels from the target to the middle of the view, positive when the
+         * target is left of the middle
+         * @param errorY pixels from the target to the middle of the view, positive when the
+         * target is above the middle
+         * @param dt seconds since the last frame
+         * @param yawSteps a reference to a variable to hold the steps to turn, positive for left
+         * @param pitchSteps a reference to a variable to hold the steps to turn, positive for up
+         */
+        void update(double errorX, double errorY, double dt, int &yawSteps, int &pitchSteps);
+    };
+}
+
+#endif	/* AIMCONTROLLER_H */
@@ -0,0 +1,2214 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <stdlib.h>
+#include <math.h>
+#include "opencv2/core/core.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+#include "opencv2/imgcodecs/imgcodecs.hpp"
+#include "ColorDetection.h"
+#include "ColorKernel.h"
+#include "FrameGrabber.h"
+#include "BlobDetector.h"
+#include "MemoryFrameSource.h"
+#include "Trace.h"
+#include "GPIO.h"
+#include "GPIOLineGroup.h"
+#include "EdgeMonitor.h"
+#include "SerialLink.h"
+#include "CommandSender.h"
+#include "AimController.h"
+#include "SnapshotCell.h"
+#include "PipelineStage.h"
+#include "DetectorGroup.h"
+#include "MjpegFrameSource.h"
+#include "V4L2Capture.h"
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace cv;
+using namespace std;
+using namespace SniperBot;
+
+/** Creates a noisy test frame with a colored blob in it
+ * @param size the size of the frame
+ * @param color the BGR color of the blob
+ * @return the test frame
+ */
+Mat makeFrame(Size size, Scalar color)
+{
+    Mat frame(size, CV_8UC3);
+    RNG rng(12345);  // fixed seed so every run uses the same frames
+
+    rng.fill(frame, RNG::UNIFORM, Scalar::all(0), Scalar::all(256));  // random background
+    circle(frame, Point(size.width / 3, size.height / 2), size.height / 6, color, -1);
+
+    return frame;
+}
+
+/** Times the findColorInFrame function using the specified process mode
+ * @param cd the color detector to time
+ * @param frame the frame to search
+ * @param mode the process mode to use
+ * @param iterations how many times to search the frame
+ * @param x a reference to a variable to hold the x coordinate of the color
+ * @param y a reference to a variable to hold the y coordinate of the color
+ * @param reallocations a reference to a variable to hold the number of work buffer
+ * reallocations after the first search
+ * @return the average time of a search in milliseconds
+ */
+double timeMode(ColorDetector &cd, const Mat &frame, int mode, int iterations, int &x, int &y,
+    long &reallocations)
+{
+    Mat work;  // copy of the frame, since the crosshair is drawn on it
+    double total = 0;  // total ticks spent searching
+    long warm = 0;  // work buffer reallocations after the first search
+
+    cd.setProcessMode(mode);
+    for(int i = 0; i < iterations; ++i)
+    {
+        frame.copyTo(work);
+        int64 start = getTickCount();
+        cd.findColorInFrame(work, x, y);
+        total += (double)(getTickCount() - start);
+
+        if(i == 0)
+            warm = cd.getBufferReallocations();
+    }
+
+    reallocations = cd.getBufferReallocations() - warm;
+    return total * 1000.0 / getTickFrequency() / iterations;
+}
+
+/** Counts how many pixels differ between the OpenCV threshold and morphology and the fused
+ * threshold and morphology
+ * @param frame the frame to threshold
+ * @param range the HSV range to threshold with
+ * @return the number of pixels that differ
+ */
+int countMaskDifferences(const Mat &frame, const HSVRange &range)
+{
+    Mat hsv, expected, actual, temp;
+    Mat kernel = getStructuringElement(MORPH_ELLIPSE, Size(5, 5));
+
+    cvtColor(frame, hsv, COLOR_BGR2HSV);
+    inRange(hsv, Scalar(range.lower[0], range.lower[1], range.lower[2]),
+        Scalar(range.upper[0], range.upper[1], range.upper[2]), expected);
+    thresholdMoments(frame, range, &actual, NULL);
+    int differences = countNonZero(expected != actual);
+
+    erode(expected, expected, kernel);
+    dilate(expected, expected, kernel);
+    dilate(expected, expected, kernel);
+    erode(expected, expected, kernel);
+    erodeEllipse5(actual, temp);
+    dilateEllipse5(temp, actual);
+    dilateEllipse5(actual, temp);
+    erodeEllipse5(temp, actual);
+
+    return differences + countNonZero(expected != actual);
+}
+
+/** Times each process mode over several frame sizes
+ * @return error code, if any
+ */
+int benchmarkModes()
+{
+    Size sizes[] = { Size(320, 240), Size(640, 480), Size(1280, 720), Size(1920, 1080) };
+    int iterations = 50;  // searches per mode and frame size
+    VideoCapture cap;  // unused, the frames are passed in directly
+    ColorDetector cd(cap, ColorDetector::GREEN, false, ColorDetector::DEFAULT_WINDOW_WIDTH, false);
+    HSVRange range;
+
+    ColorDetector::getColorRange(ColorDetector::GREEN, range);
+
+    cout << setw(10) << "size" << setw(12) << "legacy ms" << setw(12) << "exact ms"
+        << setw(12) << "fast ms" << setw(11) << "exact spd" << setw(10) << "fast spd"
+        << setw(10) << "mask diff" << setw(10) << "match" << setw(10) << "reallocs" << endl;
+
+    for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+    {
+        Mat frame = makeFrame(sizes[i], Scalar(40, 150, 60));
+        int lx, ly, ex, ey, fx, fy;  // x and y found by each mode
+        long la, ea, fa;  // steady state work buffer reallocations of each mode
+
+        double legacy = timeMode(cd, frame, ColorDetector::PROCESS_LEGACY, iterations, lx, ly, la);
+        double exact = timeMode(cd, frame, ColorDetector::PROCESS_FUSED_EXACT, iterations, ex, ey, ea);
+        double fast = timeMode(cd, frame, ColorDetector::PROCESS_FUSED_FAST, iterations, fx, fy, fa);
+
+        cout << setw(10) << (to_string(sizes[i].width) + "x" + to_string(sizes[i].height))
+            << fixed << setprecision(3)
+            << setw(12) << legacy << setw(12) << exact << setw(12) << fast
+            << setprecision(2)
+            << setw(11) << legacy / exact << setw(10) << legacy / fast
+            << setw(10) << countMaskDifferences(frame, range)
+            << setw(10) << (lx == ex && ly == ey ? "yes" : "NO")
+            << setw(10) << la + ea + fa << endl;
+    }
+
+    return 0;
+}
+
+/** Times searching for 1 to 4 colors in one pass against searching for each color in its
+ * own pass
+ * @return error code, if any
+ */
+int benchmarkColors()
+{
+    int codes[] = { ColorDetector::GREEN, ColorDetector::RED, ColorDetector::BLUE,
+        ColorDetector::YELLOW };
+    Scalar colors[] = { Scalar(40, 150, 60), Scalar(40, 20, 200), Scalar(200, 60, 20),
+        Scalar(30, 200, 220) };
+    int iterations = 50;  // searches per color count
+    VideoCapture cap;  // unused, the frames are passed in directly
+    ColorDetector cd(cap, ColorDetector::GREEN, false, ColorDetector::DEFAULT_WINDOW_WIDTH, false);
+    vector<ColorResult> results;
+    Mat frame = makeFrame(Size(640, 480), colors[0]);
+    Mat work;  // copy of the frame, since the crosshair is drawn on it
+
+    // Add a blob of each of the other colors
+    for(int i = 1; i < 4; ++i)
+        circle(frame, Point(120 + 130 * i, 120 + 80 * (i % 2)), 60, colors[i], -1);
+
+    cout << setw(8) << "colors" << setw(14) << "one pass ms" << setw(14) << "n passes ms"
+        << setw(10) << "found" << endl;
+
+    for(int n = 1; n <= 4; ++n)
+    {
+        double onePass = 0, nPasses = 0;  // total ticks of each method
+        int found = 0;  // the number of colors found in one pass
+
+        cd.setTargetColors(vector<int>(codes, codes + n));
+        for(int i = 0; i < iterations; ++i)
+        {
+            frame.copyTo(work);
+            int64 start = getTickCount();
+            cd.findColorsInFrame(work, results);
+            onePass += (double)(getTickCount() - start);
+
+            for(int c = 0; c < n; ++c)
+            {
+                int x, y;
+                frame.copyTo(work);
+                cd.setColor(codes[c]);
+                start = getTickCount();
+                cd.findColorInFrame(work, x, y);
+                nPasses += (double)(getTickCount() - start);
+            }
+        }
+
+        for(size_t i = 0; i < results.size(); ++i)
+            found += results[i].found ? 1 : 0;
+
+        cout << setw(8) << n << fixed << setprecision(3)
+            << setw(14) << onePass * 1000.0 / getTickFrequency() / iterations
+            << setw(14) << nPasses * 1000.0 / getTickFrequency() / iterations
+            << setw(10) << found << endl;
+    }
+
+    return 0;
+}
+
+/** Times following a moving target with and without the tracking window
+ * @return error code, if any
+ */
+int benchmarkTracking()
+{
+    Size sizes[] = { Size(640, 480), Size(1280, 720), Size(1920, 1080) };
+    int frames = 100;  // frames the target moves over
+    VideoCapture cap;  // unused, the frames are passed in directly
+    ColorDetector cd(cap, ColorDetector::GREEN, false, ColorDetector::DEFAULT_WINDOW_WIDTH, false);
+
+    cout << setw(10) << "size" << setw(12) << "full ms" << setw(12) << "window ms"
+        << setw(12) << "searched" << setw(10) << "lost" << endl;
+
+    for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+    {
+        Mat background = makeFrame(sizes[i], Scalar(0, 0, 0));
+        Mat work;
+        double total[2] = { 0, 0 };  // total ticks without and with the window
+        double searched = 0;  // total fraction of the frame searched with the window
+        int lost = 0;  // frames the target was not found with the window
+
+        for(int pass = 0; pass < 2; ++pass)
+        {
+            cd.setTrackingWindow(pass == 1);
+            for(int f = 0; f < frames; ++f)
+            {
+                int x, y;
+                background.copyTo(work);
+                circle(work, Point(sizes[i].width / 4 + f * 3, sizes[i].height / 2 + f),
+                    sizes[i].height / 10, Scalar(40, 150, 60), -1);
+
+                int64 start = getTickCount();
+                cd.findColorInFrame(work, x, y);
+                total[pass] += (double)(getTickCount() - start);
+
+                if(pass == 1)
+                {
+                    searched += cd.getSearchWindow().area() / (double)sizes[i].area();
+                    lost += x == -1 ? 1 : 0;
+                }
+            }
+        }
+
+        cout << setw(10) << (to_string(sizes[i].width) + "x" + to_string(sizes[i].height))
+            << fixed << setprecision(3)
+            << setw(12) << total[0] * 1000.0 / getTickFrequency() / frames
+            << setw(12) << total[1] * 1000.0 / getTickFrequency() / frames
+            << setw(11) << setprecision(1) << searched * 100 / frames << "%"
+            << setw(10) << lost << endl;
+    }
+
+    return 0;
+}
+
+/** Times BlobDetector against connectedComponentsWithStats on masks with many blobs, and
+ * checks that both find the same blobs
+ * @return error code, if any
+ */
+int benchmarkBlobs()
+{
+    Size sizes[] = { Size(320, 240), Size(640, 480), Size(1280, 720), Size(1920, 1080) };
+    int iterations = 50;  // runs per mask size
+    BlobDetector detector;
+    vector<Blob> blobs;
+
+    cout << setw(10) << "size" << setw(10) << "blobs" << setw(12) << "runs ms"
+        << setw(12) << "opencv ms" << setw(10) << "match" << endl;
+
+    for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+    {
+        Mat mask = Mat::zeros(sizes[i], CV_8UC1);
+        Mat labels, stats, centroids;
+        RNG rng(12345);  // fixed seed so every run uses the same masks
+        double total[2] = { 0, 0 };  // total ticks of each method
+        int found[2] = { 0, 0 };  // the number of blobs found by each method
+
+        // Scatter filled circles of random sizes, some of them overlapping
+        for(int c = 0; c < 60; ++c)
+            circle(mask, Point(rng.uniform(0, mask.cols), rng.uniform(0, mask.rows)),
+                rng.uniform(2, mask.rows / 12), Scalar(255), -1);
+
+        for(int n = 0; n < iterations; ++n)
+        {
+            int64 start = getTickCount();
+            found[0] = detector.findBlobs(mask, blobs);
+            total[0] += (double)(getTickCount() - start);
+
+            start = getTickCount();
+            found[1] = connectedComponentsWithStats(mask, labels, stats, centroids, 8, CV_32S) - 1;
+            total[1] += (double)(getTickCount() - start);
+        }
+
+        // Both label in scan order, so the blobs should line up one to one
+        bool match = found[0] == found[1];
+        for(int b = 0; match && b < found[0]; ++b)
+            match = blobs[b].area == stats.at<int>(b + 1, CC_STAT_AREA) &&
+                blobs[b].bounds.x == stats.at<int>(b + 1, CC_STAT_LEFT) &&
+                blobs[b].bounds.width == stats.at<int>(b + 1, CC_STAT_WIDTH) &&
+                fabs(blobs[b].x - centroids.at<double>(b + 1, 0)) < 1e-6;
+
+        cout << setw(10) << (to_string(sizes[i].width) + "x" + to_string(sizes[i].height))
+            << setw(10) << found[0] << fixed << setprecision(3)
+            << setw(12) << total[0] * 1000.0 / getTickFrequency() / iterations
+            << setw(12) << total[1] * 1000.0 / getTickFrequency() / iterations
+            << setw(10) << (match ? "yes" : "NO") << endl;
+    }
+
+    return 0;
+}
+
+/** Times the coarse-to-fine search at each pyramid level against the full resolution search,
+ * and reports the centroid error and the work done at each level
+ * @return error code, if any
+ */
+int benchmarkPyramid()
+{
+    Size sizes[] = { Size(640, 480), Size(1280, 720), Size(1920, 1080) };
+    int iterations = 30;  // searches per level and frame size
+    VideoCapture cap;  // unused, the frames are passed in directly
+    ColorDetector cd(cap, ColorDetector::GREEN, false, ColorDetector::DEFAULT_WINDOW_WIDTH, false);
+
+    // The first region only overlaps the union of the other two, so it has to be merged after
+    // it was already checked against both of them
+    vector<Rect> regions;
+    regions.push_back(Rect(0, 30, 4, 4));
+    regions.push_back(Rect(0, 0, 10, 10));
+    regions.push_back(Rect(5, 5, 30, 30));
+    ColorDetector::mergeOverlapping(regions);
+    bool merged = regions.size() == 1 && regions[0] == Rect(0, 0, 35, 35);
+    cout << "Overlapping regions merged: " << (merged ? "yes" : "NO") << endl;
+    if(!merged)
+        return 1;
+
+    cout << setw(10) << "size" << setw(7) << "level" << setw(10) << "ms" << setw(10) << "error"
+        << setw(14) << "coarse px" << setw(10) << "regions" << setw(12) << "full px" << endl;
+
+    for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+    {
+        Mat frame = makeFrame(sizes[i], Scalar(40, 150, 60));
+        Mat work;
+        int fullX = -1, fullY = -1;  // the target found by the full resolution search
+
+        for(int level = 0; level <= 4; ++level)
+        {
+            double total = 0;  // total ticks spent searching
+            int x = -1, y = -1;
+
+            cd.setPyramidLevel(level);
+            for(int n = 0; n < iterations; ++n)
+            {
+                frame.copyTo(work);
+                int64 start = getTickCount();
+                cd.findColorInFrame(work, x, y);
+                total += (double)(getTickCount() - start);
+            }
+
+            if(level == 0)
+            {
+                fullX = x;
+                fullY = y;
+            }
+
+            cout << setw(10) << (to_string(sizes[i].width) + "x" + to_string(sizes[i].height))
+                << setw(7) << level << fixed << setprecision(3)
+                << setw(10) << total * 1000.0 / getTickFrequency() / iterations
+                << setprecision(1) << setw(10) << sqrt(pow(x - fullX, 2.0) + pow(y - fullY, 2.0));
+            if(level > 0)
+            {
+                const vector<PyramidLevelWork> &levels = cd.getPyramidWork();
+                cout << setw(14) << levels[0].pixels << setw(10) << levels[1].regions
+                    << setw(12) << levels[1].pixels;
+            }
+            else
+                cout << setw(14) << "-" << setw(10) << 1 << setw(12) << sizes[i].area();
+            cout << endl;
+        }
+    }
+
+    cd.setPyramidLevel(0);
+    return 0;
+}
+
+/** Scene Struct
+ * Purpose: Describes a generated test scene with a known target.
+ */
+struct Scene
+{
+    Size size;  // the frame size
+    int blobs;  // the number of blobs of the target color. The first one is the target and the rest are smaller.
+    double noise;  // the standard deviation of the pixel noise
+    double light;  // the brightness gain applied to the whole frame
+};
+
+/** Config Struct
+ * Purpose: Describes a color detector setup to run the scenes with.
+ */
+struct Config
+{
+    const char *name;  // the name of the setup
+    int processMode;  // the detector's process mode
+    bool blobMode;  // should the detector aim at one blob
+    int pyramidLevel;  // the detector's pyramid level
+};
+
+/** Generates the frames of a scene. The target moves across the frame while the smaller
+ * blobs stay still.
+ * @param scene the scene to generate
+ * @param numFrames the number of frames to generate
+ * @param source the frame source to add the frames to
+ * @param truth a reference to a vector that will hold the target's center in each frame
+ */
+void makeScene(const Scene &scene, int numFrames, MemoryFrameSource &source, vector<Point> &truth)
+{
+    Scalar color(40, 150, 60);  // the target color, inside the green range
+    int w = scene.size.width, h = scene.size.height;
+    int radius = h / 8;  // the radius of the target
+    RNG rng(12345);  // fixed seed so every run uses the same scenes
+    Mat background(scene.size, CV_8UC3);
+
+    // Gray background that gets brighter from left to right
+    for(int x = 0; x < w; ++x)
+        background.col(x).setTo(Scalar::all(60 + 140 * x / w));
+
+    source.clear();
+    truth.clear();
+    for(int f = 0; f < numFrames; ++f)
+    {
+        Mat frame = background.clone();
+        Point center((int)(w * (0.3 + 0.4 * f / numFrames)), (int)(h * (0.5 + 0.15 * sin(f * 0.2))));
+
+        // The smaller blobs sit at the sides, out of the target's path
+        for(int b = 1; b < scene.blobs; ++b)
+            circle(frame, Point(b % 2 ? w / 8 : w * 7 / 8, b <= 2 ? h / 4 : h * 3 / 4),
+                radius / 2, color, -1);
+        circle(frame, center, radius, color, -1);
+
+        // Shift the lighting and add noise
+        Mat noisy;
+        frame.convertTo(noisy, CV_16SC3, scene.light);
+        if(scene.noise > 0)
+        {
+            Mat noise(scene.size, CV_16SC3);
+            rng.fill(noise, RNG::NORMAL, Scalar::all(0), Scalar::all(scene.noise));
+            noisy += noise;
+        }
+        noisy.convertTo(frame, CV_8UC3);
+
+        source.addFrame(frame);
+        truth.push_back(center);
+    }
+}
+
+/** Gets a percentile of a sorted list of values
+ * @param sorted the values, sorted from smallest to largest
+ * @param p the percentile, from 0 to 100
+ * @return the value at the percentile
+ */
+double percentile(const vector<double> &sorted, double p)
+{
+    size_t i = (size_t)(p / 100 * (sorted.size() - 1) + 0.5);
+    return sorted[min(i, sorted.size() - 1)];
+}
+
+/** Runs the color detector over generated scenes of several sizes, blob counts, noise levels
+ * and lighting shifts, and reports latency percentiles, throughput, and the centroid error
+ * against the known target position
+ * @param jsonFile if not empty, the file to write the results to as JSON
+ * @return error code, if any
+ */
+int benchmarkSuite(const string &jsonFile)
+{
+    Size sizes[] = { Size(320, 240), Size(640, 480), Size(1280, 720), Size(1920, 1080) };
+    int blobCounts[] = { 1, 3 };
+    double noises[] = { 0, 15 };
+    double lights[] = { 0.8, 1.0, 1.2 };
+    Config configs[] = {
+        { "moments", ColorDetector::PROCESS_FUSED_EXACT, false, 0 },
+        { "blob", ColorDetector::PROCESS_FUSED_EXACT, true, 0 },
+        { "pyramid", ColorDetector::PROCESS_FUSED_EXACT, true, 2 } };
+    int numFrames = 30;  // frames per scene
+    VideoCapture cap;  // unused, the frames come from the memory frame source
+    MemoryFrameSource source;
+    ColorDetector cd(cap, ColorDetector::GREEN, false, ColorDetector::DEFAULT_WINDOW_WIDTH, false);
+    vector<Point> truth;  // the target's center in each frame
+    vector<double> latencies;  // the time of each frame in milliseconds
+    ofstream json;
+    bool first = true;  // no comma before the first JSON result
+
+    cd.setFrameSource(&source);
+    if(!jsonFile.empty())
+    {
+        json.open(jsonFile.c_str());
+        if(!json)
+        {
+            cout << "Error: Could not write " << jsonFile << endl;
+            return 1;
+        }
+        json << "[" << endl;
+    }
+
+    cout << setw(10) << "size" << setw(6) << "blobs" << setw(6) << "noise" << setw(6) << "light"
+        << setw(9) << "config" << setw(9) << "p50 ms" << setw(9) << "p90 ms" << setw(9) << "p99 ms"
+        << setw(8) << "fps" << setw(8) << "found" << setw(9) << "mean px" << setw(9) << "max px"
+        << endl;
+
+    for(size_t si = 0; si < sizeof(sizes) / sizeof(sizes[0]); ++si)
+    for(size_t bi = 0; bi < sizeof(blobCounts) / sizeof(blobCounts[0]); ++bi)
+    for(size_t ni = 0; ni < sizeof(noises) / sizeof(noises[0]); ++ni)
+    for(size_t li = 0; li < sizeof(lights) / sizeof(lights[0]); ++li)
+    {
+        Scene scene = { sizes[si], blobCounts[bi], noises[ni], lights[li] };
+        makeScene(scene, numFrames, source, truth);
+
+        for(size_t ci = 0; ci < sizeof(configs) / sizeof(configs[0]); ++ci)
+        {
+            const Config &config = configs[ci];
+            int found = 0;  // frames the target was found in
+            double errorSum = 0, errorMax = 0;  // centroid error of the frames it was found in
+            double total = 0;  // total time in milliseconds
+
+            cd.setProcessMode(config.processMode);
+            cd.setBlobMode(config.blobMode);
+            cd.setPyramidLevel(config.pyramidLevel);
+            source.rewind();
+            latencies.clear();
+
+            for(int f = 0; f < numFrames; ++f)
+            {
+                int x, y;
+                int64 start = getTickCount();
+                if(cd.findColorFromCam(x, y) != ColorDetector::ERROR_NONE)
+                    break;
+                double ms = (getTickCount() - start) * 1000.0 / getTickFrequency();
+                latencies.push_back(ms);
+                total += ms;
+
+                if(x != -1)
+                {
+                    double error = sqrt(pow(x - truth[f].x, 2.0) + pow(y - truth[f].y, 2.0));
+                    ++found;
+                    errorSum += error;
+                    errorMax = max(errorMax, error);
+                }
+            }
+
+            sort(latencies.begin(), latencies.end());
+            double p50 = percentile(latencies, 50), p90 = percentile(latencies, 90);
+            double p99 = percentile(latencies, 99);
+            double fps = latencies.size() * 1000.0 / total;
+            double errorMean = found ? errorSum / found : 0;
+            string size = to_string(scene.size.width) + "x" + to_string(scene.size.height);
+
+            cout << setw(10) << size << setw(6) << scene.blobs << fixed << setprecision(0)
+                << setw(6) << scene.noise << setprecision(1) << setw(6) << scene.light
+                << setw(9) << config.name << setprecision(3) << setw(9) << p50 << setw(9) << p90
+                << setw(9) << p99 << setprecision(1) << setw(8) << fps
+                << setw(5) << found << "/" << setw(2) << numFrames
+                << setprecision(2) << setw(9) << errorMean << setw(9) << errorMax << endl;
+
+            if(json.is_open())
+            {
+                json << (first ? "" : ",\n") << "  {\"size\": \"" << size << "\", \"blobs\": "
+                    << scene.blobs << ", \"noise\": " << scene.noise << ", \"light\": "
+                    << scene.light << ", \"config\": \"" << config.name << "\", \"frames\": "
+                    << numFrames << ", \"p50_ms\": " << p50 << ", \"p90_ms\": " << p90
+                    << ", \"p99_ms\": " << p99 << ", \"fps\": " << fps << ", \"found\": "
+                    << found << ", \"mean_error_px\": " << errorMean << ", \"max_error_px\": "
+                    << errorMax << "}";
+                first = false;
+            }
+        }
+    }
+
+    if(json.is_open())
+        json << endl << "]" << endl;
+
+    return 0;
+}
+
+/** Times the color detector with tracing off and on to measure the cost of the trace spans,
+ * then writes the trace
+ * @param traceFile the file to write the trace to
+ * @return error code, if any
+ */
+int benchmarkTrace(const string &traceFile)
+{
+    Size sizes[] = { Size(320, 240), Size(640, 480), Size(1280, 720) };
+    int modes[] = { ColorDetector::PROCESS_LEGACY, ColorDetector::PROCESS_FUSED_EXACT,
+        ColorDetector::PROCESS_FUSED_FAST };
+    const char *modeNames[] = { "legacy", "exact", "fast" };
+    int iterations = 200;  // searches per mode, frame size and trace setting
+    VideoCapture cap;  // unused, the frames are passed in directly
+    ColorDetector cd(cap, ColorDetector::GREEN, false, ColorDetector::DEFAULT_WINDOW_WIDTH, false);
+    int x, y;
+    long reallocations;
+
+    cd.setBlobMode(true);
+
+    cout << setw(10) << "size" << setw(8) << "mode" << setw(12) << "off (ms)"
+        << setw(12) << "on (ms)" << setw(12) << "overhead" << endl;
+
+    for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        Mat frame = makeFrame(sizes[s], Scalar(40, 150, 60));
+
+        for(size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m)
+        {
+            // Warm up the work buffers and the trace ring before timing
+            Tracer::setEnabled(true);
+            timeMode(cd, frame, modes[m], 5, x, y, reallocations);
+
+            Tracer::setEnabled(false);
+            double off = timeMode(cd, frame, modes[m], iterations, x, y, reallocations);
+            Tracer::setEnabled(true);
+            double on = timeMode(cd, frame, modes[m], iterations, x, y, reallocations);
+
+            cout << setw(10) << (to_string(sizes[s].width) + "x" + to_string(sizes[s].height))
+                << setw(8) << modeNames[m] << fixed << setprecision(3) << setw(12) << off
+                << setw(12) << on << setprecision(2) << setw(11) << (on - off) / off * 100 << "%"
+                << endl;
+        }
+    }
+
+    if(Tracer::dump(traceFile) != Tracer::ERROR_NONE)
+    {
+        cout << "Error: Could not write " << traceFile << endl;
+        return 1;
+    }
+    cout << "Trace written to " << traceFile << endl;
+
+    return 0;
+}
+
+/** Makes a temporary directory tree laid out like /sys/class/gpio
+ * @param pins the pin numbers
+ * @return the root of the tree, empty if it could not be made
+ */
+string makeGPIOTree(const vector<string> &pins)
+{
+    char root[] = "/tmp/sniperbot-gpio-XXXXXX";
+
+    if(!mkdtemp(root))
+        return "";
+
+    ofstream((string(root) + "/export").c_str());
+    ofstream((string(root) + "/unexport").c_str());
+    for(size_t i = 0; i < pins.size(); ++i)
+    {
+        string pinDir = string(root) + "/gpio" + pins[i];
+        mkdir(pinDir.c_str(), 0755);
+        ofstream((pinDir + "/direction").c_str()) << "out";
+        ofstream((pinDir + "/value").c_str()) << "0";
+    }
+
+    return root;
+}
+
+/** Removes a directory tree made by makeGPIOTree
+ * @param root the root of the tree
+ * @param pins the pin numbers the tree was made with
+ */
+void removeGPIOTree(const string &root, const vector<string> &pins)
+{
+    for(size_t i = 0; i < pins.size(); ++i)
+    {
+        string pinDir = root + "/gpio" + pins[i];
+        unlink((pinDir + "/value").c_str());
+        unlink((pinDir + "/direction").c_str());
+        rmdir(pinDir.c_str());
+    }
+    unlink((root + "/export").c_str());
+    unlink((root + "/unexport").c_str());
+    rmdir(root.c_str());
+}
+
+/** Times setting and reading a pin by opening the value file on every call, the way GPIO used
+ * to, against the GPIO class keeping the value file open. A temporary directory stands in for
+ * sysfs, so this measures the file handling and not the hardware.
+ * @return error code, if any
+ */
+int benchmarkGPIO()
+{
+    int iterations = 100000;  // writes and reads per method
+    vector<string> pins(1, "4");
+    string root = makeGPIOTree(pins);
+    string valuePath = root + "/gpio4/value";
+    string value;
+    bool state;
+
+    if(root.empty())
+    {
+        cout << "Error: Could not make a temporary GPIO directory" << endl;
+        return 1;
+    }
+
+    // Open, write or read, and close the value file on every call
+    int64 start = getTickCount();
+    for(int i = 0; i < iterations; ++i)
+    {
+        ofstream setvalgpio(valuePath.c_str());
+        setvalgpio << (i & 1 ? "1" : "0");
+        setvalgpio.close();
+        ifstream getvalgpio(valuePath.c_str());
+        getvalgpio >> value;
+        getvalgpio.close();
+    }
+    double reopen = (getTickCount() - start) * 1e6 / getTickFrequency() / iterations;
+
+    // Keep the value file open
+    GPIO pin("4", root);
+    bool correct = true;  // did every read return what was written
+    start = getTickCount();
+    for(int i = 0; i < iterations; ++i)
+    {
+        pin.setval_gpio((i & 1) != 0);
+        pin.getval_gpio(state);
+        correct = correct && state == ((i & 1) != 0);
+    }
+    double persistent = (getTickCount() - start) * 1e6 / getTickFrequency() / iterations;
+
+    cout << fixed << setprecision(3);
+    cout << "Reopening the file: " << reopen << " us per write and read" << endl;
+    cout << "Keeping it open:    " << persistent << " us per write and read ("
+        << setprecision(1) << reopen / persistent << "x faster)" << endl;
+    cout << "Reads matched writes: " << (correct ? "yes" : "no") << endl;
+
+    removeGPIOTree(root, pins);
+
+    return correct ? 0 : 1;
+}
+
+/** Sends every command over a line group and checks that the data is only ever seen whole:
+ * the data changes with the trigger low, and the trigger then rises with the data unchanged
+ * @param bus the line group, with the data on lines 0 to 3 and the trigger on line 4
+ * @return true if every command was sent glitch free
+ */
+bool checkBusCommands(FakeLineGroup &bus)
+{
+    for(unsigned long long command = 0; command < 16; ++command)
+    {
+        bus.clearHistory();
+        bus.strobe(command, 0xF, 4);
+
+        const vector<unsigned long long> &history = bus.getHistory();
+        if(history.size() != 2 || history[0] != command || history[1] != (command | 0x10))
+            return false;
+    }
+
+    return true;
+}
+
+/** Times sending a command to the Arduino with one sysfs write per pin against one line group
+ * change for the data and one for the trigger. The sysfs pins are a temporary directory. If a
+ * GPIO chip is given, the line group is also timed on the real lines, which toggles pins 4,
+ * 17, 27, 22 and 12.
+ * @param chip the GPIO chip device to time, empty to skip it
+ * @return error code, if any
+ */
+int benchmarkBus(const string &chip)
+{
+    int iterations = 20000;  // commands per method
+    const char *pinNumbers[] = { "4", "17", "27", "22", "12" };
+    vector<string> pins(pinNumbers, pinNumbers + 5);
+    string root = makeGPIOTree(pins);
+
+    if(root.empty())
+    {
+        cout << "Error: Could not make a temporary GPIO directory" << endl;
+        return 1;
+    }
+
+    // One write per pin, the trigger cleared first and set last
+    GPIO *gpio[5];
+    for(int i = 0; i < 5; ++i)
+        gpio[i] = new GPIO(pins[i], root);
+    int64 start = getTickCount();
+    for(int i = 0; i < iterations; ++i)
+    {
+        int command = i & 15;
+        gpio[4]->setval_gpio(false);
+        for(int b = 0; b < 4; ++b)
+            gpio[b]->setval_gpio((command >> b & 1) != 0);
+        gpio[4]->setval_gpio(true);
+    }
+    double sysfs = (getTickCount() - start) * 1e6 / getTickFrequency() / iterations;
+    for(int i = 0; i < 5; ++i)
+        delete gpio[i];
+    removeGPIOTree(root, pins);
+
+    FakeLineGroup fake;
+    bool glitchFree = checkBusCommands(fake);
+
+    cout << fixed << setprecision(3);
+    cout << "sysfs, one write per pin: " << sysfs << " us per command" << endl;
+    cout << "Line group sends each command in 2 changes with no half written data: "
+        << (glitchFree ? "yes" : "no") << endl;
+
+    if(!chip.empty())
+    {
+        ChipLineGroup bus;
+        unsigned offsets[] = { 4, 17, 27, 22, 12 };
+        if(bus.open(chip, vector<unsigned>(offsets, offsets + 5), true) != GPIOLineGroup::ERROR_NONE)
+        {
+            cout << "Error: Could not request the lines from " << chip << endl;
+            return 1;
+        }
+
+        start = getTickCount();
+        for(int i = 0; i < iterations; ++i)
+            bus.strobe(i & 15, 0xF, 4);
+        double lines = (getTickCount() - start) * 1e6 / getTickFrequency() / iterations;
+
+        cout << "Line group on " << chip << ": " << lines << " us per command" << endl;
+    }
+
+    return glitchFree ? 0 : 1;
+}
+
+/** Times checking the 3 ultrasonic pins by reading each one against checking an edge monitor
+ * for changes, and measures how long a simulated edge takes to reach the monitor
+ * @return error code, if any
+ */
+int benchmarkEdges()
+{
+    int iterations = 100000;  // checks per method
+    int edges = 10000;  // simulated edges
+    const char *pinNumbers[] = { "5", "6", "13" };
+    vector<string> pins(pinNumbers, pinNumbers + 3);
+    string root = makeGPIOTree(pins);
+    bool state;
+
+    if(root.empty())
+    {
+        cout << "Error: Could not make a temporary GPIO directory" << endl;
+        return 1;
+    }
+
+    // Read every pin on every pass
+    GPIO left(pins[0], root), right(pins[1], root), front(pins[2], root);
+    int64 start = getTickCount();
+    for(int i = 0; i < iterations; ++i)
+    {
+        left.getval_gpio(state);
+        right.getval_gpio(state);
+        front.getval_gpio(state);
+    }
+    double reads = (getTickCount() - start) * 1e6 / getTickFrequency() / iterations;
+    removeGPIOTree(root, pins);
+
+    // Check the edge monitor when nothing changed
+    SimulatedEdgeSource sensors;
+    EdgeMonitor monitor;
+    vector<EdgeEvent> events;
+    if(monitor.addSource(&sensors) < 0)
+    {
+        cout << "Error: Could not watch the simulated sensors" << endl;
+        return 1;
+    }
+    start = getTickCount();
+    for(int i = 0; i < iterations; ++i)
+        monitor.poll(events, 0);
+    double checks = (getTickCount() - start) * 1e6 / getTickFrequency() / iterations;
+
+    // Time from an edge to the monitor handing it out
+    vector<double> latencies;
+    for(int i = 0; i < edges; ++i)
+    {
+        sensors.setLine(2, (i & 1) == 0);
+        monitor.poll(events, -1);
+        latencies.push_back((EdgeMonitor::now() - events[0].time) / 1000.0);
+    }
+    sort(latencies.begin(), latencies.end());
+
+    cout << fixed << setprecision(3);
+    cout << "Reading 3 pins:               " << reads << " us per pass" << endl;
+    cout << "Checking for edges:           " << checks << " us per pass" << endl;
+    cout << "Edge to control loop latency: p50 " << percentile(latencies, 50) << " us, p99 "
+        << percentile(latencies, 99) << " us, max " << latencies.back() << " us" << endl;
+
+    return 0;
+}
+
+/** Runs a stand-in Arduino on one end of a pseudo terminal, and measures how many commands
+ * per second get through the framed serial protocol and the round trip time of a ping. The
+ * pseudo terminal has no baud rate, so this measures the encoding, decoding and system calls,
+ * and the time on a real 115200 baud wire is shown next to it.
+ * @return error code, if any
+ */
+int benchmarkProtocol()
+{
+    int packets = 20000;  // packets sent for the throughput test
+    int batch = 5;  // commands per packet
+    int pings = 1000;  // round trips timed
+    SerialLink arduino, pi;  // the two ends of the link
+    string peer;  // the path of the Pi's end
+    atomic<bool> running(true);
+    atomic<long> received(0);  // commands the stand-in Arduino has received
+
+    if(arduino.openPseudoTerminal(peer) != SerialLink::ERROR_NONE ||
+            pi.open(peer) != SerialLink::ERROR_NONE)
+    {
+        cout << "Error: Could not make a pseudo terminal" << endl;
+        return 1;
+    }
+
+    // The stand-in Arduino counts commands and answers pings, like SniperBot.cpp does
+    thread echo([&]()
+    {
+        vector<Command> commands;
+        PacketBuilder reply;
+        while(running)
+        {
+            commands.clear();
+            arduino.receive(commands, 50);
+            for(size_t i = 0; i < commands.size(); ++i)
+            {
+                ++received;
+                if(commands[i].opcode == OP_PING)
+                {
+                    reply.clear();
+                    reply.add(OP_PONG, commands[i].a);
+                    arduino.send(reply);
+                }
+            }
+        }
+    });
+
+    // Send batches of aiming and driving commands as fast as possible
+    PacketBuilder packet;
+    int64 start = getTickCount();
+    for(int i = 0; i < packets; ++i)
+    {
+        packet.clear();
+        for(int c = 0; c < batch - 1; ++c)
+            packet.add(OP_SET_CAMERA, (int16_t)(900 + c), (int16_t)(900 - c));
+        packet.add(OP_DRIVE, -20, 100);
+        pi.send(packet);
+    }
+    while(received < (long)packets * batch)
+        this_thread::sleep_for(chrono::microseconds(100));
+    double seconds = (getTickCount() - start) / getTickFrequency();
+    int packetSize = packet.size();
+
+    // Time one ping at a time
+    vector<Command> replies;
+    vector<double> latencies;
+    bool correct = true;  // did every pong carry its ping's token
+    for(int i = 0; i < pings; ++i)
+    {
+        start = getTickCount();
+        packet.clear();
+        packet.add(OP_PING, (int16_t)i);
+        pi.send(packet);
+
+        replies.clear();
+        while(replies.empty())
+            pi.receive(replies, 100);
+        latencies.push_back((getTickCount() - start) * 1e6 / getTickFrequency());
+        correct = correct && replies[0].opcode == OP_PONG && replies[0].a == (int16_t)i;
+    }
+    sort(latencies.begin(), latencies.end());
+
+    running = false;
+    echo.join();
+
+    // A byte is 10 bits on the wire with a start and stop bit
+    double wireCommands = SerialLink::DEFAULT_BAUD / 10.0 / packetSize * batch;
+
+    cout << fixed << setprecision(1);
+    cout << "Throughput: " << packets * batch / seconds << " commands per second in packets of "
+        << batch << " (" << packetSize << " bytes, " << wireCommands
+        << " commands per second on a 115200 baud wire)" << endl;
+    cout << "Round trip: p50 " << percentile(latencies, 50) << " us, p99 "
+        << percentile(latencies, 99) << " us, max " << latencies.back() << " us" << endl;
+    cout << "Bad packets: " << arduino.getReceiveErrors() + pi.getReceiveErrors()
+        << ", pongs matched: " << (correct ? "yes" : "no") << endl;
+
+    return correct ? 0 : 1;
+}
+
+/** SysfsCommandOutput Class
+ * Purpose: Writes commands to 5 sysfs pins the way the robot does without the GPIO
+ * character device, with the trigger cleared first and set last.
+ */
+class SysfsCommandOutput : public CommandOutput
+{
+private:
+    GPIO **gpio;  // the 4 data pins and the trigger pin
+
+public:
+    SysfsCommandOutput(GPIO **gpio) { this->gpio = gpio; }
+
+    int write(const Command *commands, int count)
+    {
+        for(int i = 0; i < count; ++i)
+        {
+            gpio[4]->setval_gpio(false);
+            for(int b = 0; b < 4; ++b)
+                gpio[b]->setval_gpio((commands[i].opcode >> b & 1) != 0);
+            gpio[4]->setval_gpio(true);
+        }
+        return 0;
+    }
+};
+
+/** TimedCommandOutput Class
+ * Purpose: Keeps when each command was written, to check the command sender's spacing.
+ */
+class TimedCommandOutput : public CommandOutput
+{
+public:
+    vector<chrono::steady_clock::time_point> times;  // when each command was written
+
+    int write(const Command *commands, int count)
+    {
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        for(int i = 0; i < count; ++i)
+            times.push_back(now);
+        return 0;
+    }
+};
+
+/** Makes the commands the main loop sends each frame of a session. Searching sends
+ * CENTER_CAMERA and MOVE_FORWARD every frame, and aiming steps the camera toward a target
+ * and sends STOP_FIRING or START_FIRING every frame.
+ * @param frames the number of frames
+ * @return the commands of each frame
+ */
+vector<vector<int> > makeCommandScript(int frames)
+{
+    vector<vector<int> > script(frames);
+    int x = 0, y = 0;  // the camera steps left to reach the target
+
+    srand(7);
+    for(int i = 0; i < frames; ++i)
+    {
+        // Search for 40 frames, then aim at a new target for 60
+        if(i % 100 < 40)
+        {
+            script[i].push_back(OP_CENTER_CAMERA);
+            script[i].push_back(OP_MOVE_FORWARD);
+            continue;
+        }
+        if(i % 100 == 40)
+        {
+            script[i].push_back(OP_STOP);
+            x = rand() % 21 - 10;
+            y = rand() % 11 - 5;
+        }
+
+        if(x != 0)
+            script[i].push_back(x > 0 ? OP_LOOK_LEFT : OP_LOOK_RIGHT);
+        if(y != 0)
+            script[i].push_back(y > 0 ? OP_LOOK_UP : OP_LOOK_DOWN);
+        script[i].push_back(x == 0 && y == 0 ? OP_START_FIRING : OP_STOP_FIRING);
+        x -= x > 0 ? 1 : x < 0 ? -1 : 0;
+        y -= y > 0 ? 1 : y < 0 ? -1 : 0;
+    }
+
+    return script;
+}
+
+/** Times how long the vision thread spends sending a session's commands, writing them to
+ * sysfs pins inline against posting them to the command sender, and counts the commands the
+ * sender suppressed
+ * @return error code, if any
+ */
+int benchmarkSender()
+{
+    int frames = 1000;  // frames in the session
+    int frameTime = 2;  // milliseconds between frames
+    const char *pinNumbers[] = { "4", "17", "27", "22", "12" };
+    vector<string> pins(pinNumbers, pinNumbers + 5);
+    string root = makeGPIOTree(pins);
+    vector<vector<int> > script = makeCommandScript(frames);
+
+    if(root.empty())
+    {
+        cout << "Error: Could not make a temporary GPIO directory" << endl;
+        return 1;
+    }
+
+    GPIO *gpio[5];
+    for(int i = 0; i < 5; ++i)
+        gpio[i] = new GPIO(pins[i], root);
+    SysfsCommandOutput output(gpio);
+
+    // Write every command on the vision thread, like sendCommand used to
+    vector<double> inlineTimes;
+    long inlineCommands = 0;
+    for(int i = 0; i < frames; ++i)
+    {
+        int64 start = getTickCount();
+        for(size_t c = 0; c < script[i].size(); ++c)
+        {
+            Command command = { (uint8_t)script[i][c], 0, 0 };
+            output.write(&command, 1);
+        }
+        inlineTimes.push_back((getTickCount() - start) * 1e6 / getTickFrequency());
+        inlineCommands += script[i].size();
+        this_thread::sleep_for(chrono::milliseconds(frameTime));
+    }
+
+    // Post them to the sender thread instead
+    CommandSender sender(output);
+    vector<double> postTimes;
+    sender.start();
+    for(int i = 0; i < frames; ++i)
+    {
+        int64 start = getTickCount();
+        for(size_t c = 0; c < script[i].size(); ++c)
+            sender.post((uint8_t)script[i][c]);
+        postTimes.push_back((getTickCount() - start) * 1e6 / getTickFrequency());
+        this_thread::sleep_for(chrono::milliseconds(frameTime));
+    }
+    sender.stop();
+
+    // Post the session again to a sender that spaces its commands out like the data pins need,
+    // with frames faster than the sender's poll so the commands pile up into bursts
+    const int gap = 50;  // microseconds between the starts of two commands
+    TimedCommandOutput timed;
+    CommandSender spaced(timed, false, gap);
+    spaced.start();
+    for(int i = 0; i < frames; ++i)
+    {
+        for(size_t c = 0; c < script[i].size(); ++c)
+            spaced.post((uint8_t)script[i][c]);
+        this_thread::sleep_for(chrono::microseconds(100));
+    }
+    spaced.stop();
+    double shortestGap = 1e9;  // the fewest microseconds between two commands
+    for(size_t i = 1; i < timed.times.size(); ++i)
+        shortestGap = min(shortestGap,
+            chrono::duration<double, micro>(timed.times[i] - timed.times[i - 1]).count());
+
+    for(int i = 0; i < 5; ++i)
+        delete gpio[i];
+    removeGPIOTree(root, pins);
+
+    sort(inlineTimes.begin(), inlineTimes.end());
+    sort(postTimes.begin(), postTimes.end());
+
+    cout << fixed << setprecision(2);
+    cout << "Inline: p50 " << percentile(inlineTimes, 50) << " us, p99 "
+        << percentile(inlineTimes, 99) << " us per frame, " << inlineCommands
+        << " commands written" << endl;
+    cout << "Sender: p50 " << percentile(postTimes, 50) << " us, p99 "
+        << percentile(postTimes, 99) << " us per frame, " << sender.getSent() << " sent, "
+        << sender.getSuppressed() << " suppressed, " << sender.getDropped() << " dropped" << endl;
+    cout << "Spaced: " << timed.times.size() << " commands, shortest gap " << shortestGap
+        << " us of " << gap << " us " << (shortestGap >= gap ? "yes" : "NO") << endl;
+
+    return sender.getDropped() || shortestGap < gap ? 1 : 0;
+}
+
+/** PacedFrameSource Class
+ * Purpose: Hands out a frame at a camera's frame rate for benchmarkPipeline. A reader that
+ * falls behind gets the newest frame, like the frame grabber gives it.
+ */
+class PacedFrameSource : public FrameSource
+{
+private:
+    Mat frame;  // the frame handed out every time
+    chrono::steady_clock::time_point start;  // when the first frame came in
+    chrono::nanoseconds interval;  // the time between frames
+    long next;  // the number of the next frame to hand out
+
+public:
+    PacedFrameSource(const Mat &frame, double frameRate)
+    {
+        this->frame = frame;
+        this->start = chrono::steady_clock::now();
+        this->interval = chrono::nanoseconds((long long)(1e9 / frameRate));
+        this->next = 0;
+    }
+
+    bool read(Mat &out)
+    {
+        long newest = (long)((chrono::steady_clock::now() - start) / interval);
+        if(newest >= next)
+            next = newest;
+        else
+            this_thread::sleep_until(start + interval * next);
+        ++next;
+        out = frame;
+        return true;
+    }
+};
+
+/** PipelineReading Struct
+ * Purpose: Holds a change of the front sensor for benchmarkPipeline.
+ */
+struct PipelineReading
+{
+    bool front;  // is an object in front
+    long long time;  // when the sensor changed, in nanoseconds of CLOCK_MONOTONIC
+};
+
+/** BenchSensorStage Class
+ * Purpose: Waits on the simulated front sensor and hands each change to the control stage,
+ * like the robot's sensor stage.
+ */
+class BenchSensorStage : public PipelineStage
+{
+private:
+    EdgeMonitor *monitor;  // watches the sensor
+    SnapshotCell<PipelineReading> *cell;  // where the changes go
+    vector<EdgeEvent> events;  // the changes from the last wait
+
+public:
+    BenchSensorStage(EdgeMonitor &monitor, SnapshotCell<PipelineReading> &cell) :
+        PipelineStage("sensors", 0)
+    {
+        this->monitor = &monitor;
+        this->cell = &cell;
+    }
+
+protected:
+    int step()
+    {
+        if(monitor->poll(events, 10) != EdgeMonitor::ERROR_NONE || events.empty())
+            return STEP_IDLE;
+
+        PipelineReading reading = { events.back().rising, events.back().time };
+        cell->publish(reading);
+        return STEP_WORKED;
+    }
+};
+
+/** BenchVisionStage Class
+ * Purpose: Searches every frame and hands the target to the control stage, like the robot's
+ * vision stage.
+ */
+class BenchVisionStage : public PipelineStage
+{
+private:
+    ColorDetector *cd;  // searches the frames
+    SnapshotCell<Point> *cell;  // where the targets go
+
+public:
+    BenchVisionStage(ColorDetector &cd, SnapshotCell<Point> &cell) : PipelineStage("vision", 0)
+    {
+        this->cd = &cd;
+        this->cell = &cell;
+    }
+
+protected:
+    int step()
+    {
+        int x, y;
+        cd->findColorFromCam(x, y);
+        cell->publish(Point(x, y));
+        return STEP_WORKED;
+    }
+};
+
+/** BenchControlStage Class
+ * Purpose: Takes the newest sensor change and target, and times how long each sensor change
+ * took to reach it.
+ */
+class BenchControlStage : public PipelineStage
+{
+private:
+    SnapshotCell<PipelineReading> *sensors;  // the sensor changes
+    SnapshotCell<Point> *targets;  // the targets
+
+public:
+    vector<double> latencies;  // milliseconds from each sensor change to this stage
+    long frames;  // the targets taken
+
+    BenchControlStage(SnapshotCell<PipelineReading> &sensors, SnapshotCell<Point> &targets) :
+        PipelineStage("control", 200)
+    {
+        this->sensors = &sensors;
+        this->targets = &targets;
+        this->frames = 0;
+    }
+
+protected:
+    int step()
+    {
+        PipelineReading reading;
+        Point target;
+        bool sensed = sensors->take(reading);
+        bool seen = targets->take(target);
+
+        if(sensed)
+            latencies.push_back((EdgeMonitor::now() - reading.time) / 1e6);
+        if(seen)
+            ++frames;
+        return sensed || seen ? STEP_WORKED : STEP_IDLE;
+    }
+};
+
+/** Prints how fast one way of running the control loop reacted to the sensor
+ * @param name the way of running the loop
+ * @param latencies milliseconds from each sensor change to the state machine
+ * @param frames the frames searched
+ * @param seconds how long the loop ran
+ */
+void printPipelineResult(const string &name, vector<double> &latencies, long frames, double seconds)
+{
+    sort(latencies.begin(), latencies.end());
+    cout << name << "reaction p50 " << percentile(latencies, 50) << " ms, p99 "
+        << percentile(latencies, 99) << " ms, max " << latencies.back() << " ms, "
+        << frames / seconds << " frames per second" << endl;
+}
+
+/** Flips a simulated front sensor at random times while the control loop runs, once with
+ * the sensors, vision and state machine in order on one thread like the old main loop, and
+ * once with each on its own thread handing snapshots to the next, and reports how long each
+ * change took to reach the state machine and how many frames were searched
+ * @return error code, if any
+ */
+int benchmarkPipeline()
+{
+    int changes = 100;  // sensor changes in each run
+    double frameRate = 30;  // the camera's frames per second
+    Mat frame = makeFrame(Size(1280, 720), Scalar(40, 150, 60));
+    VideoCapture cap;  // unused, the frames come from the paced source
+    ColorDetector cd(cap, ColorDetector::GREEN, false, ColorDetector::DEFAULT_WINDOW_WIDTH, false);
+    cout << fixed << setprecision(2);
+
+    for(int pipelined = 0; pipelined < 2; ++pipelined)
+    {
+        SimulatedEdgeSource sensor;
+        EdgeMonitor monitor;
+        PacedFrameSource source(frame, frameRate);
+        atomic<bool> done(false);
+
+        if(monitor.addSource(&sensor) < 0)
+        {
+            cout << "Error: Could not watch the simulated sensor" << endl;
+            return 1;
+        }
+        cd.setFrameSource(&source);
+
+        // Flip the sensor every 20 to 60 ms, at the same times in both runs
+        thread flipper([&]()
+        {
+            RNG rng(777);
+            for(int i = 0; i < changes; ++i)
+            {
+                this_thread::sleep_for(chrono::milliseconds(rng.uniform(20, 60)));
+                sensor.setLine(0, (i & 1) == 0);
+            }
+            this_thread::sleep_for(chrono::milliseconds(100));
+            done = true;
+        });
+
+        int64 start = getTickCount();
+        vector<double> latencies;
+        long frames = 0;
+        if(!pipelined)
+        {
+            // Read the sensor, run the state machine, search a frame, then wait on the sensor
+            // for 30 ms, like the old main loop
+            vector<EdgeEvent> events;
+            long long changed = 0;  // when the sensor changed, 0 if the state machine has seen it
+            while(!done)
+            {
+                monitor.poll(events, 0);
+                if(!events.empty())
+                    changed = events.back().time;
+                if(changed)
+                {
+                    latencies.push_back((EdgeMonitor::now() - changed) / 1e6);
+                    changed = 0;
+                }
+                int x, y;
+                cd.findColorFromCam(x, y);
+                ++frames;
+                monitor.poll(events, 30);
+                if(!events.empty())
+                    changed = events.back().time;
+            }
+        }
+        else
+        {
+            SnapshotCell<PipelineReading> sensorCell;
+            SnapshotCell<Point> targetCell;
+            BenchSensorStage sensorStage(monitor, sensorCell);
+            BenchVisionStage visionStage(cd, targetCell);
+            BenchControlStage controlStage(sensorCell, targetCell);
+
+            sensorStage.start();
+            visionStage.start();
+            controlStage.start();
+            while(!done)
+                this_thread::sleep_for(chrono::milliseconds(10));
+            controlStage.stop();
+            visionStage.stop();
+            sensorStage.stop();
+
+            latencies = controlStage.latencies;
+            frames = controlStage.frames;
+        }
+        double seconds = (getTickCount() - start) / getTickFrequency();
+        flipper.join();
+
+        printPipelineResult(pipelined ? "Pipelined: " : "In order:  ", latencies, frames, seconds);
+    }
+
+    return 0;
+}
+
+/** AimCamera Struct
+ * Purpose: Holds the simulated camera for benchmarkAim. Each servo follows the angle it was
+ * sent along the same trapezoid profile as SniperBot.cpp.
+ */
+struct AimCamera
+{
+    double angle[2];  // the yaw and pitch the servos are at, in degrees
+    double velocity[2];  // degrees a second each servo is turning
+    double target[2];  // the yaw and pitch the servos are headed to, in degrees
+};
+
+/** Moves the simulated camera's servos for a number of the Arduino's 5 ms updates
+ * @param camera a reference to the camera
+ * @param updates the number of updates
+ */
+void stepAimCamera(AimCamera &camera, int updates)
+{
+    const double period = 0.005;  // seconds between updates
+    const double maxSpeed = 300;  // degrees a second
+    const double accel = 4000;  // degrees a second squared
+
+    for(int u = 0; u < updates; ++u)
+    {
+        for(int axis = 0; axis < 2; ++axis)
+        {
+            double remaining = camera.target[axis] - camera.angle[axis];
+            double distance = fabs(remaining);
+            double speed = remaining >= 0 ? camera.velocity[axis] : -camera.velocity[axis];
+
+            if(distance <= accel * period * period && fabs(speed) <= accel * period)
+            {
+                camera.angle[axis] = camera.target[axis];
+                camera.velocity[axis] = 0;
+                continue;
+            }
+            if(speed > 0 && speed * (speed + accel * period) >= 2 * accel * distance)
+                speed -= accel * period;
+            else
+                speed = min(speed + accel * period, maxSpeed);
+            speed = min(speed, distance / period);
+
+            camera.velocity[axis] = remaining >= 0 ? speed : -speed;
+            camera.angle[axis] += camera.velocity[axis] * period;
+        }
+    }
+}
+
+/** AimResult Struct
+ * Purpose: Holds how one way of aiming did over the trials of benchmarkAim.
+ */
+struct AimResult
+{
+    vector<double> lockFrames;  // frames until the target was in the target area, for each trial that got there
+    vector<double> centerFrames;  // frames until the target stayed in the dead zone, for each trial that got there
+    vector<double> overshoots;  // the most pixels the target went past the middle, for each trial
+    long reversals;  // times an axis turned back the other way after the target was in the target area
+    double trackingError;  // the average pixels from the middle while following a moving target
+};
+
+/** Aims the simulated camera at targets at random angles with the main loop's old bang-bang
+ * steps or with the AimController
+ * @param usePid should the AimController pick the steps
+ * @param trials the number of targets
+ * @param moving should each target move across the view
+ * @return how the aiming did
+ */
+AimResult runAimTrials(bool usePid, int trials, bool moving)
+{
+    const int width = 640, height = 480;  // the camera's view
+    const double pixelsPerDegree = width / 60.0;  // a 60 degree field of view
+    const double frameTime = 1.0 / 30;  // seconds between frames
+    const int frames = 90;  // frames aimed at each target
+    const int settleFrames = 5;  // frames the target must stay in the dead zone to be centered
+    const int targetSize = 250;  // the target area's width and height
+    Rect area(width / 2 - targetSize / 2, height / 2 - targetSize / 2, targetSize, targetSize);
+    RNG rng(4242);  // fixed seed so both ways aim at the same targets
+    AimController aim;
+    AimResult result;
+
+    result.reversals = 0;
+    double errorSum = 0;
+    long errorFrames = 0;
+
+    for(int t = 0; t < trials; ++t)
+    {
+        AimCamera camera = { { 90, 90 }, { 0, 0 }, { 90, 90 } };
+        double target[2] = { 90 + rng.uniform(-35.0, 35.0), 90 + rng.uniform(-25.0, 25.0) };
+        double drift[2] = { moving ? rng.uniform(-15.0, 15.0) : 0, moving ? rng.uniform(-8.0, 8.0) : 0 };  // degrees a second
+        int lastStep[2] = { 0, 0 };  // the direction of each axis's last step
+        int startSide[2] = { 0, 0 };  // which side of the middle the target started on
+        int locked = -1, centeredFrom = -1;
+        double overshoot = 0;
+
+        aim.reset();
+        for(int f = 0; f < frames; ++f)
+        {
+            // Where the detector sees the target, with a couple of pixels of noise
+            double errorX = (target[0] - camera.angle[0]) * pixelsPerDegree + rng.gaussian(1.5);
+            double errorY = (target[1] - camera.angle[1]) * pixelsPerDegree + rng.gaussian(1.5);
+            int x = (int)(width / 2 - errorX), y = (int)(height / 2 - errorY);
+            double errors[2] = { errorX, errorY };
+
+            bool inArea = area.contains(Point(x, y));
+            if(inArea && locked < 0)
+                locked = f;
+            bool centered = fabs(errorX) <= aim.getDeadZone() && fabs(errorY) <= aim.getDeadZone();
+            if(!centered)
+                centeredFrom = -1;
+            else if(centeredFrom < 0)
+                centeredFrom = f;
+            for(int axis = 0; axis < 2; ++axis)
+            {
+                int side = errors[axis] > 0 ? 1 : -1;
+                if(!startSide[axis])
+                    startSide[axis] = side;
+                else if(side != startSide[axis])
+                    overshoot = max(overshoot, fabs(errors[axis]));
+            }
+            if(moving && locked >= 0)
+            {
+                errorSum += sqrt(errorX * errorX + errorY * errorY);
+                ++errorFrames;
+            }
+
+            int steps[2];
+            if(usePid)
+                aim.update(errorX, errorY, frameTime, steps[0], steps[1]);
+            else
+            {
+                steps[0] = x < area.x ? 1 : x > area.x + area.width ? -1 : 0;
+                steps[1] = y < area.y ? 1 : y > area.y + area.height ? -1 : 0;
+            }
+
+            for(int axis = 0; axis < 2; ++axis)
+            {
+                if(steps[axis] && lastStep[axis] && (steps[axis] > 0) != (lastStep[axis] > 0) &&
+                        locked >= 0)
+                    ++result.reversals;
+                if(steps[axis])
+                    lastStep[axis] = steps[axis];
+
+                // The sender and the Arduino keep the camera between 45 and 135 degrees
+                camera.target[axis] += steps[axis] * AimController::STEP_DEGREES;
+                camera.target[axis] = max(45.0, min(135.0, camera.target[axis]));
+                target[axis] += drift[axis] * frameTime;
+            }
+            stepAimCamera(camera, (int)(frameTime / 0.005 + 0.5));
+        }
+
+        if(locked >= 0)
+            result.lockFrames.push_back(locked);
+        if(centeredFrom >= 0 && centeredFrom <= frames - settleFrames)
+            result.centerFrames.push_back(centeredFrom);
+        result.overshoots.push_back(overshoot);
+    }
+
+    sort(result.lockFrames.begin(), result.lockFrames.end());
+    sort(result.centerFrames.begin(), result.centerFrames.end());
+    sort(result.overshoots.begin(), result.overshoots.end());
+    result.trackingError = errorFrames ? errorSum / errorFrames : 0;
+
+    return result;
+}
+
+/** Prints how one way of aiming did
+ * @param name the way of aiming
+ * @param result how it did
+ * @param trials the number of targets
+ * @param moving were the targets moving
+ */
+void printAimResult(const string &name, const AimResult &result, int trials, bool moving)
+{
+    cout << name << ": " << result.lockFrames.size() << "/" << trials << " locked";
+    if(!result.lockFrames.empty())
+        cout << " in p50 " << percentile(result.lockFrames, 50) << ", p99 "
+            << percentile(result.lockFrames, 99) << " frames";
+    cout << ", " << result.centerFrames.size() << "/" << trials << " centered";
+    if(!result.centerFrames.empty())
+        cout << " in p50 " << percentile(result.centerFrames, 50) << " frames";
+    cout << ", overshoot p50 " << percentile(result.overshoots, 50) << " px, max "
+        << result.overshoots.back() << " px, " << result.reversals << " reversals after lock";
+    if(moving)
+        cout << ", " << result.trackingError << " px average error while following";
+    cout << endl;
+}
+
+/** Aims a simulated camera at still and moving targets with the main loop's old bang-bang
+ * steps and with the AimController, and reports the frames to lock onto the target, the
+ * overshoot, and how often the camera turned back and forth
+ * @return error code, if any
+ */
+int benchmarkAim()
+{
+    int trials = 200;  // targets for each way of aiming
+
+    cout << fixed << setprecision(1);
+    for(int moving = 0; moving < 2; ++moving)
+    {
+        cout << (moving ? "Moving targets" : "Still targets") << endl;
+        printAimResult("  Bang-bang", runAimTrials(false, trials, moving), trials, moving);
+        printAimResult("  PID", runAimTrials(true, trials, moving), trials, moving);
+    }
+
+    return 0;
+}
+
+/** Searches the frames of several cameras with a DetectorGroup on 1 thread up to one thread
+ * per camera, and checks that the group finds the same targets as each camera's detector alone
+ * @param files video files to play as the cameras, or none for 4 cameras of generated frames
+ * @return error code, if any
+ */
+int benchmarkGroup(const vector<string> &files)
+{
+    int frameCount = 30;  // frames kept from each camera
+    int rounds = 60;  // group searches timed for each thread count
+    int codes[] = { ColorDetector::GREEN, ColorDetector::RED };
+    vector<int> targetColors(codes, codes + 2);
+    int cameras = files.empty() ? 4 : (int)files.size();
+    VideoCapture cap;  // unused, the frames come from memory
+    vector<MemoryFrameSource *> sources;  // the frames the group searches
+    vector<MemoryFrameSource *> aloneSources;  // the same frames, for the detectors searched alone
+    vector<ColorDetector *> detectors;
+    vector<ColorDetector *> alone;
+
+    // Keep each camera's frames in memory, so only the searching is timed. The detectors
+    // only read the frames, so both sources can share them.
+    for(int c = 0; c < cameras; ++c)
+    {
+        sources.push_back(new MemoryFrameSource(true));
+        aloneSources.push_back(new MemoryFrameSource(true));
+
+        if(files.empty())
+        {
+            Mat background = makeFrame(Size(1280, 720), Scalar(0, 0, 0));
+            for(int f = 0; f < frameCount; ++f)
+            {
+                Mat frame = background.clone();
+                circle(frame, Point(200 + f * 20 + c * 40, 200 + c * 100), 70, Scalar(40, 150, 60), -1);
+                sources[c]->addFrame(frame);
+                aloneSources[c]->addFrame(frame);
+            }
+        }
+        else
+        {
+            VideoCapture file(files[c]);
+            Mat frame;
+            for(int f = 0; f < frameCount && file.read(frame); ++f)
+            {
+                Mat copy = frame.clone();
+                sources[c]->addFrame(copy);
+                aloneSources[c]->addFrame(copy);
+            }
+            if(sources[c]->getFrameCount() == 0)
+            {
+                cout << "Error: Could not read " << files[c] << endl;
+                return 1;
+            }
+        }
+
+        for(int i = 0; i < 2; ++i)
+        {
+            ColorDetector *detector = new ColorDetector(cap, ColorDetector::GREEN, false,
+                ColorDetector::DEFAULT_WINDOW_WIDTH, false);
+            detector->setFrameSource(i == 0 ? sources[c] : aloneSources[c]);
+            detector->setTargetColors(targetColors);
+            detector->setBlobMode(true);
+            (i == 0 ? detectors : alone).push_back(detector);
+        }
+    }
+
+    cout << cameras << " cameras, " << std::thread::hardware_concurrency() << " cores" << endl;
+    cout << setw(8) << "threads" << setw(12) << "frames/s" << setw(10) << "speedup"
+        << setw(12) << "mismatches" << endl;
+
+    double single = 0;  // frames per second with one thread
+    vector<GroupDetection> detections;
+    vector<ColorResult> results;
+    for(int threads = 1; threads <= cameras; ++threads)
+    {
+        DetectorGroup group(threads);
+        long mismatches = 0;  // results that differ from searching the camera alone
+
+        for(int c = 0; c < cameras; ++c)
+            group.addDetector(detectors[c]);
+        group.start();
+
+        int64 start = getTickCount();
+        for(int r = 0; r < rounds; ++r)
+            group.findColors(detections);
+        double seconds = (getTickCount() - start) / getTickFrequency();
+
+        // Search every frame once more in lockstep with the lone detectors and compare
+        for(int c = 0; c < cameras; ++c)
+        {
+            sources[c]->rewind();
+            aloneSources[c]->rewind();
+        }
+        for(int f = 0; f < frameCount; ++f)
+        {
+            group.findColors(detections);
+            for(int c = 0; c < cameras; ++c)
+            {
+                alone[c]->findColorsFromCam(results);
+                const vector<ColorResult> &grouped = group.getResults(c);
+                for(size_t i = 0; i < results.size(); ++i)
+                    if(i >= grouped.size() || grouped[i].found != results[i].found ||
+                            grouped[i].x != results[i].x || grouped[i].y != results[i].y)
+                        ++mismatches;
+            }
+        }
+        group.stop();
+
+        double rate = rounds * cameras / seconds;
+        if(threads == 1)
+            single = rate;
+        cout << setw(8) << threads << fixed << setprecision(1) << setw(12) << rate
+            << setw(9) << setprecision(2) << rate / single << "x" << setw(12) << mismatches << endl;
+    }
+
+    for(int c = 0; c < cameras; ++c)
+    {
+        delete detectors[c];
+        delete alone[c];
+        delete sources[c];
+        delete aloneSources[c];
+    }
+
+    return 0;
+}
+
+/** Splits a recorded MJPEG stream, which is the camera's JPEG frames one after another, into
+ * its frames
+ * @param file the stream, such as one saved with ffmpeg's "-c:v copy -f mjpeg"
+ * @param frames a reference to a vector that will hold each compressed frame
+ * @return true if any frames were read
+ */
+bool readMjpegStream(const string &file, vector<Mat> &frames)
+{
+    ifstream in(file.c_str(), ios::binary);
+    vector<uchar> data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    if(!in.good() && !in.eof())
+        return false;
+
+    // Each frame runs from a start of image marker to the next end of image marker
+    size_t start = string::npos;
+    for(size_t i = 0; i + 1 < data.size(); ++i)
+    {
+        if(data[i] != 0xFF)
+            continue;
+        if(data[i + 1] == 0xD8 && start == string::npos)
+            start = i;
+        else if(data[i + 1] == 0xD9 && start != string::npos)
+        {
+            frames.push_back(Mat(1, (int)(i + 2 - start), CV_8UC1, &data[start]).clone());
+            start = string::npos;
+        }
+    }
+
+    return !frames.empty();
+}
+
+/** Times decoding an MJPEG stream at full size and resizing it for the detector against
+ * decoding it straight to the searched width, and checks that both find the same target
+ * @param file the MJPEG stream to play, or empty to encode generated 1280x720 frames
+ * @param width the width to search at, or 0 for 640, 320 and 160
+ * @return error code, if any
+ */
+int benchmarkMjpeg(const string &file, long width)
+{
+    vector<Mat> jpegs;  // the compressed frames
+    MemoryFrameSource compressed;  // hands the compressed frames to the scaled path
+    VideoCapture cap;  // unused, the frames come from memory
+
+    if(file.empty())
+    {
+        Mat background = makeFrame(Size(1280, 720), Scalar(0, 0, 0));
+        vector<uchar> buffer;
+        for(int f = 0; f < 60; ++f)
+        {
+            Mat frame = background.clone();
+            circle(frame, Point(300 + f * 10, 300 + f * 3), 80, Scalar(40, 150, 60), -1);
+            imencode(".jpg", frame, buffer);
+            jpegs.push_back(Mat(buffer, true).reshape(1, 1));
+        }
+    }
+    else if(!readMjpegStream(file, jpegs))
+    {
+        cout << "Error: Could not read " << file << endl;
+        return 1;
+    }
+    for(size_t f = 0; f < jpegs.size(); ++f)
+        compressed.addFrame(jpegs[f]);
+
+    vector<long> widths;
+    if(width > 0)
+        widths.push_back(width);
+    else
+    {
+        widths.push_back(640);
+        widths.push_back(320);
+        widths.push_back(160);
+    }
+
+    size_t frames = jpegs.size();
+    cout << frames << " frames" << endl;
+    cout << setw(8) << "width" << setw(8) << "path" << setw(12) << "decode ms" << setw(12)
+        << "detect ms" << setw(12) << "total ms" << setw(8) << "scale" << setw(8) << "found"
+        << setw(12) << "x/y diff" << endl;
+
+    for(size_t w = 0; w < widths.size(); ++w)
+    {
+        double decodeTicks[2] = { 0, 0 };  // total ticks decoding, full size and scaled
+        double detectTicks[2] = { 0, 0 };  // total ticks resizing and searching
+        int found[2] = { 0, 0 };  // frames the target was found in
+        double difference = 0;  // total distance between where the two paths found the target
+        int compared = 0;  // frames both paths found the target in
+        ColorDetector full(cap, ColorDetector::GREEN, false, widths[w], false);
+        ColorDetector scaled(cap, ColorDetector::GREEN, false, widths[w], false);
+        MjpegFrameSource mjpeg(&compressed, widths[w]);
+        Mat decoded, frame;
+
+        compressed.rewind();
+        for(size_t f = 0; f < frames; ++f)
+        {
+            int x[2], y[2];
+
+            // The current path decodes the whole frame, and the detector resizes it
+            int64 start = getTickCount();
+            imdecode(jpegs[f], IMREAD_COLOR, &decoded);
+            int64 middle = getTickCount();
+            full.findColorInFrame(decoded, x[0], y[0]);
+            int64 end = getTickCount();
+            decodeTicks[0] += (double)(middle - start);
+            detectTicks[0] += (double)(end - middle);
+
+            // The scaled path decodes straight to the searched width
+            start = getTickCount();
+            mjpeg.read(frame);
+            middle = getTickCount();
+            scaled.findColorInFrame(frame, x[1], y[1]);
+            end = getTickCount();
+            decodeTicks[1] += (double)(middle - start);
+            detectTicks[1] += (double)(end - middle);
+
+            for(int p = 0; p < 2; ++p)
+                found[p] += x[p] != -1 ? 1 : 0;
+            if(x[0] != -1 && x[1] != -1)
+            {
+                difference += sqrt((double)(x[0] - x[1]) * (x[0] - x[1]) + (y[0] - y[1]) * (y[0] - y[1]));
+                ++compared;
+            }
+        }
+
+        for(int p = 0; p < 2; ++p)
+        {
+            double toMs = 1000.0 / getTickFrequency() / frames;
+            cout << setw(8) << widths[w] << setw(8) << (p ? "scaled" : "full") << fixed
+                << setprecision(3) << setw(12) << decodeTicks[p] * toMs << setw(12)
+                << detectTicks[p] * toMs << setw(12) << (decodeTicks[p] + detectTicks[p]) * toMs
+                << setw(8) << (p ? mjpeg.getScale() : 1) << setw(8) << found[p];
+            if(p)
+                cout << setw(12) << setprecision(2) << (compared ? difference / compared : 0.0);
+            cout << endl;
+        }
+    }
+
+    return 0;
+}
+
+/** Reads the same camera through VideoCapture and through V4L2Capture's shared buffers, and
+ * reports the time spent reading and searching each frame, the bytes not copied, and the
+ * time from capture until each frame was searched. Load the vivid driver to run it without
+ * a camera.
+ * @param device the video device, such as /dev/video0
+ * @param frames the frames to read each way
+ * @return error code, if any
+ */
+int benchmarkV4L2(const string &device, int frames)
+{
+    int x, y;  // holds the x and y of the target
+    int width, height;  // the size of the frames
+
+    // The current path, which copies and converts every frame
+    {
+        VideoCapture cap(device, CAP_V4L2);
+        if(!cap.isOpened())
+        {
+            cout << "Error: Could not open " << device << endl;
+            return 1;
+        }
+        cap.set(CAP_PROP_FOURCC, VideoWriter::fourcc('Y', 'U', 'Y', 'V'));
+        ColorDetector cd(cap, ColorDetector::GREEN, false, ColorDetector::DEFAULT_WINDOW_WIDTH, false);
+        Mat frame;
+        double readTicks = 0, searchTicks = 0;
+        long long copied = 0;  // the bytes VideoCapture wrote into Mats
+        int read = 0;  // the frames read
+
+        for(; read < frames; ++read)
+        {
+            int64 start = getTickCount();
+            if(!cap.read(frame))
+                break;
+            int64 middle = getTickCount();
+            cd.findColorInFrame(frame, x, y);
+            searchTicks += (double)(getTickCount() - middle);
+            readTicks += (double)(middle - start);
+            copied += (long long)(frame.total() * frame.elemSize());
+        }
+        if(read == 0)
+        {
+            cout << "Error: Could not read " << device << endl;
+            return 1;
+        }
+        width = frame.cols;
+        height = frame.rows;
+
+        cout << "VideoCapture: " << width << "x" << height << fixed << setprecision(3)
+            << ", read " << readTicks * 1000.0 / getTickFrequency() / read << " ms, search "
+            << searchTicks * 1000.0 / getTickFrequency() / read << " ms, "
+            << copied / read << " bytes copied per frame" << endl;
+    }
+
+    // The shared buffer path, which hands the detector the driver's own buffer
+    V4L2Capture capture;
+    int error = capture.open(device, width, height, V4L2Capture::FORMAT_YUYV);
+    if(error != V4L2Capture::ERROR_NONE)
+    {
+        cout << "Error: V4L2Capture could not open " << device << " (error " << error << ")" << endl;
+        return 1;
+    }
+
+    VideoCapture unused;
+    ColorDetector cd(unused, ColorDetector::GREEN, false, ColorDetector::DEFAULT_WINDOW_WIDTH, false);
+    vector<double> latencies;  // seconds from capture until each frame was searched
+    double searchTicks = 0;
+    cd.setFrameSource(&capture);
+    for(int f = 0; f < frames; ++f)
+    {
+        int64 start = getTickCount();
+        if(cd.findColorFromCam(x, y) != ColorDetector::ERROR_NONE)
+            break;
+        searchTicks += (double)(getTickCount() - start);
+        latencies.push_back(capture.getLastLatency());
+    }
+    if(latencies.empty())
+    {
+        cout << "Error: V4L2Capture could not read " << device << endl;
+        return 1;
+    }
+    sort(latencies.begin(), latencies.end());
+
+    long read = (long)latencies.size();
+    cout << "V4L2Capture:  " << capture.getWidth() << "x" << capture.getHeight() << " YUYV, "
+        << capture.getBufferCount() << " buffers, read and search " << fixed << setprecision(3)
+        << searchTicks * 1000.0 / getTickFrequency() / read << " ms, "
+        << capture.getBytesNotCopied() / read << " bytes not copied per frame" << endl;
+    cout << "  capture to searched: p50 " << latencies[read / 2] * 1000 << " ms, p99 "
+        << latencies[read * 99 / 100] * 1000 << " ms, max " << capture.getMaxLatency() * 1000
+        << " ms, " << capture.getFramesDropped() << " of " << capture.getFramesCaptured()
+        << " frames dropped for a newer one" << endl;
+
+    return 0;
+}
+
+/** Converts a BGR frame to YUYV, the way a camera sends it, with each pair of pixels sharing
+ * the average of their U and V
+ * @param bgr the BGR frame, with an even width
+ * @return the YUYV frame
+ */
+Mat makeYuyv(const Mat &bgr)
+{
+    Mat yuv;
+    Mat yuyv(bgr.size(), CV_8UC2);
+
+    cvtColor(bgr, yuv, COLOR_BGR2YUV);
+    for(int y = 0; y < yuv.rows; ++y)
+    {
+        const Vec3b *src = yuv.ptr<Vec3b>(y);
+        uchar *dst = yuyv.ptr<uchar>(y);
+        for(int x = 0; x < yuv.cols; x += 2, dst += 4)
+        {
+            dst[0] = src[x][0];
+            dst[1] = (uchar)((src[x][1] + src[x + 1][1] + 1) / 2);
+            dst[2] = src[x + 1][0];
+            dst[3] = (uchar)((src[x][2] + src[x + 1][2] + 1) / 2);
+        }
+    }
+
+    return yuyv;
+}
+
+/** Classifies YUYV frames with the YUV class table against converting them to BGR and
+ * classifying that, the way the detector did before. Reports the table's build time, the
+ * share of each color's pixels the two classify differently, the time of each, and how far
+ * apart the detector found each target each way.
+ * @return error code, if any
+ */
+int benchmarkYuv()
+{
+    const double MAX_MISMATCH = 2.0;  // the most percent of pixels a color's mask may differ by
+    const double MAX_OFFSET = 2.0;  // the most pixels a target may move by
+    int codes[] = { ColorDetector::GREEN, ColorDetector::RED, ColorDetector::BLUE,
+        ColorDetector::YELLOW };
+    Scalar colors[] = { Scalar(40, 150, 60), Scalar(40, 20, 200), Scalar(200, 60, 20),
+        Scalar(30, 200, 220) };
+    Size sizes[] = { Size(320, 240), Size(640, 480), Size(1280, 720) };
+    int iterations = 50;  // searches per frame size
+    HSVRange ranges[4];  // the HSV range of each color
+    vector<uchar> table(YUV_TABLE_SIZE);
+    bool passed = true;  // stays true while every check is inside the tolerance
+
+    for(int c = 0; c < 4; ++c)
+        ColorDetector::getColorRange(codes[c], ranges[c]);
+
+    int64 start = getTickCount();
+    buildYuvClassTable(ranges, 4, &table[0]);
+    cout << "Table: " << YUV_TABLE_SIZE / 1024 << " KB, built in " << fixed << setprecision(1)
+        << (getTickCount() - start) * 1000.0 / getTickFrequency() << " ms" << endl;
+
+    cout << setw(10) << "size" << setw(22) << "mismatch % by color" << setw(12) << "bgr ms"
+        << setw(12) << "table ms" << setw(12) << "offset px" << setw(8) << "ok" << endl;
+
+    for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+    {
+        Mat frame = makeFrame(sizes[i], colors[0]);
+        int radius = sizes[i].height / 8;  // the radius of the other colors' blobs
+        for(int c = 1; c < 4; ++c)
+            circle(frame, Point(sizes[i].width * (c + 1) / 5, sizes[i].height * (1 + c % 2) / 3),
+                radius, colors[c], -1);
+        Mat yuyv = makeYuyv(frame);
+
+        // Classify the frame both ways, and count the pixels of each color that differ
+        Mat bgr, expected, actual, diff;
+        cvtColor(yuyv, bgr, COLOR_YUV2BGR_YUYV);
+        thresholdClasses(bgr, ranges, 4, &expected, NULL);
+        classifyYuyv(yuyv, &table[0], 4, &actual, NULL);
+        bitwise_xor(expected, actual, diff);
+        double mismatch[4];  // the percent of pixels each color differs by
+        for(int c = 0; c < 4; ++c)
+        {
+            Mat bit = diff & Scalar(1 << c);
+            mismatch[c] = countNonZero(bit) * 100.0 / frame.total();
+        }
+
+        // Time converting and classifying against looking up, gathering the moments both ways
+        MaskMoments m[4];
+        double ticks[2] = { 0, 0 };  // total ticks of each way
+        for(int n = 0; n < iterations; ++n)
+        {
+            start = getTickCount();
+            cvtColor(yuyv, bgr, COLOR_YUV2BGR_YUYV);
+            thresholdClasses(bgr, ranges, 4, NULL, m);
+            ticks[0] += (double)(getTickCount() - start);
+
+            start = getTickCount();
+            classifyYuyv(yuyv, &table[0], 4, NULL, m);
+            ticks[1] += (double)(getTickCount() - start);
+        }
+
+        // Find the targets with the detector both ways, with morphology and blob mode on
+        VideoCapture cap;  // unused, the frames are passed in directly
+        ColorDetector cd(cap, ColorDetector::GREEN, false, ColorDetector::DEFAULT_WINDOW_WIDTH, false);
+        vector<ColorResult> results[2];
+        cd.setTargetColors(vector<int>(codes, codes + 4));
+        cd.setBlobMode(true);
+        cd.setYuvClasses(true);
+        cvtColor(yuyv, bgr, COLOR_YUV2BGR_YUYV);
+        cd.findColorsInFrame(bgr, results[0]);
+        for(int n = 0; n < 3; ++n)
+            cd.findColorsInYuyv(yuyv, results[1]);
+        double offset = 0;  // the farthest apart a target was found
+        for(int c = 0; c < 4; ++c)
+        {
+            if(results[0][c].found != results[1][c].found)
+                offset = INFINITY;
+            else if(results[0][c].found)
+                offset = max(offset, hypot(results[0][c].x - results[1][c].x,
+                    results[0][c].y - results[1][c].y));
+        }
+        bool ok = offset <= MAX_OFFSET && cd.getYuvTableBuilds() == 1 &&
+            *max_element(mismatch, mismatch + 4) <= MAX_MISMATCH;
+        passed = passed && ok;
+
+        ostringstream percents;
+        percents << fixed << setprecision(2) << mismatch[0] << " " << mismatch[1] << " "
+            << mismatch[2] << " " << mismatch[3];
+        cout << setw(10) << (to_string(sizes[i].width) + "x" + to_string(sizes[i].height))
+            << setw(22) << percents.str() << fixed << setprecision(3)
+            << setw(12) << ticks[0] * 1000.0 / getTickFrequency() / iterations
+            << setw(12) << ticks[1] * 1000.0 / getTickFrequency() / iterations
+            << setw(12) << setprecision(1) << offset << setw(8) << (ok ? "yes" : "NO") << endl;
+    }
+
+    return passed ? 0 : 1;
+}
+
+/** Runs the color detector on a video file through a FrameGrabber, the same way the robot
+ * runs it on the camera, and reports how many frames were processed and dropped.
+ * @param file the video file to play
+ * @param frameRate the frame rate to play the file at
+ * @return error code, if any
+ */
+int benchmarkGrabber(const string &file, double frameRate)
+{
+    VideoCapture cap(file);  // file-backed capture standing in for the camera
+    FrameGrabber grabber(cap, frameRate);
+    ColorDetector cd(cap, ColorDetector::GREEN, false, ColorDetector::DEFAULT_WINDOW_WIDTH, false);
+    int x, y;  // holds the x and y of the target
+    long frames = 0;  // the number of frames processed
+
+    if(!cap.isOpened() || grabber.start() != FrameGrabber::ERROR_NONE)
+    {
+        cout << "Error: Could not read " << file << endl;
+        return 1;
+    }
+    cd.setFrameSource(&grabber);
+
+    int64 start = getTickCount();
+    while(cd.findColorFromCam(x, y) == ColorDetector::ERROR_NONE)
+        ++frames;
+    double seconds = (getTickCount() - start) / getTickFrequency();
+
+    cout << "processed " << frames << " of " << grabber.getFramesCaptured() << " frames, dropped "
+        << grabber.getFramesDropped() << ", " << fixed << setprecision(1) << frames / seconds
+        << " frames per second" << endl;
+
+    return 0;
+}
+
+/** The benchmark's starting point.
+ * With no arguments, times each process mode over several frame sizes.
+ * With "colors", times searching for several colors in one pass.
+ * With "track", times following a moving target with the tracking window.
+ * With "blobs", times BlobDetector against connectedComponentsWithStats.
+ * With "pyramid", checks the region merge and times the coarse-to-fine search at each pyramid level.
+ * With "suite [results.json]", runs the ground truth scene suite.
+ * With "trace [trace.json]", measures the cost of tracing and writes a trace.
+ * With "gpio", times GPIO pin access against a temporary directory.
+ * With "bus [chip]", times sending commands over sysfs and over a GPIO line group.
+ * With "edges", times polling the ultrasonic pins against waiting for their edges.
+ * With "protocol", runs the serial command protocol over a pseudo terminal loopback.
+ * With "sender", times sending a session's commands inline against the command sender.
+ * With "pipeline", times how fast the control loop sees a sensor change, in order and pipelined.
+ * With "aim", aims a simulated camera with the old bang-bang steps and the AimController.
+ * With "group [files...]", times searching several cameras with a DetectorGroup on 1 to N threads.
+ * With "mjpeg [stream] [width]", times decoding MJPEG at full size against scaled decoding.
+ * With "v4l2 <device> [frames]", times reading a camera through VideoCapture and V4L2Capture.
+ * With "yuv", checks and times classifying YUYV frames with the YUV class table.
+ * With "grabber <file> [fps]", plays a video file through a FrameGrabber.
+ */
+int main(int argc, char **argv)
+{
+    if(argc >= 2 && string(argv[1]) == "suite")
+        return benchmarkSuite(argc > 2 ? argv[2] : "");
+    if(argc >= 2 && string(argv[1]) == "yuv")
+        return benchmarkYuv();
+    if(argc >= 3 && string(argv[1]) == "v4l2")
+        return benchmarkV4L2(argv[2], argc > 3 ? atoi(argv[3]) : 300);
+    if(argc >= 2 && string(argv[1]) == "mjpeg")
+        return benchmarkMjpeg(argc > 2 ? argv[2] : "", argc > 3 ? atol(argv[3]) : 0);
+    if(argc >= 2 && string(argv[1]) == "group")
+        return benchmarkGroup(vector<string>(argv + 2, argv + argc));
+    if(argc >= 2 && string(argv[1]) == "pipeline")
+        return benchmarkPipeline();
+    if(argc >= 2 && string(argv[1]) == "aim")
+        return benchmarkAim();
+    if(argc >= 2 && string(argv[1]) == "sender")
+        return benchmarkSender();
+    if(argc >= 2 && string(argv[1]) == "protocol")
+        return benchmarkProtocol();
+    if(argc >= 2 && string(argv[1]) == "edges")
+        return benchmarkEdges();
+    if(argc >= 2 && string(argv[1]) == "bus")
+        return benchmarkBus(argc > 2 ? argv[2] : "");
+    if(argc >= 2 && string(argv[1]) == "gpio")
+        return benchmarkGPIO();
+    if(argc >= 2 && string(argv[1]) == "trace")
+        return benchmarkTrace(argc > 2 ? argv[2] : "trace.json");
+    if(argc >= 2 && string(argv[1]) == "pyramid")
+        return benchmarkPyramid();
+    if(argc >= 2 && string(argv[1]) == "blobs")
+        return benchmarkBlobs();
+    if(argc >= 2 && string(argv[1]) == "track")
+        return benchmarkTracking();
+    if(argc >= 2 && string(argv[1]) == "colors")
+        return benchmarkColors();
+    if(argc >= 3 && string(argv[1]) == "grabber")
+        return benchmarkGrabber(argv[2], argc > 3 ? atof(argv[3]) : 30);
+
+    return benchmarkModes();
+}
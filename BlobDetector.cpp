@@ -0,0 +1,142 @@
+#include "BlobDetector.h"
+#include "opencv2/core/hal/intrin.hpp"
+#include <algorithm>
+
+using namespace std;
+using namespace cv;
+
+namespace SniperBot
+{
+    int BlobDetector::findRoot(int i)
+    {
+        int root = i;
+
+        while(parent[root] != root)
+            root = parent[root];
+
+        // Point every run on the path straight at the root
+        while(parent[i] != root)
+        {
+            int next = parent[i];
+            parent[i] = root;
+            i = next;
+        }
+
+        return root;
+    }
+
+    void BlobDetector::join(int a, int b)
+    {
+        a = findRoot(a);
+        b = findRoot(b);
+
+        // Keep the earlier run as the root so blobs come out in scan order
+        if(a < b)
+            parent[b] = a;
+        else if(b < a)
+            parent[a] = b;
+    }
+
+    int BlobDetector::findBlobs(const Mat &mask, vector<Blob> &blobs)
+    {
+        CV_Assert(mask.type() == CV_8UC1);
+
+        int previousStart = 0, previousEnd = 0;  // the runs of the row above
+
+        runs.clear();
+        parent.clear();
+
+        for(int y = 0; y < mask.rows; ++y)
+        {
+            const uchar *src = mask.ptr<uchar>(y);
+            int rowStart = (int)runs.size();  // the first run of this row
+            int x = 0;
+
+            while(x < mask.cols)
+            {
+#if CV_SIMD128
+                // Skip empty pixels 16 at a time
+                while(x <= mask.cols - 16 && !v_check_any(v_load(src + x) != v_setzero_u8()))
+                    x += 16;
+#endif
+                while(x < mask.cols && !src[x])
+                    ++x;
+                if(x >= mask.cols)
+                    break;
+
+                Run run;
+                run.y = y;
+                run.start = x;
+                while(x < mask.cols && src[x])
+                    ++x;
+                run.end = x;
+
+                int index = (int)runs.size();
+                runs.push_back(run);
+                parent.push_back(index);
+
+                // Join every run of the row above that touches this run, including diagonally.
+                // Both rows are in x order, so runs that end before this one starts are
+                // skipped for good.
+                while(previousStart < previousEnd && runs[previousStart].end < run.start)
+                    ++previousStart;
+                for(int p = previousStart; p < previousEnd && runs[p].start <= run.end; ++p)
+                    join(index, p);
+            }
+
+            previousStart = rowStart;
+            previousEnd = (int)runs.size();
+        }
+
+        // Give each group a blob and gather its statistics from its runs
+        int numRuns = (int)runs.size();
+        label.assign(numRuns, -1);
+        blobs.clear();
+        sumX.clear();
+        sumY.clear();
+
+        for(int i = 0; i < numRuns; ++i)
+        {
+            const Run &run = runs[i];
+            int root = findRoot(i);
+            int length = run.end - run.start;
+
+            if(label[root] < 0)
+            {
+                Blob blob;
+                blob.area = 0;
+                blob.bounds = Rect(run.start, run.y, length, 1);
+                label[root] = (int)blobs.size();
+                blobs.push_back(blob);
+                sumX.push_back(0);
+                sumY.push_back(0);
+            }
+
+            int b = label[root];
+            Blob &blob = blobs[b];
+            blob.area += length;
+            blob.bounds |= Rect(run.start, run.y, length, 1);
+            sumX[b] += (run.start + run.end - 1) * (double)length / 2;
+            sumY[b] += (double)run.y * length;
+        }
+
+        for(size_t b = 0; b < blobs.size(); ++b)
+        {
+            blobs[b].x = sumX[b] / blobs[b].area;
+            blobs[b].y = sumY[b] / blobs[b].area;
+        }
+
+        return (int)blobs.size();
+    }
+
+    int BlobDetector::largestBlob(const vector<Blob> &blobs)
+    {
+        int best = -1;
+
+        for(size_t i = 0; i < blobs.size(); ++i)
+            if(best < 0 || blobs[i].area > blobs[best].area)
+                best = (int)i;
+
+        return best;
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef BLOBDETECTOR_H
+#define	BLOBDETECTOR_H
+
+#include "opencv2/core/core.hpp"
+#include <vector>
+
+using namespace cv;
+
+namespace SniperBot
+{
+    /** Blob Struct
+     * Purpose: Holds the size and position of one connected group of pixels in a mask.
+     */
+    struct Blob
+    {
+        int area;  // the number of pixels in the blob
+        Rect bounds;  // the bounding box of the blob
+        double x;  // the x coordinate of the blob's centroid
+        double y;  // the y coordinate of the blob's centroid
+    };
+
+    /** BlobDetector Class
+     * Purpose: Finds the 8-connected blobs of a mask in one pass over its rows. Each row is
+     * turned into runs of set pixels, runs that touch a run on the row above are joined with
+     * union-find, and the blob statistics are gathered from the runs instead of the pixels.
+     * The work arrays are kept between calls so steady state use does not allocate.
+     */
+    class BlobDetector
+    {
+    private:
+
+        /** Run Struct
+         * Purpose: Holds a horizontal run of set pixels.
+         */
+        struct Run
+        {
+            int y;  // the row of the run
+            int start;  // the x coordinate of the first pixel of the run
+            int end;  // the x coordinate after the last pixel of the run
+        };
+
+        std::vector<Run> runs;  // the runs of the mask, in row order
+        std::vector<int> parent;  // the union-find parent of each run
+        std::vector<int> label;  // the blob index of each root run
+        std::vector<double> sumX;  // the sum of the x coordinates of each blob
+        std::vector<double> sumY;  // the sum of the y coordinates of each blob
+
+        /** Finds the root run of a run's group, flattening the path on the way
+         * @param i the index of the run
+         * @return the index of the root run
+         */
+        int findRoot(int i);
+
+        /** Joins the groups of two runs
+         * @param a the index of the first run
+         * @param b the index of the second run
+         */
+        void join(int a, int b);
+
+    public:
+
+        /** The findBlobs function finds the blobs of a mask
+         * @param mask the 8-bit, 1 channel mask. Any non-zero pixel is set.
+         * @param blobs a reference to a vector that will hold the blobs, in the order their
+         * first pixel appears
+         * @return the number of blobs found
+         */
+        int findBlobs(const Mat &mask, std::vector<Blob> &blobs);
+
+        /** The largestBlob function gets the blob with the most pixels
+         * @param blobs the blobs to choose from
+         * @return the index of the largest blob, -1 if there are no blobs
+         */
+        static int largestBlob(const std::vector<Blob> &blobs);
+    };
+}
+
+#endif	/* BLOBDETECTOR_H */
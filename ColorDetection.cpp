@@ -1,7 +1,11 @@
 #include "ColorDetection.h"
+#include "Trace.h"
 #include "opencv2/highgui/highgui.hpp"
 //#include "opencv2/imgproc/imgproc.hpp"
 #include <iostream>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
 
 using namespace std;
 using namespace cv;
@@ -13,14 +17,36 @@ namespace SniperBot
         long width, bool drawCrosshair, bool showThreshold)
     {
         this->cap = &c;
+        this->source = NULL;
         this->color = color;
         this->showWindow = showWindow;
         this->width = width;
         this->drawCrosshair = drawCrosshair;
         this->showThreshold = showThreshold;
+        this->processMode = PROCESS_FUSED_EXACT;
+        this->morphKernel = getStructuringElement(MORPH_ELLIPSE, Size(5, 5));
+        this->bufferReallocations = 0;
+        this->trackingWindow = false;
+        this->hasTrack = false;
+        this->lastX = -1;
+        this->lastY = -1;
+        this->lastArea = 0;
+        this->blobMode = false;
+        this->bestBlob = -1;
+        this->pyramidLevel = 0;
+        this->yuvClasses = false;
+        this->yuvTableColors = 0;
+        this->yuvTableBuilds = 0;
+        this->yuvClass = -1;
     }
     
     VideoCapture *ColorDetector::getVideoCapture() { return cap; }
+    
+    // getFrameSource function
+    FrameSource *ColorDetector::getFrameSource() { return source; }
+    
+    // setFrameSource function
+    void ColorDetector::setFrameSource(FrameSource *value) { source = value; }
         
     // getColor function
     int ColorDetector::getColor() { return color; }
@@ -52,59 +78,570 @@ namespace SniperBot
     // setShowThreshold function
     void ColorDetector::setShowThreshold(bool value) { showThreshold = value; }
 
-    int ColorDetector::findColorFromCam(int &x, int &y)
+    // getProcessMode function
+    int ColorDetector::getProcessMode() { return processMode; }
+
+    // setProcessMode function
+    void ColorDetector::setProcessMode(int value) { processMode = value; }
+
+    // getBufferReallocations function
+    long ColorDetector::getBufferReallocations() { return bufferReallocations; }
+
+    // getTrackingWindow function
+    bool ColorDetector::getTrackingWindow() { return trackingWindow; }
+
+    // setTrackingWindow function
+    void ColorDetector::setTrackingWindow(bool value)
     {
-        Mat imgOriginal;  // holds the image matrix of the camera capture
+        trackingWindow = value;
+        hasTrack = false;  // the first frame is always searched in full
+    }
 
-        bool bSuccess = (*cap).read(imgOriginal); // read a new frame from camera
+    // getSearchWindow function
+    Rect ColorDetector::getSearchWindow() { return searchWindow; }
 
-        //if could not read from camera, return error
-        if (!bSuccess)
-            return ERROR_CANNOT_READ_CAMERA;
-        
-        // if width is not the default width, resize the window keeping the aspect ratio
-        if(width > 0)
-            resize(imgOriginal, imgOriginal,
-                    Size(width, (int)(imgOriginal.rows * (width / (float)imgOriginal.cols))));
-        
-        Mat imgHSV;  // stores the HSV color version of the original camera capture
-        
-        cvtColor(imgOriginal, imgHSV, COLOR_BGR2HSV); //Convert the captured frame from BGR to HSV
+    // getBlobMode function
+    bool ColorDetector::getBlobMode() { return blobMode; }
+
+    // setBlobMode function
+    void ColorDetector::setBlobMode(bool value) { blobMode = value; }
+
+    // getBlobs function
+    const vector<Blob> &ColorDetector::getBlobs() { return blobs; }
+
+    // getPyramidLevel function
+    int ColorDetector::getPyramidLevel() { return pyramidLevel; }
+
+    // setPyramidLevel function
+    void ColorDetector::setPyramidLevel(int value) { pyramidLevel = value; }
+
+    // getPyramidWork function
+    const vector<PyramidLevelWork> &ColorDetector::getPyramidWork() { return pyramidWork; }
+
+    // getTargetColors function
+    vector<int> ColorDetector::getTargetColors() { return targetColors; }
+
+    // setTargetColors function
+    void ColorDetector::setTargetColors(const vector<int> &value) { targetColors = value; }
+    
+    // getYuvClasses function
+    bool ColorDetector::getYuvClasses() { return yuvClasses; }
+    
+    // setYuvClasses function
+    void ColorDetector::setYuvClasses(bool value) { yuvClasses = value; }
+    
+    // getYuvTableBuilds function
+    long ColorDetector::getYuvTableBuilds() { return yuvTableBuilds; }
+
+    void ColorDetector::prepareBuffer(Mat &buffer, Size size, int type)
+    {
+        // Only allocate if the buffer can't be reused
+        if(buffer.size() != size || buffer.type() != type)
+        {
+            buffer.create(size, type);
+            ++bufferReallocations;
+        }
+    }
+
+    bool ColorDetector::getColorRange(int color, HSVRange &range)
+    {
+        int lower[3], upper[3];  // the H, S and V bounds of the color
         
-        Mat imgThresholded;
         // This needs to be tested in a control environment to acquire predefined colors and their values. Colors can be selected selected from switch case.
         switch(color)
         {
             case 1:  // Red
-                inRange(imgHSV, Scalar(170, 150, 60), Scalar(179, 255, 255), imgThresholded); //Threshold the image
+                lower[0] = 170; lower[1] = 150; lower[2] = 60;
+                upper[0] = 179; upper[1] = 255; upper[2] = 255;
                 break;
             case 2:  // Blue
-                inRange(imgHSV, Scalar(72, 63, 28), Scalar(179, 255, 255), imgThresholded); //Threshold the image
+                lower[0] = 72; lower[1] = 63; lower[2] = 28;
+                upper[0] = 179; upper[1] = 255; upper[2] = 255;
                 break;
             case 3:  // Green
-                inRange(imgHSV, Scalar(0, 107, 102), Scalar(179, 255, 187), imgThresholded); //Threshold the image
+                lower[0] = 0; lower[1] = 107; lower[2] = 102;
+                upper[0] = 179; upper[1] = 255; upper[2] = 187;
                 break;
             case 4:  // Yellow
-                inRange(imgHSV, Scalar(19, 0, 169), Scalar(44, 255, 255), imgThresholded); //Threshold the image
+                lower[0] = 19; lower[1] = 0; lower[2] = 169;
+                upper[0] = 44; upper[1] = 255; upper[2] = 255;
                 break;
+            default:  // Unknown color
+                return false;
+        }
+        
+        for(int i = 0; i < 3; ++i)
+        {
+            range.lower[i] = (uchar)lower[i];
+            range.upper[i] = (uchar)upper[i];
+        }
+        return true;
+    }
+
+    bool ColorDetector::readFrame(bool keepYuyv)
+    {
+        TRACE_SPAN("camera read");
+        
+        if(source)
+        {
+            // The frame source lends its own preallocated frame
+            if(!source->read(frameBuffer))
+                return false;
+            
+            // A camera's own YUYV buffer is only needed until it has been converted
+            if(frameBuffer.type() == CV_8UC2 && !keepYuyv)
+            {
+                frameBuffer = convertYuyv(frameBuffer);
+                source->release();
+            }
+            return true;
+        }
+        
+        uchar *previous = frameBuffer.data;  // used to tell if the capture reallocated the buffer
+        
+        bool bSuccess = (*cap).read(frameBuffer); // read a new frame from camera
+        
+        if(frameBuffer.data != previous)
+            ++bufferReallocations;
+        
+        return bSuccess;
+    }
+
+    void ColorDetector::mergeOverlapping(vector<Rect> &regions)
+    {
+        // A grown region may overlap one that was already checked against it, so keep
+        // going until a whole pass merges nothing
+        bool merged = true;
+        while(merged)
+        {
+            merged = false;
+            for(size_t i = 0; i < regions.size(); ++i)
+            {
+                for(size_t j = i + 1; j < regions.size(); )
+                {
+                    if((regions[i] & regions[j]).area() > 0)
+                    {
+                        regions[i] |= regions[j];
+                        regions.erase(regions.begin() + j);
+                        merged = true;
+                    }
+                    else
+                        ++j;
+                }
+            }
+        }
+    }
+
+    Mat &ColorDetector::convertYuyv(Mat &frame)
+    {
+        if(frame.type() != CV_8UC2)
+            return frame;
+        
+        TRACE_SPAN("yuyv convert");
+        prepareBuffer(convertedBuffer, frame.size(), CV_8UC3);
+        cvtColor(frame, convertedBuffer, COLOR_YUV2BGR_YUYV);
+        return convertedBuffer;
+    }
+
+    bool ColorDetector::canClassifyYuyv(const Mat &frame)
+    {
+        // The table can only classify the frame at its own size, and the window needs BGR
+        return frame.type() == CV_8UC2 && yuvClasses && !showWindow &&
+            (width <= 0 || frame.cols == width);
+    }
+
+    Mat &ColorDetector::resizeFrame(Mat &frame)
+    {
+        // if width is the default width, or the frame was decoded at the width, search the
+        // frame as it is
+        if(width <= 0 || frame.cols == width)
+            return frame;
+        
+        TRACE_SPAN("resize");
+        
+        // resize the window keeping the aspect ratio
+        Size size(width, (int)(frame.rows * (width / (float)frame.cols)));
+        prepareBuffer(resizedBuffer, size, frame.type());
+        resize(frame, resizedBuffer, size);
+        
+        return resizedBuffer;
+    }
+
+    void ColorDetector::drawCrosshairAt(Mat &img, int posX, int posY)
+    {
+        circle(img, Point(posX, posY), 15, Scalar(0, 255, 0));
+        line(img, Point(posX, posY - 20), Point(posX, posY - 5), Scalar(0, 255, 0));
+        line(img, Point(posX, posY + 20), Point(posX, posY + 5), Scalar(0, 255, 0));
+        line(img, Point(posX - 20, posY), Point(posX - 5, posY), Scalar(0, 255, 0));
+        line(img, Point(posX + 20, posY), Point(posX + 5, posY), Scalar(0, 255, 0));
+    }
+
+    int ColorDetector::findColorFromCam(int &x, int &y)
+    {
+        TRACE_SPAN("findColorFromCam");
+        
+        //if could not read from camera, return error
+        if (!readFrame(yuvClasses && !showWindow))
+            return ERROR_CANNOT_READ_CAMERA;
+        
+        int error = findColorInFrame(frameBuffer, x, y);
+        if(source)
+            source->release();  // the frame has been searched
+        return error;
+    }
+
+    void ColorDetector::searchRegion(Mat &img, const Rect &region, const HSVRange &range,
+        bool needMask, MaskMoments &oMoments)
+    {
+        Mat imgRegion = img(region);  // the part of the frame to search
+        
+        // The work buffers are sized for the whole frame, and the region is a view into them,
+        // so a smaller region never reallocates anything
+        prepareBuffer(thresholdBuffer, img.size(), CV_8UC1);
+        Mat imgThresholded = thresholdBuffer(region);
+        
+        if(img.type() == CV_8UC2)
+        {
+            // A pair of YUYV pixels shares its U and V, so the region is widened to whole pairs
+            int left = region.x & ~1;
+            Rect pairs(left, region.y, ((region.x + region.width + 1) & ~1) - left, region.height);
+            
+            if(processMode == PROCESS_FUSED_FAST && !needMask && pairs == region)
+            {
+                TRACE_SPAN("yuv table + moments");
+                MaskMoments m[MAX_COLOR_CLASSES];  // the moments of every target color
+                classifyYuyv(img(region), &yuvTable[0], yuvTableColors, NULL, m);
+                oMoments = m[yuvClass];
+            }
+            else
+            {
+                prepareBuffer(classBuffer, img.size(), CV_8UC1);
+                Mat imgClasses = classBuffer(pairs);
+                {
+                    TRACE_SPAN("yuv table");
+                    classifyYuyv(img(pairs), &yuvTable[0], yuvTableColors, &imgClasses, NULL);
+                    extractClass(classBuffer(region), yuvClass, imgThresholded);
+                }
+                
+                if(processMode != PROCESS_FUSED_FAST)
+                {
+                    prepareBuffer(morphBuffer, img.size(), CV_8UC1);
+                    Mat imgMorph = morphBuffer(region);
+                    
+                    TRACE_SPAN("morphology");
+                    erodeEllipse5(imgThresholded, imgMorph);
+                    dilateEllipse5(imgMorph, imgThresholded);
+                    dilateEllipse5(imgThresholded, imgMorph);
+                    erodeEllipse5(imgMorph, imgThresholded);
+                }
+                
+                TRACE_SPAN("moments");
+                oMoments = maskMoments(imgThresholded);
+            }
+        }
+        else if(processMode == PROCESS_FUSED_FAST)
+        {
+            // Threshold and gather the moments in one sweep. The threshold image is only
+            // written when it is needed.
+            TRACE_SPAN("threshold + moments");
+            thresholdMoments(imgRegion, range, needMask ? &imgThresholded : NULL, &oMoments);
+        }
+        else if(processMode == PROCESS_LEGACY)
+        {
+            prepareBuffer(hsvBuffer, img.size(), CV_8UC3);
+            Mat imgHSV = hsvBuffer(region);
+            
+            {
+                TRACE_SPAN("hsv");
+                cvtColor(imgRegion, imgHSV, COLOR_BGR2HSV); //Convert the captured frame from BGR to HSV
+            }
+            {
+                TRACE_SPAN("threshold");
+                inRange(imgHSV, Scalar(range.lower[0], range.lower[1], range.lower[2]),
+                    Scalar(range.upper[0], range.upper[1], range.upper[2]), imgThresholded); //Threshold the image
+            }
+            {
+                TRACE_SPAN("morphology");
+                
+                // The threshold image is a view into the whole frame's buffer, so the pixels
+                // around it are left over from other searches and must not be read
+                int border = BORDER_CONSTANT | BORDER_ISOLATED;
+                Scalar borderValue = morphologyDefaultBorderValue();
+                
+                //morphological opening (removes small objects from the foreground)
+                erode(imgThresholded, imgThresholded, morphKernel, Point(-1, -1), 1, border, borderValue);
+                dilate(imgThresholded, imgThresholded, morphKernel, Point(-1, -1), 1, border, borderValue);
+
+                //morphological closing (removes small holes from the foreground)
+                dilate(imgThresholded, imgThresholded, morphKernel, Point(-1, -1), 1, border, borderValue);
+                erode(imgThresholded, imgThresholded, morphKernel, Point(-1, -1), 1, border, borderValue);
+            }
+            
+            //Calculate the moments of the thresholded image
+            TRACE_SPAN("moments");
+            Moments m = moments(imgThresholded);
+            oMoments.m00 = m.m00;
+            oMoments.m10 = m.m10;
+            oMoments.m01 = m.m01;
+        }
+        else
+        {
+            prepareBuffer(morphBuffer, img.size(), CV_8UC1);
+            Mat imgMorph = morphBuffer(region);
+            
+            // Convert to HSV and threshold in one pass without storing the HSV image
+            {
+                TRACE_SPAN("hsv + threshold");
+                thresholdMoments(imgRegion, range, &imgThresholded, NULL);
+            }
+            
+            // morphological opening and closing, passing the image back and forth between
+            // the two buffers
+            {
+                TRACE_SPAN("morphology");
+                erodeEllipse5(imgThresholded, imgMorph);
+                dilateEllipse5(imgMorph, imgThresholded);
+                dilateEllipse5(imgThresholded, imgMorph);
+                erodeEllipse5(imgMorph, imgThresholded);
+            }
+            
+            //Calculate the moments of the thresholded image
+            TRACE_SPAN("moments");
+            oMoments = maskMoments(imgThresholded);
+        }
+        
+        // Move the moments from the region's coordinates to the frame's coordinates
+        oMoments.m10 += region.x * oMoments.m00;
+        oMoments.m01 += region.y * oMoments.m00;
+    }
+
+    MaskMoments ColorDetector::findBestBlob(const Rect &region)
+    {
+        TRACE_SPAN("blobs");
+        
+        MaskMoments oMoments;  // the moments of the target blob
+        double bestScore = 0;  // the score of the target blob
+        
+        blobDetector.findBlobs(thresholdBuffer(region), blobs);
+        bestBlob = -1;
+        
+        for(size_t i = 0; i < blobs.size(); ++i)
+        {
+            Blob &blob = blobs[i];
+            
+            // Move the blob from the region's coordinates to the frame's coordinates
+            blob.bounds.x += region.x;
+            blob.bounds.y += region.y;
+            blob.x += region.x;
+            blob.y += region.y;
+            
+            // Blobs too small to be a target are noise
+            if(255.0 * blob.area <= MIN_AREA)
+                continue;
+            
+            // While tracking, prefer the blob nearest the last target. Otherwise prefer the
+            // largest blob.
+            double score = blob.area;
+            if(trackingWindow && hasTrack)
+            {
+                double dx = blob.x - lastX, dy = blob.y - lastY;
+                score = -(dx * dx + dy * dy);
+            }
+            
+            if(bestBlob < 0 || score > bestScore)
+            {
+                bestBlob = (int)i;
+                bestScore = score;
+            }
+        }
+        
+        if(bestBlob < 0)
+        {
+            oMoments.m00 = oMoments.m10 = oMoments.m01 = 0;
+            return oMoments;
+        }
+        
+        oMoments.m00 = 255.0 * blobs[bestBlob].area;
+        oMoments.m10 = oMoments.m00 * blobs[bestBlob].x;
+        oMoments.m01 = oMoments.m00 * blobs[bestBlob].y;
+        return oMoments;
+    }
+
+    void ColorDetector::searchCoarseToFine(Mat &img, const HSVRange &range, MaskMoments &oMoments)
+    {
+        int scale = 1 << pyramidLevel;  // how many full resolution pixels a coarse pixel covers
+        int pad = scale + 4;  // covers the coarse sampling and the morphology around each region
+        Size coarseSize((img.cols + scale - 1) / scale, (img.rows + scale - 1) / scale);
+        Rect fullFrame(0, 0, img.cols, img.rows);
+        
+        // Threshold a decimated copy of the frame. Nearest neighbor sampling keeps the pixel
+        // colors as they are, so the coarse threshold sees the same colors.
+        {
+            TRACE_SPAN("coarse search");
+            prepareBuffer(coarseBuffer, coarseSize, CV_8UC3);
+            prepareBuffer(coarseMask, coarseSize, CV_8UC1);
+            resize(img, coarseBuffer, coarseSize, 0, 0, INTER_NEAREST);
+            thresholdMoments(coarseBuffer, range, &coarseMask, NULL);
+            blobDetector.findBlobs(coarseMask, coarseBlobs);
+        }
+        
+        // Turn the coarse blobs that could be targets into full resolution regions. The area
+        // cutoff is halved since the coarse area is only an estimate.
+        candidateRegions.clear();
+        for(size_t i = 0; i < coarseBlobs.size(); ++i)
+        {
+            const Rect &b = coarseBlobs[i].bounds;
+            if(255.0 * coarseBlobs[i].area * scale * scale <= MIN_AREA / 2)
+                continue;
+            candidateRegions.push_back(Rect(b.x * scale - pad, b.y * scale - pad,
+                b.width * scale + pad * 2, b.height * scale + pad * 2) & fullFrame);
         }
         
-        //morphological opening (removes small objects from the foreground)
-        erode(imgThresholded, imgThresholded, getStructuringElement(MORPH_ELLIPSE, Size(5, 5)) );
-        dilate( imgThresholded, imgThresholded, getStructuringElement(MORPH_ELLIPSE, Size(5, 5)) );
+        // Merge regions that overlap so no pixel is counted twice
+        mergeOverlapping(candidateRegions);
+        
+        // Search the regions at full resolution
+        oMoments.m00 = oMoments.m10 = oMoments.m01 = 0;
+        searchWindow = Rect();
+        long finePixels = 0;
+        for(size_t i = 0; i < candidateRegions.size(); ++i)
+        {
+            const Rect &region = candidateRegions[i];
+            MaskMoments m;
+            
+            searchRegion(img, region, range, showThreshold || blobMode, m);
+            finePixels += region.area();
+            searchWindow |= region;
+            
+            if(blobMode)
+            {
+                // Keep the largest blob of all the regions
+                m = findBestBlob(region);
+                if(m.m00 > oMoments.m00)
+                    oMoments = m;
+            }
+            else
+            {
+                oMoments.m00 += m.m00;
+                oMoments.m10 += m.m10;
+                oMoments.m01 += m.m01;
+            }
+        }
+        
+        // Report the work of each level
+        pyramidWork.resize(2);
+        pyramidWork[0].level = pyramidLevel;
+        pyramidWork[0].regions = 1;
+        pyramidWork[0].pixels = (long)coarseSize.area();
+        pyramidWork[1].level = 0;
+        pyramidWork[1].regions = (int)candidateRegions.size();
+        pyramidWork[1].pixels = finePixels;
+    }
+
+    Rect ColorDetector::trackingRect(Size frameSize, double scale)
+    {
+        // Make the window a few times wider than the target, which is sqrt(area) across
+        int half = (int)(scale * TRACK_WINDOW_SCALE * sqrt(lastArea / 255.0) / 2);
+        half = max(half, MIN_TRACK_WINDOW / 2);
+        
+        Rect window(lastX - half, lastY - half, half * 2, half * 2);
+        return window & Rect(0, 0, frameSize.width, frameSize.height);
+    }
+
+    bool ColorDetector::touchesWindowEdge(const Rect &region, Size frameSize)
+    {
+        Mat imgThresholded = thresholdBuffer(region);
+        
+        // In blob mode, only the target blob matters
+        if(blobMode && bestBlob >= 0)
+        {
+            Rect target = blobs[bestBlob].bounds;
+            return (region.x > 0 && target.x == region.x) ||
+                (region.x + region.width < frameSize.width &&
+                    target.x + target.width == region.x + region.width) ||
+                (region.y > 0 && target.y == region.y) ||
+                (region.y + region.height < frameSize.height &&
+                    target.y + target.height == region.y + region.height);
+        }
+        
+        // Only the sides that are inside the frame count. The target can't leave through the
+        // side of the frame.
+        if(region.x > 0 && countNonZero(imgThresholded.col(0)))
+            return true;
+        if(region.x + region.width < frameSize.width &&
+                countNonZero(imgThresholded.col(region.width - 1)))
+            return true;
+        if(region.y > 0 && countNonZero(imgThresholded.row(0)))
+            return true;
+        if(region.y + region.height < frameSize.height &&
+                countNonZero(imgThresholded.row(region.height - 1)))
+            return true;
+        
+        return false;
+    }
 
-        //morphological closing (removes small holes from the foreground)
-        dilate( imgThresholded, imgThresholded, getStructuringElement(MORPH_ELLIPSE, Size(5, 5)) );
-        erode(imgThresholded, imgThresholded, getStructuringElement(MORPH_ELLIPSE, Size(5, 5)) );
+    int ColorDetector::findColorInFrame(Mat &frame, int &x, int &y)
+    {
+        HSVRange range;  // the HSV range of the color to find
+        
+        if(!getColorRange(color, range))
+            return ERROR_UNKNOWN_COLOR;
+        
+        // A YUYV frame is classified with the target colors' table if the color is one of
+        // them, and the search is one the table can do. Otherwise it is converted to BGR.
+        yuvClass = -1;
+        if(canClassifyYuyv(frame) && processMode != PROCESS_LEGACY && pyramidLevel == 0)
+        {
+            HSVRange ranges[MAX_COLOR_CLASSES];  // the HSV range of each target color
+            int numColors = getTargetRanges(ranges);  // the number of target colors
+            
+            for(int i = 0; i < numColors && yuvClass < 0; ++i)
+                if(targetColors[i] == color)
+                    yuvClass = i;
+            if(yuvClass >= 0)
+                prepareYuvTable(ranges, numColors);
+        }
+        
+        Mat &imgOriginal = resizeFrame(yuvClass >= 0 ? frame : convertYuyv(frame));  // the frame to search
+        Rect fullFrame(0, 0, imgOriginal.cols, imgOriginal.rows);
+        MaskMoments oMoments;  // the moments of the thresholded image
+        
+        // If the target was found last time, start with a window around it
+        searchWindow = trackingWindow && hasTrack ? trackingRect(imgOriginal.size(), 1) : fullFrame;
+        
+        // With no target to track, search coarse to fine if a pyramid level is set
+        if(pyramidLevel > 0 && searchWindow == fullFrame)
+            searchCoarseToFine(imgOriginal, range, oMoments);
+        else
+        {
+            // Grow the window until the whole target is inside it, ending with the full frame
+            for(double scale = 2; ; scale *= 2)
+            {
+                bool isFullFrame = searchWindow == fullFrame;
+            
+                searchRegion(imgOriginal, searchWindow, range,
+                    showThreshold || blobMode || !isFullFrame, oMoments);
+            
+                // Aim at one blob instead of the center of the whole threshold image
+                if(blobMode)
+                    oMoments = findBestBlob(searchWindow);
+            
+                if(isFullFrame || (oMoments.m00 > MIN_AREA &&
+                        !touchesWindowEdge(searchWindow, imgOriginal.size())))
+                    break;
+            
+                searchWindow = trackingRect(imgOriginal.size(), scale);
+                if(scale >= TRACK_MAX_GROWTH)
+                    searchWindow = fullFrame;
+            }
+        }
         
-        //Calculate the moments of the thresholded image
-        Moments oMoments = moments(imgThresholded);
         double dM01 = oMoments.m01;
         double dM10 = oMoments.m10;
         double dArea = oMoments.m00;
         
         // if the area <= 10000, I consider that the there are no object in the image and it's because of the noise, the area is not zero
-        if (dArea > 10000)
+        if (dArea > MIN_AREA)
         {
             //calculate the position of the target object
             int posX = dM10 / dArea;
@@ -112,14 +649,8 @@ namespace SniperBot
             x = posX;
             y = posY;
             
-            if(drawCrosshair)  // Draw a crosshair
-            {
-                circle(imgOriginal, Point(posX, posY), 15, Scalar(0, 255, 0));
-                line(imgOriginal, Point(posX, posY - 20), Point(posX, posY - 5), Scalar(0, 255, 0));
-                line(imgOriginal, Point(posX, posY + 20), Point(posX, posY + 5), Scalar(0, 255, 0));
-                line(imgOriginal, Point(posX - 20, posY), Point(posX - 5, posY), Scalar(0, 255, 0));
-                line(imgOriginal, Point(posX + 20, posY), Point(posX + 5, posY), Scalar(0, 255, 0));
-            }
+            if(drawCrosshair && yuvClass < 0)  // Draw a crosshair
+                drawCrosshairAt(imgOriginal, posX, posY);
         }
         else  // No target object detected
         {
@@ -127,12 +658,213 @@ namespace SniperBot
             y = -1;
         }
         
+        // Remember the target so the next frame can search around it
+        hasTrack = dArea > MIN_AREA;
+        lastX = x;
+        lastY = y;
+        lastArea = dArea;
+        
+        TRACE_SPAN("display");
+        
         // Show window
         if(showWindow) imshow("Original", imgOriginal); //show the original image
         
         // Show threshold window
-        if(showThreshold) imshow("Threshold", imgThresholded);
+        if(showThreshold && searchWindow.area() > 0) imshow("Threshold", thresholdBuffer(searchWindow));
+        
+        return ERROR_NONE;
+    }
+
+    int ColorDetector::findColorsFromCam(vector<ColorResult> &results)
+    {
+        TRACE_SPAN("findColorsFromCam");
+        
+        //if could not read from camera, return error
+        if (!readFrame(yuvClasses && !showWindow))
+            return ERROR_CANNOT_READ_CAMERA;
+        
+        int error = frameBuffer.type() == CV_8UC2 ? findColorsInYuyv(frameBuffer, results) :
+            findColorsInFrame(frameBuffer, results);
+        if(source)
+            source->release();  // the frame has been searched
+        return error;
+    }
+
+    int ColorDetector::getTargetRanges(HSVRange *ranges)
+    {
+        int numColors = (int)targetColors.size();  // the number of colors to search for
+        
+        if(numColors < 1 || numColors > MAX_COLOR_CLASSES)
+            return -1;
+        for(int i = 0; i < numColors; ++i)
+            if(!getColorRange(targetColors[i], ranges[i]))
+                return -1;
+        return numColors;
+    }
+
+    void ColorDetector::prepareYuvTable(const HSVRange *ranges, int numColors)
+    {
+        if(numColors == yuvTableColors &&
+                memcmp(ranges, yuvTableRanges, numColors * sizeof(HSVRange)) == 0)
+            return;
+        
+        TRACE_SPAN("yuv table build");
+        yuvTable.resize(YUV_TABLE_SIZE);
+        buildYuvClassTable(ranges, numColors, &yuvTable[0]);
+        memcpy(yuvTableRanges, ranges, numColors * sizeof(HSVRange));
+        yuvTableColors = numColors;
+        ++yuvTableBuilds;
+    }
+
+    void ColorDetector::measureClasses(Size size, int numColors, MaskMoments *oMoments)
+    {
+        prepareBuffer(thresholdBuffer, size, CV_8UC1);
+        prepareBuffer(morphBuffer, size, CV_8UC1);
+        
+        for(int i = 0; i < numColors; ++i)
+        {
+            extractClass(classBuffer, i, thresholdBuffer);
+            
+            //morphological opening and closing
+            if(processMode != PROCESS_FUSED_FAST)
+            {
+                TRACE_SPAN("morphology");
+                erodeEllipse5(thresholdBuffer, morphBuffer);
+                dilateEllipse5(morphBuffer, thresholdBuffer);
+                dilateEllipse5(thresholdBuffer, morphBuffer);
+                erodeEllipse5(morphBuffer, thresholdBuffer);
+            }
+            
+            // Aim at one blob of the color, or the center of all of it
+            if(blobMode)
+                oMoments[i] = findBestBlob(Rect(0, 0, size.width, size.height));
+            else
+            {
+                TRACE_SPAN("moments");
+                oMoments[i] = maskMoments(thresholdBuffer);
+            }
+        }
+    }
+
+    void ColorDetector::reportColors(Mat *img, int numColors, const MaskMoments *oMoments,
+        vector<ColorResult> &results)
+    {
+        results.resize(numColors);
+        for(int i = 0; i < numColors; ++i)
+        {
+            ColorResult &result = results[i];
+            
+            result.color = targetColors[i];
+            result.area = oMoments[i].m00;
+            result.found = result.area > MIN_AREA;
+            
+            if(result.found)
+            {
+                //calculate the position of the target object
+                result.x = (int)(oMoments[i].m10 / result.area);
+                result.y = (int)(oMoments[i].m01 / result.area);
+                
+                if(drawCrosshair && img)  // Draw a crosshair
+                    drawCrosshairAt(*img, result.x, result.y);
+            }
+            else  // No target object detected
+            {
+                result.x = -1;
+                result.y = -1;
+            }
+        }
+        
+        TRACE_SPAN("display");
+        
+        // Show window
+        if(showWindow && img) imshow("Original", *img); //show the original image
+        
+        // Show threshold window. Every color is shown in white.
+        if(showThreshold)
+        {
+            prepareBuffer(thresholdBuffer, classBuffer.size(), CV_8UC1);
+            compare(classBuffer, Scalar(0), thresholdBuffer, CMP_NE);
+            imshow("Threshold", thresholdBuffer);
+        }
+    }
+
+    int ColorDetector::findColorsInFrame(Mat &frame, vector<ColorResult> &results)
+    {
+        HSVRange ranges[MAX_COLOR_CLASSES];  // the HSV range of each target color
+        MaskMoments oMoments[MAX_COLOR_CLASSES];  // the moments of each target color
+        
+        int numColors = getTargetRanges(ranges);  // the number of colors to search for
+        if(numColors < 0)
+            return ERROR_UNKNOWN_COLOR;
+        
+        Mat &imgOriginal = resizeFrame(frame);  // the frame to search
+        
+        if(processMode == PROCESS_FUSED_FAST && !blobMode)
+        {
+            // Classify and gather the moments of every color in one sweep. The class image is
+            // only written when it is going to be shown.
+            TRACE_SPAN("threshold + moments");
+            if(showThreshold)
+                prepareBuffer(classBuffer, imgOriginal.size(), CV_8UC1);
+            thresholdClasses(imgOriginal, ranges, numColors, showThreshold ? &classBuffer : NULL,
+                oMoments);
+        }
+        else
+        {
+            // Classify every color in one sweep, then clean up each color's threshold image
+            // the same way findColorInFrame does
+            prepareBuffer(classBuffer, imgOriginal.size(), CV_8UC1);
+            
+            {
+                TRACE_SPAN("hsv + threshold");
+                thresholdClasses(imgOriginal, ranges, numColors, &classBuffer, NULL);
+            }
+            
+            measureClasses(imgOriginal.size(), numColors, oMoments);
+        }
+        
+        reportColors(&imgOriginal, numColors, oMoments, results);
+        
+        return ERROR_NONE;
+    }
+
+    int ColorDetector::findColorsInYuyv(Mat &frame, vector<ColorResult> &results)
+    {
+        if(!canClassifyYuyv(frame))
+            return findColorsInFrame(convertYuyv(frame), results);
+        
+        HSVRange ranges[MAX_COLOR_CLASSES];  // the HSV range of each target color
+        MaskMoments oMoments[MAX_COLOR_CLASSES];  // the moments of each target color
+        
+        int numColors = getTargetRanges(ranges);  // the number of colors to search for
+        if(numColors < 0)
+            return ERROR_UNKNOWN_COLOR;
+        
+        prepareYuvTable(ranges, numColors);
+        
+        if(processMode == PROCESS_FUSED_FAST && !blobMode)
+        {
+            // Classify and gather the moments of every color in one sweep, as findColorsInFrame does
+            TRACE_SPAN("yuv table + moments");
+            if(showThreshold)
+                prepareBuffer(classBuffer, frame.size(), CV_8UC1);
+            classifyYuyv(frame, &yuvTable[0], numColors, showThreshold ? &classBuffer : NULL,
+                oMoments);
+        }
+        else
+        {
+            prepareBuffer(classBuffer, frame.size(), CV_8UC1);
+            
+            {
+                TRACE_SPAN("yuv table");
+                classifyYuyv(frame, &yuvTable[0], numColors, &classBuffer, NULL);
+            }
+            
+            measureClasses(frame.size(), numColors, oMoments);
+        }
+        
+        reportColors(NULL, numColors, oMoments, results);
         
         return ERROR_NONE;
     }
-}
\ No newline at end of file
+}
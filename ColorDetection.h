@@ -3,11 +3,37 @@
 
 #include "opencv2/highgui/highgui.hpp"
 #include "opencv2/imgproc/imgproc.hpp"
+#include "ColorKernel.h"
+#include "FrameSource.h"
+#include "BlobDetector.h"
+#include <vector>
 
 using namespace cv;
 
 namespace SniperBot
 {
+    /** ColorResult Struct
+     * Purpose: Holds what the detector found for one target color.
+     */
+    struct ColorResult
+    {
+        int color;  // the color code
+        bool found;  // true if the color was found
+        double area;  // the area of the color, in the units of the image moments
+        int x;  // the x coordinate of the color, -1 if it was not found
+        int y;  // the y coordinate of the color, -1 if it was not found
+    };
+    
+    /** PyramidLevelWork Struct
+     * Purpose: Holds how much work one pyramid level did in a coarse-to-fine search.
+     */
+    struct PyramidLevelWork
+    {
+        int level;  // the pyramid level. Each level halves the width and height of the frame.
+        int regions;  // the number of regions searched at this level
+        long pixels;  // the number of pixels searched at this level
+    };
+    
     /** ColorDetector Class
      * Purpose: To grab screen captures from a USB camera and detect a specific color. The
      * coordinates of the color are returned through the parameters passed in.
@@ -21,6 +47,9 @@ namespace SniperBot
         /** Error code for if the camera cannot be read */
         static const int ERROR_CANNOT_READ_CAMERA = 1;
         
+        /** Error code for if the color code has no HSV range */
+        static const int ERROR_UNKNOWN_COLOR = 2;
+        
         /** The default width code for the screen */
         static const long DEFAULT_WINDOW_WIDTH = 0;
         
@@ -36,9 +65,21 @@ namespace SniperBot
         /** Yellow color code */
         static const int YELLOW = 4;
         
+        /** Process mode that runs the original cvtColor, inRange, morphology and moments passes */
+        static const int PROCESS_LEGACY = 0;
+        
+        /** Process mode that thresholds with the fused kernel and gives the same result as
+         * PROCESS_LEGACY */
+        static const int PROCESS_FUSED_EXACT = 1;
+        
+        /** Process mode that thresholds and gathers moments in one sweep. It skips the
+         * morphology, so small specks of noise count towards the area. */
+        static const int PROCESS_FUSED_FAST = 2;
+        
     private:
         
         VideoCapture *cap; // holds a reference to a VideoCapture object used to grab screenshots
+        FrameSource *source;  // if not NULL, frames are read from here instead of cap
         int color;  // the code for the color to find
         bool showWindow;  // tells the findColorFromCam function to either show or hide
                           // what the camera sees
@@ -47,6 +88,171 @@ namespace SniperBot
                              // at the x and y of the target
         bool showThreshold;  // tells the findColorFromCam function to either show or
                              // hide the threshold image
+        int processMode;  // the process mode used to find the color
+        std::vector<int> targetColors;  // the color codes searched for by findColorsFromCam
+        
+        /** The smallest area that counts as a target. Anything smaller is considered noise. */
+        static const int MIN_AREA = 10000;
+        
+        /** How many times wider than the target the tracking window is */
+        static const int TRACK_WINDOW_SCALE = 3;
+        
+        /** The smallest width and height of the tracking window */
+        static const int MIN_TRACK_WINDOW = 64;
+        
+        /** How many times the tracking window can double before the full frame is searched */
+        static const int TRACK_MAX_GROWTH = 8;
+        
+        bool trackingWindow;  // tells findColorInFrame to only search around the last target
+        bool hasTrack;  // true if the last search found the target
+        int lastX;  // the x coordinate of the last target
+        int lastY;  // the y coordinate of the last target
+        double lastArea;  // the area of the last target
+        Rect searchWindow;  // the region of the frame that was searched last
+        
+        bool blobMode;  // tells findColorInFrame to aim at one blob instead of the whole threshold image
+        BlobDetector blobDetector;  // finds the blobs of the threshold image
+        std::vector<Blob> blobs;  // the blobs found in the last search, in frame coordinates
+        int bestBlob;  // the index of the blob that was chosen as the target, -1 if none
+        
+        int pyramidLevel;  // the pyramid level of the coarse search, 0 if coarse-to-fine is off
+        Mat coarseBuffer;  // holds the decimated frame
+        Mat coarseMask;  // holds the threshold image of the decimated frame
+        std::vector<Blob> coarseBlobs;  // the blobs of the decimated frame
+        std::vector<Rect> candidateRegions;  // the full resolution regions that may hold the target
+        std::vector<PyramidLevelWork> pyramidWork;  // how much work each level of the last search did
+        
+        bool yuvClasses;  // tells findColorsFromCam to classify YUYV frames with the YUV class table
+        std::vector<uchar> yuvTable;  // maps a YUV pixel to the class bits of the target colors
+        HSVRange yuvTableRanges[MAX_COLOR_CLASSES];  // the ranges the YUV class table was built with
+        int yuvTableColors;  // the number of ranges the YUV class table was built with, 0 if not built
+        long yuvTableBuilds;  // the number of times the YUV class table was built
+        int yuvClass;  // the class of the color findColorInFrame is classifying a YUYV frame for, -1 if it converted the frame
+        
+        // Work buffers that are kept between frames so they are only allocated once
+        Mat frameBuffer;  // holds the camera capture
+        Mat convertedBuffer;  // holds a YUYV camera capture converted to BGR
+        Mat resizedBuffer;  // holds the resized camera capture
+        Mat hsvBuffer;  // holds the HSV image for the legacy process mode
+        Mat thresholdBuffer;  // holds the threshold image
+        Mat morphBuffer;  // holds the threshold image between morphology passes
+        Mat classBuffer;  // holds the class image when searching for several colors
+        Mat morphKernel;  // the structuring element used by the legacy process mode
+        long bufferReallocations;  // the number of times a work buffer above had to be allocated
+        
+        /** Makes sure a work buffer has the specified size and type, allocating it and
+         * counting the reallocation if it does not
+         * @param buffer the work buffer
+         * @param size the size the buffer needs
+         * @param type the type the buffer needs
+         */
+        void prepareBuffer(Mat &buffer, Size size, int type);
+        
+        /** Reads the next frame from the frame source or the camera into the frame buffer. A
+         * YUYV frame from the source is converted to BGR, and given back to the source.
+         * @param keepYuyv leaves a YUYV frame as it is, still lent by the source
+         * @return true if a frame was read
+         */
+        bool readFrame(bool keepYuyv = false);
+        
+        /** Converts a YUYV frame to BGR in the converted buffer
+         * @param frame the frame to convert
+         * @return the converted buffer, or the frame if it is not YUYV
+         */
+        Mat &convertYuyv(Mat &frame);
+        
+        /** Checks if a frame can be classified with the YUV class table. It has to be YUYV and
+         * already the width it is searched at, and the window cannot be shown, since the
+         * window needs a BGR frame.
+         * @param frame the frame to check
+         * @return true if the YUV class table can be used
+         */
+        bool canClassifyYuyv(const Mat &frame);
+        
+        /** Gets the HSV range of each target color
+         * @param ranges an array of MAX_COLOR_CLASSES ranges that receives the ranges
+         * @return the number of target colors, or -1 if there are none, too many, or one is unknown
+         */
+        int getTargetRanges(HSVRange *ranges);
+        
+        /** Builds the YUV class table, unless it was already built with the same ranges
+         * @param ranges the HSV range of each target color
+         * @param numColors the number of target colors
+         */
+        void prepareYuvTable(const HSVRange *ranges, int numColors);
+        
+        /** Cleans up each color's threshold image from the class buffer the same way
+         * findColorInFrame does, and gets its moments, or the moments of its target blob
+         * @param size the size of the class image
+         * @param numColors the number of target colors
+         * @param oMoments an array of numColors moments that receives the moments of each color
+         */
+        void measureClasses(Size size, int numColors, MaskMoments *oMoments);
+        
+        /** Fills in the result of each target color from its moments, and shows the windows
+         * @param img the searched frame to draw the crosshairs on and show, or NULL if the
+         * frame was not BGR
+         * @param numColors the number of target colors
+         * @param oMoments the moments of each target color
+         * @param results a reference to a vector that will hold the result of each target color
+         */
+        void reportColors(Mat *img, int numColors, const MaskMoments *oMoments,
+            std::vector<ColorResult> &results);
+        
+        /** Resizes the frame if a width is set
+         * @param frame the frame to resize
+         * @return the frame to search, which is either the frame or the resized buffer
+         */
+        Mat &resizeFrame(Mat &frame);
+        
+        /** Draws a crosshair on an image
+         * @param img the image to draw on
+         * @param x the x coordinate of the crosshair
+         * @param y the y coordinate of the crosshair
+         */
+        void drawCrosshairAt(Mat &img, int x, int y);
+        
+        /** Thresholds a region of the frame and gets the moments of the color in it. The
+         * threshold image is left in the matching region of the threshold buffer.
+         * @param img the frame to search
+         * @param region the region of the frame to search
+         * @param range the HSV range of the color to find
+         * @param needMask tells the fast process mode to write the threshold image
+         * @param oMoments a reference to a variable to hold the moments, in frame coordinates
+         */
+        void searchRegion(Mat &img, const Rect &region, const HSVRange &range, bool needMask,
+            MaskMoments &oMoments);
+        
+        /** Finds the blobs in a region of the threshold buffer and chooses the target. The
+         * target is the blob nearest the last target while tracking, or else the largest blob.
+         * @param region the region of the threshold buffer to search
+         * @return the moments of the target blob, in frame coordinates
+         */
+        MaskMoments findBestBlob(const Rect &region);
+        
+        /** Searches a decimated copy of the frame for blobs that may be the target, then
+         * searches only those blobs' regions at full resolution
+         * @param img the frame to search
+         * @param range the HSV range of the color to find
+         * @param oMoments a reference to a variable to hold the moments, in frame coordinates
+         */
+        void searchCoarseToFine(Mat &img, const HSVRange &range, MaskMoments &oMoments);
+        
+        /** Gets the tracking window around the last target
+         * @param frameSize the size of the frame
+         * @param scale how much to grow the window by
+         * @return the tracking window, clipped to the frame
+         */
+        Rect trackingRect(Size frameSize, double scale);
+        
+        /** Checks if the target touches a side of the search window that is inside the frame,
+         * which means part of the target may be outside the window. In blob mode only the
+         * target blob is checked, otherwise the whole threshold image is.
+         * @param region the search window
+         * @param frameSize the size of the frame
+         * @return true if the threshold image touches the edge of the window
+         */
+        bool touchesWindowEdge(const Rect &region, Size frameSize);
         
     public:
         
@@ -66,6 +272,19 @@ namespace SniperBot
                 return Point(frame.cols, frame.rows);
 	    }
         
+        /** The getColorRange function gets the HSV range used to threshold a color.
+         * @param color the code for the color
+         * @param range a reference to a variable to hold the HSV range of the color
+         * @return true if the color code is known
+         */
+        static bool getColorRange(int color, HSVRange &range);
+        
+        /** The mergeOverlapping function merges regions that overlap into their bounding box,
+         * until no two regions overlap, so no pixel is in more than one region
+         * @param regions the regions to merge. The merged regions replace them.
+         */
+        static void mergeOverlapping(std::vector<Rect> &regions);
+        
         /** Constructor to create a ColorDetector object
          * @param cap a reference to a VideoCapture object used to grab screenshots
          * @param color the code for the color to find
@@ -83,6 +302,17 @@ namespace SniperBot
          */
         VideoCapture *getVideoCapture();
         
+        /** Gets the frame source
+         * @return the frame source, or NULL if frames are read from the VideoCapture
+         */
+        FrameSource *getFrameSource();
+        
+        /** Sets the frame source. Use this to read frames from a FrameGrabber instead of
+         * blocking on the VideoCapture.
+         * @param value the frame source, or NULL to read frames from the VideoCapture
+         */
+        void setFrameSource(FrameSource *value);
+        
         /** Gets the target color code
          * @return the target color code
          */
@@ -133,14 +363,160 @@ namespace SniperBot
          */
         void setShowThreshold(bool value);
         
-        /** The findColorFromCam function grabs a screen capture from the camera,
-         * looks for the specified color, and sets the x and y parameters to the x 
-         * and y coordinates of the color, if it is found.
+        /** Gets the process mode used to find the color
+         * @return the process mode
+         */
+        int getProcessMode();
+        
+        /** Sets the process mode used to find the color
+         * @param value the process mode (PROCESS_LEGACY, PROCESS_FUSED_EXACT or PROCESS_FUSED_FAST)
+         */
+        void setProcessMode(int value);
+        
+        /** Gets the number of times one of the detector's own work buffers had to be
+         * allocated. After the first frame, this only goes up if the frame size, width or
+         * process mode changes. It does not count every heap allocation: OpenCV functions
+         * such as the legacy process mode's erode and dilate still allocate inside.
+         * @return the number of work buffer reallocations
+         */
+        long getBufferReallocations();
+        
+        /** Gets if findColorFromCam only searches a window around the last target
+         * @return if the tracking window is used
+         */
+        bool getTrackingWindow();
+        
+        /** Sets if findColorFromCam only searches a window around the last target. The window
+         * is sized from the target's area. If the target is lost or reaches the edge of the
+         * window, the window grows until it is found, ending with the full frame.
+         * @param value should the tracking window be used
+         */
+        void setTrackingWindow(bool value);
+        
+        /** Gets the region of the frame that was searched last
+         * @return the region that was searched last
+         */
+        Rect getSearchWindow();
+        
+        /** Gets if findColorFromCam and findColorsFromCam aim at a single blob
+         * @return if blob mode is on
+         */
+        bool getBlobMode();
+        
+        /** Sets if findColorFromCam and findColorsFromCam aim at a single blob. When off, the target is the center
+         * of every pixel of the color, so two objects of the same color average to a point
+         * between them. When on, the target is the largest blob, or the blob nearest the last
+         * target while the tracking window is used.
+         * @param value should blob mode be on
+         */
+        void setBlobMode(bool value);
+        
+        /** Gets the blobs found by the last search in blob mode. After findColorsFromCam,
+         * these are the blobs of the last target color.
+         * @return the blobs, in frame coordinates
+         */
+        const std::vector<Blob> &getBlobs();
+        
+        /** Gets the pyramid level of the coarse search
+         * @return the pyramid level, 0 if coarse-to-fine search is off
+         */
+        int getPyramidLevel();
+        
+        /** Sets the pyramid level of the coarse search. findColorFromCam first searches the
+         * frame decimated to 1 / 2^level of its width and height, then searches only around
+         * the blobs it found at full resolution. The tracking window is used instead when it
+         * has a target.
+         * @param value the pyramid level, 0 to turn coarse-to-fine search off
+         */
+        void setPyramidLevel(int value);
+        
+        /** Gets how much work each pyramid level did in the last coarse-to-fine search. The
+         * first entry is the coarse level, and the second is full resolution.
+         * @return the work of each pyramid level
+         */
+        const std::vector<PyramidLevelWork> &getPyramidWork();
+        
+        /** Gets the color codes searched for by findColorsFromCam
+         * @return the target color codes
+         */
+        std::vector<int> getTargetColors();
+        
+        /** Sets the color codes searched for by findColorsFromCam. The results come back in
+         * the same order.
+         * @param value the target color codes. At most MAX_COLOR_CLASSES colors can be searched for.
+         */
+        void setTargetColors(const std::vector<int> &value);
+        
+        /** Gets if findColorsFromCam classifies YUYV frames with the YUV class table
+         * @return if the YUV class table is used
+         */
+        bool getYuvClasses();
+        
+        /** Sets if findColorsFromCam classifies YUYV frames with the YUV class table. The
+         * table maps each pixel's Y, U and V straight to the class bits of the target colors,
+         * so the frame is never converted to BGR or HSV. It is built the first time it is used,
+         * and again only when the target colors change. The window is not shown from a YUYV
+         * frame, so the frame is converted as before while the window is shown, or while a
+         * width is set that the frame is not already.
+         * @param value should the YUV class table be used
+         */
+        void setYuvClasses(bool value);
+        
+        /** Gets the number of times the YUV class table was built
+         * @return the number of builds
+         */
+        long getYuvTableBuilds();
+        
+        /** The findColorFromCam function grabs a screen capture from the camera (or the frame
+         * source, if one is set), looks for the specified color, and sets the x and y
+         * parameters to the x and y coordinates of the color, if it is found.
          * @param x a reference to a variable to hold the x coordinate of the color
          * @param y a reference to a variable to hold the y coordinate of the color
          * @return an error code if an error occurs
          */
         int findColorFromCam(int &x, int &y);
+        
+        /** The findColorInFrame function looks for the specified color in a frame that has
+         * already been captured, and sets the x and y parameters to the x and y coordinates
+         * of the color, if it is found. The crosshair is drawn on the frame, or on the
+         * resized copy of it if the width is set and the frame is not already that wide.
+         * A YUYV frame is classified with the YUV class table if the color is one of the
+         * target colors, no pyramid level is set and the process mode is not legacy, and is
+         * converted to BGR otherwise.
+         * @param frame the BGR or YUYV frame to search
+         * @param x a reference to a variable to hold the x coordinate of the color
+         * @param y a reference to a variable to hold the y coordinate of the color
+         * @return an error code if an error occurs
+         */
+        int findColorInFrame(Mat &frame, int &x, int &y);
+        
+        /** The findColorsFromCam function grabs a screen capture from the camera (or the frame
+         * source, if one is set) and looks for every target color in one pass over it.
+         * @param results a reference to a vector that will hold the result of each target
+         * color, in the same order as the target colors
+         * @return an error code if an error occurs
+         */
+        int findColorsFromCam(std::vector<ColorResult> &results);
+        
+        /** The findColorsInFrame function looks for every target color in one pass over a
+         * frame that has already been captured.
+         * @param frame the BGR frame to search
+         * @param results a reference to a vector that will hold the result of each target
+         * color, in the same order as the target colors
+         * @return an error code if an error occurs
+         */
+        int findColorsInFrame(Mat &frame, std::vector<ColorResult> &results);
+        
+        /** The findColorsInYuyv function looks for every target color in a YUYV frame that has
+         * already been captured, using the YUV class table. The frame is converted to BGR and
+         * searched by findColorsInFrame instead if a width is set that it is not already, or
+         * if the window is shown.
+         * @param frame the YUYV frame to search
+         * @param results a reference to a vector that will hold the result of each target
+         * color, in the same order as the target colors
+         * @return an error code if an error occurs
+         */
+        int findColorsInYuyv(Mat &frame, std::vector<ColorResult> &results);
     };
 }
 
@@ -0,0 +1,647 @@
+#include "ColorKernel.h"
+#include "opencv2/core/hal/intrin.hpp"
+#include <algorithm>
+
+using namespace std;
+using namespace cv;
+
+namespace SniperBot
+{
+    static const int HSV_SHIFT = 12;  // fixed point shift used by OpenCV's BGR to HSV conversion
+    static const int HSV_ROUND = 1 << (HSV_SHIFT - 1);  // rounding term for the fixed point math
+    static const int YUV_SHIFT = 20;  // fixed point shift used by OpenCV's YUV to BGR conversion
+    static const int YUV_CY = 1220542;  // 1.164 in fixed point, the scale of Y
+    static const int YUV_CUB = 2116026;  // 2.018 in fixed point, how much U adds to blue
+    static const int YUV_CUG = -409993;  // -0.391 in fixed point, how much U adds to green
+    static const int YUV_CVG = -852492;  // -0.813 in fixed point, how much V adds to green
+    static const int YUV_CVR = 1673527;  // 1.596 in fixed point, how much V adds to red
+    static const int YUV_QUANT = 8 - YUV_TABLE_BITS;  // bits dropped from Y, U and V to index the table
+
+    /** HSVTables Struct
+     * Purpose: Holds the division tables OpenCV uses to convert 8-bit BGR pixels to HSV
+     * without dividing. Using the same tables is what makes the fused mask exact.
+     */
+    struct HSVTables
+    {
+        int sdiv[256];  // 255 / v in fixed point, used for the saturation
+        int hdiv[256];  // 180 / (6 * diff) in fixed point, used for the hue
+
+        HSVTables()
+        {
+            sdiv[0] = hdiv[0] = 0;
+            for(int i = 1; i < 256; ++i)
+            {
+                sdiv[i] = saturate_cast<int>((255 << HSV_SHIFT) / (1. * i));
+                hdiv[i] = saturate_cast<int>((180 << HSV_SHIFT) / (6. * i));
+            }
+        }
+    };
+
+    // Returns the division tables, building them the first time they are used
+    static const HSVTables &hsvTables()
+    {
+        static HSVTables tables;
+        return tables;
+    }
+
+    // Converts one BGR pixel to HSV
+    static inline void pixelHSV(int b, int g, int r, const HSVTables &t, int &h, int &s, int &v)
+    {
+        v = max(max(b, g), r);
+        int diff = v - min(min(b, g), r);
+        int vr = v == r ? -1 : 0;
+        int vg = v == g ? -1 : 0;
+
+        s = (diff * t.sdiv[v] + HSV_ROUND) >> HSV_SHIFT;
+        h = (vr & (g - b)) + (~vr & ((vg & (b - r + 2 * diff)) + (~vg & (r - g + 4 * diff))));
+        h = (h * t.hdiv[diff] + HSV_ROUND) >> HSV_SHIFT;
+        h += h < 0 ? 180 : 0;
+    }
+
+    // Converts one YUV pixel to BGR with the same fixed point math as cvtColor(COLOR_YUV2BGR_YUYV)
+    static inline void pixelBGR(int y, int u, int v, int &b, int &g, int &r)
+    {
+        int yy = max(0, y - 16) * YUV_CY + (1 << (YUV_SHIFT - 1));
+
+        u -= 128;
+        v -= 128;
+        b = saturate_cast<uchar>((yy + YUV_CUB * u) >> YUV_SHIFT);
+        g = saturate_cast<uchar>((yy + YUV_CVG * v + YUV_CUG * u) >> YUV_SHIFT);
+        r = saturate_cast<uchar>((yy + YUV_CVR * v) >> YUV_SHIFT);
+    }
+
+    // Returns if an HSV pixel is inside the range
+    static inline bool hsvInRange(int h, int s, int v, const HSVRange &range)
+    {
+        return h >= range.lower[0] && h <= range.upper[0] &&
+            s >= range.lower[1] && s <= range.upper[1] &&
+            v >= range.lower[2] && v <= range.upper[2];
+    }
+
+#if CV_SIMD128
+    /** RangeVectors Struct
+     * Purpose: Holds the range bounds of the vectorized kernel so they are broadcast once
+     * per image instead of once per pixel.
+     */
+    struct RangeVectors
+    {
+        v_int32x4 lower[3];  // lower H, S and V bounds
+        v_int32x4 upper[3];  // upper H, S and V bounds
+
+        RangeVectors() {}
+
+        RangeVectors(const HSVRange &range)
+        {
+            for(int c = 0; c < 3; ++c)
+            {
+                lower[c] = v_setall_s32(range.lower[c]);
+                upper[c] = v_setall_s32(range.upper[c]);
+            }
+        }
+    };
+
+    // Loads 16 BGR pixels and widens each channel into 4 vectors of 4 pixels
+    static inline void loadPixels(const uchar *src, v_int32x4 *b, v_int32x4 *g, v_int32x4 *r)
+    {
+        v_uint8x16 b8, g8, r8;
+        v_load_deinterleave(src, b8, g8, r8);
+
+        v_uint16x8 b16[2], g16[2], r16[2];
+        v_expand(b8, b16[0], b16[1]);
+        v_expand(g8, g16[0], g16[1]);
+        v_expand(r8, r16[0], r16[1]);
+
+        for(int k = 0; k < 2; ++k)
+        {
+            v_uint32x4 b0, b1, g0, g1, r0, r1;
+            v_expand(b16[k], b0, b1);
+            v_expand(g16[k], g0, g1);
+            v_expand(r16[k], r0, r1);
+            b[k * 2] = v_reinterpret_as_s32(b0);
+            b[k * 2 + 1] = v_reinterpret_as_s32(b1);
+            g[k * 2] = v_reinterpret_as_s32(g0);
+            g[k * 2 + 1] = v_reinterpret_as_s32(g1);
+            r[k * 2] = v_reinterpret_as_s32(r0);
+            r[k * 2 + 1] = v_reinterpret_as_s32(r1);
+        }
+    }
+
+    // Vectorized version of pixelHSV for 4 pixels
+    static inline void pixelsHSV(const v_int32x4 &b, const v_int32x4 &g, const v_int32x4 &r,
+        const HSVTables &t, v_int32x4 &h, v_int32x4 &s, v_int32x4 &v)
+    {
+        v_int32x4 round = v_setall_s32(HSV_ROUND);
+
+        v = v_max(v_max(b, g), r);
+        v_int32x4 diff = v - v_min(v_min(b, g), r);
+        v_int32x4 vr = v == r;
+        v_int32x4 vg = v == g;
+
+        s = (diff * v_lut(t.sdiv, v) + round) >> HSV_SHIFT;
+        h = (vr & (g - b)) +
+            (~vr & ((vg & (b - r + (diff << 1))) + (~vg & (r - g + (diff << 2)))));
+        h = (h * v_lut(t.hdiv, diff) + round) >> HSV_SHIFT;
+        h += (h < v_setzero_s32()) & v_setall_s32(180);
+    }
+
+    // Vectorized version of hsvInRange for 4 pixels. Returns -1 in each lane that is in range.
+    static inline v_int32x4 hsvInRange(const v_int32x4 &h, const v_int32x4 &s,
+        const v_int32x4 &v, const RangeVectors &rv)
+    {
+        return (h >= rv.lower[0]) & (h <= rv.upper[0]) &
+            (s >= rv.lower[1]) & (s <= rv.upper[1]) &
+            (v >= rv.lower[2]) & (v <= rv.upper[2]);
+    }
+#endif
+
+    void thresholdMoments(const Mat &bgr, const HSVRange &range, Mat *mask, MaskMoments *m)
+    {
+        CV_Assert(bgr.type() == CV_8UC3);
+
+        const HSVTables &t = hsvTables();
+        int64 count = 0, sumX = 0, sumY = 0;  // pixel count and coordinate sums of the mask
+
+        if(mask)
+            mask->create(bgr.size(), CV_8UC1);
+
+#if CV_SIMD128
+        RangeVectors rv(range);
+#endif
+
+        for(int y = 0; y < bgr.rows; ++y)
+        {
+            const uchar *src = bgr.ptr<uchar>(y);
+            uchar *dst = mask ? mask->ptr<uchar>(y) : NULL;
+            int64 rowCount = 0, rowSumX = 0;
+            int x = 0;
+
+#if CV_SIMD128
+            v_int32x4 xs(0, 1, 2, 3);  // x coordinates of the lanes
+            v_int32x4 xStep = v_setall_s32(4);
+            v_int32x4 vCount = v_setzero_s32();
+            v_int32x4 vSumX = v_setzero_s32();
+
+            for(; x <= bgr.cols - 16; x += 16)
+            {
+                v_int32x4 b[4], g[4], r[4];
+                v_int32x4 in[4];  // in range flags for the 16 pixels
+                loadPixels(src + x * 3, b, g, r);
+
+                for(int k = 0; k < 4; ++k)
+                {
+                    v_int32x4 h, s, v;
+                    pixelsHSV(b[k], g[k], r[k], t, h, s, v);
+                    in[k] = hsvInRange(h, s, v, rv);
+
+                    vCount -= in[k];
+                    vSumX += in[k] & xs;
+                    xs += xStep;
+                }
+
+                if(dst)
+                    v_store(dst + x, v_reinterpret_as_u8(v_pack(v_pack(in[0], in[1]),
+                        v_pack(in[2], in[3]))));
+            }
+
+            rowCount = v_reduce_sum(vCount);
+            rowSumX = v_reduce_sum(vSumX);
+#endif
+
+            // Finish the pixels that did not fill a whole vector
+            for(; x < bgr.cols; ++x)
+            {
+                int h, s, v;
+                pixelHSV(src[x * 3], src[x * 3 + 1], src[x * 3 + 2], t, h, s, v);
+                bool in = hsvInRange(h, s, v, range);
+                if(in)
+                {
+                    ++rowCount;
+                    rowSumX += x;
+                }
+                if(dst)
+                    dst[x] = in ? 255 : 0;
+            }
+
+            count += rowCount;
+            sumX += rowSumX;
+            sumY += rowCount * y;
+        }
+
+        if(m)
+        {
+            m->m00 = 255.0 * count;
+            m->m10 = 255.0 * sumX;
+            m->m01 = 255.0 * sumY;
+        }
+    }
+
+    void thresholdClasses(const Mat &bgr, const HSVRange *ranges, int numRanges, Mat *classes,
+        MaskMoments *m)
+    {
+        CV_Assert(bgr.type() == CV_8UC3 && numRanges >= 1 && numRanges <= MAX_COLOR_CLASSES);
+
+        const HSVTables &t = hsvTables();
+        int64 count[MAX_COLOR_CLASSES], sumX[MAX_COLOR_CLASSES], sumY[MAX_COLOR_CLASSES];
+
+        for(int c = 0; c < numRanges; ++c)
+            count[c] = sumX[c] = sumY[c] = 0;
+
+        if(classes)
+            classes->create(bgr.size(), CV_8UC1);
+
+#if CV_SIMD128
+        RangeVectors rv[MAX_COLOR_CLASSES];
+        v_int32x4 bit[MAX_COLOR_CLASSES];  // the class bit of each range
+        for(int c = 0; c < numRanges; ++c)
+        {
+            rv[c] = RangeVectors(ranges[c]);
+            bit[c] = v_setall_s32(1 << c);
+        }
+#endif
+
+        for(int y = 0; y < bgr.rows; ++y)
+        {
+            const uchar *src = bgr.ptr<uchar>(y);
+            uchar *dst = classes ? classes->ptr<uchar>(y) : NULL;
+            int64 rowCount[MAX_COLOR_CLASSES], rowSumX[MAX_COLOR_CLASSES];
+            int x = 0;
+
+            for(int c = 0; c < numRanges; ++c)
+                rowCount[c] = rowSumX[c] = 0;
+
+#if CV_SIMD128
+            v_int32x4 xs(0, 1, 2, 3);  // x coordinates of the lanes
+            v_int32x4 xStep = v_setall_s32(4);
+            v_int32x4 vCount[MAX_COLOR_CLASSES], vSumX[MAX_COLOR_CLASSES];
+            for(int c = 0; c < numRanges; ++c)
+                vCount[c] = vSumX[c] = v_setzero_s32();
+
+            for(; x <= bgr.cols - 16; x += 16)
+            {
+                v_int32x4 b[4], g[4], r[4];
+                v_int32x4 bits[4];  // the class bits of the 16 pixels
+                loadPixels(src + x * 3, b, g, r);
+
+                for(int k = 0; k < 4; ++k)
+                {
+                    // The HSV conversion is shared by every range
+                    v_int32x4 h, s, v;
+                    pixelsHSV(b[k], g[k], r[k], t, h, s, v);
+
+                    bits[k] = v_setzero_s32();
+                    for(int c = 0; c < numRanges; ++c)
+                    {
+                        v_int32x4 in = hsvInRange(h, s, v, rv[c]);
+                        bits[k] |= in & bit[c];
+                        if(m)
+                        {
+                            vCount[c] -= in;
+                            vSumX[c] += in & xs;
+                        }
+                    }
+                    xs += xStep;
+                }
+
+                if(dst)
+                    v_store(dst + x, v_pack_u(v_pack(bits[0], bits[1]), v_pack(bits[2], bits[3])));
+            }
+
+            if(m)
+            {
+                for(int c = 0; c < numRanges; ++c)
+                {
+                    rowCount[c] = v_reduce_sum(vCount[c]);
+                    rowSumX[c] = v_reduce_sum(vSumX[c]);
+                }
+            }
+#endif
+
+            // Finish the pixels that did not fill a whole vector
+            for(; x < bgr.cols; ++x)
+            {
+                int h, s, v;
+                uchar bits = 0;  // the class bits of the pixel
+                pixelHSV(src[x * 3], src[x * 3 + 1], src[x * 3 + 2], t, h, s, v);
+
+                for(int c = 0; c < numRanges; ++c)
+                {
+                    if(hsvInRange(h, s, v, ranges[c]))
+                    {
+                        bits |= 1 << c;
+                        ++rowCount[c];
+                        rowSumX[c] += x;
+                    }
+                }
+                if(dst)
+                    dst[x] = bits;
+            }
+
+            for(int c = 0; c < numRanges; ++c)
+            {
+                count[c] += rowCount[c];
+                sumX[c] += rowSumX[c];
+                sumY[c] += rowCount[c] * y;
+            }
+        }
+
+        if(m)
+        {
+            for(int c = 0; c < numRanges; ++c)
+            {
+                m[c].m00 = 255.0 * count[c];
+                m[c].m10 = 255.0 * sumX[c];
+                m[c].m01 = 255.0 * sumY[c];
+            }
+        }
+    }
+
+    void buildYuvClassTable(const HSVRange *ranges, int numRanges, uchar *table)
+    {
+        CV_Assert(numRanges >= 1 && numRanges <= MAX_COLOR_CLASSES);
+
+        const HSVTables &t = hsvTables();
+        int cell = 1 << YUV_QUANT;  // the Y, U and V values each entry covers
+        int offsets[2] = { cell / 4, cell * 3 / 4 };  // where the samples are taken in a cell
+
+        for(int index = 0; index < YUV_TABLE_SIZE; ++index)
+        {
+            int y0 = (index >> (2 * YUV_TABLE_BITS)) << YUV_QUANT;
+            int u0 = ((index >> YUV_TABLE_BITS) & ((1 << YUV_TABLE_BITS) - 1)) << YUV_QUANT;
+            int v0 = (index & ((1 << YUV_TABLE_BITS) - 1)) << YUV_QUANT;
+            int votes[MAX_COLOR_CLASSES] = { 0 };  // the samples inside each range
+
+            for(int sample = 0; sample < 8; ++sample)
+            {
+                int b, g, r, h, s, v;
+                pixelBGR(y0 + offsets[sample & 1], u0 + offsets[(sample >> 1) & 1],
+                    v0 + offsets[sample >> 2], b, g, r);
+                pixelHSV(b, g, r, t, h, s, v);
+
+                for(int c = 0; c < numRanges; ++c)
+                    votes[c] += hsvInRange(h, s, v, ranges[c]) ? 1 : 0;
+            }
+
+            uchar bits = 0;  // the class bits of the cell
+            for(int c = 0; c < numRanges; ++c)
+                if(votes[c] >= 4)
+                    bits |= 1 << c;
+            table[index] = bits;
+        }
+    }
+
+    void classifyYuyv(const Mat &yuyv, const uchar *table, int numRanges, Mat *classes,
+        MaskMoments *m)
+    {
+        CV_Assert(yuyv.type() == CV_8UC2 && yuyv.cols % 2 == 0 &&
+            numRanges >= 1 && numRanges <= MAX_COLOR_CLASSES);
+
+        int64 count[MAX_COLOR_CLASSES], sumX[MAX_COLOR_CLASSES], sumY[MAX_COLOR_CLASSES];
+
+        for(int c = 0; c < numRanges; ++c)
+            count[c] = sumX[c] = sumY[c] = 0;
+
+        if(classes)
+            classes->create(yuyv.size(), CV_8UC1);
+
+        for(int y = 0; y < yuyv.rows; ++y)
+        {
+            const uchar *src = yuyv.ptr<uchar>(y);
+            uchar *dst = classes ? classes->ptr<uchar>(y) : NULL;
+            int64 rowCount[MAX_COLOR_CLASSES], rowSumX[MAX_COLOR_CLASSES];
+
+            for(int c = 0; c < numRanges; ++c)
+                rowCount[c] = rowSumX[c] = 0;
+
+            // Each pair of pixels is Y0 U Y1 V, and shares its U and V
+            for(int x = 0; x < yuyv.cols; x += 2, src += 4)
+            {
+                int uv = ((src[1] >> YUV_QUANT) << YUV_TABLE_BITS) | (src[3] >> YUV_QUANT);
+                uchar bits[2];  // the class bits of the 2 pixels
+                bits[0] = table[((src[0] >> YUV_QUANT) << (2 * YUV_TABLE_BITS)) | uv];
+                bits[1] = table[((src[2] >> YUV_QUANT) << (2 * YUV_TABLE_BITS)) | uv];
+
+                if(dst)
+                {
+                    dst[x] = bits[0];
+                    dst[x + 1] = bits[1];
+                }
+
+                // Most pixels are no color, so the moments are only gathered for the rest
+                if(m && (bits[0] | bits[1]))
+                {
+                    for(int k = 0; k < 2; ++k)
+                    {
+                        for(int c = 0; c < numRanges; ++c)
+                        {
+                            if(bits[k] & (1 << c))
+                            {
+                                ++rowCount[c];
+                                rowSumX[c] += x + k;
+                            }
+                        }
+                    }
+                }
+            }
+
+            for(int c = 0; c < numRanges; ++c)
+            {
+                count[c] += rowCount[c];
+                sumX[c] += rowSumX[c];
+                sumY[c] += rowCount[c] * y;
+            }
+        }
+
+        if(m)
+        {
+            for(int c = 0; c < numRanges; ++c)
+            {
+                m[c].m00 = 255.0 * count[c];
+                m[c].m10 = 255.0 * sumX[c];
+                m[c].m01 = 255.0 * sumY[c];
+            }
+        }
+    }
+
+    void extractClass(const Mat &classes, int index, Mat &mask)
+    {
+        CV_Assert(classes.type() == CV_8UC1 && index >= 0 && index < MAX_COLOR_CLASSES);
+
+        uchar bit = (uchar)(1 << index);  // the class bit to extract
+
+        mask.create(classes.size(), CV_8UC1);
+
+        for(int y = 0; y < classes.rows; ++y)
+        {
+            const uchar *src = classes.ptr<uchar>(y);
+            uchar *dst = mask.ptr<uchar>(y);
+            int x = 0;
+
+#if CV_SIMD128
+            v_uint8x16 vBit = v_setall_u8(bit);
+            for(; x <= classes.cols - 16; x += 16)
+                v_store(dst + x, (v_load(src + x) & vBit) == vBit);
+#endif
+
+            for(; x < classes.cols; ++x)
+                dst[x] = (src[x] & bit) ? 255 : 0;
+        }
+    }
+
+    MaskMoments maskMoments(const Mat &mask)
+    {
+        CV_Assert(mask.type() == CV_8UC1);
+
+        int64 sum = 0, sumX = 0, sumY = 0;  // pixel value sum and weighted coordinate sums
+
+        for(int y = 0; y < mask.rows; ++y)
+        {
+            const uchar *src = mask.ptr<uchar>(y);
+            int64 rowSum = 0, rowSumX = 0;
+            int x = 0;
+
+#if CV_SIMD128
+            v_int32x4 xs(0, 1, 2, 3);  // x coordinates of the lanes
+            v_int32x4 xStep = v_setall_s32(4);
+            v_int32x4 vSum = v_setzero_s32();
+            v_int32x4 vSumX = v_setzero_s32();
+
+            // The lane sums stay in 32 bits, so flush them often enough to never overflow
+            while(x <= mask.cols - 16)
+            {
+                int blockEnd = min(mask.cols - 15, x + 1024);
+                for(; x < blockEnd; x += 16)
+                {
+                    v_uint16x8 p16[2];
+                    v_expand(v_load(src + x), p16[0], p16[1]);
+                    for(int k = 0; k < 2; ++k)
+                    {
+                        v_uint32x4 p0, p1;
+                        v_expand(p16[k], p0, p1);
+                        vSum += v_reinterpret_as_s32(p0);
+                        vSumX += v_reinterpret_as_s32(p0) * xs;
+                        xs += xStep;
+                        vSum += v_reinterpret_as_s32(p1);
+                        vSumX += v_reinterpret_as_s32(p1) * xs;
+                        xs += xStep;
+                    }
+                }
+                rowSum += v_reduce_sum(vSum);
+                rowSumX += v_reduce_sum(vSumX);
+                vSum = v_setzero_s32();
+                vSumX = v_setzero_s32();
+            }
+#endif
+
+            // Finish the pixels that did not fill a whole vector
+            for(; x < mask.cols; ++x)
+            {
+                rowSum += src[x];
+                rowSumX += (int64)src[x] * x;
+            }
+
+            sum += rowSum;
+            sumX += rowSumX;
+            sumY += rowSum * y;
+        }
+
+        MaskMoments m;
+        m.m00 = (double)sum;
+        m.m10 = (double)sumX;
+        m.m01 = (double)sumY;
+        return m;
+    }
+
+    /** MinOp Struct
+     * Purpose: Combines pixels by taking the minimum, which erodes the mask.
+     */
+    struct MinOp
+    {
+        static uchar init() { return 255; }
+        static uchar apply(uchar a, uchar b) { return min(a, b); }
+#if CV_SIMD128
+        static v_uint8x16 apply(const v_uint8x16 &a, const v_uint8x16 &b) { return v_min(a, b); }
+#endif
+    };
+
+    /** MaxOp Struct
+     * Purpose: Combines pixels by taking the maximum, which dilates the mask.
+     */
+    struct MaxOp
+    {
+        static uchar init() { return 0; }
+        static uchar apply(uchar a, uchar b) { return max(a, b); }
+#if CV_SIMD128
+        static v_uint8x16 apply(const v_uint8x16 &a, const v_uint8x16 &b) { return v_max(a, b); }
+#endif
+    };
+
+    // Applies the 5x5 ellipse to one pixel. The ellipse is the full 5x5 square without the
+    // corners of the top and bottom rows, which leaves only the center pixel of those rows.
+    // Pixels outside the image are skipped, like OpenCV's default morphology border.
+    template<class Op>
+    static inline uchar morphPixel(const uchar *const *rows, int x, int cols)
+    {
+        uchar v = Op::init();
+
+        for(int k = 1; k <= 3; ++k)
+            if(rows[k])
+                for(int xx = max(x - 2, 0); xx <= min(x + 2, cols - 1); ++xx)
+                    v = Op::apply(v, rows[k][xx]);
+        if(rows[0])
+            v = Op::apply(v, rows[0][x]);
+        if(rows[4])
+            v = Op::apply(v, rows[4][x]);
+
+        return v;
+    }
+
+    // Applies the 5x5 ellipse to every pixel of the image
+    template<class Op>
+    static void morphEllipse5(const Mat &src, Mat &dst)
+    {
+        CV_Assert(src.type() == CV_8UC1 && src.data != dst.data);
+
+        dst.create(src.size(), CV_8UC1);
+
+        for(int y = 0; y < src.rows; ++y)
+        {
+            const uchar *rows[5];  // rows y - 2 to y + 2, NULL if outside the image
+            uchar *out = dst.ptr<uchar>(y);
+            int cols = src.cols;
+            int x = 0;
+
+            for(int k = 0; k < 5; ++k)
+                rows[k] = y + k - 2 >= 0 && y + k - 2 < src.rows ? src.ptr<uchar>(y + k - 2) : NULL;
+
+            // The first 2 pixels need the left border
+            for(; x < min(2, cols); ++x)
+                out[x] = morphPixel<Op>(rows, x, cols);
+
+#if CV_SIMD128
+            for(; x <= cols - 18; x += 16)
+            {
+                v_uint8x16 v = v_setall_u8(Op::init());
+
+                for(int k = 1; k <= 3; ++k)
+                    if(rows[k])
+                        for(int dx = -2; dx <= 2; ++dx)
+                            v = Op::apply(v, v_load(rows[k] + x + dx));
+                if(rows[0])
+                    v = Op::apply(v, v_load(rows[0] + x));
+                if(rows[4])
+                    v = Op::apply(v, v_load(rows[4] + x));
+
+                v_store(out + x, v);
+            }
+#endif
+
+            // Finish the pixels that did not fill a whole vector and the right border
+            for(; x < cols; ++x)
+                out[x] = morphPixel<Op>(rows, x, cols);
+        }
+    }
+
+    void erodeEllipse5(const Mat &src, Mat &dst) { morphEllipse5<MinOp>(src, dst); }
+
+    void dilateEllipse5(const Mat &src, Mat &dst) { morphEllipse5<MaxOp>(src, dst); }
+}
@@ -0,0 +1,123 @@
+#ifndef COLORKERNEL_H
+#define	COLORKERNEL_H
+
+#include "opencv2/core/core.hpp"
+
+using namespace cv;
+
+namespace SniperBot
+{
+    /** The most color ranges thresholdClasses can test at once, one per bit of a class pixel */
+    const int MAX_COLOR_CLASSES = 8;
+
+    /** HSVRange Struct
+     * Purpose: Holds the inclusive lower and upper HSV bounds of a color, in the same units
+     * OpenCV uses for 8-bit HSV images (H is 0-179, S and V are 0-255).
+     */
+    struct HSVRange
+    {
+        uchar lower[3];  // lower H, S and V bounds
+        uchar upper[3];  // upper H, S and V bounds
+    };
+
+    /** MaskMoments Struct
+     * Purpose: Holds the spatial moments of a thresholded image. The values are scaled the
+     * same way cv::moments scales a 0/255 mask, so m00 is 255 times the pixel count.
+     */
+    struct MaskMoments
+    {
+        double m00;  // area of the mask
+        double m10;  // sum of the x coordinates of the mask
+        double m01;  // sum of the y coordinates of the mask
+    };
+
+    /** The thresholdMoments function converts each BGR pixel to HSV, tests it against the
+     * color range, and gathers the moments of the result in a single sweep over the image.
+     * The HSV conversion uses the same fixed point math as cvtColor(COLOR_BGR2HSV), so the
+     * mask matches cvtColor followed by inRange exactly. The inner loop is vectorized with
+     * OpenCV's universal intrinsics when they are available (SSE, NEON).
+     * @param bgr the 8-bit, 3 channel BGR image to threshold
+     * @param range the HSV range of the color to find
+     * @param mask if not NULL, receives the 0/255 threshold image
+     * @param m if not NULL, receives the moments of the threshold image
+     */
+    void thresholdMoments(const Mat &bgr, const HSVRange &range, Mat *mask, MaskMoments *m);
+
+    /** The thresholdClasses function converts each BGR pixel to HSV once and tests it
+     * against every color range in the same sweep. Bit i of a class pixel is set if the
+     * pixel is inside range i, so adding a color only adds a few compares per pixel instead
+     * of another pass over the image.
+     * @param bgr the 8-bit, 3 channel BGR image to classify
+     * @param ranges the HSV ranges of the colors to find
+     * @param numRanges the number of ranges, from 1 to MAX_COLOR_CLASSES
+     * @param classes if not NULL, receives the 8-bit class image
+     * @param m if not NULL, an array of numRanges moments that receives the moments of each
+     * color's threshold image
+     */
+    void thresholdClasses(const Mat &bgr, const HSVRange *ranges, int numRanges, Mat *classes,
+        MaskMoments *m);
+
+    /** The number of bits of each of Y, U and V that index a YUV class table */
+    const int YUV_TABLE_BITS = 6;
+
+    /** The number of entries in a YUV class table */
+    const int YUV_TABLE_SIZE = 1 << (3 * YUV_TABLE_BITS);
+
+    /** The buildYuvClassTable function fills a table that maps a YUV pixel straight to its
+     * class bits, so a YUYV frame can be classified without converting it to BGR and then to
+     * HSV. Each entry covers a 4x4x4 cell of Y, U and V values. A range's bit is set if at
+     * least half of 8 samples in the cell are inside the range, after converting each sample
+     * the way cvtColor(COLOR_YUV2BGR_YUYV) and then thresholdClasses would. Only pixels near
+     * the edge of a range can be classified differently than the BGR path.
+     * @param ranges the HSV ranges of the colors to find
+     * @param numRanges the number of ranges, from 1 to MAX_COLOR_CLASSES
+     * @param table receives YUV_TABLE_SIZE class pixels
+     */
+    void buildYuvClassTable(const HSVRange *ranges, int numRanges, uchar *table);
+
+    /** The classifyYuyv function looks up the class bits of each pixel of a YUYV image in a
+     * table made by buildYuvClassTable, and gathers the moments of each color in the same
+     * sweep, like thresholdClasses does for a BGR image.
+     * @param yuyv the 8-bit, 2 channel YUYV image, with an even width
+     * @param table the YUV class table
+     * @param numRanges the number of ranges the table was built with
+     * @param classes if not NULL, receives the 8-bit class image
+     * @param m if not NULL, an array of numRanges moments that receives the moments of each
+     * color's threshold image
+     */
+    void classifyYuyv(const Mat &yuyv, const uchar *table, int numRanges, Mat *classes,
+        MaskMoments *m);
+
+    /** The extractClass function makes a 0/255 threshold image of one color from a class
+     * image made by thresholdClasses.
+     * @param classes the 8-bit class image
+     * @param index the index of the color's range
+     * @param mask receives the 0/255 threshold image
+     */
+    void extractClass(const Mat &classes, int index, Mat &mask);
+
+    /** The maskMoments function gathers the moments of a 0/255 threshold image. It gives
+     * the same m00, m10 and m01 values as cv::moments.
+     * @param mask the 8-bit, 1 channel threshold image
+     * @return the moments of the threshold image
+     */
+    MaskMoments maskMoments(const Mat &mask);
+
+    /** The erodeEllipse5 function erodes a mask with the 5x5 elliptical structuring element.
+     * It gives the same result as erode with getStructuringElement(MORPH_ELLIPSE, Size(5, 5)),
+     * but never allocates memory when dst already has the right size.
+     * @param src the 8-bit, 1 channel image to erode
+     * @param dst the eroded image. Must not be the same image as src.
+     */
+    void erodeEllipse5(const Mat &src, Mat &dst);
+
+    /** The dilateEllipse5 function dilates a mask with the 5x5 elliptical structuring element.
+     * It gives the same result as dilate with getStructuringElement(MORPH_ELLIPSE, Size(5, 5)),
+     * but never allocates memory when dst already has the right size.
+     * @param src the 8-bit, 1 channel image to dilate
+     * @param dst the dilated image. Must not be the same image as src.
+     */
+    void dilateEllipse5(const Mat &src, Mat &dst);
+}
+
+#endif	/* COLORKERNEL_H */
@@ -0,0 +1,227 @@
+#include "CommandProtocol.h"
+
+namespace SniperBot
+{
+    bool commandArgumentSizes(uint8_t opcode, int &aSize, int &bSize)
+    {
+        aSize = 0;
+        bSize = 0;
+
+        if(opcode >= NUM_OPCODES)
+            return false;
+
+        switch(opcode)
+        {
+            case OP_SET_CAMERA:
+            case OP_MOVE_CAMERA:
+                aSize = 2;
+                bSize = 2;
+                break;
+            case OP_DRIVE:
+                aSize = 1;
+                bSize = 1;
+                break;
+            case OP_SET_SPEED_SCALE:
+                aSize = 1;
+                break;
+            case OP_PING:
+            case OP_PONG:
+                aSize = 2;
+                break;
+        }
+
+        return true;
+    }
+
+    int commandSize(uint8_t opcode)
+    {
+        int aSize, bSize;
+
+        if(!commandArgumentSizes(opcode, aSize, bSize))
+            return 0;
+        return 1 + aSize + bSize;
+    }
+
+    uint16_t crc16(const uint8_t *data, int length, uint16_t crc)
+    {
+        for(int i = 0; i < length; ++i)
+        {
+            crc ^= (uint16_t)data[i] << 8;
+            for(int bit = 0; bit < 8; ++bit)
+                crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+
+        return crc;
+    }
+
+    /** Reads a signed argument, low byte first
+     * @param data where the argument starts
+     * @param size the bytes of the argument, 1 or 2
+     * @return the argument
+     */
+    static int16_t readArgument(const uint8_t *data, int size)
+    {
+        if(size == 1)
+            return (int8_t)data[0];
+        return (int16_t)(data[0] | (uint16_t)data[1] << 8);
+    }
+
+    /** Writes a signed argument, low byte first
+     * @param data where the argument goes
+     * @param size the bytes of the argument, 1 or 2
+     * @param value the argument
+     */
+    static void writeArgument(uint8_t *data, int size, int16_t value)
+    {
+        data[0] = (uint8_t)(value & 0xFF);
+        if(size == 2)
+            data[1] = (uint8_t)((uint16_t)value >> 8);
+    }
+
+    int readCommand(const uint8_t *payload, int length, int offset, Command &command)
+    {
+        int aSize, bSize;
+
+        if(offset >= length || !commandArgumentSizes(payload[offset], aSize, bSize) ||
+                offset + 1 + aSize + bSize > length)
+            return -1;
+
+        command.opcode = payload[offset];
+        command.a = aSize ? readArgument(payload + offset + 1, aSize) : 0;
+        command.b = bSize ? readArgument(payload + offset + 1 + aSize, bSize) : 0;
+
+        return offset + 1 + aSize + bSize;
+    }
+
+    // Constructor
+    PacketBuilder::PacketBuilder() { this->length = 0; }
+
+    // clear function
+    void PacketBuilder::clear() { length = 0; }
+
+    bool PacketBuilder::add(const Command &command)
+    {
+        int aSize, bSize;
+
+        if(!commandArgumentSizes(command.opcode, aSize, bSize) ||
+                length + 1 + aSize + bSize > MAX_PAYLOAD)
+            return false;
+
+        uint8_t *data = buffer + 3 + length;  // after the sync, length and sequence
+        data[0] = command.opcode;
+        if(aSize)
+            writeArgument(data + 1, aSize, command.a);
+        if(bSize)
+            writeArgument(data + 1 + aSize, bSize, command.b);
+        length += 1 + aSize + bSize;
+
+        return true;
+    }
+
+    bool PacketBuilder::add(uint8_t opcode, int16_t a, int16_t b)
+    {
+        Command command;
+        command.opcode = opcode;
+        command.a = a;
+        command.b = b;
+        return add(command);
+    }
+
+    // isEmpty function
+    bool PacketBuilder::isEmpty() { return length == 0; }
+
+    const uint8_t *PacketBuilder::finish(uint8_t sequence)
+    {
+        buffer[0] = PACKET_SYNC;
+        buffer[1] = (uint8_t)length;
+        buffer[2] = sequence;
+
+        uint16_t crc = crc16(buffer + 1, length + 2);
+        buffer[3 + length] = (uint8_t)(crc & 0xFF);
+        buffer[4 + length] = (uint8_t)(crc >> 8);
+
+        return buffer;
+    }
+
+    // size function
+    int PacketBuilder::size() { return length + PACKET_OVERHEAD; }
+
+    // Constructor
+    PacketDecoder::PacketDecoder()
+    {
+        this->state = WAIT_SYNC;
+        this->length = 0;
+        this->sequence = 0;
+        this->received = 0;
+        this->crc = 0;
+        this->packets = 0;
+        this->errors = 0;
+    }
+
+    bool PacketDecoder::push(uint8_t byte)
+    {
+        switch(state)
+        {
+            case WAIT_SYNC:
+                if(byte == PACKET_SYNC)
+                    state = WAIT_LENGTH;
+                break;
+            case WAIT_LENGTH:
+                if(byte > MAX_PAYLOAD)
+                {
+                    ++errors;
+                    state = byte == PACKET_SYNC ? WAIT_LENGTH : WAIT_SYNC;
+                    break;
+                }
+                length = byte;
+                state = WAIT_SEQUENCE;
+                break;
+            case WAIT_SEQUENCE:
+                sequence = byte;
+                received = 0;
+                state = length ? WAIT_PAYLOAD : WAIT_CRC_LOW;
+                break;
+            case WAIT_PAYLOAD:
+                payload[received++] = byte;
+                if(received == length)
+                    state = WAIT_CRC_LOW;
+                break;
+            case WAIT_CRC_LOW:
+                crc = byte;
+                state = WAIT_CRC_HIGH;
+                break;
+            case WAIT_CRC_HIGH:
+            {
+                crc |= (uint16_t)byte << 8;
+                state = WAIT_SYNC;
+
+                uint8_t header[2] = { length, sequence };
+                if(crc16(payload, length, crc16(header, 2)) != crc)
+                {
+                    ++errors;
+                    break;
+                }
+
+                ++packets;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // getPayload function
+    const uint8_t *PacketDecoder::getPayload() { return payload; }
+
+    // getLength function
+    int PacketDecoder::getLength() { return length; }
+
+    // getSequence function
+    uint8_t PacketDecoder::getSequence() { return sequence; }
+
+    // getPackets function
+    unsigned long PacketDecoder::getPackets() { return packets; }
+
+    // getErrors function
+    unsigned long PacketDecoder::getErrors() { return errors; }
+}
@@ -0,0 +1,199 @@
+#ifndef COMMANDPROTOCOL_H
+#define	COMMANDPROTOCOL_H
+
+#include <stdint.h>
+
+/* The framed serial protocol between the Raspberry Pi and the Arduino. This file is built
+ * on both sides, so it only uses what the Arduino has: no STL, no exceptions and no heap.
+ *
+ * A packet is:
+ *   SYNC (0xA5) | length | sequence | payload (length bytes) | CRC-16 (low byte first)
+ * The CRC covers the length, sequence and payload. The payload holds one or more commands,
+ * each an opcode followed by the opcode's arguments, so several commands can go in one
+ * packet.
+ */
+namespace SniperBot
+{
+    /** The byte every packet starts with */
+    const uint8_t PACKET_SYNC = 0xA5;
+
+    /** The most payload bytes a packet can hold. A whole packet fits in the Arduino's 64 byte
+     * serial receive buffer. */
+    const int MAX_PAYLOAD = 32;
+
+    /** The bytes a packet adds around its payload */
+    const int PACKET_OVERHEAD = 5;
+
+    // Opcodes 0 to 11 are the same as the 4 bit commands and have no arguments
+    const uint8_t OP_STOP = 0;  // Stops the robot from moving
+    const uint8_t OP_MOVE_FORWARD = 1;  // Moves the robot forward
+    const uint8_t OP_MOVE_BACKWARDS = 2;  // Moves the robot backwards
+    const uint8_t OP_TURN_LEFT = 3;  // Rotates the robot left
+    const uint8_t OP_TURN_RIGHT = 4;  // Rotates the robot right
+    const uint8_t OP_LOOK_LEFT = 5;  // Turns the camera left one step
+    const uint8_t OP_LOOK_RIGHT = 6;  // Turns the camera right one step
+    const uint8_t OP_LOOK_UP = 7;  // Turns the camera up one step
+    const uint8_t OP_LOOK_DOWN = 8;  // Turns the camera down one step
+    const uint8_t OP_START_FIRING = 9;  // Starts firing the laser
+    const uint8_t OP_STOP_FIRING = 10;  // Stops firing the laser
+    const uint8_t OP_CENTER_CAMERA = 11;  // Returns the camera to the center position
+    const uint8_t OP_SET_CAMERA = 12;  // Points the camera. a = yaw, b = pitch, in tenths of a degree (int16).
+    const uint8_t OP_DRIVE = 13;  // Drives along an arc. a = arc from -100 (sharp left) to 100 (sharp right), b = speed from -100 (full backwards) to 100 (full forward) (int8).
+    const uint8_t OP_SET_SPEED_SCALE = 14;  // Scales the wheel speed. a = percent from 0 to 100 (int8).
+    const uint8_t OP_PING = 15;  // Asks for an OP_PONG. a = a token to send back (int16).
+    const uint8_t OP_PONG = 16;  // Answers an OP_PING, from the Arduino. a = the ping's token (int16).
+    const uint8_t OP_MOVE_CAMERA = 17;  // Turns the camera from where it is headed. a = yaw, b = pitch, in tenths of a degree (int16).
+    const uint8_t NUM_OPCODES = 18;  // The number of opcodes
+
+    /** Command Struct
+     * Purpose: Holds one command and its arguments.
+     */
+    struct Command
+    {
+        uint8_t opcode;  // the opcode
+        int16_t a;  // the first argument, 0 if the opcode has none
+        int16_t b;  // the second argument, 0 if the opcode has none
+    };
+
+    /** Gets the bytes an opcode's arguments take
+     * @param opcode the opcode
+     * @param aSize a reference to a variable to hold the bytes of the first argument, 0 if none
+     * @param bSize a reference to a variable to hold the bytes of the second argument, 0 if none
+     * @return false if the opcode is unknown
+     */
+    bool commandArgumentSizes(uint8_t opcode, int &aSize, int &bSize);
+
+    /** Gets the bytes a command takes in a payload
+     * @param opcode the opcode
+     * @return the size of the opcode and its arguments, 0 if the opcode is unknown
+     */
+    int commandSize(uint8_t opcode);
+
+    /** Calculates the CRC-16/CCITT-FALSE of some bytes
+     * @param data the bytes
+     * @param length the number of bytes
+     * @param crc the CRC so far, for calculating it in pieces
+     * @return the CRC
+     */
+    uint16_t crc16(const uint8_t *data, int length, uint16_t crc = 0xFFFF);
+
+    /** Reads the command at a position in a payload
+     * @param payload the payload
+     * @param length the length of the payload
+     * @param offset the position of the command
+     * @param command a reference to a Command that will hold the command
+     * @return the position of the next command, -1 if the command is unknown or cut off
+     */
+    int readCommand(const uint8_t *payload, int length, int offset, Command &command);
+
+    /** PacketBuilder Class
+     * Purpose: Puts commands together into a packet.
+     */
+    class PacketBuilder
+    {
+    private:
+        uint8_t buffer[MAX_PAYLOAD + PACKET_OVERHEAD];  // the packet
+        int length;  // the length of the payload so far
+
+    public:
+
+        /** Constructor to create an empty packet */
+        PacketBuilder();
+
+        /** Empties the packet */
+        void clear();
+
+        /** Adds a command to the packet
+         * @param command the command
+         * @return false if the command is unknown or does not fit
+         */
+        bool add(const Command &command);
+
+        /** Adds a command to the packet
+         * @param opcode the opcode
+         * @param a the first argument
+         * @param b the second argument
+         * @return false if the command is unknown or does not fit
+         */
+        bool add(uint8_t opcode, int16_t a = 0, int16_t b = 0);
+
+        /** Gets if the packet has no commands
+         * @return if the packet has no commands
+         */
+        bool isEmpty();
+
+        /** Fills in the packet's header and CRC
+         * @param sequence the packet's sequence number
+         * @return the packet's bytes, valid until the packet is changed
+         */
+        const uint8_t *finish(uint8_t sequence);
+
+        /** Gets the size of the packet
+         * @return the number of bytes of the finished packet
+         */
+        int size();
+    };
+
+    /** PacketDecoder Class
+     * Purpose: Finds packets in a stream of bytes, one byte at a time. Bytes that are not part
+     * of a packet with a good CRC are skipped, so the decoder finds the next packet after
+     * noise or a lost byte.
+     */
+    class PacketDecoder
+    {
+    private:
+        static const uint8_t WAIT_SYNC = 0;  // looking for the sync byte
+        static const uint8_t WAIT_LENGTH = 1;  // waiting for the length
+        static const uint8_t WAIT_SEQUENCE = 2;  // waiting for the sequence number
+        static const uint8_t WAIT_PAYLOAD = 3;  // reading the payload
+        static const uint8_t WAIT_CRC_LOW = 4;  // waiting for the low byte of the CRC
+        static const uint8_t WAIT_CRC_HIGH = 5;  // waiting for the high byte of the CRC
+
+        uint8_t state;  // what the decoder is waiting for
+        uint8_t payload[MAX_PAYLOAD];  // the payload of the packet being read
+        uint8_t length;  // the length of the packet being read
+        uint8_t sequence;  // the sequence number of the packet being read
+        uint8_t received;  // the payload bytes read so far
+        uint16_t crc;  // the CRC read from the packet
+        unsigned long packets;  // the number of good packets
+        unsigned long errors;  // the number of packets with a bad length or CRC
+
+    public:
+
+        /** Constructor to create a decoder that is looking for a packet */
+        PacketDecoder();
+
+        /** Reads one byte
+         * @param byte the byte
+         * @return true if the byte finished a good packet
+         */
+        bool push(uint8_t byte);
+
+        /** Gets the payload of the last good packet
+         * @return the payload, valid until the next byte is pushed
+         */
+        const uint8_t *getPayload();
+
+        /** Gets the payload length of the last good packet
+         * @return the payload length
+         */
+        int getLength();
+
+        /** Gets the sequence number of the last good packet
+         * @return the sequence number
+         */
+        uint8_t getSequence();
+
+        /** Gets the number of good packets
+         * @return the number of good packets
+         */
+        unsigned long getPackets();
+
+        /** Gets the number of packets thrown away for a bad length or CRC
+         * @return the number of bad packets
+         */
+        unsigned long getErrors();
+    };
+}
+
+#endif	/* COMMANDPROTOCOL_H */
@@ -0,0 +1,410 @@
+#include "CommandSender.h"
+#include "Trace.h"
+#include <chrono>
+
+using namespace std;
+
+namespace SniperBot
+{
+    static const int POLL_INTERVAL = 200;  // microseconds the sender thread sleeps while the ring is empty
+
+    /** Gets if a command sets the wheels
+     * @param opcode the command's opcode
+     * @return if the command sets the wheels
+     */
+    static bool isDrive(uint8_t opcode)
+    {
+        return opcode == OP_STOP || opcode == OP_MOVE_FORWARD || opcode == OP_MOVE_BACKWARDS ||
+            opcode == OP_TURN_LEFT || opcode == OP_TURN_RIGHT || opcode == OP_DRIVE;
+    }
+
+    /** Gets if a command moves the camera
+     * @param opcode the command's opcode
+     * @return if the command moves the camera
+     */
+    static bool isCamera(uint8_t opcode)
+    {
+        return (opcode >= OP_LOOK_LEFT && opcode <= OP_LOOK_DOWN) ||
+            opcode == OP_CENTER_CAMERA || opcode == OP_SET_CAMERA;
+    }
+
+    /** Turns the camera one step the way the Arduino does, stopping at the limits
+     * @param angle the angle before the step
+     * @param step the degrees to turn, negative to turn the other way
+     * @return the angle after the step
+     */
+    static int stepCamera(int angle, int step)
+    {
+        if(step > 0)
+            return angle + step >= CommandSender::CAMERA_MAX ? CommandSender::CAMERA_MAX : angle + step;
+        return angle + step <= CommandSender::CAMERA_MIN ? CommandSender::CAMERA_MIN : angle + step;
+    }
+
+    /** Converts an OP_SET_CAMERA argument to the angle the Arduino turns to
+     * @param tenths the angle in tenths of a degree
+     * @return the angle in degrees
+     */
+    static int setCameraAngle(int tenths)
+    {
+        int angle = (tenths + 5) / 10;
+        if(angle < CommandSender::CAMERA_MIN)
+            return CommandSender::CAMERA_MIN;
+        return angle > CommandSender::CAMERA_MAX ? CommandSender::CAMERA_MAX : angle;
+    }
+
+    /** Makes a command with no arguments
+     * @param opcode the opcode
+     * @return the command
+     */
+    static Command makeCommand(uint8_t opcode)
+    {
+        Command command;
+        command.opcode = opcode;
+        command.a = 0;
+        command.b = 0;
+        return command;
+    }
+
+    /** Writes the steps that turn one axis of the camera from one angle to another, if
+     * stepping one way gets there
+     * @param from the angle to start at
+     * @param to the angle to end at
+     * @param up the opcode that makes the angle larger
+     * @param down the opcode that makes the angle smaller
+     * @param result where to put the steps
+     * @return the number of steps, -1 if stepping one way does not reach the angle
+     */
+    static int stepsBetween(int from, int to, uint8_t up, uint8_t down, Command *result)
+    {
+        int count = 0;
+        int step = to > from ? CommandSender::CAMERA_STEP : -CommandSender::CAMERA_STEP;
+
+        // Count the steps first, so nothing is written if the angle can't be reached
+        for(int angle = from; angle != to; ++count)
+        {
+            int next = stepCamera(angle, step);
+            if(next == angle || (step > 0 ? next > to : next < to))
+                return -1;
+            angle = next;
+        }
+
+        for(int i = 0; i < count; ++i)
+            result[i] = makeCommand(step > 0 ? up : down);
+
+        return count;
+    }
+
+    // Constructor
+    SerialCommandOutput::SerialCommandOutput(SerialLink &link) { this->link = &link; }
+
+    int SerialCommandOutput::write(const Command *commands, int count)
+    {
+        packet.clear();
+        for(int i = 0; i < count; ++i)
+        {
+            // Send the packet once the next command doesn't fit
+            if(!packet.add(commands[i]))
+            {
+                int error = link->send(packet);
+                if(error != SerialLink::ERROR_NONE)
+                    return error;
+                packet.clear();
+                packet.add(commands[i]);
+            }
+        }
+
+        return packet.isEmpty() ? SerialLink::ERROR_NONE : link->send(packet);
+    }
+
+    // Constructor
+    CommandSender::CommandSender(CommandOutput &output, bool setCamera, int commandGap)
+    {
+        this->output = &output;
+        this->setCamera = setCamera;
+        this->commandGap = commandGap;
+        this->head = 0;
+        this->tail = 0;
+        this->running = false;
+        this->sent = 0;
+        this->suppressed = 0;
+        this->dropped = 0;
+        this->driveKnown = false;
+        this->drive = makeCommand(OP_STOP);
+        this->firingKnown = false;
+        this->firing = false;
+        this->speedKnown = false;
+        this->speed = 100;
+        this->cameraKnown = false;
+        this->yaw = CAMERA_CENTER;
+        this->pitch = CAMERA_CENTER;
+    }
+
+    // Destructor
+    CommandSender::~CommandSender() { stop(); }
+
+    int CommandSender::start()
+    {
+        if(thread.joinable())
+            return ERROR_ALREADY_RUNNING;
+
+        running = true;
+        thread = std::thread(&CommandSender::run, this);
+
+        return ERROR_NONE;
+    }
+
+    void CommandSender::stop()
+    {
+        running = false;
+        if(thread.joinable())
+            thread.join();
+    }
+
+    bool CommandSender::post(const Command &command)
+    {
+        unsigned position = head.load(memory_order_relaxed);
+
+        if(position - tail.load(memory_order_acquire) >= (unsigned)QUEUE_SIZE)
+        {
+            ++dropped;
+            return false;
+        }
+
+        queue[position & (QUEUE_SIZE - 1)] = command;
+        head.store(position + 1, memory_order_release);
+
+        return true;
+    }
+
+    bool CommandSender::post(uint8_t opcode, int16_t a, int16_t b)
+    {
+        Command command;
+        command.opcode = opcode;
+        command.a = a;
+        command.b = b;
+        return post(command);
+    }
+
+    void CommandSender::run()
+    {
+        Command taken[QUEUE_SIZE];  // the commands taken from the ring
+        Command result[QUEUE_SIZE];  // the commands left to send
+
+        while(true)
+        {
+            // Read the flag first, so whatever was posted before stop is still sent
+            bool stopping = !running;
+            unsigned first = tail.load(memory_order_relaxed);
+            unsigned last = head.load(memory_order_acquire);
+
+            if(first == last)
+            {
+                if(stopping)
+                    break;
+                this_thread::sleep_for(chrono::microseconds(POLL_INTERVAL));
+                continue;
+            }
+
+            int count = (int)(last - first);
+            for(int i = 0; i < count; ++i)
+                taken[i] = queue[(first + i) & (QUEUE_SIZE - 1)];
+
+            TRACE_SPAN("send commands");
+            int resultCount = coalesce(taken, count, result);
+            if(resultCount > 0)
+                writeSpaced(result, resultCount);
+            sent += resultCount;
+            suppressed += count - resultCount;
+
+            // Free the slots only once the commands are written, so isIdle means sent
+            tail.store(last, memory_order_release);
+        }
+    }
+
+    void CommandSender::writeSpaced(const Command *commands, int count)
+    {
+        if(commandGap <= 0)
+        {
+            output->write(commands, count);
+            return;
+        }
+
+        for(int i = 0; i < count; ++i)
+        {
+            this_thread::sleep_until(lastWrite + chrono::microseconds(commandGap));
+            lastWrite = chrono::steady_clock::now();
+            output->write(commands + i, 1);
+        }
+    }
+
+    int CommandSender::coalesce(const Command *commands, int count, Command *result)
+    {
+        int resultCount = 0;
+        int i = 0;
+
+        while(i < count)
+        {
+            // Merge every camera command in a row
+            if(isCamera(commands[i].opcode))
+            {
+                int end = i;
+                while(end < count && isCamera(commands[end].opcode))
+                    ++end;
+                resultCount += mergeCamera(commands + i, end - i, result + resultCount);
+                i = end;
+                continue;
+            }
+
+            const Command &command = commands[i++];
+            if(isDrive(command.opcode))
+            {
+                // The wheels are already doing this
+                if(driveKnown && drive.opcode == command.opcode && drive.a == command.a &&
+                        drive.b == command.b)
+                    continue;
+                driveKnown = true;
+                drive = command;
+
+                // Driving sets the speed scale on the Arduino
+                if(command.opcode == OP_DRIVE)
+                {
+                    speedKnown = true;
+                    speed = command.b < 0 ? -command.b : command.b;
+                }
+            }
+            else if(command.opcode == OP_START_FIRING || command.opcode == OP_STOP_FIRING)
+            {
+                bool fire = command.opcode == OP_START_FIRING;
+                if(firingKnown && firing == fire)
+                    continue;
+                firingKnown = true;
+                firing = fire;
+            }
+            else if(command.opcode == OP_SET_SPEED_SCALE)
+            {
+                if(speedKnown && speed == command.a)
+                    continue;
+                speedKnown = true;
+                speed = command.a;
+
+                // The new speed only reaches the wheels with the next drive command
+                driveKnown = false;
+            }
+
+            result[resultCount++] = command;
+        }
+
+        return resultCount;
+    }
+
+    int CommandSender::mergeCamera(const Command *commands, int count, Command *result)
+    {
+        // Only the commands after the last one that sets an exact angle matter
+        int last = -1;  // the last centering or OP_SET_CAMERA command
+        for(int i = 0; i < count; ++i)
+            if(commands[i].opcode == OP_CENTER_CAMERA || commands[i].opcode == OP_SET_CAMERA)
+                last = i;
+
+        // Without a known angle to start from, the steps can't be merged
+        if(last < 0 && !cameraKnown)
+        {
+            for(int i = 0; i < count; ++i)
+                result[i] = commands[i];
+            return count;
+        }
+
+        int startYaw = yaw, startPitch = pitch;  // the angle the steps start from
+        if(last >= 0 && commands[last].opcode == OP_CENTER_CAMERA)
+        {
+            startYaw = CAMERA_CENTER;
+            startPitch = CAMERA_CENTER;
+        }
+        else if(last >= 0)
+        {
+            startYaw = setCameraAngle(commands[last].a);
+            startPitch = setCameraAngle(commands[last].b);
+        }
+
+        // Turn the camera like the Arduino would to find where it ends up
+        int endYaw = startYaw, endPitch = startPitch;
+        for(int i = last + 1; i < count; ++i)
+        {
+            switch(commands[i].opcode)
+            {
+                case OP_LOOK_LEFT: endYaw = stepCamera(endYaw, CAMERA_STEP); break;
+                case OP_LOOK_RIGHT: endYaw = stepCamera(endYaw, -CAMERA_STEP); break;
+                case OP_LOOK_UP: endPitch = stepCamera(endPitch, CAMERA_STEP); break;
+                case OP_LOOK_DOWN: endPitch = stepCamera(endPitch, -CAMERA_STEP); break;
+            }
+        }
+
+        bool moves = !cameraKnown || endYaw != yaw || endPitch != pitch;  // does the camera move at all
+        int resultCount = 0;
+
+        if(setCamera)
+        {
+            // One command turns straight to the end angle
+            if(moves)
+            {
+                result[0].opcode = OP_SET_CAMERA;
+                result[0].a = (int16_t)(endYaw * 10);
+                result[0].b = (int16_t)(endPitch * 10);
+                resultCount = 1;
+            }
+        }
+        else if(moves)
+        {
+            int fromYaw = yaw, fromPitch = pitch;  // where the steps are sent from
+
+            // Send the exact angle again only if the camera isn't there already
+            if(last >= 0 && (!cameraKnown || yaw != startYaw || pitch != startPitch))
+            {
+                result[resultCount++] = commands[last];
+                fromYaw = startYaw;
+                fromPitch = startPitch;
+            }
+
+            // Step straight to each end angle. A run that pressed against a limit may not be
+            // reachable that way, so send its steps as they came.
+            int yawSteps = stepsBetween(fromYaw, endYaw, OP_LOOK_LEFT, OP_LOOK_RIGHT,
+                result + resultCount);
+            if(yawSteps < 0)
+            {
+                yawSteps = 0;
+                for(int i = last + 1; i < count; ++i)
+                    if(commands[i].opcode == OP_LOOK_LEFT || commands[i].opcode == OP_LOOK_RIGHT)
+                        result[resultCount + yawSteps++] = commands[i];
+            }
+            resultCount += yawSteps;
+
+            int pitchSteps = stepsBetween(fromPitch, endPitch, OP_LOOK_UP, OP_LOOK_DOWN,
+                result + resultCount);
+            if(pitchSteps < 0)
+            {
+                pitchSteps = 0;
+                for(int i = last + 1; i < count; ++i)
+                    if(commands[i].opcode == OP_LOOK_UP || commands[i].opcode == OP_LOOK_DOWN)
+                        result[resultCount + pitchSteps++] = commands[i];
+            }
+            resultCount += pitchSteps;
+        }
+
+        cameraKnown = true;
+        yaw = endYaw;
+        pitch = endPitch;
+
+        return resultCount;
+    }
+
+    // getSent function
+    long CommandSender::getSent() { return sent; }
+
+    // getSuppressed function
+    long CommandSender::getSuppressed() { return suppressed; }
+
+    // getDropped function
+    long CommandSender::getDropped() { return dropped; }
+
+    // isIdle function
+    bool CommandSender::isIdle() { return head.load() == tail.load(); }
+}
@@ -0,0 +1,187 @@
+#ifndef COMMANDSENDER_H
+#define	COMMANDSENDER_H
+
+#include "CommandProtocol.h"
+#include "SerialLink.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace SniperBot
+{
+    /** CommandOutput Class
+     * Purpose: Interface for where a CommandSender writes its commands, such as the data pins
+     * or the serial link to the Arduino.
+     */
+    class CommandOutput
+    {
+    public:
+        /** Destructor */
+        virtual ~CommandOutput() {}
+
+        /** Writes commands to the Arduino, in order
+         * @param commands the commands
+         * @param count the number of commands
+         * @return 0 if the commands were written, otherwise an error code of the output
+         */
+        virtual int write(const Command *commands, int count) = 0;
+    };
+
+    /** SerialCommandOutput Class
+     * Purpose: Writes commands to a SerialLink, putting as many as fit into each packet.
+     */
+    class SerialCommandOutput : public CommandOutput
+    {
+    private:
+        SerialLink *link;  // the link to write to
+        PacketBuilder packet;  // the packet being filled
+
+    public:
+
+        /** Constructor to create a SerialCommandOutput object
+         * @param link a reference to an open link
+         */
+        SerialCommandOutput(SerialLink &link);
+
+        int write(const Command *commands, int count);
+    };
+
+    /** CommandSender Class
+     * Purpose: Sends commands to the Arduino on its own thread, so the vision loop never waits
+     * on a GPIO or serial write. Commands are posted to a lock-free ring that only the caller's
+     * thread writes and only the sender thread reads. The sender thread takes every command
+     * waiting in the ring at once and drops the ones that would not change the Arduino: a
+     * drive or firing command that repeats the last one sent, and centering a camera that is
+     * already centered. A run of camera commands is merged into the fewest steps that reach
+     * the same angle, or into one OP_SET_CAMERA if the output takes it.
+     */
+    class CommandSender
+    {
+    public:
+        /** Error code for no error */
+        static const int ERROR_NONE = 0;
+
+        /** Error code for if the sender thread is already running */
+        static const int ERROR_ALREADY_RUNNING = 1;
+
+        /** The number of commands the ring holds. This must be a power of 2. */
+        static const int QUEUE_SIZE = 256;
+
+        // The Arduino's camera, which must match SniperBot.cpp
+        static const int CAMERA_STEP = 2;  // degrees the camera turns for each step command
+        static const int CAMERA_CENTER = 90;  // the yaw and pitch of the centered camera
+        static const int CAMERA_MIN = 45;  // the smallest yaw and pitch
+        static const int CAMERA_MAX = 135;  // the largest yaw and pitch
+
+    private:
+        CommandOutput *output;  // where the commands are written
+        bool setCamera;  // can the output take OP_SET_CAMERA
+        int commandGap;  // the fewest microseconds between the starts of two writes, 0 to write each batch at once
+        std::chrono::steady_clock::time_point lastWrite;  // when the last write started
+        Command queue[QUEUE_SIZE];  // the ring of posted commands
+        std::atomic<unsigned> head;  // the number of commands posted, only written by post
+        std::atomic<unsigned> tail;  // the number of commands taken, only written by the sender thread
+        std::atomic<bool> running;  // tells the sender thread to keep going
+        std::atomic<long> sent;  // the number of commands written to the output
+        std::atomic<long> suppressed;  // the number of posted commands dropped or merged away
+        std::atomic<long> dropped;  // the number of commands not posted because the ring was full
+        std::thread thread;  // the sender thread
+
+        // What the Arduino was last told, only used by the sender thread
+        bool driveKnown;  // has a drive command been sent
+        Command drive;  // the last drive command sent
+        bool firingKnown;  // has a firing command been sent
+        bool firing;  // is the laser firing
+        bool speedKnown;  // has the speed scale been sent
+        int speed;  // the speed scale in percent
+        bool cameraKnown;  // is the camera's angle known
+        int yaw;  // the camera's yaw in degrees
+        int pitch;  // the camera's pitch in degrees
+
+        /** The sender thread's loop */
+        void run();
+
+        /** Drops and merges commands taken from the ring
+         * @param commands the commands taken from the ring, in order
+         * @param count the number of commands
+         * @param result an array of at least count commands to hold the commands to send
+         * @return the number of commands to send
+         */
+        int coalesce(const Command *commands, int count, Command *result);
+
+        /** Merges a run of camera commands
+         * @param commands the camera commands, in order
+         * @param count the number of commands
+         * @param result where to put the commands to send
+         * @return the number of commands put in result
+         */
+        int mergeCamera(const Command *commands, int count, Command *result);
+
+        /** Writes commands to the output. With a command gap, they are written one at a time,
+         * each one waiting until the gap has passed since the last write started.
+         * @param commands the commands
+         * @param count the number of commands
+         */
+        void writeSpaced(const Command *commands, int count);
+
+    public:
+
+        /** Constructor to create a CommandSender object
+         * @param output a reference to where the commands are written
+         * @param setCamera can the output take OP_SET_CAMERA. The data pins can only take the
+         * opcodes that fit in 4 bits.
+         * @param commandGap the fewest microseconds between the starts of two commands, for an
+         * output like the data pins that the Arduino reads one command at a time. 0 writes
+         * each batch at once.
+         */
+        CommandSender(CommandOutput &output, bool setCamera = false, int commandGap = 0);
+
+        /** Destructor. Sends the commands still in the ring and stops the sender thread. */
+        ~CommandSender();
+
+        /** Starts the sender thread
+         * @return an error code if an error occurs
+         */
+        int start();
+
+        /** Sends the commands still in the ring and stops the sender thread */
+        void stop();
+
+        /** Queues a command to send. This never blocks, and must only be called from one thread.
+         * @param command the command
+         * @return false if the ring was full and the command was dropped
+         */
+        bool post(const Command &command);
+
+        /** Queues a command to send. This never blocks, and must only be called from one thread.
+         * @param opcode the opcode
+         * @param a the first argument
+         * @param b the second argument
+         * @return false if the ring was full and the command was dropped
+         */
+        bool post(uint8_t opcode, int16_t a = 0, int16_t b = 0);
+
+        /** Gets the number of commands written to the output
+         * @return the number of commands sent
+         */
+        long getSent();
+
+        /** Gets the number of posted commands that were not sent because they repeated the
+         * Arduino's state or were merged into another command
+         * @return the number of commands suppressed
+         */
+        long getSuppressed();
+
+        /** Gets the number of commands that could not be posted because the ring was full
+         * @return the number of commands dropped
+         */
+        long getDropped();
+
+        /** Gets if every posted command has been handled
+         * @return if the ring is empty
+         */
+        bool isIdle();
+    };
+}
+
+#endif	/* COMMANDSENDER_H */
@@ -0,0 +1,157 @@
+#include "DetectorGroup.h"
+#include "Trace.h"
+#include <chrono>
+
+using namespace std;
+
+namespace SniperBot
+{
+    static const int POLL_INTERVAL = 100;  // microseconds a pool thread sleeps while there is no search
+
+    // Constructor
+    DetectorGroup::DetectorGroup(int threads)
+    {
+        this->threads = threads;
+        this->running = false;
+        this->round = 0;
+        this->nextJob = 0;
+        this->jobsDone = 0;
+        this->frames = 0;
+    }
+
+    // Destructor
+    DetectorGroup::~DetectorGroup() { stop(); }
+
+    int DetectorGroup::addDetector(ColorDetector *detector)
+    {
+        detectors.push_back(detector);
+        results.push_back(vector<ColorResult>());
+        errors.push_back((int)ColorDetector::ERROR_NONE);  // a copy, since the constant has no definition
+
+        return (int)detectors.size() - 1;
+    }
+
+    // getDetectorCount function
+    int DetectorGroup::getDetectorCount() { return (int)detectors.size(); }
+
+    // getDetector function
+    ColorDetector *DetectorGroup::getDetector(int source) { return detectors[source]; }
+
+    int DetectorGroup::getThreadCount()
+    {
+        if(threads > 0)
+            return threads;
+
+        // One thread per camera is as many as can be kept busy
+        int cores = (int)std::thread::hardware_concurrency();
+        int count = (int)detectors.size();
+        if(cores > 0 && cores < count)
+            count = cores;
+        return count > 0 ? count : 1;
+    }
+
+    int DetectorGroup::start()
+    {
+        if(!pool.empty())
+            return ERROR_ALREADY_RUNNING;
+
+        running = true;
+        for(int i = 1; i < getThreadCount(); ++i)
+            pool.push_back(std::thread(&DetectorGroup::work, this));
+
+        return ERROR_NONE;
+    }
+
+    void DetectorGroup::stop()
+    {
+        running = false;
+        for(size_t i = 0; i < pool.size(); ++i)
+            pool[i].join();
+        pool.clear();
+    }
+
+    void DetectorGroup::work()
+    {
+        unsigned seen = round;  // the last round this thread looked for work in
+
+        while(running)
+        {
+            if(round.load() == seen)
+            {
+                this_thread::sleep_for(chrono::microseconds(POLL_INTERVAL));
+                continue;
+            }
+            seen = round;
+            runJobs();
+        }
+    }
+
+    void DetectorGroup::runJobs()
+    {
+        int count = (int)detectors.size();
+
+        for(int job = nextJob++; job < count; job = nextJob++)
+        {
+            TRACE_SPAN("group search");
+            errors[job] = detectors[job]->findColorsFromCam(results[job]);
+            ++frames;
+            ++jobsDone;
+        }
+    }
+
+    int DetectorGroup::findColors(vector<GroupDetection> &detections)
+    {
+        int count = (int)detectors.size();
+
+        // Clear the count before handing out the first job. A pool thread that is still
+        // leaving the last round can only take a job once nextJob is reset, and then it
+        // counts toward this round.
+        jobsDone = 0;
+        nextJob = 0;
+        ++round;
+
+        // Search alongside the pool, then wait for the detectors still being searched
+        runJobs();
+        while(jobsDone.load() < count)
+            this_thread::yield();
+
+        // Take each color from the first camera that saw it
+        detections.clear();
+        bool anyRead = false;
+        for(int s = 0; s < count; ++s)
+        {
+            if(errors[s] != ColorDetector::ERROR_NONE)
+                continue;
+            anyRead = true;
+
+            for(size_t c = 0; c < results[s].size(); ++c)
+            {
+                if(c >= detections.size())
+                {
+                    GroupDetection none;
+                    none.source = -1;
+                    none.result = results[s][c];
+                    none.result.found = false;
+                    none.result.x = none.result.y = -1;
+                    detections.push_back(none);
+                }
+                if(results[s][c].found && detections[c].source < 0)
+                {
+                    detections[c].source = s;
+                    detections[c].result = results[s][c];
+                }
+            }
+        }
+
+        return anyRead ? ERROR_NONE : ERROR_CANNOT_READ_CAMERA;
+    }
+
+    // getResults function
+    const vector<ColorResult> &DetectorGroup::getResults(int source) { return results[source]; }
+
+    // getError function
+    int DetectorGroup::getError(int source) { return errors[source]; }
+
+    // getFramesSearched function
+    long DetectorGroup::getFramesSearched() { return frames; }
+}
@@ -0,0 +1,130 @@
+#ifndef DETECTORGROUP_H
+#define	DETECTORGROUP_H
+
+#include "ColorDetection.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace SniperBot
+{
+    /** GroupDetection Struct
+     * Purpose: Holds what a DetectorGroup found for one target color, and which camera saw it.
+     */
+    struct GroupDetection
+    {
+        int source;  // the index of the detector that found the color, -1 if none did
+        ColorResult result;  // what that detector found
+    };
+
+    /** DetectorGroup Class
+     * Purpose: Searches the frames of several cameras at once, such as the camera on the
+     * servos and a fixed wide angle camera. Each camera has its own ColorDetector and frame
+     * source, and each search of the group hands one detector to each thread of a pool. The
+     * calling thread searches too, so a group of N cameras needs N - 1 pool threads to search
+     * every camera at once. The pool threads wait for work the way the command sender does,
+     * so handing out a search never takes a lock.
+     */
+    class DetectorGroup
+    {
+    public:
+        /** Error code for no error */
+        static const int ERROR_NONE = 0;
+
+        /** Error code for if no camera's frame could be read */
+        static const int ERROR_CANNOT_READ_CAMERA = 1;
+
+        /** Error code for if the pool threads are already running */
+        static const int ERROR_ALREADY_RUNNING = 2;
+
+    private:
+        std::vector<ColorDetector *> detectors;  // the detector of each camera, in priority order
+        std::vector<std::vector<ColorResult> > results;  // what each detector found in the last search
+        std::vector<int> errors;  // the error code of each detector's last search
+        int threads;  // the threads that search, including the caller's, 0 for one per detector
+        std::vector<std::thread> pool;  // the pool threads
+        std::atomic<bool> running;  // tells the pool threads to keep going
+        std::atomic<unsigned> round;  // counts the searches, so the pool threads know there is work
+        std::atomic<int> nextJob;  // the index of the next detector to hand out
+        std::atomic<int> jobsDone;  // the number of detectors searched in this round
+        std::atomic<long> frames;  // the number of frames searched
+
+        /** A pool thread's loop */
+        void work();
+
+        /** Searches with detectors until every one of this round has been handed out */
+        void runJobs();
+
+    public:
+
+        /** Constructor to create an empty DetectorGroup object
+         * @param threads the threads that search, including the caller's. 0 uses one per
+         * detector, up to the number of cores.
+         */
+        DetectorGroup(int threads = 0);
+
+        /** Destructor. Stops the pool threads. */
+        ~DetectorGroup();
+
+        /** Adds a camera's detector to the group. Detectors added first have priority when
+         * more than one camera sees a color. The detector must not be used by anything else
+         * while the group is searching.
+         * @param detector the detector, with its frame source set and the same target colors
+         * as the other detectors
+         * @return the index of the detector in the group
+         */
+        int addDetector(ColorDetector *detector);
+
+        /** Gets the number of detectors
+         * @return the number of detectors
+         */
+        int getDetectorCount();
+
+        /** Gets a detector
+         * @param source the index of the detector
+         * @return the detector
+         */
+        ColorDetector *getDetector(int source);
+
+        /** Gets the number of threads that search, including the caller's
+         * @return the number of threads
+         */
+        int getThreadCount();
+
+        /** Starts the pool threads
+         * @return an error code if an error occurs
+         */
+        int start();
+
+        /** Stops the pool threads and waits for them to finish */
+        void stop();
+
+        /** Reads the next frame of every camera and searches them all at once for the target
+         * colors. Only one thread may call this.
+         * @param detections a reference to a vector that will hold one detection for each
+         * target color, in the same order as the target colors. Each color is taken from the
+         * first detector that found it.
+         * @return an error code if an error occurs
+         */
+        int findColors(std::vector<GroupDetection> &detections);
+
+        /** Gets what one detector found in the last search
+         * @param source the index of the detector
+         * @return the result of each of its target colors
+         */
+        const std::vector<ColorResult> &getResults(int source);
+
+        /** Gets the error code of one detector's last search
+         * @param source the index of the detector
+         * @return the error code
+         */
+        int getError(int source);
+
+        /** Gets the number of frames searched, over every camera
+         * @return the number of frames searched
+         */
+        long getFramesSearched();
+    };
+}
+
+#endif	/* DETECTORGROUP_H */
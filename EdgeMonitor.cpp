@@ -0,0 +1,260 @@
+#include "EdgeMonitor.h"
+#include <algorithm>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <linux/gpio.h>
+
+using namespace std;
+
+namespace SniperBot
+{
+    static const int MAX_READY = 16;  // the most sources handled per epoll_wait
+
+    /** Orders events by their time
+     * @param a the first event
+     * @param b the second event
+     * @return true if a happened before b
+     */
+    static bool earlierEvent(const EdgeEvent &a, const EdgeEvent &b) { return a.time < b.time; }
+
+    // Constructor
+    ChipEdgeSource::ChipEdgeSource() { this->fd = -1; }
+
+    // Destructor
+    ChipEdgeSource::~ChipEdgeSource() { close(); }
+
+    int ChipEdgeSource::open(const string &chip, const vector<unsigned> &offsets,
+        const string &consumer)
+    {
+        close();
+
+#ifdef GPIO_V2_GET_LINE_IOCTL
+        if(offsets.empty() || offsets.size() > GPIO_V2_LINES_MAX)
+            return ERROR_CANNOT_REQUEST_LINES;
+
+        int chipFd = ::open(chip.c_str(), O_RDWR | O_CLOEXEC);
+        if(chipFd < 0)
+            return ERROR_CANNOT_OPEN_CHIP;
+
+        gpio_v2_line_request request;
+        memset(&request, 0, sizeof(request));
+        for(size_t i = 0; i < offsets.size(); ++i)
+            request.offsets[i] = offsets[i];
+        request.num_lines = (unsigned)offsets.size();
+        strncpy(request.consumer, consumer.c_str(), GPIO_MAX_NAME_SIZE - 1);
+        request.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING |
+            GPIO_V2_LINE_FLAG_EDGE_FALLING;
+
+        int result = ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &request);
+        ::close(chipFd);  // the line request keeps its own descriptor
+        if(result < 0)
+            return ERROR_CANNOT_REQUEST_LINES;
+
+        // Reads must never block, since epoll says when there is something to read
+        fd = request.fd;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        this->offsets = offsets;
+        return ERROR_NONE;
+#else
+        return ERROR_NOT_SUPPORTED;
+#endif
+    }
+
+    void ChipEdgeSource::close()
+    {
+        if(fd >= 0)
+            ::close(fd);
+        fd = -1;
+        offsets.clear();
+    }
+
+    // getFd function
+    int ChipEdgeSource::getFd() { return fd; }
+
+    int ChipEdgeSource::readEvents(vector<EdgeEvent> &events)
+    {
+#ifdef GPIO_V2_GET_LINE_IOCTL
+        gpio_v2_line_event buffer[16];  // the kernel's events
+        int count = 0;
+
+        while(true)
+        {
+            ssize_t bytes = read(fd, buffer, sizeof(buffer));
+            if(bytes == 0)
+                return count;
+            if(bytes < 0)
+                return errno == EAGAIN || errno == EWOULDBLOCK ? count : -1;
+
+            for(size_t i = 0; i < bytes / sizeof(buffer[0]); ++i)
+            {
+                EdgeEvent event;
+                event.source = 0;
+                event.line = (int)(find(offsets.begin(), offsets.end(), buffer[i].offset) -
+                    offsets.begin());
+                event.rising = buffer[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE;
+                event.time = (long long)buffer[i].timestamp_ns;
+                events.push_back(event);
+                ++count;
+            }
+        }
+#else
+        return -1;
+#endif
+    }
+
+    bool ChipEdgeSource::getValues(unsigned long long &values)
+    {
+#ifdef GPIO_V2_LINE_GET_VALUES_IOCTL
+        gpio_v2_line_values lineValues;
+        lineValues.bits = 0;
+        lineValues.mask = offsets.size() == 64 ? ~0ULL : (1ULL << offsets.size()) - 1;
+
+        if(fd < 0 || ioctl(fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &lineValues) < 0)
+            return false;
+        values = lineValues.bits;
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Constructor
+    SimulatedEdgeSource::SimulatedEdgeSource()
+    {
+        int fds[2];
+
+        this->readFd = -1;
+        this->writeFd = -1;
+        this->values = 0;
+        if(pipe2(fds, O_NONBLOCK | O_CLOEXEC) == 0)
+        {
+            this->readFd = fds[0];
+            this->writeFd = fds[1];
+        }
+    }
+
+    // Destructor
+    SimulatedEdgeSource::~SimulatedEdgeSource()
+    {
+        if(readFd >= 0)
+            ::close(readFd);
+        if(writeFd >= 0)
+            ::close(writeFd);
+    }
+
+    void SimulatedEdgeSource::setLine(int line, bool value)
+    {
+        unsigned long long bit = 1ULL << line;
+
+        if(((values & bit) != 0) == value)
+            return;
+        values ^= bit;
+
+        EdgeEvent event;
+        event.source = 0;
+        event.line = line;
+        event.rising = value;
+        event.time = EdgeMonitor::now();
+
+        // A full pipe drops the edge, like an overrun kernel queue would
+        ssize_t written = write(writeFd, &event, sizeof(event));
+        (void)written;
+    }
+
+    // getFd function
+    int SimulatedEdgeSource::getFd() { return readFd; }
+
+    int SimulatedEdgeSource::readEvents(vector<EdgeEvent> &events)
+    {
+        EdgeEvent buffer[16];  // the queued events
+        int count = 0;
+
+        while(true)
+        {
+            ssize_t bytes = read(readFd, buffer, sizeof(buffer));
+            if(bytes == 0)
+                return count;
+            if(bytes < 0)
+                return errno == EAGAIN || errno == EWOULDBLOCK ? count : -1;
+
+            for(size_t i = 0; i < bytes / sizeof(buffer[0]); ++i)
+            {
+                events.push_back(buffer[i]);
+                ++count;
+            }
+        }
+    }
+
+    bool SimulatedEdgeSource::getValues(unsigned long long &values)
+    {
+        values = this->values;
+        return true;
+    }
+
+    // Constructor
+    EdgeMonitor::EdgeMonitor() { this->epollFd = epoll_create1(EPOLL_CLOEXEC); }
+
+    // Destructor
+    EdgeMonitor::~EdgeMonitor()
+    {
+        if(epollFd >= 0)
+            close(epollFd);
+    }
+
+    int EdgeMonitor::addSource(EdgeSource *source)
+    {
+        epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.u32 = (unsigned)sources.size();
+
+        if(epollFd < 0 || source->getFd() < 0 ||
+                epoll_ctl(epollFd, EPOLL_CTL_ADD, source->getFd(), &event) < 0)
+            return -1;
+
+        sources.push_back(source);
+        return (int)sources.size() - 1;
+    }
+
+    int EdgeMonitor::poll(vector<EdgeEvent> &events, int timeout)
+    {
+        epoll_event ready[MAX_READY];
+
+        events.clear();
+        if(epollFd < 0)
+            return ERROR_EPOLL_FAILED;
+
+        int count = epoll_wait(epollFd, ready, MAX_READY, timeout);
+        if(count < 0)
+            return errno == EINTR ? ERROR_NONE : ERROR_EPOLL_FAILED;
+
+        for(int i = 0; i < count; ++i)
+        {
+            int index = (int)ready[i].data.u32;
+            size_t first = events.size();
+
+            if(sources[index]->readEvents(events) < 0)
+                return ERROR_CANNOT_READ_SOURCE;
+            for(size_t e = first; e < events.size(); ++e)
+                events[e].source = index;
+        }
+
+        // Each source is in order already, so this only interleaves the sources
+        if(count > 1)
+            stable_sort(events.begin(), events.end(), earlierEvent);
+
+        return ERROR_NONE;
+    }
+
+    long long EdgeMonitor::now()
+    {
+        timespec time;
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        return time.tv_sec * 1000000000LL + time.tv_nsec;
+    }
+}
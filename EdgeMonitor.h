@@ -0,0 +1,179 @@
+#ifndef EDGEMONITOR_H
+#define	EDGEMONITOR_H
+
+#include <string>
+#include <vector>
+
+namespace SniperBot
+{
+    /** EdgeEvent Struct
+     * Purpose: Holds one change of an input line.
+     */
+    struct EdgeEvent
+    {
+        int source;  // the index of the edge source in the monitor
+        int line;  // the line of the edge source that changed
+        bool rising;  // true if the line went high, false if it went low
+        long long time;  // when the line changed, in nanoseconds of CLOCK_MONOTONIC
+    };
+
+    /** EdgeSource Class
+     * Purpose: Interface for a group of input lines that report their changes through a file
+     * descriptor, so the changes can be waited on with epoll instead of reading the lines.
+     */
+    class EdgeSource
+    {
+    public:
+
+        /** Destructor */
+        virtual ~EdgeSource() {}
+
+        /** Gets the file descriptor that becomes readable when changes are waiting
+         * @return the file descriptor, -1 if the source is not open
+         */
+        virtual int getFd() = 0;
+
+        /** Reads every change that is waiting, without blocking
+         * @param events a reference to a vector to add the changes to, oldest first
+         * @return the number of changes read, -1 if an error occurs
+         */
+        virtual int readEvents(std::vector<EdgeEvent> &events) = 0;
+
+        /** Reads the current levels of the lines
+         * @param values a reference to a variable to hold the levels, line i in bit i
+         * @return true if the levels were read
+         */
+        virtual bool getValues(unsigned long long &values) = 0;
+    };
+
+    /** ChipEdgeSource Class
+     * Purpose: Requests input lines from a /dev/gpiochipN character device with edge detection
+     * on both edges. The kernel timestamps each edge when the interrupt fires and queues it,
+     * so no change is missed between reads.
+     */
+    class ChipEdgeSource : public EdgeSource
+    {
+    public:
+        /** Error code for no error */
+        static const int ERROR_NONE = 0;
+
+        /** Error code for if the GPIO chip cannot be opened */
+        static const int ERROR_CANNOT_OPEN_CHIP = 1;
+
+        /** Error code for if the lines cannot be requested from the chip */
+        static const int ERROR_CANNOT_REQUEST_LINES = 2;
+
+        /** Error code for if the GPIO character device is not supported by this build */
+        static const int ERROR_NOT_SUPPORTED = 3;
+
+    private:
+        int fd;  // the line request, -1 if no lines are requested
+        std::vector<unsigned> offsets;  // the chip's line numbers, in the order of the lines
+
+    public:
+
+        /** Constructor to create a ChipEdgeSource object with no lines */
+        ChipEdgeSource();
+
+        /** Destructor. Releases the lines. */
+        ~ChipEdgeSource();
+
+        /** Requests input lines from a GPIO chip
+         * @param chip the chip's device, such as "/dev/gpiochip0"
+         * @param offsets the chip's line numbers, in the order of the lines. These are the BCM
+         * pin numbers on the Raspberry Pi.
+         * @param consumer the name the lines are shown as in use by
+         * @return an error code if an error occurs
+         */
+        int open(const std::string &chip, const std::vector<unsigned> &offsets,
+            const std::string &consumer = "sniperbot");
+
+        /** Releases the lines */
+        void close();
+
+        int getFd();
+        int readEvents(std::vector<EdgeEvent> &events);
+        bool getValues(unsigned long long &values);
+    };
+
+    /** SimulatedEdgeSource Class
+     * Purpose: Input lines that are changed by calling setLine, for running and testing the
+     * robot without sensors. Changes go through a pipe, so they wake epoll the same way real
+     * edges do.
+     */
+    class SimulatedEdgeSource : public EdgeSource
+    {
+    private:
+        int readFd;  // the end of the pipe the changes are read from
+        int writeFd;  // the end of the pipe the changes are written to
+        unsigned long long values;  // the levels of the lines
+
+    public:
+
+        /** Constructor to create a SimulatedEdgeSource object with every line low */
+        SimulatedEdgeSource();
+
+        /** Destructor. Closes the pipe. */
+        ~SimulatedEdgeSource();
+
+        /** Changes a line, and queues an edge if its level changed
+         * @param line the line to change
+         * @param value the new level of the line
+         */
+        void setLine(int line, bool value);
+
+        int getFd();
+        int readEvents(std::vector<EdgeEvent> &events);
+        bool getValues(unsigned long long &values);
+    };
+
+    /** EdgeMonitor Class
+     * Purpose: Waits on any number of edge sources with one epoll set and collects their
+     * changes in time order. Checking for changes when there are none is one epoll_wait call,
+     * no matter how many lines are watched.
+     */
+    class EdgeMonitor
+    {
+    public:
+        /** Error code for no error */
+        static const int ERROR_NONE = 0;
+
+        /** Error code for if the epoll set cannot be made or changed */
+        static const int ERROR_EPOLL_FAILED = 1;
+
+        /** Error code for if an edge source cannot be read */
+        static const int ERROR_CANNOT_READ_SOURCE = 2;
+
+    private:
+        int epollFd;  // the epoll set of the sources
+        std::vector<EdgeSource *> sources;  // the sources, in the order they were added
+
+    public:
+
+        /** Constructor to create an EdgeMonitor object with no sources */
+        EdgeMonitor();
+
+        /** Destructor. Closes the epoll set. The sources are not deleted. */
+        ~EdgeMonitor();
+
+        /** Adds an edge source to watch
+         * @param source the edge source. It must stay open while it is watched.
+         * @return the index of the source in the events, -1 if it could not be added
+         */
+        int addSource(EdgeSource *source);
+
+        /** Waits for changes and collects every change that is waiting
+         * @param events a reference to a vector that will hold the changes, oldest first
+         * @param timeout milliseconds to wait for a change, 0 to only check, -1 to wait forever
+         * @return an error code if an error occurs
+         */
+        int poll(std::vector<EdgeEvent> &events, int timeout);
+
+        /** Gets the current time on the clock the events are timestamped with
+         * @return the time in nanoseconds of CLOCK_MONOTONIC
+         */
+        static long long now();
+    };
+}
+
+#endif	/* EDGEMONITOR_H */
@@ -0,0 +1,118 @@
+#include "FrameGrabber.h"
+#include "Trace.h"
+#include <chrono>
+
+using namespace std;
+using namespace cv;
+
+namespace SniperBot
+{
+    static const int POLL_INTERVAL = 200;  // microseconds the reader sleeps while waiting for a new frame
+
+    // Constructor
+    FrameGrabber::FrameGrabber(VideoCapture &c, double frameRate)
+    {
+        this->cap = &c;
+        this->frameRate = frameRate;
+        this->writeSlot = 1;
+        this->readSlot = 2;
+        this->publishedSlot = 0;
+        this->running = false;
+        this->finished = true;
+        this->framesCaptured = 0;
+        this->framesDropped = 0;
+    }
+
+    // Destructor
+    FrameGrabber::~FrameGrabber() { stop(); }
+
+    int FrameGrabber::start()
+    {
+        if(thread.joinable())
+            return ERROR_ALREADY_RUNNING;
+
+        // Read the first frame so every slot can be allocated at the camera's frame size
+        if(!cap->read(slots[0]))
+            return ERROR_CANNOT_READ_CAMERA;
+        for(int i = 1; i < NUM_SLOTS; ++i)
+            slots[0].copyTo(slots[i]);
+
+        // The first frame is published, and is waiting to be read
+        writeSlot = 1;
+        readSlot = 2;
+        publishedSlot = 0 | NEW_FRAME;
+        framesCaptured = 1;
+        framesDropped = 0;
+
+        running = true;
+        finished = false;
+        thread = std::thread(&FrameGrabber::run, this);
+
+        return ERROR_NONE;
+    }
+
+    void FrameGrabber::stop()
+    {
+        running = false;
+        if(thread.joinable())
+            thread.join();
+    }
+
+    void FrameGrabber::run()
+    {
+        chrono::steady_clock::time_point next = chrono::steady_clock::now();  // when to read the next frame
+        chrono::nanoseconds interval(frameRate > 0 ? (long long)(1e9 / frameRate) : 0);
+
+        while(running)
+        {
+            // Pace the capture if a frame rate was given
+            if(frameRate > 0)
+            {
+                next += interval;
+                this_thread::sleep_until(next);
+            }
+
+            {
+                TRACE_SPAN("camera capture");
+                if(!cap->read(slots[writeSlot]))
+                    break;
+            }
+            ++framesCaptured;
+
+            // Publish the frame and take back the slot it replaced. If that slot was never
+            // read, its frame is dropped.
+            int previous = publishedSlot.exchange(writeSlot | NEW_FRAME);
+            if(previous & NEW_FRAME)
+                ++framesDropped;
+            writeSlot = previous & SLOT_MASK;
+        }
+
+        finished = true;
+    }
+
+    bool FrameGrabber::read(Mat &frame)
+    {
+        while(!(publishedSlot.load() & NEW_FRAME))
+        {
+            // Only give up once the capture thread has stopped and left no frame behind
+            if(finished && !(publishedSlot.load() & NEW_FRAME))
+                return false;
+            this_thread::sleep_for(chrono::microseconds(POLL_INTERVAL));
+        }
+
+        // Swap the slot that was just used for the newest frame
+        readSlot = publishedSlot.exchange(readSlot) & SLOT_MASK;
+        frame = slots[readSlot];
+
+        return true;
+    }
+
+    // getFramesCaptured function
+    long FrameGrabber::getFramesCaptured() { return framesCaptured; }
+
+    // getFramesDropped function
+    long FrameGrabber::getFramesDropped() { return framesDropped; }
+
+    // isRunning function
+    bool FrameGrabber::isRunning() { return !finished; }
+}
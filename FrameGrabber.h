@@ -0,0 +1,100 @@
+#ifndef FRAMEGRABBER_H
+#define	FRAMEGRABBER_H
+
+#include "opencv2/highgui/highgui.hpp"
+#include "FrameSource.h"
+#include <atomic>
+#include <thread>
+
+using namespace cv;
+
+namespace SniperBot
+{
+    /** FrameGrabber Class
+     * Purpose: Reads frames from a VideoCapture on its own thread so the robot never waits on
+     * the camera. Frames go into a ring of 3 preallocated slots. One slot is written by the
+     * capture thread, one holds the newest finished frame, and one is held by the reader. The
+     * slots are swapped with a single atomic exchange, so neither side ever takes a lock, and
+     * the reader always gets the newest frame. Frames that are replaced before they are read
+     * are counted as dropped.
+     */
+    class FrameGrabber : public FrameSource
+    {
+    public:
+        /** Error code for no error */
+        static const int ERROR_NONE = 0;
+
+        /** Error code for if the camera cannot be read */
+        static const int ERROR_CANNOT_READ_CAMERA = 1;
+
+        /** Error code for if the capture thread is already running */
+        static const int ERROR_ALREADY_RUNNING = 2;
+
+        /** The number of frame slots in the ring */
+        static const int NUM_SLOTS = 3;
+
+    private:
+
+        static const int NEW_FRAME = 4;  // flag set in the published slot index when it holds an unread frame
+        static const int SLOT_MASK = 3;  // mask for the slot index in the published slot index
+
+        VideoCapture *cap;  // holds a reference to the VideoCapture object used to grab frames
+        double frameRate;  // frames per second to pace the capture at. 0 reads as fast as possible.
+        Mat slots[NUM_SLOTS];  // the preallocated frames
+        int writeSlot;  // the slot the capture thread is writing, only used by the capture thread
+        int readSlot;  // the slot the reader holds, only used by the reader
+        std::atomic<int> publishedSlot;  // the slot holding the newest frame, with the NEW_FRAME flag
+        std::atomic<bool> running;  // tells the capture thread to keep going
+        std::atomic<bool> finished;  // set when the capture thread has stopped reading frames
+        std::atomic<long> framesCaptured;  // the number of frames read from the camera
+        std::atomic<long> framesDropped;  // the number of frames replaced before they were read
+        std::thread thread;  // the capture thread
+
+        /** The capture thread's loop */
+        void run();
+
+    public:
+
+        /** Constructor to create a FrameGrabber object
+         * @param cap a reference to an open VideoCapture object used to grab frames
+         * @param frameRate frames per second to pace the capture at. Use this with a
+         * file-backed VideoCapture to play it back like a camera. 0 reads as fast as possible.
+         */
+        FrameGrabber(VideoCapture &cap, double frameRate = 0);
+
+        /** Destructor. Stops the capture thread. */
+        ~FrameGrabber();
+
+        /** Reads the first frame to size the slots and starts the capture thread
+         * @return an error code if an error occurs
+         */
+        int start();
+
+        /** Stops the capture thread and waits for it to finish */
+        void stop();
+
+        /** Waits for a frame newer than the last one read and hands it to the caller. The
+         * frame shares its pixels with the slot, so it is only valid until the next call.
+         * @param frame a reference to a Mat that will hold the frame
+         * @return true if a frame was read, false if the capture has ended
+         */
+        bool read(Mat &frame);
+
+        /** Gets the number of frames read from the camera
+         * @return the number of frames read from the camera
+         */
+        long getFramesCaptured();
+
+        /** Gets the number of frames that were replaced by a newer frame before they were read
+         * @return the number of dropped frames
+         */
+        long getFramesDropped();
+
+        /** Gets if the capture thread is still reading frames
+         * @return if the capture thread is still reading frames
+         */
+        bool isRunning();
+    };
+}
+
+#endif	/* FRAMEGRABBER_H */
@@ -0,0 +1,37 @@
+#ifndef FRAMESOURCE_H
+#define	FRAMESOURCE_H
+
+#include "opencv2/core/core.hpp"
+
+using namespace cv;
+
+namespace SniperBot
+{
+    /** FrameSource Class
+     * Purpose: Interface for anything that supplies camera frames to a ColorDetector, so the
+     * detector does not need to know if the frames come straight from a VideoCapture, from a
+     * capture thread, or from memory.
+     */
+    class FrameSource
+    {
+    public:
+
+        /** Destructor */
+        virtual ~FrameSource() {}
+
+        /** Reads the next frame. The frame may share its pixels with the source, so it is
+         * only valid until the next call to read.
+         * @param frame a reference to a Mat that will hold the frame
+         * @return true if a frame was read
+         */
+        virtual bool read(Mat &frame) = 0;
+
+        /** Tells the source the last frame read is no longer needed, so a source that lends
+         * out a camera's own buffer can give it back before the next read. Does nothing by
+         * default.
+         */
+        virtual void release() {}
+    };
+}
+
+#endif	/* FRAMESOURCE_H */
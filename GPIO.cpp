@@ -1,96 +1,154 @@
-#include <fstream>
 #include <string>
 #include <iostream>
-#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
 #include "GPIO.h"
  
 using namespace std;
+
+const char *GPIO::DEFAULT_ROOT = "/sys/class/gpio";
  
 GPIO::GPIO()
 {
     this->gpionum = "4"; //GPIO4 is default
+    this->rootdir = DEFAULT_ROOT;
+    this->valuefd = -1;
 }
  
-GPIO::GPIO(string gnum)
+GPIO::GPIO(string gnum, string root)
 {
     this->gpionum = gnum;  //Instatiate GPIOClass object for GPIO pin number "gnum"
+    this->rootdir = root;
+    this->valuefd = -1;
+}
+
+GPIO::~GPIO()
+{
+    close_value();
+}
+
+int GPIO::write_file(string path, string text)
+{
+    string file_str = this->rootdir + "/" + path;
+    int fd = open(file_str.c_str(), O_WRONLY); // open the file for writing
+    if (fd < 0){
+        cout << " OPERATION FAILED: Unable to open " << file_str << ": " << strerror(errno) << endl;
+        return -1;
+    }
+ 
+    ssize_t written = write(fd, text.c_str(), text.size()); // write the text to the file
+    if (written != (ssize_t)text.size()){
+        cout << " OPERATION FAILED: Unable to write " << file_str << ": " << strerror(errno) << endl;
+        close(fd);
+        return -1;
+    }
+ 
+    close(fd); // close the file
+    return 0;
+}
+
+int GPIO::open_value()
+{
+    if (this->valuefd >= 0)
+        return 0;
+ 
+    string value_str = this->rootdir + "/gpio" + this->gpionum + "/value";
+    this->valuefd = open(value_str.c_str(), O_RDWR); // open value file for gpio
+    if (this->valuefd < 0)
+        this->valuefd = open(value_str.c_str(), O_RDONLY); // input pins may only allow reading
+    if (this->valuefd < 0){
+        cout << " OPERATION FAILED: Unable to open the value of GPIO"<< this->gpionum <<": " << strerror(errno) << endl;
+        return -1;
+    }
+    return 0;
+}
+
+void GPIO::close_value()
+{
+    if (this->valuefd >= 0)
+        close(this->valuefd);
+    this->valuefd = -1;
 }
  
 int GPIO::export_gpio()
 {
-    string export_str = "/sys/class/gpio/export";
-    ofstream exportgpio(export_str.c_str()); // Open "export" file. Convert C++ string to C string. Required for all Linux pathnames
-    if (exportgpio < 0){
+    if (write_file("export", this->gpionum) < 0){ //write GPIO number to export
         cout << " OPERATION FAILED: Unable to export GPIO"<< this->gpionum <<" ."<< endl;
         return -1;
     }
- 
-    exportgpio << this->gpionum ; //write GPIO number to export
-    exportgpio.close(); //close export file
     return 0;
 }
  
 int GPIO::unexport_gpio()
 {
-    string unexport_str = "/sys/class/gpio/unexport";
-    ofstream unexportgpio(unexport_str.c_str()); //Open unexport file
-    if (unexportgpio < 0){
+    close_value(); // the value file goes away with the pin
+ 
+    if (write_file("unexport", this->gpionum) < 0){ //write GPIO number to unexport
         cout << " OPERATION FAILED: Unable to unexport GPIO"<< this->gpionum <<" ."<< endl;
         return -1;
     }
- 
-    unexportgpio << this->gpionum ; //write GPIO number to unexport
-    unexportgpio.close(); //close unexport file
     return 0;
 }
  
 int GPIO::setdir_gpio(string dir)
 {
- 
-    string setdir_str ="/sys/class/gpio/gpio" + this->gpionum + "/direction";
-    ofstream setdirgpio(setdir_str.c_str()); // open direction file for gpio
-        if (setdirgpio < 0){
-            cout << " OPERATION FAILED: Unable to set direction of GPIO"<< this->gpionum <<" ."<< endl;
-            return -1;
-        }
- 
-        setdirgpio << dir; //write direction to direction file
-        setdirgpio.close(); // close direction file
-        return 0;
+    if (write_file("gpio" + this->gpionum + "/direction", dir) < 0){ //write direction to direction file
+        cout << " OPERATION FAILED: Unable to set direction of GPIO"<< this->gpionum <<" ."<< endl;
+        return -1;
+    }
+    return 0;
 }
  
 int GPIO::setval_gpio(string val)
 {
+    return setval_gpio(val != "0");
+}
  
-    string setval_str = "/sys/class/gpio/gpio" + this->gpionum + "/value";
-    ofstream setvalgpio(setval_str.c_str()); // open value file for gpio
-        if (setvalgpio < 0){
-            cout << " OPERATION FAILED: Unable to set the value of GPIO"<< this->gpionum <<" ."<< endl;
-            return -1;
-        }
+int GPIO::setval_gpio(bool val)
+{
+    if (open_value() < 0)
+        return -1;
  
-        setvalgpio << val ;//write value to value file
-        setvalgpio.close();// close value file 
-        return 0;
+    // sysfs reads the whole value from the start of the file, so write at offset 0
+    // instead of reopening the file
+    if (pwrite(this->valuefd, val ? "1" : "0", 1, 0) != 1){
+        cout << " OPERATION FAILED: Unable to set the value of GPIO"<< this->gpionum <<": " << strerror(errno) << endl;
+        return -1;
+    }
+    return 0;
 }
  
 int GPIO::getval_gpio(string& val){
  
-    string getval_str = "/sys/class/gpio/gpio" + this->gpionum + "/value";
-    ifstream getvalgpio(getval_str.c_str());// open value file for gpio
-    if (getvalgpio < 0){
-        cout << " OPERATION FAILED: Unable to get value of GPIO"<< this->gpionum <<" ."<< endl;
+    bool state;
+    if (getval_gpio(state) < 0)
         return -1;
-            }
  
-    getvalgpio >> val ;  //read gpio value
+    val = state ? "1" : "0";
+    return 0;
+}
+ 
+int GPIO::getval_gpio(bool& val){
+ 
+    char buffer[4]; // holds the value, and the newline after it
  
-    if(val != "0")
-        val = "1";
-    else
-        val = "0";
+    if (open_value() < 0)
+        return -1;
+ 
+    // sysfs only reads the pin again when read from offset 0
+    ssize_t count = pread(this->valuefd, buffer, sizeof(buffer), 0);
+    if (count < 0){
+        cout << " OPERATION FAILED: Unable to get value of GPIO"<< this->gpionum <<": " << strerror(errno) << endl;
+        return -1;
+    }
+    if (count == 0){
+        cout << " OPERATION FAILED: Unable to get value of GPIO"<< this->gpionum <<": the value file is empty" << endl;
+        return -1;
+    }
  
-    getvalgpio.close(); //close the value file
+    val = buffer[0] != '0';
     return 0;
 }
  
@@ -6,18 +6,28 @@ using namespace std;
 /** GPIO Class
  * Purpose: Each object instantiated from this class will control a GPIO pin
  * The GPIO pin number must be passed to the overloaded class constructor
+ * The pin's value file is opened the first time it is used and kept open, so reading
+ * and writing the pin is a single pread or pwrite.
  */
 class GPIO
 {
 public:
     
+    /** The default directory the GPIO pins are found in */
+    static const char *DEFAULT_ROOT;
+    
     /** Creates a GPIO object */
     GPIO();  // create a GPIO object that controls GPIO4 (default
     
     /** Creates a GPIO object for the specified pin
      * @param x the GPIO pin to control
+     * @param root the directory the GPIO pins are found in. Point this at a temporary
+     * directory tree to test or benchmark without real hardware.
      */
-    GPIO(string x);
+    GPIO(string x, string root = DEFAULT_ROOT);
+    
+    /** Closes the pin's value file */
+    ~GPIO();
     
     /** Sets up a GPIO pin
      * @return error code
@@ -41,18 +51,51 @@ public:
      */
     int setval_gpio(string val);
     
+    /** Sets the state of the GPIO pin
+     * @param val the state of the pin
+     * @return error code
+     */
+    int setval_gpio(bool val);
+    
     /** Reads the state of the GPIO pin
      * @param val a reference to a variable that will hold the state of the GPIO pin
      * @return error code
      */
     int getval_gpio(string& val);
     
+    /** Reads the state of the GPIO pin
+     * @param val a reference to a variable that will hold the state of the GPIO pin
+     * @return error code
+     */
+    int getval_gpio(bool& val);
+    
     /** Gets the GPIO pin number for this object
      * @return the GPIO pin number for this object
      */
     string get_gpionum();
 private:
     string gpionum; // GPIO number associated with the instance of an object
+    string rootdir; // directory the GPIO pins are found in
+    int valuefd; // the pin's open value file, -1 if it is not open yet
+    
+    /** Writes text to a file in the GPIO directory
+     * @param path the path of the file from the GPIO directory
+     * @param text the text to write
+     * @return error code
+     */
+    int write_file(string path, string text);
+    
+    /** Opens the pin's value file if it is not open yet
+     * @return error code
+     */
+    int open_value();
+    
+    /** Closes the pin's value file */
+    void close_value();
+    
+    // A copy would close the same value file again, so GPIO objects cannot be copied
+    GPIO(const GPIO &);
+    GPIO &operator=(const GPIO &);
 };
  
-#endif
\ No newline at end of file
+#endif
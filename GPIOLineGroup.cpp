@@ -0,0 +1,160 @@
+#include "GPIOLineGroup.h"
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+
+using namespace std;
+
+namespace SniperBot
+{
+    int GPIOLineGroup::strobe(unsigned long long data, unsigned long long dataMask, int strobeLine)
+    {
+        unsigned long long strobeBit = 1ULL << strobeLine;
+
+        // Change the data while the strobe is low, then raise the strobe on its own
+        int error = setValues(data & dataMask & ~strobeBit, dataMask | strobeBit);
+        if(error != ERROR_NONE)
+            return error;
+
+        error = setValues(strobeBit, strobeBit);
+        if(error != ERROR_NONE)
+            return error;
+
+        // Give the other side time to read the data before it can change
+        wait(STROBE_HOLD);
+        return ERROR_NONE;
+    }
+
+    void GPIOLineGroup::wait(int micros)
+    {
+        timespec delay;
+        delay.tv_sec = micros / 1000000;
+        delay.tv_nsec = (micros % 1000000) * 1000L;
+        while(nanosleep(&delay, &delay) < 0 && errno == EINTR)
+            ;  // a signal woke it early, so sleep for the rest
+    }
+
+    // Constructor
+    ChipLineGroup::ChipLineGroup() { this->fd = -1; }
+
+    // Destructor
+    ChipLineGroup::~ChipLineGroup() { close(); }
+
+    int ChipLineGroup::open(const string &chip, const vector<unsigned> &offsets, bool output,
+        const string &consumer)
+    {
+        close();
+
+#ifdef GPIO_V2_GET_LINE_IOCTL
+        if(offsets.empty() || offsets.size() > GPIO_V2_LINES_MAX)
+            return ERROR_CANNOT_REQUEST_LINES;
+
+        int chipFd = ::open(chip.c_str(), O_RDWR | O_CLOEXEC);
+        if(chipFd < 0)
+            return ERROR_CANNOT_OPEN_CHIP;
+
+        gpio_v2_line_request request;
+        memset(&request, 0, sizeof(request));
+        for(size_t i = 0; i < offsets.size(); ++i)
+            request.offsets[i] = offsets[i];
+        request.num_lines = (unsigned)offsets.size();
+        strncpy(request.consumer, consumer.c_str(), GPIO_MAX_NAME_SIZE - 1);
+        request.config.flags = output ? GPIO_V2_LINE_FLAG_OUTPUT : GPIO_V2_LINE_FLAG_INPUT;
+
+        // Outputs start low, instead of whatever the pin was left at
+        if(output)
+        {
+            request.config.num_attrs = 1;
+            request.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+            request.config.attrs[0].attr.values = 0;
+            request.config.attrs[0].mask = offsets.size() == 64 ? ~0ULL :
+                (1ULL << offsets.size()) - 1;
+        }
+
+        int result = ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &request);
+        ::close(chipFd);  // the line request keeps its own descriptor
+        if(result < 0)
+            return ERROR_CANNOT_REQUEST_LINES;
+
+        fd = request.fd;
+        return ERROR_NONE;
+#else
+        return ERROR_NOT_SUPPORTED;
+#endif
+    }
+
+    void ChipLineGroup::close()
+    {
+        if(fd >= 0)
+            ::close(fd);
+        fd = -1;
+    }
+
+    // isOpen function
+    bool ChipLineGroup::isOpen() { return fd >= 0; }
+
+    int ChipLineGroup::setValues(unsigned long long values, unsigned long long mask)
+    {
+#ifdef GPIO_V2_LINE_SET_VALUES_IOCTL
+        gpio_v2_line_values lineValues;
+        lineValues.bits = values;
+        lineValues.mask = mask;
+
+        if(fd < 0 || ioctl(fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &lineValues) < 0)
+            return ERROR_CANNOT_SET_VALUES;
+        return ERROR_NONE;
+#else
+        return ERROR_NOT_SUPPORTED;
+#endif
+    }
+
+    int ChipLineGroup::getValues(unsigned long long &values, unsigned long long mask)
+    {
+#ifdef GPIO_V2_LINE_GET_VALUES_IOCTL
+        gpio_v2_line_values lineValues;
+        lineValues.bits = 0;
+        lineValues.mask = mask;
+
+        if(fd < 0 || ioctl(fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &lineValues) < 0)
+            return ERROR_CANNOT_GET_VALUES;
+        values = lineValues.bits & mask;
+        return ERROR_NONE;
+#else
+        return ERROR_NOT_SUPPORTED;
+#endif
+    }
+
+    // Constructor
+    FakeLineGroup::FakeLineGroup() { this->values = 0; }
+
+    int FakeLineGroup::setValues(unsigned long long values, unsigned long long mask)
+    {
+        this->values = (this->values & ~mask) | (values & mask);
+        history.push_back(this->values);
+        return ERROR_NONE;
+    }
+
+    int FakeLineGroup::getValues(unsigned long long &values, unsigned long long mask)
+    {
+        values = this->values & mask;
+        return ERROR_NONE;
+    }
+
+    void FakeLineGroup::setInputs(unsigned long long values, unsigned long long mask)
+    {
+        this->values = (this->values & ~mask) | (values & mask);
+    }
+
+    // getHistory function
+    const vector<unsigned long long> &FakeLineGroup::getHistory() { return history; }
+
+    // clearHistory function
+    void FakeLineGroup::clearHistory() { history.clear(); }
+
+    // Nothing reads the fake lines while they are held
+    void FakeLineGroup::wait(int) {}
+}
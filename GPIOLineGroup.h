@@ -0,0 +1,152 @@
+#ifndef GPIOLINEGROUP_H
+#define	GPIOLINEGROUP_H
+
+#include <string>
+#include <vector>
+
+namespace SniperBot
+{
+    /** GPIOLineGroup Class
+     * Purpose: Interface for a group of GPIO lines that are set or read together. Line i of
+     * the group is bit i of the values, so a whole bus can be changed in one call.
+     */
+    class GPIOLineGroup
+    {
+    public:
+        /** Error code for no error */
+        static const int ERROR_NONE = 0;
+
+        /** Error code for if the GPIO chip cannot be opened */
+        static const int ERROR_CANNOT_OPEN_CHIP = 1;
+
+        /** Error code for if the lines cannot be requested from the chip */
+        static const int ERROR_CANNOT_REQUEST_LINES = 2;
+
+        /** Error code for if the line values cannot be set */
+        static const int ERROR_CANNOT_SET_VALUES = 3;
+
+        /** Error code for if the line values cannot be read */
+        static const int ERROR_CANNOT_GET_VALUES = 4;
+
+        /** Error code for if the GPIO character device is not supported by this build */
+        static const int ERROR_NOT_SUPPORTED = 5;
+
+        /** Microseconds the strobe is held high before the data can change again. The
+         * Arduino's trigger handler takes up to about 35 us to start and read the data pins. */
+        static const int STROBE_HOLD = 40;
+
+        /** Destructor */
+        virtual ~GPIOLineGroup() {}
+
+        /** Sets some of the lines at once
+         * @param values the values of the lines, line i in bit i
+         * @param mask the lines to set, line i in bit i. The other lines keep their values.
+         * @return an error code if an error occurs
+         */
+        virtual int setValues(unsigned long long values, unsigned long long mask) = 0;
+
+        /** Reads some of the lines at once
+         * @param values a reference to a variable to hold the values of the lines, line i in bit i
+         * @param mask the lines to read, line i in bit i
+         * @return an error code if an error occurs
+         */
+        virtual int getValues(unsigned long long &values, unsigned long long mask) = 0;
+
+        /** Waits before the next change of the lines
+         * @param micros the microseconds to wait
+         */
+        virtual void wait(int micros);
+
+        /** Puts data on a bus and then raises a strobe line, so the other side only ever sees
+         * a finished value. The data goes out with the strobe held low in one change, and the
+         * strobe rises in a second change. The strobe is then held for STROBE_HOLD before
+         * returning, so the next value cannot change the data while it is still being read.
+         * @param data the values of the data lines, line i in bit i
+         * @param dataMask the data lines, line i in bit i
+         * @param strobeLine the line of the group to raise once the data is set
+         * @return an error code if an error occurs
+         */
+        int strobe(unsigned long long data, unsigned long long dataMask, int strobeLine);
+    };
+
+    /** ChipLineGroup Class
+     * Purpose: Requests lines from a /dev/gpiochipN character device with the version 2 GPIO
+     * uAPI. Every change of the group is one GPIO_V2_LINE_SET_VALUES_IOCTL, so all the lines
+     * change together instead of one sysfs write per line.
+     */
+    class ChipLineGroup : public GPIOLineGroup
+    {
+    private:
+        int fd;  // the line request, -1 if no lines are requested
+
+    public:
+
+        /** Constructor to create a ChipLineGroup object with no lines */
+        ChipLineGroup();
+
+        /** Destructor. Releases the lines. */
+        ~ChipLineGroup();
+
+        /** Requests lines from a GPIO chip
+         * @param chip the chip's device, such as "/dev/gpiochip0"
+         * @param offsets the chip's line numbers, in the order of the group. These are the
+         * BCM pin numbers on the Raspberry Pi.
+         * @param output should the lines be outputs, or inputs
+         * @param consumer the name the lines are shown as in use by
+         * @return an error code if an error occurs
+         */
+        int open(const std::string &chip, const std::vector<unsigned> &offsets, bool output,
+            const std::string &consumer = "sniperbot");
+
+        /** Releases the lines */
+        void close();
+
+        /** Gets if the lines are requested
+         * @return if the lines are requested
+         */
+        bool isOpen();
+
+        int setValues(unsigned long long values, unsigned long long mask);
+        int getValues(unsigned long long &values, unsigned long long mask);
+    };
+
+    /** FakeLineGroup Class
+     * Purpose: A group of lines in memory, for running and testing the robot without GPIO
+     * hardware. Every change is kept so tests can check what the other side would have seen.
+     */
+    class FakeLineGroup : public GPIOLineGroup
+    {
+    private:
+        unsigned long long values;  // the values of the lines
+        std::vector<unsigned long long> history;  // the values after each change
+
+    public:
+
+        /** Constructor to create a FakeLineGroup object with every line low */
+        FakeLineGroup();
+
+        int setValues(unsigned long long values, unsigned long long mask);
+        int getValues(unsigned long long &values, unsigned long long mask);
+
+        /** Returns straight away, since nothing reads the lines while they are held
+         * @param micros the microseconds to wait
+         */
+        void wait(int micros);
+
+        /** Sets lines as if the outside world changed them, without adding to the history
+         * @param values the values of the lines, line i in bit i
+         * @param mask the lines to set, line i in bit i
+         */
+        void setInputs(unsigned long long values, unsigned long long mask);
+
+        /** Gets the values of the lines after each change
+         * @return the values after each change, oldest first
+         */
+        const std::vector<unsigned long long> &getHistory();
+
+        /** Forgets the changes made so far */
+        void clearHistory();
+    };
+}
+
+#endif	/* GPIOLINEGROUP_H */
@@ -0,0 +1,42 @@
+#include "MemoryFrameSource.h"
+
+using namespace std;
+using namespace cv;
+
+namespace SniperBot
+{
+    // Constructor
+    MemoryFrameSource::MemoryFrameSource(bool loop)
+    {
+        this->next = 0;
+        this->loop = loop;
+    }
+
+    // addFrame function
+    void MemoryFrameSource::addFrame(const Mat &frame) { frames.push_back(frame); }
+
+    void MemoryFrameSource::clear()
+    {
+        frames.clear();
+        next = 0;
+    }
+
+    // rewind function
+    void MemoryFrameSource::rewind() { next = 0; }
+
+    // getFrameCount function
+    size_t MemoryFrameSource::getFrameCount() { return frames.size(); }
+
+    bool MemoryFrameSource::read(Mat &frame)
+    {
+        // Start over after the last frame if looping
+        if(next >= frames.size() && loop)
+            next = 0;
+
+        if(next >= frames.size())
+            return false;
+
+        frame = frames[next++];
+        return true;
+    }
+}
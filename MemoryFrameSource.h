@@ -0,0 +1,54 @@
+#ifndef MEMORYFRAMESOURCE_H
+#define	MEMORYFRAMESOURCE_H
+
+#include "FrameSource.h"
+#include <vector>
+
+using namespace cv;
+
+namespace SniperBot
+{
+    /** MemoryFrameSource Class
+     * Purpose: Supplies frames that are already in memory, so the color detector can be run
+     * on generated or preloaded frames without a camera or a video file.
+     */
+    class MemoryFrameSource : public FrameSource
+    {
+    private:
+        std::vector<Mat> frames;  // the frames to supply
+        size_t next;  // the index of the next frame to supply
+        bool loop;  // tells read to start over after the last frame
+
+    public:
+
+        /** Constructor to create a MemoryFrameSource object
+         * @param loop should read start over after the last frame
+         */
+        MemoryFrameSource(bool loop = false);
+
+        /** Adds a frame to the end of the frames. The frame's pixels are shared, not copied.
+         * @param frame the frame to add
+         */
+        void addFrame(const Mat &frame);
+
+        /** Removes every frame */
+        void clear();
+
+        /** Starts reading from the first frame again */
+        void rewind();
+
+        /** Gets the number of frames
+         * @return the number of frames
+         */
+        size_t getFrameCount();
+
+        /** Hands out the next frame. The frame shares its pixels with the stored frame, so
+         * anything drawn on it is kept.
+         * @param frame a reference to a Mat that will hold the frame
+         * @return true if a frame was read, false after the last frame if not looping
+         */
+        bool read(Mat &frame);
+    };
+}
+
+#endif	/* MEMORYFRAMESOURCE_H */
@@ -0,0 +1,145 @@
+#include "MjpegFrameSource.h"
+#include "Trace.h"
+#include "opencv2/imgproc/imgproc.hpp"
+#include <stdio.h>
+#include <setjmp.h>
+#include <jpeglib.h>
+
+using namespace std;
+
+namespace SniperBot
+{
+    /** JpegState Struct
+     * Purpose: Holds the libjpeg decoder, and where to jump back to when a frame is corrupt,
+     * since libjpeg reports errors by calling a function that must not return.
+     */
+    struct JpegState
+    {
+        jpeg_decompress_struct info;  // the decoder
+        jpeg_error_mgr errors;  // the decoder's error handler
+        jmp_buf failed;  // where decode continues after an error
+    };
+
+    /** Jumps back into decode instead of ending the program, which is what libjpeg does
+     * @param info the decoder
+     */
+    static void jpegFailed(j_common_ptr info)
+    {
+        longjmp(((JpegState *)info->client_data)->failed, 1);
+    }
+
+    /** Keeps libjpeg's warnings about corrupt frames off the console
+     * @param info the decoder
+     */
+    static void jpegMessage(j_common_ptr info) {}
+
+    // Constructor
+    MjpegFrameSource::MjpegFrameSource(FrameSource *source, long width)
+    {
+        this->source = source;
+        this->width = width;
+        this->scale = 1;
+        this->framesDecoded = 0;
+        this->decodeErrors = 0;
+
+        jpeg = new JpegState;
+        jpeg->info.err = jpeg_std_error(&jpeg->errors);
+        jpeg->errors.error_exit = jpegFailed;
+        jpeg->errors.output_message = jpegMessage;
+        jpeg->info.client_data = jpeg;
+        jpeg_create_decompress(&jpeg->info);
+    }
+
+    // Destructor
+    MjpegFrameSource::~MjpegFrameSource()
+    {
+        jpeg_destroy_decompress(&jpeg->info);
+        delete jpeg;
+    }
+
+    // getWidth function
+    long MjpegFrameSource::getWidth() { return width; }
+
+    // setWidth function
+    void MjpegFrameSource::setWidth(long value) { width = value; }
+
+    bool MjpegFrameSource::decode(const uchar *data, size_t size, Mat &frame)
+    {
+        TRACE_SPAN("jpeg decode");
+
+        jpeg_decompress_struct &info = jpeg->info;
+
+        if(setjmp(jpeg->failed))
+        {
+            jpeg_abort_decompress(&info);
+            ++decodeErrors;
+            return false;
+        }
+
+        jpeg_mem_src(&info, (unsigned char *)data, (unsigned long)size);
+        jpeg_read_header(&info, TRUE);
+
+        // Shrink by the most that still leaves the frame at least as wide as it is searched
+        scale = 1;
+        while(width > 0 && scale < MAX_SCALE &&
+                (long)(info.image_width + scale * 2 - 1) / (scale * 2) >= width)
+            scale *= 2;
+        info.scale_num = 1;
+        info.scale_denom = scale;
+
+#ifdef JCS_EXTENSIONS
+        info.out_color_space = JCS_EXT_BGR;  // libjpeg-turbo writes OpenCV's channel order itself
+#else
+        info.out_color_space = JCS_RGB;
+#endif
+        jpeg_start_decompress(&info);
+
+        frame.create(info.output_height, info.output_width, CV_8UC3);
+        while(info.output_scanline < info.output_height)
+        {
+            JSAMPROW row = frame.ptr(info.output_scanline);
+            jpeg_read_scanlines(&info, &row, 1);
+        }
+        jpeg_finish_decompress(&info);
+
+#ifndef JCS_EXTENSIONS
+        cvtColor(frame, frame, COLOR_RGB2BGR);
+#endif
+        ++framesDecoded;
+        return true;
+    }
+
+    bool MjpegFrameSource::read(Mat &frame)
+    {
+        if(!source->read(compressed))
+            return false;
+
+        // A camera that ignored the request for compressed frames hands out decoded ones
+        if(compressed.rows != 1 || compressed.type() != CV_8UC1)
+        {
+            frame = compressed;
+            return true;
+        }
+
+        // The compressed frame can go back to the source as soon as it is decoded
+        bool decoded = decode(compressed.ptr(), compressed.total(), frameBuffer);
+        source->release();
+        if(!decoded)
+            return false;
+
+        frame = frameBuffer;
+        return true;
+    }
+
+    // Only a frame that was passed through is still the source's, and releasing again does nothing
+    void MjpegFrameSource::release() { source->release(); }
+
+    // getScale function
+    int MjpegFrameSource::getScale() { return scale; }
+
+    // getFramesDecoded function
+    long MjpegFrameSource::getFramesDecoded() { return framesDecoded; }
+
+    // getDecodeErrors function
+    long MjpegFrameSource::getDecodeErrors() { return decodeErrors; }
+}
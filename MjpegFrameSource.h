@@ -0,0 +1,94 @@
+#ifndef MJPEGFRAMESOURCE_H
+#define	MJPEGFRAMESOURCE_H
+
+#include "FrameSource.h"
+
+using namespace cv;
+
+namespace SniperBot
+{
+    struct JpegState;
+
+    /** MjpegFrameSource Class
+     * Purpose: Decodes the frames of an MJPEG camera straight to the size the color detector
+     * searches. The compressed frames come from another frame source that hands out the
+     * camera's JPEG buffers as they are, such as a FrameGrabber on a VideoCapture with RGB
+     * conversion turned off. libjpeg can scale the image by 1/2, 1/4 or 1/8 while decoding it,
+     * so most of the pixels the detector would resize away are never decoded. The smallest
+     * scale that is still at least the wanted width is used, and the detector resizes the
+     * rest of the way. Frames that are already decoded are passed through.
+     */
+    class MjpegFrameSource : public FrameSource
+    {
+    public:
+        /** The most the decoder can shrink a frame by */
+        static const int MAX_SCALE = 8;
+
+    private:
+        FrameSource *source;  // supplies the compressed frames
+        long width;  // the width the frames are searched at, 0 to decode at full size
+        Mat compressed;  // the last compressed frame read from the source
+        Mat frameBuffer;  // holds the decoded frame, reused from frame to frame
+        JpegState *jpeg;  // the libjpeg decoder, kept between frames
+        int scale;  // what the last frame was shrunk by while decoding
+        long framesDecoded;  // the number of frames decoded
+        long decodeErrors;  // the number of compressed frames that could not be decoded
+
+    public:
+
+        /** Constructor to create a MjpegFrameSource object
+         * @param source the frame source to read compressed frames from
+         * @param width the width the frames are searched at, 0 to decode at full size
+         */
+        MjpegFrameSource(FrameSource *source, long width = 0);
+
+        /** Destructor. Frees the decoder. */
+        ~MjpegFrameSource();
+
+        /** Gets the width the frames are searched at
+         * @return the width, 0 if the frames are decoded at full size
+         */
+        long getWidth();
+
+        /** Sets the width the frames are searched at. This should match the color detector's.
+         * @param value the width, 0 to decode at full size
+         */
+        void setWidth(long value);
+
+        /** Decodes one compressed frame at the smallest scale that is still at least the width
+         * @param data the JPEG data
+         * @param size the number of bytes of JPEG data
+         * @param frame a reference to a Mat that will hold the BGR frame. It is only
+         * reallocated when the decoded size changes.
+         * @return true if the frame was decoded
+         */
+        bool decode(const uchar *data, size_t size, Mat &frame);
+
+        /** Reads the next compressed frame from the source and decodes it. The frame is the
+         * source's own buffer, so it is only valid until the next call.
+         * @param frame a reference to a Mat that will hold the frame
+         * @return true if a frame was read and decoded
+         */
+        bool read(Mat &frame);
+
+        /** Passes the release on to the source, for frames that were passed through */
+        void release();
+
+        /** Gets what the last frame was shrunk by while decoding
+         * @return 1, 2, 4 or 8
+         */
+        int getScale();
+
+        /** Gets the number of frames decoded
+         * @return the number of frames decoded
+         */
+        long getFramesDecoded();
+
+        /** Gets the number of compressed frames that could not be decoded
+         * @return the number of decode errors
+         */
+        long getDecodeErrors();
+    };
+}
+
+#endif	/* MJPEGFRAMESOURCE_H */
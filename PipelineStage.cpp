@@ -0,0 +1,93 @@
+#include "PipelineStage.h"
+#include "Trace.h"
+#include <chrono>
+
+using namespace std;
+
+namespace SniperBot
+{
+    // Constructor
+    PipelineStage::PipelineStage(const char *name, int idleWait)
+    {
+        this->name = name;
+        this->idleWait = idleWait;
+        this->running = false;
+        this->finished = false;
+        this->passes = 0;
+        this->updates = 0;
+        this->busyTime = 0;
+    }
+
+    // Destructor
+    PipelineStage::~PipelineStage() { stop(); }
+
+    int PipelineStage::start()
+    {
+        if(thread.joinable())
+            return ERROR_ALREADY_RUNNING;
+
+        running = true;
+        thread = std::thread(&PipelineStage::run, this);
+
+        return ERROR_NONE;
+    }
+
+    void PipelineStage::stop()
+    {
+        running = false;
+        if(thread.joinable())
+            thread.join();
+    }
+
+    void PipelineStage::run()
+    {
+        while(running)
+        {
+            int result = runOnce();
+            if(result == STEP_FINISHED)
+                break;
+            if(result == STEP_IDLE)
+                this_thread::sleep_for(chrono::microseconds(idleWait));
+        }
+
+        running = false;
+    }
+
+    int PipelineStage::runOnce()
+    {
+        TRACE_SPAN(name);
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        int result = step();
+
+        ++passes;
+        if(result == STEP_WORKED)
+        {
+            ++updates;
+            busyTime += chrono::duration_cast<chrono::nanoseconds>(
+                chrono::steady_clock::now() - start).count();
+        }
+        else if(result == STEP_FINISHED)
+            finished = true;
+
+        return result;
+    }
+
+    // isRunning function
+    bool PipelineStage::isRunning() { return running && !finished; }
+
+    // isFinished function
+    bool PipelineStage::isFinished() { return finished; }
+
+    // getName function
+    const char *PipelineStage::getName() { return name; }
+
+    // getPasses function
+    long PipelineStage::getPasses() { return passes; }
+
+    // getUpdates function
+    long PipelineStage::getUpdates() { return updates; }
+
+    // getBusyTime function
+    double PipelineStage::getBusyTime() { return busyTime / 1e9; }
+}
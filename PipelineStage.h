@@ -0,0 +1,112 @@
+#ifndef PIPELINESTAGE_H
+#define	PIPELINESTAGE_H
+
+#include <atomic>
+#include <thread>
+
+namespace SniperBot
+{
+    /** PipelineStage Class
+     * Purpose: Runs one stage of the robot's control loop, such as reading the sensors or
+     * searching a frame, over and over on its own thread. Stages hand their results to each
+     * other through SnapshotCells, so a slow stage never holds up a fast one. A stage can also
+     * be run one pass at a time on the caller's thread, which keeps a recorded session in the
+     * same order when it is replayed. Each stage counts its passes, the passes that did
+     * something, and the time spent in them.
+     */
+    class PipelineStage
+    {
+    public:
+        /** Error code for no error */
+        static const int ERROR_NONE = 0;
+
+        /** Error code for if the stage's thread is already running */
+        static const int ERROR_ALREADY_RUNNING = 1;
+
+        /** Result of a pass that did something */
+        static const int STEP_WORKED = 0;
+
+        /** Result of a pass that had nothing to do. The thread sleeps before the next pass. */
+        static const int STEP_IDLE = 1;
+
+        /** Result of a pass after which the stage has nothing more to do, which ends the thread */
+        static const int STEP_FINISHED = 2;
+
+    private:
+        const char *name;  // the name of the stage, for the counters
+        int idleWait;  // microseconds the thread sleeps after a pass with nothing to do
+        std::atomic<bool> running;  // tells the thread to keep going
+        std::atomic<bool> finished;  // set when a pass returned STEP_FINISHED
+        std::atomic<long> passes;  // the number of passes
+        std::atomic<long> updates;  // the number of passes that did something
+        std::atomic<long long> busyTime;  // nanoseconds spent in passes that did something
+        std::thread thread;  // the stage's thread
+
+        /** The stage's thread's loop */
+        void run();
+
+    protected:
+
+        /** Does one pass of the stage's work
+         * @return STEP_WORKED, STEP_IDLE or STEP_FINISHED
+         */
+        virtual int step() = 0;
+
+    public:
+
+        /** Constructor to create a PipelineStage object
+         * @param name the name of the stage. Must be a string literal, since only the pointer is kept.
+         * @param idleWait microseconds the thread sleeps after a pass with nothing to do
+         */
+        PipelineStage(const char *name, int idleWait);
+
+        /** Destructor. The stage must be stopped before the subclass is destroyed. */
+        virtual ~PipelineStage();
+
+        /** Starts running the stage on its own thread
+         * @return an error code if an error occurs
+         */
+        int start();
+
+        /** Stops the stage's thread after its current pass and waits for it to finish */
+        void stop();
+
+        /** Does one pass of the stage on the caller's thread. The stage must not be running on
+         * its own thread.
+         * @return STEP_WORKED, STEP_IDLE or STEP_FINISHED
+         */
+        int runOnce();
+
+        /** Gets if the stage's thread is running and has more to do
+         * @return if the stage is running
+         */
+        bool isRunning();
+
+        /** Gets if a pass returned STEP_FINISHED
+         * @return if the stage has nothing more to do
+         */
+        bool isFinished();
+
+        /** Gets the name of the stage
+         * @return the name of the stage
+         */
+        const char *getName();
+
+        /** Gets the number of passes
+         * @return the number of passes
+         */
+        long getPasses();
+
+        /** Gets the number of passes that did something
+         * @return the number of passes that did something
+         */
+        long getUpdates();
+
+        /** Gets the time spent in passes that did something
+         * @return the time in seconds
+         */
+        double getBusyTime();
+    };
+}
+
+#endif	/* PIPELINESTAGE_H */
@@ -0,0 +1,181 @@
+#include "SerialLink.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <termios.h>
+
+using namespace std;
+
+namespace SniperBot
+{
+    /** Gets the termios speed of a baud rate
+     * @param baud the baud rate
+     * @return the termios speed, B0 if the rate is not supported
+     */
+    static speed_t baudSpeed(int baud)
+    {
+        switch(baud)
+        {
+            case 9600: return B9600;
+            case 19200: return B19200;
+            case 38400: return B38400;
+            case 57600: return B57600;
+            case 115200: return B115200;
+            case 230400: return B230400;
+            case 460800: return B460800;
+            case 500000: return B500000;
+            case 1000000: return B1000000;
+            default: return B0;
+        }
+    }
+
+    // Constructor
+    SerialLink::SerialLink()
+    {
+        this->fd = -1;
+        this->sequence = 0;
+    }
+
+    // Destructor
+    SerialLink::~SerialLink() { close(); }
+
+    int SerialLink::open(const string &device, int baud)
+    {
+        close();
+
+        speed_t speed = baudSpeed(baud);
+        if(speed == B0)
+            return ERROR_CANNOT_OPEN_PORT;
+
+        fd = ::open(device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        if(fd < 0)
+            return ERROR_CANNOT_OPEN_PORT;
+
+        // Raw 8N1 with no flow control, so every byte goes through untouched
+        termios options;
+        if(tcgetattr(fd, &options) < 0)
+        {
+            close();
+            return ERROR_CANNOT_OPEN_PORT;
+        }
+        cfmakeraw(&options);
+        cfsetispeed(&options, speed);
+        cfsetospeed(&options, speed);
+        options.c_cflag |= CLOCAL | CREAD;
+        options.c_cflag &= ~(CSTOPB | CRTSCTS);
+        options.c_cc[VMIN] = 0;
+        options.c_cc[VTIME] = 0;
+        if(tcsetattr(fd, TCSANOW, &options) < 0)
+        {
+            close();
+            return ERROR_CANNOT_OPEN_PORT;
+        }
+        tcflush(fd, TCIOFLUSH);
+
+        return ERROR_NONE;
+    }
+
+    int SerialLink::openPseudoTerminal(string &peer)
+    {
+        close();
+
+        fd = posix_openpt(O_RDWR | O_NOCTTY);
+        if(fd < 0)
+            return ERROR_CANNOT_OPEN_PORT;
+        if(grantpt(fd) < 0 || unlockpt(fd) < 0 || !ptsname(fd))
+        {
+            close();
+            return ERROR_CANNOT_OPEN_PORT;
+        }
+
+        peer = ptsname(fd);
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+        return ERROR_NONE;
+    }
+
+    void SerialLink::close()
+    {
+        if(fd >= 0)
+            ::close(fd);
+        fd = -1;
+    }
+
+    // isOpen function
+    bool SerialLink::isOpen() { return fd >= 0; }
+
+    int SerialLink::send(PacketBuilder &packet)
+    {
+        if(fd < 0)
+            return ERROR_NOT_OPEN;
+
+        const uint8_t *data = packet.finish(sequence++);
+        int size = packet.size();
+        int written = 0;
+
+        while(written < size)
+        {
+            ssize_t result = write(fd, data + written, size - written);
+            if(result < 0)
+            {
+                // The port's buffer is full, so wait for room
+                if(errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    pollfd ready = { fd, POLLOUT, 0 };
+                    ::poll(&ready, 1, -1);
+                    continue;
+                }
+                if(errno == EINTR)
+                    continue;
+                return ERROR_CANNOT_WRITE;
+            }
+            written += (int)result;
+        }
+
+        return ERROR_NONE;
+    }
+
+    int SerialLink::receive(vector<Command> &commands, int timeout)
+    {
+        uint8_t buffer[256];  // the bytes read
+
+        if(fd < 0)
+            return ERROR_NOT_OPEN;
+
+        pollfd ready = { fd, POLLIN, 0 };
+        if(::poll(&ready, 1, timeout) < 0)
+            return errno == EINTR ? ERROR_NONE : ERROR_CANNOT_READ;
+
+        while(true)
+        {
+            ssize_t count = read(fd, buffer, sizeof(buffer));
+            if(count < 0)
+                return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ?
+                    ERROR_NONE : ERROR_CANNOT_READ;
+            if(count == 0)
+                return ERROR_NONE;
+
+            for(ssize_t i = 0; i < count; ++i)
+            {
+                if(!decoder.push(buffer[i]))
+                    continue;
+
+                // Take every command of the packet
+                Command command;
+                int offset = 0;
+                while((offset = readCommand(decoder.getPayload(), decoder.getLength(), offset,
+                        command)) >= 0)
+                    commands.push_back(command);
+            }
+        }
+    }
+
+    // getPacketsReceived function
+    unsigned long SerialLink::getPacketsReceived() { return decoder.getPackets(); }
+
+    // getReceiveErrors function
+    unsigned long SerialLink::getReceiveErrors() { return decoder.getErrors(); }
+}
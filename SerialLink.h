@@ -0,0 +1,96 @@
+#ifndef SERIALLINK_H
+#define	SERIALLINK_H
+
+#include "CommandProtocol.h"
+#include <string>
+#include <vector>
+
+namespace SniperBot
+{
+    /** SerialLink Class
+     * Purpose: Sends and receives command packets over a serial port, such as the UART
+     * between the Raspberry Pi and the Arduino. It can also make a pseudo terminal pair so
+     * both ends of the link can be run on one Linux machine.
+     */
+    class SerialLink
+    {
+    public:
+        /** Error code for no error */
+        static const int ERROR_NONE = 0;
+
+        /** Error code for if the serial port cannot be opened or set up */
+        static const int ERROR_CANNOT_OPEN_PORT = 1;
+
+        /** Error code for if the link is not open */
+        static const int ERROR_NOT_OPEN = 2;
+
+        /** Error code for if a packet cannot be written */
+        static const int ERROR_CANNOT_WRITE = 3;
+
+        /** Error code for if the serial port cannot be read */
+        static const int ERROR_CANNOT_READ = 4;
+
+        /** The default baud rate */
+        static const int DEFAULT_BAUD = 115200;
+
+    private:
+        int fd;  // the serial port, -1 if not open
+        uint8_t sequence;  // the sequence number of the next packet sent
+        PacketDecoder decoder;  // finds the packets in the received bytes
+
+    public:
+
+        /** Constructor to create a SerialLink object that is not open */
+        SerialLink();
+
+        /** Destructor. Closes the link. */
+        ~SerialLink();
+
+        /** Opens a serial port in raw mode
+         * @param device the serial port, such as "/dev/serial0"
+         * @param baud the baud rate
+         * @return an error code if an error occurs
+         */
+        int open(const std::string &device, int baud = DEFAULT_BAUD);
+
+        /** Makes a pseudo terminal pair and opens this end of it
+         * @param peer a reference to a string that will hold the path of the other end, which
+         * can be opened with open
+         * @return an error code if an error occurs
+         */
+        int openPseudoTerminal(std::string &peer);
+
+        /** Closes the link */
+        void close();
+
+        /** Gets if the link is open
+         * @return if the link is open
+         */
+        bool isOpen();
+
+        /** Sends a packet, giving it the next sequence number
+         * @param packet the packet to send
+         * @return an error code if an error occurs
+         */
+        int send(PacketBuilder &packet);
+
+        /** Reads the bytes that have arrived and collects the commands of every whole packet
+         * @param commands a reference to a vector to add the commands to, in the order received
+         * @param timeout milliseconds to wait for bytes, 0 to only check, -1 to wait forever
+         * @return an error code if an error occurs
+         */
+        int receive(std::vector<Command> &commands, int timeout);
+
+        /** Gets the number of good packets received
+         * @return the number of good packets received
+         */
+        unsigned long getPacketsReceived();
+
+        /** Gets the number of received packets thrown away for a bad length or CRC
+         * @return the number of bad packets received
+         */
+        unsigned long getReceiveErrors();
+    };
+}
+
+#endif	/* SERIALLINK_H */
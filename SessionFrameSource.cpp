@@ -0,0 +1,74 @@
+#include "SessionFrameSource.h"
+#include <thread>
+
+using namespace std;
+using namespace cv;
+
+namespace SniperBot
+{
+    // Constructor
+    RecordingFrameSource::RecordingFrameSource(FrameSource *source, SessionRecorder *recorder)
+    {
+        this->source = source;
+        this->recorder = recorder;
+        this->frameTime = 0;
+    }
+
+    bool RecordingFrameSource::read(Mat &frame)
+    {
+        bool bSuccess = source->read(frame);
+
+        // A failed read is recorded as an empty frame so the replay fails at the same point
+        recorder->recordFrame(bSuccess ? frame : Mat());
+        frameTime = recorder->getLastTime();
+
+        return bSuccess;
+    }
+
+    void RecordingFrameSource::release() { source->release(); }
+
+    // getFrameTime function
+    long long RecordingFrameSource::getFrameTime() { return frameTime; }
+
+    // Constructor
+    ReplayFrameSource::ReplayFrameSource(SessionReader *reader, bool realTime)
+    {
+        this->reader = reader;
+        this->position = reader->begin();
+        this->realTime = realTime;
+        this->finished = false;
+        this->firstTime = -1;
+        this->frameTime = 0;
+    }
+
+    bool ReplayFrameSource::read(Mat &frame)
+    {
+        LogRecord record;
+
+        if(!reader->next(position, RECORD_FRAME, record))
+        {
+            finished = true;
+            return false;
+        }
+        frameTime = record.time;
+
+        // Wait until the frame is as far into the replay as it was into the session
+        if(realTime)
+        {
+            if(firstTime < 0)
+            {
+                firstTime = record.time;
+                startTime = chrono::steady_clock::now();
+            }
+            this_thread::sleep_until(startTime + chrono::nanoseconds(record.time - firstTime));
+        }
+
+        return SessionReader::getFrame(record, frame);
+    }
+
+    // isFinished function
+    bool ReplayFrameSource::isFinished() { return finished; }
+
+    // getFrameTime function
+    long long ReplayFrameSource::getFrameTime() { return frameTime; }
+}
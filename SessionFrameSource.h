@@ -0,0 +1,91 @@
+#ifndef SESSIONFRAMESOURCE_H
+#define	SESSIONFRAMESOURCE_H
+
+#include "FrameSource.h"
+#include "SessionLog.h"
+#include <chrono>
+
+using namespace cv;
+
+namespace SniperBot
+{
+    /** RecordingFrameSource Class
+     * Purpose: Passes frames through from another frame source and writes each one to a
+     * session log, including failed reads, so the session can be replayed frame for frame.
+     */
+    class RecordingFrameSource : public FrameSource
+    {
+    private:
+        FrameSource *source;  // the frame source to read from
+        SessionRecorder *recorder;  // the log to write the frames to
+        long long frameTime;  // the logged time of the last frame, in nanoseconds
+
+    public:
+
+        /** Constructor to create a RecordingFrameSource object
+         * @param source the frame source to read from
+         * @param recorder the open log to write the frames to
+         */
+        RecordingFrameSource(FrameSource *source, SessionRecorder *recorder);
+
+        /** Reads a frame from the source and writes it to the log
+         * @param frame a reference to a Mat that will hold the frame
+         * @return true if a frame was read
+         */
+        bool read(Mat &frame);
+
+        /** Passes the release on to the source */
+        void release();
+
+        /** Gets the time the log holds for the last frame, so the main loop can time frames the
+         * same way when the session is replayed
+         * @return the time in nanoseconds since the session started
+         */
+        long long getFrameTime();
+    };
+
+    /** ReplayFrameSource Class
+     * Purpose: Supplies the frames of a session log in the order they were recorded. Frames
+     * are views into the log's memory map, so nothing is copied. Frames can be played as fast
+     * as they are read, or at the pace they were recorded at.
+     */
+    class ReplayFrameSource : public FrameSource
+    {
+    private:
+        SessionReader *reader;  // the log to read frames from
+        size_t position;  // the position of the next frame record
+        bool realTime;  // tells read to wait until each frame's recorded time
+        bool finished;  // set once the last frame has been read
+        long long firstTime;  // the recorded time of the first frame, -1 before the first frame
+        long long frameTime;  // the recorded time of the last frame read, in nanoseconds
+        std::chrono::steady_clock::time_point startTime;  // when the first frame was read
+
+    public:
+
+        /** Constructor to create a ReplayFrameSource object
+         * @param reader the open log to read frames from
+         * @param realTime should frames be played at the pace they were recorded at
+         */
+        ReplayFrameSource(SessionReader *reader, bool realTime = false);
+
+        /** Hands out the next frame of the log. The frame views the log's memory, so it stays
+         * valid while the log is open.
+         * @param frame a reference to a Mat that will hold the frame
+         * @return true if a frame was read, false if the camera read failed when it was
+         * recorded or there are no frames left
+         */
+        bool read(Mat &frame);
+
+        /** Gets if every frame has been read
+         * @return if every frame has been read
+         */
+        bool isFinished();
+
+        /** Gets the recorded time of the last frame read
+         * @return the time in nanoseconds since the session started
+         */
+        long long getFrameTime();
+    };
+}
+
+#endif	/* SESSIONFRAMESOURCE_H */
@@ -0,0 +1,344 @@
+#include "SessionLog.h"
+#include <chrono>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+using namespace cv;
+
+namespace SniperBot
+{
+    static const char LOG_MAGIC[8] = { 'S', 'N', 'I', 'P', 'E', 'R', 'L', 'G' };  // the first bytes of every log
+    static const uint32_t LOG_VERSION = 1;  // the version of the log format
+
+    /** FileHeader Struct
+     * Purpose: The start of a log file.
+     */
+    struct FileHeader
+    {
+        char magic[8];  // LOG_MAGIC
+        uint32_t version;  // LOG_VERSION
+        uint32_t reserved;  // always 0
+    };
+
+    /** RecordHeader Struct
+     * Purpose: The start of each record. The record's data follows, padded to 8 bytes.
+     */
+    struct RecordHeader
+    {
+        uint32_t type;  // the record type, 0 past the last record
+        uint32_t size;  // the size of the data in bytes
+        int64_t time;  // when the record was written, in nanoseconds since the session started
+    };
+
+    /** FrameHeader Struct
+     * Purpose: The start of a frame record's data. The pixels follow with no gaps between rows.
+     */
+    struct FrameHeader
+    {
+        int32_t rows;  // the height of the frame, 0 for a failed camera read
+        int32_t cols;  // the width of the frame
+        int32_t type;  // the OpenCV type of the frame
+        int32_t reserved;  // always 0
+    };
+
+    /** Rounds a record's data size up so the next record starts on 8 bytes
+     * @param size the size of the data
+     * @return the padded size
+     */
+    static size_t padSize(size_t size) { return (size + 7) & ~(size_t)7; }
+
+    /** Gets the current time of a steady clock
+     * @return the time in nanoseconds
+     */
+    static long long steadyNow()
+    {
+        return chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Constructor
+    SessionRecorder::SessionRecorder()
+    {
+        this->fd = -1;
+        this->map = NULL;
+        this->mapSize = 0;
+        this->used = 0;
+        this->startTime = 0;
+        this->lastTime = 0;
+    }
+
+    // Destructor
+    SessionRecorder::~SessionRecorder() { close(); }
+
+    int SessionRecorder::open(const string &fileName)
+    {
+        close();
+
+        fd = ::open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0)
+            return ERROR_CANNOT_OPEN_FILE;
+
+        // Map the first step of the file and write the file header
+        if(ftruncate(fd, GROW_SIZE) < 0)
+        {
+            close();
+            return ERROR_CANNOT_GROW_FILE;
+        }
+        void *m = mmap(NULL, GROW_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(m == MAP_FAILED)
+        {
+            close();
+            return ERROR_CANNOT_GROW_FILE;
+        }
+        map = (uchar *)m;
+        mapSize = GROW_SIZE;
+
+        FileHeader header;
+        memcpy(header.magic, LOG_MAGIC, sizeof(header.magic));
+        header.version = LOG_VERSION;
+        header.reserved = 0;
+        memcpy(map, &header, sizeof(header));
+        used = sizeof(header);
+        startTime = steadyNow();
+        lastTime = 0;
+
+        return ERROR_NONE;
+    }
+
+    void SessionRecorder::close()
+    {
+        if(map)
+            munmap(map, mapSize);
+        if(fd >= 0)
+        {
+            // Cut off the unused end of the last step. If this fails the zeros stay, and the
+            // reader stops at them anyway.
+            int result = ftruncate(fd, used);
+            (void)result;
+            ::close(fd);
+        }
+
+        fd = -1;
+        map = NULL;
+        mapSize = 0;
+        used = 0;
+    }
+
+    // isOpen function
+    bool SessionRecorder::isOpen() { return fd >= 0; }
+
+    // getLastTime function
+    long long SessionRecorder::getLastTime() { return lastTime; }
+
+    uchar *SessionRecorder::reserve(size_t size)
+    {
+        size_t needed = used + sizeof(RecordHeader) + padSize(size);
+
+        if(needed > mapSize)
+        {
+            // Grow by whole steps so growing stays rare
+            size_t newSize = mapSize + GROW_SIZE * ((needed - mapSize) / GROW_SIZE + 1);
+            if(ftruncate(fd, newSize) < 0)
+                return NULL;
+            void *m = mremap(map, mapSize, newSize, MREMAP_MAYMOVE);
+            if(m == MAP_FAILED)
+                return NULL;
+            map = (uchar *)m;
+            mapSize = newSize;
+        }
+
+        return map + used + sizeof(RecordHeader);
+    }
+
+    void SessionRecorder::commit(int type, size_t size)
+    {
+        RecordHeader header;
+        header.type = type;
+        header.size = (uint32_t)size;
+        header.time = lastTime = steadyNow() - startTime;
+
+        memcpy(map + used, &header, sizeof(header));
+        used += sizeof(header) + padSize(size);
+    }
+
+    int SessionRecorder::append(int type, const void *data, size_t size)
+    {
+        if(fd < 0)
+            return ERROR_NOT_OPEN;
+
+        uchar *dst = reserve(size);
+        if(!dst)
+            return ERROR_CANNOT_GROW_FILE;
+
+        memcpy(dst, data, size);
+        commit(type, size);
+
+        return ERROR_NONE;
+    }
+
+    int SessionRecorder::recordFrame(const Mat &frame)
+    {
+        if(fd < 0)
+            return ERROR_NOT_OPEN;
+
+        size_t rowSize = frame.cols * frame.elemSize();  // the bytes of one row of pixels
+        size_t size = sizeof(FrameHeader) + rowSize * frame.rows;
+        uchar *dst = reserve(size);
+        if(!dst)
+            return ERROR_CANNOT_GROW_FILE;
+
+        FrameHeader header;
+        header.rows = frame.rows;
+        header.cols = frame.cols;
+        header.type = frame.type();
+        header.reserved = 0;
+        memcpy(dst, &header, sizeof(header));
+        dst += sizeof(header);
+
+        // Copy the rows one at a time, since the frame may be a view with gaps between rows
+        for(int y = 0; y < frame.rows; ++y, dst += rowSize)
+            memcpy(dst, frame.ptr(y), rowSize);
+
+        commit(RECORD_FRAME, size);
+
+        return ERROR_NONE;
+    }
+
+    int SessionRecorder::recordSensors(bool left, bool right, bool front)
+    {
+        uint8_t states[3] = { left, right, front };
+        return append(RECORD_SENSORS, states, sizeof(states));
+    }
+
+    int SessionRecorder::recordState(int from, int to)
+    {
+        int32_t states[2] = { from, to };
+        return append(RECORD_STATE, states, sizeof(states));
+    }
+
+    int SessionRecorder::recordCommand(int command)
+    {
+        int32_t value = command;
+        return append(RECORD_COMMAND, &value, sizeof(value));
+    }
+
+    // Constructor
+    SessionReader::SessionReader()
+    {
+        this->map = NULL;
+        this->mapSize = 0;
+    }
+
+    // Destructor
+    SessionReader::~SessionReader() { close(); }
+
+    int SessionReader::open(const string &fileName)
+    {
+        close();
+
+        int fd = ::open(fileName.c_str(), O_RDONLY);
+        if(fd < 0)
+            return ERROR_CANNOT_OPEN_FILE;
+
+        struct stat info;
+        if(fstat(fd, &info) < 0 || (size_t)info.st_size < sizeof(FileHeader))
+        {
+            ::close(fd);
+            return ERROR_NOT_A_LOG;
+        }
+
+        // Map copy on write, so frames can be drawn on without changing the file
+        void *m = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if(m == MAP_FAILED)
+            return ERROR_CANNOT_OPEN_FILE;
+        map = (uchar *)m;
+        mapSize = info.st_size;
+        madvise(map, mapSize, MADV_SEQUENTIAL);
+
+        if(memcmp(map, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0 ||
+                ((FileHeader *)map)->version != LOG_VERSION)
+        {
+            close();
+            return ERROR_NOT_A_LOG;
+        }
+
+        return ERROR_NONE;
+    }
+
+    void SessionReader::close()
+    {
+        if(map)
+            munmap(map, mapSize);
+
+        map = NULL;
+        mapSize = 0;
+    }
+
+    // begin function
+    size_t SessionReader::begin() { return sizeof(FileHeader); }
+
+    bool SessionReader::next(size_t &position, int type, LogRecord &record)
+    {
+        while(map && position + sizeof(RecordHeader) <= mapSize)
+        {
+            const RecordHeader *header = (const RecordHeader *)(map + position);
+
+            // A zero type or a record past the end of the file is where the log stops
+            if(header->type == 0 || position + sizeof(RecordHeader) + header->size > mapSize)
+                return false;
+
+            record.type = header->type;
+            record.time = header->time;
+            record.data = map + position + sizeof(RecordHeader);
+            record.size = header->size;
+            position += sizeof(RecordHeader) + padSize(header->size);
+
+            if(type == 0 || record.type == type)
+                return true;
+        }
+
+        return false;
+    }
+
+    bool SessionReader::getFrame(const LogRecord &record, Mat &frame)
+    {
+        const FrameHeader *header = (const FrameHeader *)record.data;
+
+        if(record.size < sizeof(FrameHeader) || header->rows <= 0 || header->cols <= 0)
+            return false;
+
+        // A truncated or corrupt log must not make the Mat reach past the record
+        if((header->type & ~CV_MAT_TYPE_MASK) != 0 || CV_MAT_DEPTH(header->type) > CV_64F)
+            return false;
+        size_t rowSize = (size_t)header->cols * CV_ELEM_SIZE(header->type);  // bytes in a row
+        if((size_t)header->rows > (record.size - sizeof(FrameHeader)) / rowSize)
+            return false;
+
+        frame = Mat(header->rows, header->cols, header->type,
+            (void *)(record.data + sizeof(FrameHeader)));
+        return true;
+    }
+
+    void SessionReader::getSensors(const LogRecord &record, bool &left, bool &right, bool &front)
+    {
+        left = record.data[0] != 0;
+        right = record.data[1] != 0;
+        front = record.data[2] != 0;
+    }
+
+    void SessionReader::getState(const LogRecord &record, int &from, int &to)
+    {
+        const int32_t *states = (const int32_t *)record.data;
+        from = states[0];
+        to = states[1];
+    }
+
+    // getCommand function
+    int SessionReader::getCommand(const LogRecord &record) { return *(const int32_t *)record.data; }
+}
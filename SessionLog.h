@@ -0,0 +1,226 @@
+#ifndef SESSIONLOG_H
+#define	SESSIONLOG_H
+
+#include "opencv2/core/core.hpp"
+#include <string>
+
+using namespace cv;
+
+namespace SniperBot
+{
+    /** Record type for a camera frame */
+    const int RECORD_FRAME = 1;
+
+    /** Record type for the states of the 3 ultrasonic sensors */
+    const int RECORD_SENSORS = 2;
+
+    /** Record type for a change of the robot state */
+    const int RECORD_STATE = 3;
+
+    /** Record type for a command sent to the Arduino */
+    const int RECORD_COMMAND = 4;
+
+    /** LogRecord Struct
+     * Purpose: Points at one record of a session log.
+     */
+    struct LogRecord
+    {
+        int type;  // the record type
+        long long time;  // when the record was written, in nanoseconds since the session started
+        const uchar *data;  // the record's data, inside the log's memory map
+        size_t size;  // the size of the data in bytes
+    };
+
+    /** SessionRecorder Class
+     * Purpose: Writes the inputs and outputs of a robot session to an append-only log file so
+     * the session can be replayed later. The file is memory mapped and grown in large steps,
+     * so writing a record is a copy into memory and the kernel writes the pages to disk in the
+     * background. A record's header is written after its data, and the unused end of the file
+     * is zeros, so a log cut short by a crash still reads back up to its last whole record.
+     */
+    class SessionRecorder
+    {
+    public:
+        /** Error code for no error */
+        static const int ERROR_NONE = 0;
+
+        /** Error code for if the log file cannot be opened */
+        static const int ERROR_CANNOT_OPEN_FILE = 1;
+
+        /** Error code for if the log file cannot be grown */
+        static const int ERROR_CANNOT_GROW_FILE = 2;
+
+        /** Error code for if the recorder is not open */
+        static const int ERROR_NOT_OPEN = 3;
+
+        /** The number of bytes the file is grown by when it is full */
+        static const size_t GROW_SIZE = 64 * 1024 * 1024;
+
+    private:
+        int fd;  // the log file, -1 if not open
+        uchar *map;  // the memory map of the log file
+        size_t mapSize;  // the size of the file and its memory map
+        size_t used;  // the number of bytes written
+        long long startTime;  // when the session started, in nanoseconds of a steady clock
+        long long lastTime;  // the time of the last record written, in nanoseconds since the start
+
+        /** Makes room for a record at the end of the log, growing the file if needed
+         * @param size the size of the record's data
+         * @return a pointer to where the record's data goes, NULL if the file could not grow
+         */
+        uchar *reserve(size_t size);
+
+        /** Writes the header of the record reserved last, which makes it part of the log
+         * @param type the record type
+         * @param size the size of the record's data
+         */
+        void commit(int type, size_t size);
+
+        /** Writes a record
+         * @param type the record type
+         * @param data the record's data
+         * @param size the size of the data in bytes
+         * @return an error code if an error occurs
+         */
+        int append(int type, const void *data, size_t size);
+
+    public:
+
+        /** Constructor to create a SessionRecorder object that is not recording */
+        SessionRecorder();
+
+        /** Destructor. Closes the log. */
+        ~SessionRecorder();
+
+        /** Creates a log file and starts the session clock
+         * @param fileName the file to write. It is replaced if it exists.
+         * @return an error code if an error occurs
+         */
+        int open(const std::string &fileName);
+
+        /** Trims the file to the records written and closes it */
+        void close();
+
+        /** Gets if a log is open
+         * @return if a log is open
+         */
+        bool isOpen();
+
+        /** Gets the time of the last record written, which is what a replay sees for it
+         * @return the time in nanoseconds since the session started
+         */
+        long long getLastTime();
+
+        /** Writes a camera frame
+         * @param frame the frame. An empty frame records a failed camera read.
+         * @return an error code if an error occurs
+         */
+        int recordFrame(const Mat &frame);
+
+        /** Writes the states of the ultrasonic sensors
+         * @param left the state of the left sensor
+         * @param right the state of the right sensor
+         * @param front the state of the front sensor
+         * @return an error code if an error occurs
+         */
+        int recordSensors(bool left, bool right, bool front);
+
+        /** Writes a change of the robot state
+         * @param from the state before the change
+         * @param to the state after the change
+         * @return an error code if an error occurs
+         */
+        int recordState(int from, int to);
+
+        /** Writes a command sent to the Arduino
+         * @param command the command
+         * @return an error code if an error occurs
+         */
+        int recordCommand(int command);
+    };
+
+    /** SessionReader Class
+     * Purpose: Reads a session log written by SessionRecorder. The whole file is memory mapped,
+     * and frames are handed out as views into the map without copying. The map is copy on
+     * write, so drawing on a frame never changes the file. Each kind of record can be read with
+     * its own position, so frames, sensor states and commands can be replayed independently.
+     */
+    class SessionReader
+    {
+    public:
+        /** Error code for no error */
+        static const int ERROR_NONE = 0;
+
+        /** Error code for if the log file cannot be opened */
+        static const int ERROR_CANNOT_OPEN_FILE = 1;
+
+        /** Error code for if the file is not a session log */
+        static const int ERROR_NOT_A_LOG = 2;
+
+    private:
+        uchar *map;  // the memory map of the log file
+        size_t mapSize;  // the size of the file and its memory map
+
+    public:
+
+        /** Constructor to create a SessionReader object that is not reading */
+        SessionReader();
+
+        /** Destructor. Closes the log. */
+        ~SessionReader();
+
+        /** Opens and maps a log file
+         * @param fileName the file to read
+         * @return an error code if an error occurs
+         */
+        int open(const std::string &fileName);
+
+        /** Unmaps the log. Frames read from it can no longer be used. */
+        void close();
+
+        /** Gets the position of the first record
+         * @return the position of the first record
+         */
+        size_t begin();
+
+        /** Finds the next record of a type
+         * @param position a reference to the position to start looking from. It is moved past
+         * the record that was found.
+         * @param type the record type to find, 0 for any type
+         * @param record a reference to a LogRecord that will point at the record
+         * @return true if a record was found, false at the end of the log
+         */
+        bool next(size_t &position, int type, LogRecord &record);
+
+        /** Gets the frame of a frame record
+         * @param record the frame record
+         * @param frame a reference to a Mat that will view the frame's pixels in the log
+         * @return true if the record holds a frame, false if it records a failed camera read
+         * or its frame does not fit in the record
+         */
+        static bool getFrame(const LogRecord &record, Mat &frame);
+
+        /** Gets the sensor states of a sensor record
+         * @param record the sensor record
+         * @param left a reference to a variable to hold the state of the left sensor
+         * @param right a reference to a variable to hold the state of the right sensor
+         * @param front a reference to a variable to hold the state of the front sensor
+         */
+        static void getSensors(const LogRecord &record, bool &left, bool &right, bool &front);
+
+        /** Gets the states of a state change record
+         * @param record the state change record
+         * @param from a reference to a variable to hold the state before the change
+         * @param to a reference to a variable to hold the state after the change
+         */
+        static void getState(const LogRecord &record, int &from, int &to);
+
+        /** Gets the command of a command record
+         * @param record the command record
+         * @return the command
+         */
+        static int getCommand(const LogRecord &record);
+    };
+}
+
+#endif	/* SESSIONLOG_H */
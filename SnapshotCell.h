@@ -0,0 +1,88 @@
+#ifndef SNAPSHOTCELL_H
+#define	SNAPSHOTCELL_H
+
+#include <atomic>
+
+namespace SniperBot
+{
+    /** SnapshotCell Class
+     * Purpose: Hands the newest value from one thread to another without a lock. The cell
+     * works like FrameGrabber's ring: one slot is written by the writer, one holds the newest
+     * value, and one is held by the reader, and the slots are swapped with a single atomic
+     * exchange. The reader always gets the newest value, and a value that is replaced before
+     * it is read is counted as overwritten. Only one thread may publish and only one may take.
+     */
+    template <typename T>
+    class SnapshotCell
+    {
+    public:
+        /** The number of slots in the cell */
+        static const int NUM_SLOTS = 3;
+
+    private:
+
+        static const int NEW_VALUE = 4;  // flag set in the published slot index when it holds an unread value
+        static const int SLOT_MASK = 3;  // mask for the slot index in the published slot index
+
+        T slots[NUM_SLOTS];  // the values
+        int writeSlot;  // the slot the writer fills next, only used by the writer
+        int readSlot;  // the slot the reader holds, only used by the reader
+        std::atomic<int> publishedSlot;  // the slot holding the newest value, with the NEW_VALUE flag
+        std::atomic<long> published;  // the number of values published
+        std::atomic<long> overwritten;  // the number of values replaced before they were taken
+
+    public:
+
+        /** Constructor to create an empty SnapshotCell object */
+        SnapshotCell()
+        {
+            this->writeSlot = 1;
+            this->readSlot = 2;
+            this->publishedSlot = 0;
+            this->published = 0;
+            this->overwritten = 0;
+        }
+
+        /** Makes a value the newest one. This never blocks.
+         * @param value the value
+         */
+        void publish(const T &value)
+        {
+            slots[writeSlot] = value;
+
+            // Take back the slot the value replaced. If it was never taken, it is overwritten.
+            int previous = publishedSlot.exchange(writeSlot | NEW_VALUE);
+            if(previous & NEW_VALUE)
+                ++overwritten;
+            writeSlot = previous & SLOT_MASK;
+            ++published;
+        }
+
+        /** Takes the newest value if it is newer than the last one taken. This never blocks.
+         * @param value a reference to a variable to hold the value
+         * @return true if there was a new value
+         */
+        bool take(T &value)
+        {
+            if(!(publishedSlot.load() & NEW_VALUE))
+                return false;
+
+            readSlot = publishedSlot.exchange(readSlot) & SLOT_MASK;
+            value = slots[readSlot];
+
+            return true;
+        }
+
+        /** Gets the number of values published
+         * @return the number of values published
+         */
+        long getPublished() { return published; }
+
+        /** Gets the number of values that were replaced by a newer one before they were taken
+         * @return the number of overwritten values
+         */
+        long getOverwritten() { return overwritten; }
+    };
+}
+
+#endif	/* SNAPSHOTCELL_H */
@@ -1,4 +1,29 @@
+#include <Arduino.h>
 #include <Servo.h>
+#include "CommandProtocol.h"
+
+using namespace SniperBot;
+
+// Function prototypes, so the sketch also builds as plain C++ against the simulated core in sim/
+void startRanging();
+void setCollisionDistance(int cm);
+int getDistance(byte sensor);
+void triggerSensors();
+void finishRanging();
+int medianOf(const int *values);
+void setCameraTarget(long yaw, long pitch);
+void updateCamera();
+void stepCameraAxis(byte axis);
+void handleCommand();
+void runQueuedCommands();
+void pollSerialCommands();
+void runCommand(const Command &command);
+byte getCommand();
+void stop();
+void rotateLeft();
+void rotateRight();
+void moveForward(float arc);
+void moveBackwards(float arc);
 
 // Robot Commands
 byte const STOP = 0;
@@ -39,6 +64,17 @@ byte pinRightUSData = 31;  /** pin for the right ultrasonic sensor data */
 byte pinFrontUSData = 32;  /** pin for the front ultrasonic sensor data */
 byte pinLaser = 9;  /** pin for controlling the laser */
 bool isFiring = false;  /** flag for if the robot is currently firing the laser */
+bool laserOn = false;  /** is the laser on right now, while it flashes */
+unsigned long laserToggleTime = 0;  /** millis when the laser last turned on or off */
+byte const LASER_FLASH = 20;  /** milliseconds the laser stays on, then off, while firing */
+PacketDecoder commandDecoder;  /** finds the command packets sent by the Raspberry Pi on Serial1 */
+byte replySequence = 0;  /** the sequence number of the next packet sent to the Raspberry Pi */
+byte const QUEUE_SIZE = 32;  /** number of commands the command queue holds. must be a power of 2. */
+volatile byte commandQueue[QUEUE_SIZE];  /** commands latched by the interrupt, waiting for loop to run them */
+volatile byte queueHead = 0;  /** number of commands added to the queue. only changed by the interrupt. */
+volatile byte queueTail = 0;  /** number of commands taken from the queue. only changed by loop. */
+volatile unsigned int queueOverflows = 0;  /** number of commands dropped because the queue was full */
+unsigned int reportedOverflows = 0;  /** the overflow count last printed to the serial monitor */
 
 // Servo variables
 byte pinLeftWheel = 7;  /** pin for the left wheel servo */
@@ -49,19 +85,51 @@ Servo leftWheel;  /** used to control the left wheel */
 Servo rightWheel;  /** used to control the right wheel */
 Servo cameraPitch;  /** used to control the camera pitch */
 Servo cameraYaw;  /** user to control the camera yaw */
-byte currentPitchAngle;  /** stores the current pitch angle of the camera */
-byte currentYawAngle;  /** stores the current yaw angle of the camera */
+volatile byte currentPitchAngle;  /** stores the angle last written to the camera pitch servo */
+volatile byte currentYawAngle;  /** stores the angle last written to the camera yaw servo */
 byte cameraSpeed;  /** stores how many degrees the camera servos step each time they are moved */
 
+// Camera motion variables
+byte const YAW_AXIS = 0;  /** index of the yaw servo in the camera arrays */
+byte const PITCH_AXIS = 1;  /** index of the pitch servo in the camera arrays */
+byte const CAMERA_PERIOD = 5;  /** milliseconds between camera servo updates */
+int const CAMERA_MAX_SPEED = 150;  /** hundredths of a degree the camera can turn each update. 300 degrees a second, about what the servos do with the camera on them. */
+int const CAMERA_ACCEL = 10;  /** hundredths of a degree the camera's speed can change each update. 4000 degrees a second squared. */
+volatile int cameraTarget[2];  /** the angle each camera servo is headed to in hundredths of a degree */
+int cameraPosition[2];  /** the angle of each camera servo along its profile in hundredths of a degree. only used by the timer interrupt. */
+int cameraVelocity[2];  /** hundredths of a degree each camera servo turned in the last update. only used by the timer interrupt. */
+byte cameraTicks = 0;  /** milliseconds since the last camera update */
+
 // Ultrasonic sensor variables
-byte pinLeftUS = 22;  /** data pin for the left ultrasonic sensor */
+byte pinLeftUS = 50;  /** data pin for the left ultrasonic sensor. moved from pin 22, which has no pin change interrupt. */
 byte pinRightUS = 51;  /** data pin for the right ultrasonic sensor */
 byte pinFrontUS = 53;  /** data pin for the front ultrasonic sensor */
+byte const NUM_SENSORS = 3;  /** number of ultrasonic sensors */
+byte const RANGE_PERIOD = 25;  /** milliseconds between pings. longer than the sensor's 18.5 ms pulse when nothing echoes. */
+unsigned long const ECHO_TIMEOUT = 18000;  /** microseconds an echo can last before it counts as no object */
+byte const FILTER_SIZE = 3;  /** number of readings in each sensor's median filter. an object sets the data pin within 65 ms. */
+int const NO_OBJECT = 999;  /** distance used when a sensor finds no object */
+byte const ECHO_IDLE = 0;  /** the sensor is not being pinged */
+byte const ECHO_WAIT_RISE = 1;  /** the sensor was pinged and the echo pulse has not started */
+byte const ECHO_WAIT_FALL = 2;  /** the echo pulse has started */
+byte const ECHO_DONE = 3;  /** the echo pulse has ended */
+byte usPins[NUM_SENSORS];  /** data pins of the left, right and front sensors */
+byte usDataPins[NUM_SENSORS];  /** pins that tell the Raspberry Pi about an object for each sensor */
+volatile byte echoState[NUM_SENSORS];  /** where each sensor's ping is, one of the ECHO_ values */
+volatile bool echoLevel[NUM_SENSORS];  /** the level of each sensor pin the pin change interrupt last saw */
+volatile unsigned long echoStart[NUM_SENSORS];  /** micros when each echo pulse started */
+volatile unsigned long echoLength[NUM_SENSORS];  /** microseconds each echo pulse lasted */
+int readings[NUM_SENSORS][FILTER_SIZE];  /** the last readings of each sensor in cm. only used by the timer interrupt. */
+byte readingIndex = 0;  /** where the next reading goes in readings */
+volatile int filteredDistance[NUM_SENSORS];  /** the median of each sensor's readings in cm */
+volatile int collisionDistance = 16;  /** an object this many cm away or closer sets the sensor's data pin high */
+byte rangeTicks = 0;  /** milliseconds since the last ping */
 
 /** The first function to run when the program starts. Used for initial setup. */
 void setup()
 {
-  Serial.begin(9600);  // Start serial communication. this is used for debugging.
+  Serial.begin(115200);  // Start serial communication. this is used for debugging. fast enough to print every command.
+  Serial1.begin(115200);  // Start the command link with the Raspberry Pi
   
   noInterrupts();  // disable interrupts
   
@@ -78,6 +146,8 @@ void setup()
   pinMode(pinRightUSData, OUTPUT);
   pinMode(pinFrontUSData, OUTPUT);
   pinMode(pinLaser, OUTPUT);
+  setCollisionDistance(16);
+  startRanging();
   
   // Setup servos
   leftWheel.attach(pinLeftWheel);
@@ -90,6 +160,12 @@ void setup()
   currentYawAngle = YAW_CENTER_ANGLE;  // set the current camera yaw angle to center
   cameraPitch.write(currentPitchAngle);  // center the camera pitch servo
   cameraYaw.write(currentYawAngle);  // center the camera yaw servo
+  cameraPosition[YAW_AXIS] = YAW_CENTER_ANGLE * 100;
+  cameraPosition[PITCH_AXIS] = PITCH_CENTER_ANGLE * 100;
+  cameraVelocity[YAW_AXIS] = 0;
+  cameraVelocity[PITCH_AXIS] = 0;
+  cameraTarget[YAW_AXIS] = cameraPosition[YAW_AXIS];
+  cameraTarget[PITCH_AXIS] = cameraPosition[PITCH_AXIS];
   cameraSpeed = 2;  // set the camera to move in increments of 2 degrees
   
   interrupts();  // enable all interrupts
@@ -98,108 +174,285 @@ void setup()
 /** Runs after the setup function. This function executes an infinite number of times. */
 void loop()
 {
-  moveForward(0);
-  return;
+  runQueuedCommands();
+  pollSerialCommands();
   
-  // Check for collisions
-  checkCollisions(16);
+  // If the robot is currently firing the laser, flash it on and off. The flash is timed with
+  // millis so queued commands still run while the laser is on.
+  if((isFiring || laserOn) && millis() - laserToggleTime >= LASER_FLASH)
+  {
+    laserToggleTime = millis();
+    laserOn = isFiring && !laserOn;
+    digitalWrite(pinLaser, laserOn ? HIGH : LOW);
+    if(laserOn)
+      tone(10, 100);
+    else
+      noTone(10);
+  }
+}
+
+/** Starts pinging the 3 ultrasonic sensors in the background. Timer 4 interrupts every millisecond
+    to ping the sensors every RANGE_PERIOD milliseconds, and a pin change interrupt times the echoes,
+    so loop never waits on a sensor.
+*/
+void startRanging()
+{
+  usPins[0] = pinLeftUS;
+  usPins[1] = pinRightUS;
+  usPins[2] = pinFrontUS;
+  usDataPins[0] = pinLeftUSData;
+  usDataPins[1] = pinRightUSData;
+  usDataPins[2] = pinFrontUSData;
   
-  // If the robot is currently firing the laser...
-  if(isFiring)
+  // Start with no objects seen
+  for(byte i = 0; i < NUM_SENSORS; ++i)
   {
-    // flash the laser on and off 1 time
-    digitalWrite(pinLaser, HIGH);
-    tone(10, 100);
-    delay(20);
-    digitalWrite(pinLaser, LOW);
-    noTone(10);
-    delay(20);
+    echoState[i] = ECHO_IDLE;
+    echoLevel[i] = LOW;
+    filteredDistance[i] = NO_OBJECT;
+    for(byte r = 0; r < FILTER_SIZE; ++r)
+      readings[i][r] = NO_OBJECT;
+    pinMode(usPins[i], INPUT);
   }
+  
+  // Pins 50 to 53 share pin change interrupt 0
+  for(byte i = 0; i < NUM_SENSORS; ++i)
+    PCMSK0 |= _BV(digitalPinToPCMSKbit(usPins[i]));
+  PCICR |= _BV(PCIE0);
+  
+  // Timer 4 counts to 250 at 16 MHz / 64, which is once every millisecond
+  TCCR4A = 0;
+  TCCR4B = _BV(WGM42) | _BV(CS41) | _BV(CS40);
+  OCR4A = 249;
+  TIMSK4 |= _BV(OCIE4A);
 }
 
-/** Checks the 3 ultrasonic sensors for objects within the provided distance. This function
-    communicates the object detection data through 3 IO pins, 1 for each sensor. If an object
-    is detected, the pin is set high. If an object is not detected, the pin is set low. To avoid
-    accidental object detection, each sensor checks for an object 3 times. If an object is detected
-    all 3 times, then the data pin is set high, otherwise, it is set low.
+/** Sets how close an object has to be for a sensor's data pin to be set high.
     @param cm the maximum distance (in centimeters) that an object can be to set the data pin high
 */
-void checkCollisions(int cm)
+void setCollisionDistance(int cm)
 {
-  int numChecks = 3;  // number of times each sensor is checked for an object
-  int count = 0;  // the count of how many times an object was detected
-  
-  // Check left sensor
-  for(int i = 0; i < numChecks; ++i)
-    // If an object is detected...
-    if(getUltrasonicDistance(pinLeftUS) <= cm)
-      ++count;
-  // if all checks had an object detected...
-  if(count == numChecks)
-    digitalWrite(pinLeftUSData, HIGH);
-  else
-    digitalWrite(pinLeftUSData, LOW);
-  
-  // Check right sensor
-  count = 0;
-  for(int i = 0; i < numChecks; ++i)
-    // If an object is detected...
-    if(getUltrasonicDistance(pinRightUS) <= cm)
-      ++count;
-  // if all checks had an object detected...
-  if(count == numChecks)
-    digitalWrite(pinRightUSData, HIGH);
-  else
-    digitalWrite(pinRightUSData, LOW);
-  
-  // Check front sensor
-  count = 0;
-  for(int i = 0; i < numChecks; ++i)
-    // If an object is detected...
-    if(getUltrasonicDistance(pinFrontUS) <= cm)
-      ++count;
-  // if all checks had an object detected...
-  if(count == numChecks)
-    digitalWrite(pinFrontUSData, HIGH);
-  else
-    digitalWrite(pinFrontUSData, LOW);
+  collisionDistance = cm;
+}
+
+/** Gets the filtered distance of the nearest object seen by a sensor. This does not wait on the
+    sensor.
+    @param sensor the sensor, 0 for left, 1 for right and 2 for front
+    @return the median of the sensor's last readings in centimeters, NO_OBJECT if nothing was seen
+*/
+int getDistance(byte sensor)
+{
+  noInterrupts();
+  int distance = filteredDistance[sensor];  // two bytes, so read it with the interrupts off
+  interrupts();
+  return distance;
 }
 
-/** Gets the distance of an object using an ultrasonic sensor. This function calculates the distance
-    in centimeters.
-    @param pin the data pin of the ultrasonic sensor the perform an object detection
-    @return the distance of an object in centimeters
+/** Runs every millisecond. Every CAMERA_PERIOD milliseconds it moves the camera servos along
+    their profiles, and every RANGE_PERIOD milliseconds it finishes the last ping and pings the
+    sensors again.
 */
-int getUltrasonicDistance(int pin)
+ISR(TIMER4_COMPA_vect)
 {
-  // Sent an ultrasonic tone
-  pinMode(pin, OUTPUT);
-  digitalWrite(pin, LOW);
+  if(++cameraTicks >= CAMERA_PERIOD)
+  {
+    cameraTicks = 0;
+    updateCamera();
+  }
+  
+  if(++rangeTicks >= RANGE_PERIOD)
+  {
+    rangeTicks = 0;
+    finishRanging();
+    triggerSensors();
+  }
+}
+
+/** Runs when a sensor pin changes. Times the echo pulse of each sensor that is being pinged. */
+ISR(PCINT0_vect)
+{
+  unsigned long now = micros();  // when the pin changed
+  
+  for(byte i = 0; i < NUM_SENSORS; ++i)
+  {
+    bool level = digitalRead(usPins[i]);
+    
+    // Only look at the sensors whose pin changed
+    if(level == echoLevel[i])
+      continue;
+    echoLevel[i] = level;
+    
+    if(level && echoState[i] == ECHO_WAIT_RISE)
+    {
+      echoStart[i] = now;
+      echoState[i] = ECHO_WAIT_FALL;
+    }
+    else if(!level && echoState[i] == ECHO_WAIT_FALL)
+    {
+      echoLength[i] = now - echoStart[i];
+      echoState[i] = ECHO_DONE;
+    }
+  }
+}
+
+/** Turns the echo of each sensor's last ping into a distance, adds it to the sensor's median
+    filter, and sets the sensor's data pin high if the filtered distance is within
+    collisionDistance. A single bad reading does not change the data pin.
+*/
+void finishRanging()
+{
+  for(byte i = 0; i < NUM_SENSORS; ++i)
+  {
+    int cm = NO_OBJECT;  // what this ping found
+    
+    // A sensor that never echoed, or echoed for too long, found nothing
+    if(echoState[i] == ECHO_DONE && echoLength[i] < ECHO_TIMEOUT)
+      cm = echoLength[i] / 29 / 2;
+    readings[i][readingIndex] = cm;
+    
+    filteredDistance[i] = medianOf(readings[i]);
+    digitalWrite(usDataPins[i], filteredDistance[i] <= collisionDistance ? HIGH : LOW);
+  }
+  
+  readingIndex = (readingIndex + 1) % FILTER_SIZE;
+}
+
+/** Pings every sensor that is not still sending an echo pulse. The sensors are pinged together,
+    and each pin then goes back to being an input for its echo.
+*/
+void triggerSensors()
+{
+  bool ready[NUM_SENSORS];  // the sensors that can be pinged
+  
+  for(byte i = 0; i < NUM_SENSORS; ++i)
+  {
+    ready[i] = echoState[i] != ECHO_WAIT_FALL || digitalRead(usPins[i]) == LOW;
+    if(!ready[i])
+      continue;
+    echoState[i] = ECHO_IDLE;  // the pin change interrupt ignores the ping itself
+    pinMode(usPins[i], OUTPUT);
+    digitalWrite(usPins[i], LOW);
+  }
   delayMicroseconds(2);
-  digitalWrite(pin, HIGH);
+  for(byte i = 0; i < NUM_SENSORS; ++i)
+    if(ready[i])
+      digitalWrite(usPins[i], HIGH);
   delayMicroseconds(5);
-  digitalWrite(pin, LOW);
+  for(byte i = 0; i < NUM_SENSORS; ++i)
+  {
+    if(!ready[i])
+      continue;
+    digitalWrite(usPins[i], LOW);
+    pinMode(usPins[i], INPUT);
+    echoLevel[i] = LOW;
+    echoState[i] = ECHO_WAIT_RISE;
+  }
+}
+
+/** Gets the median of a sensor's readings
+    @param values the FILTER_SIZE readings
+    @return the median reading
+*/
+int medianOf(const int *values)
+{
+  int sorted[FILTER_SIZE];  // the readings in order
+  
+  // Insertion sort, which is quick for a handful of values
+  for(byte i = 0; i < FILTER_SIZE; ++i)
+  {
+    byte j = i;
+    for(; j > 0 && sorted[j - 1] > values[i]; --j)
+      sorted[j] = sorted[j - 1];
+    sorted[j] = values[i];
+  }
   
-  // Listen for the ultrasonic tone echo
-  pinMode(pin, INPUT);
-  int duration = pulseIn(pin, HIGH);
-  //inches = duration / 74 / 2;
-  return duration / 29 / 2;  // calculate and return the distance of an object
+  return sorted[FILTER_SIZE / 2];
 }
 
-/** This function is executed when interrupt 1 is triggered. This handles commands sent to the Arduino
-    when the trigger pin is set high.
+/** This function is executed when interrupt 1 is triggered. It only latches the command sent to the
+    Arduino into the command queue, and loop runs the command later. The data pins are read up to
+    about 35 us after the trigger rises, when the handler waits behind another interrupt, so the Pi
+    must hold each command that long before the next one. The Pi holds the trigger for 40 us and
+    starts commands at least 50 us apart.
 */
 void handleCommand()
 {
   byte command = getCommand();  // Get the command that was sent to the Arduino
   
-  // Print the command to the serial monitor for debugging
-  Serial.print("Command: ");
-  Serial.println(command);
+  // If loop has not caught up, drop the command and count it
+  if((byte)(queueHead - queueTail) >= QUEUE_SIZE)
+  {
+    ++queueOverflows;
+    return;
+  }
+  
+  // Store the command before moving the head, so loop never sees an unwritten slot
+  commandQueue[queueHead & (QUEUE_SIZE - 1)] = command;
+  ++queueHead;
+}
+
+/** Runs the commands the interrupt has latched, oldest first, and prints the overflow count
+    to the serial monitor when it changes.
+*/
+void runQueuedCommands()
+{
+  // queueHead is one byte, so it is read in one instruction even while the interrupt can change it
+  while(queueTail != queueHead)
+  {
+    Command command;  // the command that was sent to the Arduino
+    command.opcode = commandQueue[queueTail & (QUEUE_SIZE - 1)];
+    command.a = 0;
+    command.b = 0;
+    ++queueTail;
+    
+    // Print the command to the serial monitor for debugging
+    Serial.print("Command: ");
+    Serial.println(command.opcode);
+    
+    runCommand(command);
+  }
+  
+  // The count is two bytes, so read it with the interrupt off
+  noInterrupts();
+  unsigned int overflows = queueOverflows;
+  interrupts();
+  if(overflows != reportedOverflows)
+  {
+    reportedOverflows = overflows;
+    Serial.print("Command overflows: ");
+    Serial.println(overflows);
+  }
+}
+
+/** Reads the bytes that have arrived on Serial1 and runs the commands of every whole packet.
+    Packets with a bad CRC are skipped by the decoder.
+*/
+void pollSerialCommands()
+{
+  while(Serial1.available() > 0)
+  {
+    // If the byte did not finish a good packet, keep reading
+    if(!commandDecoder.push(Serial1.read()))
+      continue;
+    
+    // Run every command in the packet in order
+    Command command;
+    int offset = 0;
+    while((offset = readCommand(commandDecoder.getPayload(), commandDecoder.getLength(), offset,
+        command)) >= 0)
+      runCommand(command);
+  }
+}
+
+/** Runs a command from either the 4 bit data pins or the serial link.
+    @param command the command and its arguments
+*/
+void runCommand(const Command &command)
+{
+  PacketBuilder reply;  // the answer to a ping
   
   // Determine which command was received
-  switch(command)
+  switch(command.opcode)
   {
     case STOP:  // Stop the robot's wheels from moving
       stop();
@@ -217,40 +470,16 @@ void handleCommand()
       rotateRight();
       break;
     case LOOK_LEFT:  // turn the camera to the left
-      // Make sure the camera doesn't turn past it's max and min angle
-      if(currentYawAngle + cameraSpeed >= MAX_YAW)
-        currentYawAngle = MAX_YAW;
-      else
-        currentYawAngle += cameraSpeed;
-      cameraYaw.write(currentYawAngle);
-      delay(50);
+      setCameraTarget(cameraTarget[YAW_AXIS] + cameraSpeed * 100L, cameraTarget[PITCH_AXIS]);
       break;
     case LOOK_RIGHT:  // turn the camera to the right
-      // Make sure the camera doesn't turn past it's max and min angle
-      if(currentYawAngle - cameraSpeed <= MIN_YAW)
-        currentYawAngle = MIN_YAW;
-      else
-        currentYawAngle -= cameraSpeed;
-      cameraYaw.write(currentYawAngle);
-      delay(50);
+      setCameraTarget(cameraTarget[YAW_AXIS] - cameraSpeed * 100L, cameraTarget[PITCH_AXIS]);
       break;
     case LOOK_UP:  // turn the camera up
-      // Make sure the camera doesn't turn past it's max and min angle
-      if(currentPitchAngle + cameraSpeed >= MAX_PITCH)
-        currentPitchAngle = MAX_PITCH;
-      else
-        currentPitchAngle += cameraSpeed;
-      cameraPitch.write(currentPitchAngle);
-      delay(50);
+      setCameraTarget(cameraTarget[YAW_AXIS], cameraTarget[PITCH_AXIS] + cameraSpeed * 100L);
       break;
     case LOOK_DOWN:  // turn the camera down
-      // Make sure the camera doesn't turn past it's max and min angle
-      if(currentPitchAngle - cameraSpeed <= MIN_PITCH)
-        currentPitchAngle = MIN_PITCH;
-      else
-        currentPitchAngle -= cameraSpeed;
-      cameraPitch.write(currentPitchAngle);
-      delay(50);
+      setCameraTarget(cameraTarget[YAW_AXIS], cameraTarget[PITCH_AXIS] - cameraSpeed * 100L);
       break;
     case START_FIRING:  // start firing the laser
       isFiring = true;
@@ -259,12 +488,105 @@ void handleCommand()
       isFiring = false;
       break;
     case CENTER_CAMERA:  // move the camera to its center position
-      currentPitchAngle = PITCH_CENTER_ANGLE;
-      currentYawAngle = YAW_CENTER_ANGLE;
-      cameraPitch.write(currentPitchAngle);
-      cameraYaw.write(currentYawAngle);
+      setCameraTarget(YAW_CENTER_ANGLE * 100L, PITCH_CENTER_ANGLE * 100L);
+      break;
+    case OP_SET_CAMERA:  // point the camera at an angle, given in tenths of a degree
+      setCameraTarget(command.a * 10L, command.b * 10L);
+      break;
+    case OP_MOVE_CAMERA:  // turn the camera from where it is headed, given in tenths of a degree
+      setCameraTarget(cameraTarget[YAW_AXIS] + command.a * 10L,
+        cameraTarget[PITCH_AXIS] + command.b * 10L);
+      break;
+    case OP_DRIVE:  // drive along an arc, the speed's sign picks forward or backwards
+      speedScale = abs(command.b) / 100.0;
+      if(command.b > 0)
+        moveForward(command.a / 100.0);
+      else if(command.b < 0)
+        moveBackwards(command.a / 100.0);
+      else
+        stop();
+      break;
+    case OP_SET_SPEED_SCALE:  // change the speed of the wheels
+      speedScale = constrain(command.a, 0, 100) / 100.0;
       break;
+    case OP_PING:  // answer with the same token so the Raspberry Pi can time the link
+      reply.add(OP_PONG, command.a);
+      Serial1.write(reply.finish(replySequence++), reply.size());
+      break;
+  }
+}
+
+/** Sets the angle the camera turns to. The servos get there on their own from the timer
+    interrupt, so this returns right away, and a new angle can be set before the last is reached.
+    @param yaw the yaw angle in hundredths of a degree, kept between MIN_YAW and MAX_YAW
+    @param pitch the pitch angle in hundredths of a degree, kept between MIN_PITCH and MAX_PITCH
+*/
+void setCameraTarget(long yaw, long pitch)
+{
+  yaw = constrain(yaw, MIN_YAW * 100L, MAX_YAW * 100L);
+  pitch = constrain(pitch, MIN_PITCH * 100L, MAX_PITCH * 100L);
+  
+  // The timer interrupt reads these, so change them with the interrupts off
+  noInterrupts();
+  cameraTarget[YAW_AXIS] = yaw;
+  cameraTarget[PITCH_AXIS] = pitch;
+  interrupts();
+}
+
+/** Moves both camera servos one update along their profiles, and writes a servo when its
+    angle reaches a new degree
+*/
+void updateCamera()
+{
+  stepCameraAxis(YAW_AXIS);
+  stepCameraAxis(PITCH_AXIS);
+  
+  byte yaw = (cameraPosition[YAW_AXIS] + 50) / 100;  // round to the nearest degree
+  if(yaw != currentYawAngle)
+  {
+    currentYawAngle = yaw;
+    cameraYaw.write(yaw);
   }
+  
+  byte pitch = (cameraPosition[PITCH_AXIS] + 50) / 100;  // round to the nearest degree
+  if(pitch != currentPitchAngle)
+  {
+    currentPitchAngle = pitch;
+    cameraPitch.write(pitch);
+  }
+}
+
+/** Moves one camera servo one update along a trapezoid velocity profile. The servo speeds up by
+    CAMERA_ACCEL each update to at most CAMERA_MAX_SPEED, and slows down in time to stop at its
+    target. If the target moves behind it, the servo slows down and turns around.
+    @param axis YAW_AXIS or PITCH_AXIS
+*/
+void stepCameraAxis(byte axis)
+{
+  int remaining = cameraTarget[axis] - cameraPosition[axis];  // how far the servo has to go
+  int distance = abs(remaining);
+  int speed = remaining >= 0 ? cameraVelocity[axis] : -cameraVelocity[axis];  // speed toward the target, negative if moving away
+  
+  // Close enough and slow enough to stop on the target
+  if(distance <= CAMERA_ACCEL && abs(speed) <= CAMERA_ACCEL)
+  {
+    cameraPosition[axis] = cameraTarget[axis];
+    cameraVelocity[axis] = 0;
+    return;
+  }
+  
+  // Slow down if stopping takes all the distance left, otherwise speed up toward the target,
+  // which also slows down a servo that is moving away
+  if(speed > 0 && (long)speed * (speed + CAMERA_ACCEL) >= 2L * CAMERA_ACCEL * distance)
+    speed -= CAMERA_ACCEL;
+  else
+    speed = min(speed + CAMERA_ACCEL, CAMERA_MAX_SPEED);
+  
+  // Don't pass the target
+  speed = min(speed, distance);
+  
+  cameraVelocity[axis] = remaining >= 0 ? speed : -speed;
+  cameraPosition[axis] += cameraVelocity[axis];
 }
 
 /** This function gets the command sent to the Arduino by reading the data pins as binary digits
@@ -0,0 +1,117 @@
+#include "Trace.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+namespace SniperBot
+{
+    /** ThreadRing Struct
+     * Purpose: Holds the events recorded by one thread.
+     */
+    struct ThreadRing
+    {
+        TraceEvent events[Tracer::RING_SIZE];  // the events, oldest overwritten first
+        atomic<unsigned long long> count;  // the number of events ever recorded, only written by the owning thread
+        atomic<unsigned long long> first;  // the first event to dump, moved forward by clear
+        int thread;  // the number of the thread in the trace
+    };
+
+    static mutex ringsMutex;  // guards the list of rings
+    static vector<ThreadRing *> rings;  // the ring of every thread that has recorded. Rings are never freed so they can be dumped after their thread ends.
+    static thread_local ThreadRing *threadRing = NULL;  // the calling thread's ring
+
+    atomic<bool> Tracer::enabled(false);
+
+    // setEnabled function
+    void Tracer::setEnabled(bool value) { enabled = value; }
+
+    long long Tracer::now()
+    {
+        return chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void Tracer::record(const char *name, long long start, long long end)
+    {
+        // The first span of a thread makes its ring. This is the only time recording locks.
+        if(!threadRing)
+        {
+            ThreadRing *ring = new ThreadRing();
+            ring->count = 0;
+            ring->first = 0;
+
+            lock_guard<mutex> lock(ringsMutex);
+            ring->thread = (int)rings.size() + 1;
+            rings.push_back(ring);
+            threadRing = ring;
+        }
+
+        unsigned long long count = threadRing->count.load(memory_order_relaxed);
+        TraceEvent &event = threadRing->events[count % RING_SIZE];
+        event.name = name;
+        event.start = start;
+        event.duration = end - start;
+        threadRing->count.store(count + 1, memory_order_release);
+    }
+
+    int Tracer::dump(const string &fileName)
+    {
+        ofstream file(fileName.c_str());
+        vector<TraceEvent> events;  // a copy of one ring's events
+        bool firstEvent = true;  // no comma before the first event
+
+        if(!file)
+            return ERROR_CANNOT_WRITE_FILE;
+
+        lock_guard<mutex> lock(ringsMutex);
+        file << fixed << setprecision(3) << "{\"traceEvents\":[" << endl;
+
+        for(size_t r = 0; r < rings.size(); ++r)
+        {
+            ThreadRing *ring = rings[r];
+            unsigned long long end = ring->count.load(memory_order_acquire);
+            unsigned long long begin = max(ring->first.load(),
+                end > (unsigned long long)RING_SIZE ? end - RING_SIZE : 0ULL);
+
+            events.clear();
+            for(unsigned long long i = begin; i < end; ++i)
+                events.push_back(ring->events[i % RING_SIZE]);
+
+            // The thread may have kept recording while the events were copied. Skip any event
+            // whose slot could have been written over since, including the slot of event
+            // after - RING_SIZE, which the thread may be writing before it counts it.
+            unsigned long long after = ring->count.load(memory_order_acquire);
+            size_t skip = 0;
+            if(after >= (unsigned long long)RING_SIZE && after + 1 - RING_SIZE > begin)
+                skip = (size_t)min((unsigned long long)events.size(),
+                    after + 1 - RING_SIZE - begin);
+
+            for(size_t i = skip; i < events.size(); ++i)
+            {
+                // Chrome trace times are in microseconds
+                file << (firstEvent ? "" : ",\n") << "{\"name\":\"" << events[i].name
+                    << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->thread << ",\"ts\":"
+                    << events[i].start / 1000.0 << ",\"dur\":" << events[i].duration / 1000.0
+                    << "}";
+                firstEvent = false;
+            }
+        }
+
+        file << endl << "]}" << endl;
+
+        return file ? ERROR_NONE : ERROR_CANNOT_WRITE_FILE;
+    }
+
+    void Tracer::clear()
+    {
+        lock_guard<mutex> lock(ringsMutex);
+
+        for(size_t r = 0; r < rings.size(); ++r)
+            rings[r]->first = rings[r]->count.load();
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef TRACE_H
+#define	TRACE_H
+
+#include <atomic>
+#include <string>
+
+namespace SniperBot
+{
+    /** TraceEvent Struct
+     * Purpose: Holds one timed span of work.
+     */
+    struct TraceEvent
+    {
+        const char *name;  // the name of the span. Must be a string literal.
+        long long start;  // when the span started, in nanoseconds
+        long long duration;  // how long the span took, in nanoseconds
+    };
+
+    /** Tracer Class
+     * Purpose: Records timed spans of the vision and control loop so the time of each stage
+     * can be seen in a trace viewer. Every thread writes to its own fixed-size ring of events,
+     * so recording never locks or allocates, and the oldest events are overwritten once the
+     * ring is full. Tracing is off until it is enabled, and costs one flag check per span while
+     * off. Build with SNIPERBOT_NO_TRACE to remove the spans completely.
+     */
+    class Tracer
+    {
+    public:
+        /** Error code for no error */
+        static const int ERROR_NONE = 0;
+
+        /** Error code for if the trace file cannot be written */
+        static const int ERROR_CANNOT_WRITE_FILE = 1;
+
+        /** The number of events each thread keeps */
+        static const int RING_SIZE = 4096;
+
+    private:
+        static std::atomic<bool> enabled;  // tells the spans to record
+
+    public:
+
+        /** Turns recording on or off
+         * @param value should spans be recorded
+         */
+        static void setEnabled(bool value);
+
+        /** Gets if spans are being recorded
+         * @return if spans are being recorded
+         */
+        static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+        /** Gets the current time for a span
+         * @return the time in nanoseconds of a steady clock
+         */
+        static long long now();
+
+        /** Records a span in the calling thread's ring
+         * @param name the name of the span. Must be a string literal, since only the pointer is kept.
+         * @param start when the span started, from now()
+         * @param end when the span ended, from now()
+         */
+        static void record(const char *name, long long start, long long end);
+
+        /** Writes the events of every thread to a file in the Chrome trace format, which can be
+         * opened with chrome://tracing or Perfetto. Threads can keep recording while it runs.
+         * @param fileName the file to write
+         * @return an error code if an error occurs
+         */
+        static int dump(const std::string &fileName);
+
+        /** Throws away the recorded events of every thread */
+        static void clear();
+    };
+
+    /** TraceSpan Class
+     * Purpose: Records a span from when it is created until it goes out of scope. Use the
+     * TRACE_SPAN macro instead of using this directly.
+     */
+    class TraceSpan
+    {
+    private:
+        const char *name;  // the name of the span
+        long long start;  // when the span started, 0 if tracing was off
+
+    public:
+
+        /** Constructor to start a span
+         * @param name the name of the span. Must be a string literal.
+         */
+        TraceSpan(const char *name)
+        {
+            this->name = name;
+            this->start = Tracer::isEnabled() ? Tracer::now() : 0;
+        }
+
+        /** Destructor. Records the span if tracing was on when it started. */
+        ~TraceSpan()
+        {
+            if(start)
+                Tracer::record(name, start, Tracer::now());
+        }
+    };
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifdef SNIPERBOT_NO_TRACE
+#define TRACE_SPAN(name)
+#else
+/** Times the rest of the enclosing scope as a span with the given name */
+#define TRACE_SPAN(name) SniperBot::TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(name)
+#endif
+
+#endif	/* TRACE_H */
@@ -0,0 +1,326 @@
+#include "V4L2Capture.h"
+#include "Trace.h"
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/videodev2.h>
+
+using namespace std;
+
+namespace SniperBot
+{
+    /** Calls ioctl again if a signal interrupted it
+     * @param fd the file descriptor
+     * @param request the ioctl request
+     * @param arg the request's argument
+     * @return the result of ioctl
+     */
+    static int retryIoctl(int fd, unsigned long request, void *arg)
+    {
+        int result;
+        do
+            result = ioctl(fd, request, arg);
+        while(result < 0 && errno == EINTR);
+        return result;
+    }
+
+    /** Gets the time on the monotonic clock, which V4L2 timestamps its frames with
+     * @return the time in nanoseconds
+     */
+    static long long monotonicNow()
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return now.tv_sec * 1000000000LL + now.tv_nsec;
+    }
+
+    // Constructor
+    V4L2Capture::V4L2Capture()
+    {
+        this->fd = -1;
+        this->held = -1;
+        this->heldTime = 0;
+        this->width = 0;
+        this->height = 0;
+        this->bytesPerLine = 0;
+        this->pixelFormat = FORMAT_YUYV;
+        this->framesCaptured = 0;
+        this->framesDropped = 0;
+        this->framesReleased = 0;
+        this->bytesNotCopied = 0;
+        this->lastLatency = 0;
+        this->totalLatency = 0;
+        this->maxLatency = 0;
+    }
+
+    // Destructor
+    V4L2Capture::~V4L2Capture() { close(); }
+
+    int V4L2Capture::open(const string &device, int width, int height, unsigned pixelFormat,
+        int bufferCount)
+    {
+        close();
+
+        // Nonblocking, so every ready frame can be taken without waiting for one more
+        fd = ::open(device.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if(fd < 0)
+            return ERROR_CANNOT_OPEN;
+
+        v4l2_capability capability;
+        memset(&capability, 0, sizeof(capability));
+        if(retryIoctl(fd, VIDIOC_QUERYCAP, &capability) < 0)
+        {
+            close();
+            return ERROR_NOT_SUPPORTED;
+        }
+        unsigned caps = capability.capabilities & V4L2_CAP_DEVICE_CAPS ?
+            capability.device_caps : capability.capabilities;
+        if(!(caps & V4L2_CAP_VIDEO_CAPTURE) || !(caps & V4L2_CAP_STREAMING))
+        {
+            close();
+            return ERROR_NOT_SUPPORTED;
+        }
+
+        // Ask for the format, keeping the camera's size if none was given
+        v4l2_format format;
+        memset(&format, 0, sizeof(format));
+        format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        if(retryIoctl(fd, VIDIOC_G_FMT, &format) < 0)
+        {
+            close();
+            return ERROR_CANNOT_SET_FORMAT;
+        }
+        if(width > 0 && height > 0)
+        {
+            format.fmt.pix.width = width;
+            format.fmt.pix.height = height;
+        }
+        format.fmt.pix.pixelformat = pixelFormat;
+        format.fmt.pix.field = V4L2_FIELD_NONE;
+        if(retryIoctl(fd, VIDIOC_S_FMT, &format) < 0 || format.fmt.pix.pixelformat != pixelFormat)
+        {
+            close();
+            return ERROR_CANNOT_SET_FORMAT;
+        }
+        this->width = format.fmt.pix.width;
+        this->height = format.fmt.pix.height;
+        this->bytesPerLine = format.fmt.pix.bytesperline;
+        this->pixelFormat = pixelFormat;
+
+        // Share the driver's buffers, and give them all to it to fill
+        v4l2_requestbuffers request;
+        memset(&request, 0, sizeof(request));
+        request.count = bufferCount;
+        request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        request.memory = V4L2_MEMORY_MMAP;
+        if(retryIoctl(fd, VIDIOC_REQBUFS, &request) < 0 || request.count < 2)
+        {
+            close();
+            return ERROR_CANNOT_MAP_BUFFERS;
+        }
+        for(unsigned i = 0; i < request.count; ++i)
+        {
+            v4l2_buffer buffer;
+            memset(&buffer, 0, sizeof(buffer));
+            buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            buffer.memory = V4L2_MEMORY_MMAP;
+            buffer.index = i;
+            if(retryIoctl(fd, VIDIOC_QUERYBUF, &buffer) < 0)
+            {
+                close();
+                return ERROR_CANNOT_MAP_BUFFERS;
+            }
+
+            MappedBuffer mapped;
+            mapped.length = buffer.length;
+            mapped.start = mmap(NULL, buffer.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                buffer.m.offset);
+            if(mapped.start == MAP_FAILED)
+            {
+                close();
+                return ERROR_CANNOT_MAP_BUFFERS;
+            }
+            buffers.push_back(mapped);
+
+            if(!queue(i))
+            {
+                close();
+                return ERROR_CANNOT_MAP_BUFFERS;
+            }
+        }
+
+        int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        if(retryIoctl(fd, VIDIOC_STREAMON, &type) < 0)
+        {
+            close();
+            return ERROR_CANNOT_START;
+        }
+
+        return ERROR_NONE;
+    }
+
+    void V4L2Capture::close()
+    {
+        if(fd < 0)
+            return;
+
+        // Stopping the stream takes every buffer back from the driver
+        int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        retryIoctl(fd, VIDIOC_STREAMOFF, &type);
+        for(size_t i = 0; i < buffers.size(); ++i)
+            munmap(buffers[i].start, buffers[i].length);
+        buffers.clear();
+
+        v4l2_requestbuffers request;
+        memset(&request, 0, sizeof(request));
+        request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        request.memory = V4L2_MEMORY_MMAP;
+        retryIoctl(fd, VIDIOC_REQBUFS, &request);
+
+        ::close(fd);
+        fd = -1;
+        held = -1;
+    }
+
+    // isOpen function
+    bool V4L2Capture::isOpen() { return fd >= 0; }
+
+    bool V4L2Capture::queue(int index)
+    {
+        v4l2_buffer buffer;
+        memset(&buffer, 0, sizeof(buffer));
+        buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buffer.memory = V4L2_MEMORY_MMAP;
+        buffer.index = index;
+
+        return retryIoctl(fd, VIDIOC_QBUF, &buffer) >= 0;
+    }
+
+    bool V4L2Capture::read(Mat &frame)
+    {
+        TRACE_SPAN("v4l2 read");
+
+        if(fd < 0)
+            return false;
+        release();
+
+        v4l2_buffer newest;  // the newest frame taken so far
+        bool found = false;
+        for(;;)
+        {
+            v4l2_buffer buffer;
+            memset(&buffer, 0, sizeof(buffer));
+            buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            buffer.memory = V4L2_MEMORY_MMAP;
+
+            if(retryIoctl(fd, VIDIOC_DQBUF, &buffer) < 0)
+            {
+                // Stop at the newest frame once no more are ready
+                if(found)
+                    break;
+                if(errno != EAGAIN)
+                    return false;
+
+                // Nothing is ready yet, so wait for the driver to fill a buffer
+                pollfd ready;
+                ready.fd = fd;
+                ready.events = POLLIN;
+                int result = poll(&ready, 1, READ_TIMEOUT);
+                if(result < 0 && errno == EINTR)
+                    continue;
+                if(result <= 0)
+                    return false;
+                continue;
+            }
+            ++framesCaptured;
+
+            // A frame the driver could not fill, or one with a newer frame behind it, goes
+            // straight back
+            if((buffer.flags & V4L2_BUF_FLAG_ERROR) || buffer.bytesused == 0)
+            {
+                ++framesDropped;
+                queue(buffer.index);
+                continue;
+            }
+            if(found)
+            {
+                ++framesDropped;
+                queue(newest.index);
+            }
+            newest = buffer;
+            found = true;
+        }
+
+        held = newest.index;
+        if((newest.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+            heldTime = newest.timestamp.tv_sec * 1000000000LL + newest.timestamp.tv_usec * 1000LL;
+        else
+            heldTime = monotonicNow();
+
+        // Hand out a view of the buffer, in the camera's own format
+        void *data = buffers[held].start;
+        if(pixelFormat == FORMAT_MJPEG)
+            frame = Mat(1, (int)newest.bytesused, CV_8UC1, data);
+        else
+            frame = Mat(height, width, CV_8UC2, data, bytesPerLine);
+        bytesNotCopied += newest.bytesused;
+
+        return true;
+    }
+
+    void V4L2Capture::release()
+    {
+        if(held < 0)
+            return;
+
+        lastLatency = (monotonicNow() - heldTime) / 1e9;
+        totalLatency += lastLatency;
+        if(lastLatency > maxLatency)
+            maxLatency = lastLatency;
+        ++framesReleased;
+
+        queue(held);
+        held = -1;
+    }
+
+    // getWidth function
+    int V4L2Capture::getWidth() { return width; }
+
+    // getHeight function
+    int V4L2Capture::getHeight() { return height; }
+
+    // getPixelFormat function
+    unsigned V4L2Capture::getPixelFormat() { return pixelFormat; }
+
+    // getBufferCount function
+    int V4L2Capture::getBufferCount() { return (int)buffers.size(); }
+
+    // getFramesCaptured function
+    long V4L2Capture::getFramesCaptured() { return framesCaptured; }
+
+    // getFramesDropped function
+    long V4L2Capture::getFramesDropped() { return framesDropped; }
+
+    // getFramesReleased function
+    long V4L2Capture::getFramesReleased() { return framesReleased; }
+
+    // getBytesNotCopied function
+    long long V4L2Capture::getBytesNotCopied() { return bytesNotCopied; }
+
+    // getLastLatency function
+    double V4L2Capture::getLastLatency() { return lastLatency; }
+
+    // getAverageLatency function
+    double V4L2Capture::getAverageLatency()
+    {
+        return framesReleased > 0 ? totalLatency / framesReleased : 0;
+    }
+
+    // getMaxLatency function
+    double V4L2Capture::getMaxLatency() { return maxLatency; }
+}
@@ -0,0 +1,185 @@
+#ifndef V4L2CAPTURE_H
+#define	V4L2CAPTURE_H
+
+#include "FrameSource.h"
+#include <string>
+#include <vector>
+
+using namespace cv;
+
+namespace SniperBot
+{
+    /** V4L2Capture Class
+     * Purpose: Reads frames straight from a Video4Linux2 camera into buffers the driver shares
+     * with the program, instead of through VideoCapture, which copies every frame into a new
+     * Mat and converts it to BGR. The frame handed out is a view of the driver's buffer in the
+     * camera's own format: a CV_8UC2 image for YUYV, or a single row of bytes for MJPEG that
+     * a MjpegFrameSource can decode. The buffer is only given back to the driver once the
+     * frame is released, or at the next read. Every frame that is ready is taken at each read
+     * and all but the newest are given straight back, so the driver's buffers work like
+     * FrameGrabber's ring without a capture thread. Any V4L2 camera works, including the
+     * vivid virtual driver.
+     */
+    class V4L2Capture : public FrameSource
+    {
+    public:
+        /** Error code for no error */
+        static const int ERROR_NONE = 0;
+
+        /** Error code for if the device cannot be opened */
+        static const int ERROR_CANNOT_OPEN = 1;
+
+        /** Error code for if the device is not a camera that can stream to shared buffers */
+        static const int ERROR_NOT_SUPPORTED = 2;
+
+        /** Error code for if the camera cannot send frames in the format asked for */
+        static const int ERROR_CANNOT_SET_FORMAT = 3;
+
+        /** Error code for if the driver's buffers cannot be shared */
+        static const int ERROR_CANNOT_MAP_BUFFERS = 4;
+
+        /** Error code for if the camera cannot start streaming */
+        static const int ERROR_CANNOT_START = 5;
+
+        /** The V4L2 code of the YUYV format */
+        static const unsigned FORMAT_YUYV = 0x56595559;
+
+        /** The V4L2 code of the MJPEG format */
+        static const unsigned FORMAT_MJPEG = 0x47504A4D;
+
+        /** The number of buffers asked of the driver by default */
+        static const int DEFAULT_BUFFERS = 4;
+
+        /** Milliseconds read waits for a frame before giving up */
+        static const int READ_TIMEOUT = 2000;
+
+    private:
+        /** MappedBuffer Struct
+         * Purpose: Holds where one of the driver's buffers is in the program's memory.
+         */
+        struct MappedBuffer
+        {
+            void *start;  // the start of the buffer
+            size_t length;  // the length of the buffer in bytes
+        };
+
+        int fd;  // the device's file descriptor, -1 if closed
+        std::vector<MappedBuffer> buffers;  // the driver's buffers
+        int held;  // the index of the buffer lent out as the last frame, -1 if none is
+        long long heldTime;  // when the held buffer's frame was captured, in nanoseconds on the monotonic clock
+        int width;  // the width of the frames
+        int height;  // the height of the frames
+        int bytesPerLine;  // the bytes in one row of a YUYV frame
+        unsigned pixelFormat;  // the format of the frames
+        long framesCaptured;  // the number of frames taken from the driver
+        long framesDropped;  // the number of frames given back because a newer one was ready
+        long framesReleased;  // the number of frames given back after they were used
+        long long bytesNotCopied;  // the bytes of the frames handed out without a copy
+        double lastLatency;  // seconds from the capture of the last released frame to its release
+        double totalLatency;  // the total seconds from capture to release
+        double maxLatency;  // the most seconds from capture to release
+
+        /** Gives a buffer back to the driver to fill
+         * @param index the index of the buffer
+         * @return true if the driver took it
+         */
+        bool queue(int index);
+
+    public:
+
+        /** Constructor to create a closed V4L2Capture object */
+        V4L2Capture();
+
+        /** Destructor. Stops the camera and closes the device. */
+        ~V4L2Capture();
+
+        /** Opens the camera, shares its buffers and starts it streaming
+         * @param device the path of the video device, such as /dev/video0
+         * @param width the width to ask for, 0 to keep the camera's
+         * @param height the height to ask for, 0 to keep the camera's
+         * @param pixelFormat FORMAT_YUYV or FORMAT_MJPEG
+         * @param bufferCount the number of buffers to ask the driver for
+         * @return an error code if an error occurs
+         */
+        int open(const std::string &device, int width = 0, int height = 0,
+            unsigned pixelFormat = FORMAT_YUYV, int bufferCount = DEFAULT_BUFFERS);
+
+        /** Stops the camera and closes the device */
+        void close();
+
+        /** Gets if the device is open
+         * @return if the device is open
+         */
+        bool isOpen();
+
+        /** Waits for a frame, and hands out a view of the newest one. The last frame is
+         * released first if it has not been.
+         * @param frame a reference to a Mat that will hold the frame
+         * @return true if a frame was read
+         */
+        bool read(Mat &frame);
+
+        /** Gives the last frame's buffer back to the driver, and times how long it was held
+         * after it was captured. Does nothing if it was already given back.
+         */
+        void release();
+
+        /** Gets the width of the frames
+         * @return the width of the frames
+         */
+        int getWidth();
+
+        /** Gets the height of the frames
+         * @return the height of the frames
+         */
+        int getHeight();
+
+        /** Gets the format of the frames
+         * @return FORMAT_YUYV or FORMAT_MJPEG
+         */
+        unsigned getPixelFormat();
+
+        /** Gets the number of buffers shared with the driver
+         * @return the number of buffers
+         */
+        int getBufferCount();
+
+        /** Gets the number of frames taken from the driver
+         * @return the number of frames captured
+         */
+        long getFramesCaptured();
+
+        /** Gets the number of frames given back unread because a newer frame was ready
+         * @return the number of dropped frames
+         */
+        long getFramesDropped();
+
+        /** Gets the number of frames given back after they were used
+         * @return the number of frames released
+         */
+        long getFramesReleased();
+
+        /** Gets the bytes of the frames handed out as views, which VideoCapture would have
+         * copied
+         * @return the bytes not copied
+         */
+        long long getBytesNotCopied();
+
+        /** Gets the time from the capture of the last released frame to its release
+         * @return the time in seconds
+         */
+        double getLastLatency();
+
+        /** Gets the average time from capture to release
+         * @return the time in seconds
+         */
+        double getAverageLatency();
+
+        /** Gets the longest time from capture to release
+         * @return the time in seconds
+         */
+        double getMaxLatency();
+    };
+}
+
+#endif	/* V4L2CAPTURE_H */
@@ -1,10 +1,28 @@
 #include <iostream>
+#include <iomanip>
 #include <string>
 #include "opencv2/highgui/highgui.hpp"
 #include "opencv2/imgproc/imgproc.hpp"
 #include "GPIO.h"
+#include "GPIOLineGroup.h"
+#include "EdgeMonitor.h"
 #include <math.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
 #include "ColorDetection.h"
+#include "FrameGrabber.h"
+#include "Trace.h"
+#include "SessionLog.h"
+#include "SessionFrameSource.h"
+#include "SerialLink.h"
+#include "CommandSender.h"
+#include "AimController.h"
+#include "SnapshotCell.h"
+#include "PipelineStage.h"
+#include "DetectorGroup.h"
+#include "MjpegFrameSource.h"
+#include "V4L2Capture.h"
 
 using namespace cv;
 using namespace std;
@@ -31,6 +49,44 @@ const int STATE_AVOIDING_LEFT = 2;  // Robot is turning left to avoid an object
 const int STATE_AVOIDING_RIGHT = 3;  // Robot is turning right to avoid an object
 const int STATE_TARGETING = 4;  // Robot found an target and is aiming at it
 
+// What the vision stage looks for
+const int VISION_IDLE = 0;  // Nothing, while the robot avoids an object
+const int VISION_SEARCH = 1;  // Every target color
+const int VISION_TRACK = 2;  // The locked color, near where it was last seen
+
+/** SensorStates Struct
+ * Purpose: Holds the states of the 3 ultrasonic sensor pins.
+ */
+struct SensorStates
+{
+    bool left;  // is the left ultrasonic sensor pin high
+    bool right;  // is the right ultrasonic sensor pin high
+    bool front;  // is the front ultrasonic sensor pin high
+};
+
+/** VisionRequest Struct
+ * Purpose: Tells the vision stage what to look for.
+ */
+struct VisionRequest
+{
+    int mode;  // VISION_IDLE, VISION_SEARCH or VISION_TRACK
+    int color;  // the color to follow in VISION_TRACK
+    int generation;  // counts the requests, so results found for an old one can be dropped
+};
+
+/** VisionResult Struct
+ * Purpose: Holds what the vision stage found in one frame.
+ */
+struct VisionResult
+{
+    int color;  // the color found, -1 if none was found
+    int x;  // the x coordinate of the target, -1 if none was found
+    int y;  // the y coordinate of the target, -1 if none was found
+    int source;  // the camera that found the target, 0 for the camera on the servos and 1 for the wide camera
+    double frameTime;  // when the frame was read, in seconds
+    int generation;  // the generation of the request the frame was searched for
+};
+
 // GPIO Variables
 string data0Pin = "4";  // Bit 0 of the data bus
 string data1Pin = "17";  // Bit 1 of the data bus
@@ -48,22 +104,122 @@ GPIO *data3 = new GPIO(data3Pin);  // Connects to data 3 pin
 GPIO *leftUS = new GPIO(leftUSPin);  // Connects to left ultrasonic pin
 GPIO *rightUS = new GPIO(rightUSPin);  // Connects to right ultrasonic pin
 GPIO *frontUS = new GPIO(frontUSPin);  // Connects to front ultrasonic pin
+string gpioChip = "/dev/gpiochip0";  // GPIO character device the command bus is requested from
+ChipLineGroup commandBus;  // The 4 data pins and the trigger pin as one line group, when the character device can be used
+const int BUS_DATA_MASK = 0xF;  // Lines of the command bus that hold the data bits
+const int BUS_TRIG_LINE = 4;  // Line of the command bus that holds the trigger pin
+const int PIN_COMMAND_GAP = 50;  // Fewest microseconds between the starts of two commands on the data pins, so the Arduino reads each one before the next
+const int PIN_MAX_STEPS = 4;  // Most look commands on one axis in one frame on the data pins, 8 degrees or about 240 degrees a second at 30 frames a second
+ChipEdgeSource usEdges;  // The 3 ultrasonic pins with edge detection, when the character device can be used
+const int SENSOR_WAIT = 10;  // Milliseconds the sensor stage waits on the ultrasonic pins before checking if it should stop
+const int SENSOR_POLL_INTERVAL = 1000;  // Microseconds between reads of the ultrasonic pins through sysfs
+const int VISION_IDLE_WAIT = 1000;  // Microseconds the vision stage sleeps while there is nothing to look for
+const int CONTROL_IDLE_WAIT = 200;  // Microseconds the control stage sleeps while nothing new has come in
+EdgeMonitor edgeMonitor;  // Waits for the ultrasonic pins to change
+vector<EdgeEvent> edgeEvents;  // The ultrasonic pin changes from the last check
+SerialLink commandLink;  // The UART to the Arduino, when commands are sent as packets instead of on the data pins
+CommandOutput *commandOutput = NULL;  // Writes the commands to the data pins or the serial link
+CommandSender *commandSender = NULL;  // Sends the commands on its own thread, NULL when replaying
 
 ColorDetector *cd;  // Used to detect color from the camera
 VideoCapture cap;  // Used to grab screenshots from the camera
+FrameGrabber *grabber;  // Reads frames from the camera on its own thread
+long mjpegWidth = 0;  // the width the camera's MJPEG frames are decoded and searched at, 0 to let OpenCV decode them at full size
+MjpegFrameSource *mjpegSource = NULL;  // decodes the camera's MJPEG frames, NULL when OpenCV decodes them
+string v4l2Device;  // the video device to read the camera's own buffers from, empty to read it through VideoCapture
+V4L2Capture *v4l2Capture = NULL;  // reads the camera's own buffers, NULL when VideoCapture reads the camera
+VideoCapture wideCap;  // Used to grab screenshots from the wide camera
+FrameGrabber *wideGrabber = NULL;  // Reads frames from the wide camera on its own thread, NULL without one
+ColorDetector *wideCd = NULL;  // Used to detect color from the wide camera, NULL without one
+DetectorGroup *detectorGroup = NULL;  // Searches both cameras at once while searching, NULL without a wide camera
+vector<GroupDetection> groupDetections;  // holds what the detector group found for each target color
+int wideCenterX;  // the x coordinate of the middle of the wide camera's view
+bool turningToTarget = false;  // is the robot turning toward a target only the wide camera sees
 Rect targetArea;  // Rectangle specifying where the color object should be for the robot to start firing
 bool usLeftState;  // stores if the left ultrasonic sensor pin is high or not
 bool usRightState;  // stores if the right ultrasonic sensor pin is high or not
 bool usFrontState;  // stores if the front ultrasonic sensor pin is high or not
 int state;  // holds the robot state
+volatile sig_atomic_t stopRequested = 0;  // set by SIGINT and SIGTERM to shut the robot down
+SensorStates sensedStates;  // the ultrasonic states as last read, only used by the sensor stage
+SnapshotCell<SensorStates> sensorCell;  // hands the ultrasonic states from the sensor stage to the control stage
+SnapshotCell<VisionRequest> requestCell;  // hands what to look for from the control stage to the vision stage
+SnapshotCell<VisionResult> visionCell;  // hands what was found from the vision stage to the control stage
+int visionGeneration = 0;  // the generation of the last vision request, only used by the control stage
+int lockedColor = -1;  // the color being aimed at, only used by the control stage
+bool pipelined = false;  // do the stages run on their own threads. Off when recording or replaying, so the log replays in the same order.
+int targetColors[] = { ColorDetector::GREEN };  // the colors to shoot at, highest priority first
+vector<ColorResult> colorResults;  // holds what was found for each target color
+const char *traceFile;  // the file to write the trace to, NULL if tracing is off
+volatile sig_atomic_t traceRequested = 0;  // set by SIGUSR1 to write the trace at the end of the loop
+SessionRecorder recorder;  // writes the session to a log when recording
+SessionReader replayLog;  // the log being replayed
+ReplayFrameSource *replaySource = NULL;  // supplies the replayed frames, NULL when running live
+RecordingFrameSource *recordingSource = NULL;  // writes the frames to the log, NULL when not recording
+AimController aimController;  // picks the camera steps that aim at the target
+double lastFrameTime;  // when the last frame aimed at was read, in seconds
+size_t sensorPosition;  // the position of the next sensor record in the replayed log
+size_t commandPosition;  // the position of the next command record in the replayed log
+size_t statePosition;  // the position of the next state change record in the replayed log
+long replayedOutputs = 0;  // the number of commands and state changes checked against the log
+long replayMismatches = 0;  // the number of commands and state changes that differ from the log
+long replayExtras = 0;  // the number of commands and state changes past the end of the log
+
+/** Checks a command or state change made during a replay against the next one in the log
+ * @param type the record type, RECORD_COMMAND or RECORD_STATE
+ * @param position a reference to the position of the next record of the type
+ * @param a the command, or the state before the change
+ * @param b the state after the change, unused for commands
+ */
+void checkReplay(int type, size_t &position, int a, int b)
+{
+    LogRecord record;
+    int recordedA, recordedB = 0;  // what the log has
+    
+    if(!replayLog.next(position, type, record))
+    {
+        ++replayExtras;
+        return;
+    }
+    
+    if(type == RECORD_COMMAND)
+        recordedA = SessionReader::getCommand(record);
+    else
+        SessionReader::getState(record, recordedA, recordedB);
+    
+    ++replayedOutputs;
+    if(recordedA != a || recordedB != b)
+        ++replayMismatches;
+}
 
-/** Sends a 4 bit command to the Arduino using 4 GPIO pins
+/** Sends a command to the Arduino. The command is queued for the sender thread, so this
+ * never waits on the pins or the serial port.
+ * @param data The command to be sent to the Arduino
+ */
+void sendCommand(int data)
+{
+	TRACE_SPAN("sendCommand");
+	
+	if(recorder.isOpen())
+	    recorder.recordCommand(data);
+	
+	// When replaying, check the command against the log instead of sending it
+	if(replaySource)
+	{
+	    checkReplay(RECORD_COMMAND, commandPosition, data, 0);
+	    return;
+	}
+	
+	commandSender->post((uint8_t)data);
+}
+
+/** Writes a 4 bit command to the Arduino using 4 GPIO pins
  * @param data The data to be sent to the Arduino. This value is converted to binary
  * in order to put the data on the 4 data pins.
  */
-void sendCommand(int data)
+void writeCommand(int data)
 {
-	string bits[4];  // holds the 4 data bits
+	bool bits[4];  // holds the 4 data bits
 	int d = data;  // copy of the value passed in
 	
 	// Check that data is in bounds on a 4 bit number
@@ -77,23 +233,51 @@ void sendCommand(int data)
 	{
             if(d >= pow(2, i))
             {
-                bits[i] = "1";
+                bits[i] = true;
                 d -= pow(2, i);
             }
             else
             {
-                bits[i] = "0";
+                bits[i] = false;
             }
 	}
 	
-	trig->setval_gpio("0");  // clears the trigger pin
+	// Set all 4 data bits in one change with the trigger low, then raise the trigger, so
+	// the Arduino never sees a half written command
+	if(commandBus.isOpen())
+	{
+	    unsigned long long bus = 0;  // the data bits, bit 0 on line 0
+	    for(int i = 0; i < 4; ++i)
+	        if(bits[i])
+	            bus |= 1ULL << i;
+	    commandBus.strobe(bus, BUS_DATA_MASK, BUS_TRIG_LINE);
+	    return;
+	}
+	
+	trig->setval_gpio(false);  // clears the trigger pin
 	data0->setval_gpio(bits[0]);  // sets data bit 0
 	data1->setval_gpio(bits[1]);  // sets data bit 1
 	data2->setval_gpio(bits[2]);  // sets data bit 2
 	data3->setval_gpio(bits[3]);  // sets data bit 3
-	trig->setval_gpio("1");  // Set the trigger pin high
+	trig->setval_gpio(true);  // Set the trigger pin high
+	usleep(GPIOLineGroup::STROBE_HOLD);  // let the Arduino read the data before it changes
 }
 
+/** PinCommandOutput Class
+ * Purpose: Writes the sender thread's commands to the data pins, one at a time. The sender
+ * is given PIN_COMMAND_GAP, so it hands over one command per write and spaces them out.
+ */
+class PinCommandOutput : public CommandOutput
+{
+public:
+    int write(const Command *commands, int count)
+    {
+        for(int i = 0; i < count; ++i)
+            writeCommand(commands[i].opcode);
+        return 0;
+    }
+};
+
 /** Causes the program to pause for the specified milliseconds.
  * @param milli the number of milliseconds to pause
  */
@@ -105,226 +289,965 @@ void msleep(int milli)
     }
 }
 
+/** Changes the robot state, and records or checks the change. The vision stage is told what
+ * to look for in the new state, and anything it found for the old state is dropped.
+ * @param newState the state to change to
+ */
+void setState(int newState)
+{
+    if(recorder.isOpen())
+        recorder.recordState(state, newState);
+    if(replaySource)
+        checkReplay(RECORD_STATE, statePosition, state, newState);
+    
+    state = newState;
+    
+    VisionRequest request;
+    request.mode = state == STATE_SEARCHING ? VISION_SEARCH :
+        state == STATE_TARGETING ? VISION_TRACK : VISION_IDLE;
+    request.color = lockedColor;
+    request.generation = ++visionGeneration;
+    requestCell.publish(request);
+}
+
 /** Sets up the GPIO pins on the Raspberry Pi.*/
 void setupGPIO()
 {
+    // Request the command bus from the GPIO character device, so a command is written in
+    // one change instead of one sysfs write per pin
+    unsigned busPins[] = { (unsigned)atoi(data0Pin.c_str()), (unsigned)atoi(data1Pin.c_str()),
+        (unsigned)atoi(data2Pin.c_str()), (unsigned)atoi(data3Pin.c_str()),
+        (unsigned)atoi(trigPin.c_str()) };
+    commandBus.open(gpioChip, vector<unsigned>(busPins, busPins + 5), true);
+    
+    // Fall back to sysfs for the command bus if the character device can't be used
+    if(!commandBus.isOpen())
+    {
+        trig->export_gpio();
+        data0->export_gpio();
+        data1->export_gpio();
+        data2->export_gpio();
+        data3->export_gpio();
+        trig->setdir_gpio("out");
+        data0->setdir_gpio("out");
+        data1->setdir_gpio("out");
+        data2->setdir_gpio("out");
+        data3->setdir_gpio("out");
+    }
+    
+    // Watch the ultrasonic pins for edges, so they don't have to be read every pass
+    unsigned usPins[] = { (unsigned)atoi(leftUSPin.c_str()), (unsigned)atoi(rightUSPin.c_str()),
+        (unsigned)atoi(frontUSPin.c_str()) };
+    unsigned long long levels;  // the starting levels of the ultrasonic pins
+    if(usEdges.open(gpioChip, vector<unsigned>(usPins, usPins + 3)) == ChipEdgeSource::ERROR_NONE &&
+        edgeMonitor.addSource(&usEdges) >= 0 && usEdges.getValues(levels))
+    {
+        sensedStates.left = (levels & 1) != 0;
+        sensedStates.right = (levels & 2) != 0;
+        sensedStates.front = (levels & 4) != 0;
+        return;
+    }
+    usEdges.close();
+    
     // Tell the Raspberry Pi which pins are being used
-    trig->export_gpio();
-    data0->export_gpio();
-    data1->export_gpio();
-    data2->export_gpio();
-    data3->export_gpio();
     leftUS->export_gpio();
     rightUS->export_gpio();
     frontUS->export_gpio();
     
     // Set the pins to either input or output
-    trig->setdir_gpio("out");
-    data0->setdir_gpio("out");
-    data1->setdir_gpio("out");
-    data2->setdir_gpio("out");
-    data3->setdir_gpio("out");
     leftUS->setdir_gpio("in");
     rightUS->setdir_gpio("in");
     frontUS->setdir_gpio("in");
 }
 
-/** Opens the camera, gets the size of the screen captures, and sets up the target area.
+/** Waits for the ultrasonic pins to change and applies every change to the sensed states,
+ * in the order they happened
+ * @param timeout milliseconds to wait for a change, 0 to only check
+ */
+void applyUltrasonicEdges(int timeout)
+{
+    TRACE_SPAN("ultrasonic edges");
+    
+    if(edgeMonitor.poll(edgeEvents, timeout) != EdgeMonitor::ERROR_NONE)
+        return;
+    
+    for(size_t i = 0; i < edgeEvents.size(); ++i)
+    {
+        const EdgeEvent &event = edgeEvents[i];
+        if(event.line == 0)
+            sensedStates.left = event.rising;
+        else if(event.line == 1)
+            sensedStates.right = event.rising;
+        else if(event.line == 2)
+            sensedStates.front = event.rising;
+    }
+}
+
+/** Positions the target area in the middle of the camera's view
+ * @param size the width and height of the camera's view, as it is searched
+ * @param scale how much the frames are shrunk before they are searched
+ */
+void setupTargetArea(Point size, double scale = 1)
+{
+    int targetWidth = (int)(250 * scale);  // width of the target area
+    int targetHieght = (int)(250 * scale);  // height of the target area
+
+    // Set the coordinates of the target area to position it in the middle of the camera's view
+    targetArea.x = size.x / 2 - (targetWidth / 2);
+    targetArea.y = size.y / 2 - (targetHieght / 2);
+    targetArea.width = targetWidth;
+    targetArea.height = targetHieght;
+    
+    // The camera sees about 60 degrees across
+    aimController.setPixelsPerDegree(size.x / 60.0);
+}
+
+/** Wraps a frame source so its frames are written to the session log when recording
+ * @param source the frame source
+ * @return the frame source to give the color detector
+ */
+FrameSource *withRecording(FrameSource *source)
+{
+    if(!recorder.isOpen())
+        return source;
+    
+    recordingSource = new RecordingFrameSource(source, &recorder);
+    return recordingSource;
+}
+
+/** Gets when the last frame was read. Recorded and replayed sessions use the time in the
+ * log, so the replay aims with the same frame times as the recording.
+ * @return the time in seconds
+ */
+double getFrameTime()
+{
+    if(replaySource)
+        return replaySource->getFrameTime() / 1e9;
+    if(recordingSource)
+        return recordingSource->getFrameTime() / 1e9;
+    
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** Sends steps to turn the camera on one axis
+ * @param steps the number of steps, positive to send positive and negative to send negative
+ * @param positive the look command that turns the camera one step the positive way
+ * @param negative the look command that turns the camera one step the negative way
+ */
+void sendSteps(int steps, int positive, int negative)
+{
+    for(int i = 0; i < abs(steps); ++i)
+        sendCommand(steps > 0 ? positive : negative);
+}
+
+/** Opens the camera, gets the size of the screen captures, sets up the target area, and
+ * starts the frame grabber. With a V4L2 device, the detector reads the camera's own buffers
+ * instead.
  * @return error code, if any
  */
 int setupCamera()
 {
-    cap.open(0);  // open the first camera connected
+    FrameSource *source;  // where the color detector reads frames from
+    Point screen;  // the size of the camera's frames
     
-    // If the camera is successful when opening, return an error code
-    if(!cap.isOpened())
-    	return 1;
-    // If the camera opened successfully...
+    if(!v4l2Device.empty())
+    {
+        // The driver's buffers already work like the frame grabber's ring, so no capture
+        // thread is needed. MJPEG is asked for if it is going to be decoded here.
+        v4l2Capture = new V4L2Capture();
+        if(v4l2Capture->open(v4l2Device, 0, 0, mjpegWidth > 0 ? V4L2Capture::FORMAT_MJPEG :
+                V4L2Capture::FORMAT_YUYV) != V4L2Capture::ERROR_NONE)
+            return 1;
+        screen = Point(v4l2Capture->getWidth(), v4l2Capture->getHeight());
+        source = v4l2Capture;
+    }
     else
     {
+        cap.open(0);  // open the first camera connected
+        
+        // If the camera is successful when opening, return an error code
+        if(!cap.isOpened())
+            return 1;
+        
+        // Ask for MJPEG, so the frames can be decoded straight to the size they are searched at
+        if(mjpegWidth > 0)
+            cap.set(CAP_PROP_FOURCC, VideoWriter::fourcc('M', 'J', 'P', 'G'));
+        
         // Gets the size of the screen from the camera
-        Point size = SniperBot::ColorDetector::getScreenSize(cap);
-
-        int targetWidth = 250;  // width of the target area
-        int targetHieght = 250;  // height of the target area
-
-        // Set the coordinates of the target area to position it in the middle of the camera's view
-        targetArea.x = size.x / 2 - (targetWidth / 2);
-        targetArea.y = size.y / 2 - (targetHieght / 2);
-        targetArea.width = targetWidth;
-        targetArea.height = targetHieght;
+        screen = SniperBot::ColorDetector::getScreenSize(cap);
+        if(mjpegWidth > 0)
+            cap.set(CAP_PROP_CONVERT_RGB, 0);  // hand out the JPEG buffers as they are
+        
+        // Start reading frames in the background so the color detector always gets the
+        // newest frame instead of waiting on the camera
+        grabber = new FrameGrabber(cap);
+        if(grabber->start() != FrameGrabber::ERROR_NONE)
+            return 1;
+        source = grabber;
+    }
+    
+    if(mjpegWidth > 0)
+    {
+        // Search the frames at the decoded width, with everything in the view shrunk to match
+        cd->setWidth(mjpegWidth);
+        setupTargetArea(Point(mjpegWidth, screen.y * mjpegWidth / screen.x),
+            mjpegWidth / (double)screen.x);
+        mjpegSource = new MjpegFrameSource(source, mjpegWidth);
+        source = mjpegSource;
     }
+    else
+        setupTargetArea(screen);
+    cd->setFrameSource(withRecording(source));
 	
     return 0;  // Return no error
 }
 
-/** Reads the states of the 3 ultrasonic sensor pins to determine if there are an object
- * within the collision threshold. */
-void getUltrasonicStates()
+/** Opens the fixed wide angle camera and searches it alongside the camera on the servos.
+ * Targets it sees while searching turn the robot toward them until the camera on the servos
+ * sees them too.
+ * @param device the camera's index, or the path of its video device
+ * @return error code, if any
+ */
+int setupWideCamera(const string &device)
 {
-    string left, right, front;  // holds the 3 ultrasonic sensor states
-
-    // Get the states of the 3 ultrasonic pins
-    leftUS->getval_gpio(left);
-    rightUS->getval_gpio(right);
-    frontUS->getval_gpio(front);
-
-    // Sets the global ultrasonic state variables
-    left == "1" ? usLeftState = true : usLeftState = false;
-    right == "1" ? usRightState = true : usRightState = false;
-    front == "1" ? usFrontState = true : usFrontState = false;
+    if(!device.empty() && isdigit((unsigned char)device[0]))
+        wideCap.open(atoi(device.c_str()));
+    else
+        wideCap.open(device);
+    if(!wideCap.isOpened())
+        return 1;
+    
+    wideCenterX = ColorDetector::getScreenSize(wideCap).x / 2;
+    wideGrabber = new FrameGrabber(wideCap);
+    if(wideGrabber->start() != FrameGrabber::ERROR_NONE)
+        return 1;
+    
+    // Look for the same colors the same way as the camera on the servos
+    wideCd = new ColorDetector(wideCap, ColorDetector::GREEN, false,
+        ColorDetector::DEFAULT_WINDOW_WIDTH, false);
+    wideCd->setFrameSource(wideGrabber);
+    wideCd->setTargetColors(vector<int>(targetColors,
+        targetColors + sizeof(targetColors) / sizeof(targetColors[0])));
+    wideCd->setBlobMode(true);
+    
+    // The camera on the servos comes first, so a target both cameras see is aimed at
+    detectorGroup = new DetectorGroup();
+    detectorGroup->addDetector(cd);
+    detectorGroup->addDetector(wideCd);
+    return detectorGroup->start() == DetectorGroup::ERROR_NONE ? 0 : 1;
 }
 
-/** The program's starting point */
-int main()
+/** Opens a session log to replay in place of the camera, sensors and Arduino. The target
+ * area is set up from the size of the first recorded frame.
+ * @param fileName the session log to replay
+ * @param realTime should the frames be played at the pace they were recorded at
+ * @return error code, if any
+ */
+int setupReplay(const string &fileName, bool realTime)
 {
-    int x, y;  // holds the x and y of the target. these are set to -1 if no target is found.
-    bool xTargeted, yTargeted;  // flag for if the target is within the target area
-    int targetColor = ColorDetector::GREEN;
-    cd = new ColorDetector(cap, targetColor);
-    setupGPIO();  // Setup the GPIO pins
+    LogRecord record;
+    Mat frame;
+    size_t position;
+    
+    if(replayLog.open(fileName) != SessionReader::ERROR_NONE)
+        return 1;
+    
+    // Find the first frame that was read successfully to get the size of the screen
+    position = replayLog.begin();
+    while(replayLog.next(position, RECORD_FRAME, record))
+        if(SessionReader::getFrame(record, frame))
+            break;
+    if(frame.empty())
+        return 1;
+    setupTargetArea(Point(frame.cols, frame.rows));
     
-    int camError = setupCamera();  // Setup the camera and target area
+    sensorPosition = commandPosition = statePosition = replayLog.begin();
+    replaySource = new ReplayFrameSource(&replayLog, realTime);
+    cd->setFrameSource(withRecording(replaySource));
+    
+    return 0;
+}
+
+/** Reads the states of the 3 ultrasonic sensor pins into the sensed states to determine if
+ * there are an object within the collision threshold. When replaying, the states come from
+ * the log instead.
+ * @param timeout milliseconds to wait for the edge monitor to see a change, 0 to only check
+ * @return true if the states were read, false if the replayed log has no more states
+ */
+bool readUltrasonicStates(int timeout)
+{
+    TRACE_SPAN("ultrasonic read");
     
-    // if the camera could not be setup, show an error message and end the program
-    if(camError)
+    if(replaySource)
+    {
+        LogRecord record;
+        
+        if(!replayLog.next(sensorPosition, RECORD_SENSORS, record))
+            return false;
+        SessionReader::getSensors(record, sensedStates.left, sensedStates.right,
+            sensedStates.front);
+    }
+    else if(usEdges.getFd() >= 0)
     {
-    	cout << "Error: There was a problem setting up the camera." << endl;
-    	return 1;
+        // Only the pins that changed since the last pass need to be looked at
+        applyUltrasonicEdges(timeout);
+    }
+    else
+    {
+        // Get the states of the 3 ultrasonic pins
+        leftUS->getval_gpio(sensedStates.left);
+        rightUS->getval_gpio(sensedStates.right);
+        frontUS->getval_gpio(sensedStates.front);
     }
     
-    sendCommand(MOVE_FORWARD);  // Start the robot by telling it to move forward
-    state = STATE_SEARCHING;  // set state to looking for target
+    return true;
+}
+
+/** Looks for every target color in one frame and picks the found color with the highest
+ * priority. With a wide camera, both cameras' frames are searched at once, and a color seen
+ * by both is taken from the camera on the servos.
+ * @param x a reference to a variable to hold the x coordinate of the target, -1 if none was found
+ * @param y a reference to a variable to hold the y coordinate of the target, -1 if none was found
+ * @param source a reference to a variable to hold the camera that found the target
+ * @param color a reference to a variable to hold the color code of the target, -1 if none
+ * was found
+ * @return ColorDetector::ERROR_CANNOT_READ_CAMERA if no frame could be read, or else
+ * ColorDetector::ERROR_NONE
+ */
+int findTarget(int &x, int &y, int &source, int &color)
+{
+    x = -1;
+    y = -1;
+    source = 0;
+    color = -1;
     
-    // main robot logic loop
-    while(true)
+    if(detectorGroup)
     {
-    	getUltrasonicStates(); // Determines if there are any objects in collision range
-    	//cout << usLeftState << " " << usRightState << " " << usFrontState << endl;
-    	
-        // if the robot is searching...
-    	if(state == STATE_SEARCHING)
-    	{
-            // If object detected in front
-            if(usFrontState)
-            {
-                sendCommand(STOP); // Stop
-                
-                // Rotate left or right
-                if(!usLeftState)
-                {
-                    sendCommand(TURN_LEFT);	// Turn left to avoid object in front
-                    state = STATE_AVOIDING_LEFT; // Set state to avoiding object
-                }
-                else if(!usRightState)
-                {
-                    sendCommand(TURN_RIGHT);	// Turn right to avoid object in front
-                    state = STATE_AVOIDING_RIGHT; // Set state to avoiding object
-                }
-            }
-            // If object detected to the right
-            else if(usRightState)
+        if(detectorGroup->findColors(groupDetections) != DetectorGroup::ERROR_NONE)
+            return ColorDetector::ERROR_CANNOT_READ_CAMERA;
+        
+        for(size_t i = 0; i < groupDetections.size(); ++i)
+        {
+            if(groupDetections[i].source >= 0)
             {
-                sendCommand(TURN_LEFT); // Turn left to avoid object on right
-                state = STATE_AVOIDING_LEFT; // Set state to avoiding object
+                x = groupDetections[i].result.x;
+                y = groupDetections[i].result.y;
+                source = groupDetections[i].source;
+                color = groupDetections[i].result.color;
+                break;
             }
-            // If object detected to the left
-            else if(usLeftState)
+        }
+        
+        return ColorDetector::ERROR_NONE;
+    }
+    
+    int error = cd->findColorsFromCam(colorResults);
+    if(error == ColorDetector::ERROR_CANNOT_READ_CAMERA)
+        return error;
+    if(error != ColorDetector::ERROR_NONE)
+        return ColorDetector::ERROR_NONE;  // the frame was read, but nothing was found
+    
+    // The results are in priority order, so take the first color that was found
+    for(size_t i = 0; i < colorResults.size(); ++i)
+    {
+        if(colorResults[i].found)
+        {
+            x = colorResults[i].x;
+            y = colorResults[i].y;
+            color = colorResults[i].color;
+            break;
+        }
+    }
+    
+    return ColorDetector::ERROR_NONE;
+}
+
+/** Runs the robot's state machine on the newest sensor states and what the vision stage found
+ * @param vision what the vision stage found in a new frame for the current state, NULL if
+ * there is no new frame
+ */
+void updateState(const VisionResult *vision)
+{
+    bool xTargeted, yTargeted;  // flag for if the target is within the target area
+    int yawSteps, pitchSteps;  // the camera steps to turn toward the target
+    
+    // if the robot is searching...
+    if(state == STATE_SEARCHING)
+    {
+        // If object detected in front
+        if(usFrontState)
+        {
+            sendCommand(STOP); // Stop
+            
+            // Rotate left or right
+            if(!usLeftState)
             {
-                sendCommand(TURN_RIGHT); // Turn right to avoid object on left
-                state = STATE_AVOIDING_RIGHT; // Set state to avoiding object
+                sendCommand(TURN_LEFT);	// Turn left to avoid object in front
+                setState(STATE_AVOIDING_LEFT); // Set state to avoiding object
             }
-	        
-            // Look for target color
-            cd->findColorFromCam(x, y);
-            //cout << x << "  " << y << endl;
-
-            // If target color is detected
-            if(x != -1 && y != -1)
+            else if(!usRightState)
             {
-                sendCommand(STOP);  // Stop
-                state = STATE_TARGETING;  // Set state to targeting
+                sendCommand(TURN_RIGHT);	// Turn right to avoid object in front
+                setState(STATE_AVOIDING_RIGHT); // Set state to avoiding object
             }
         }
-        // If the robot is turning right to avoid an object
-        else if(state == STATE_AVOIDING_RIGHT)
+        // If object detected to the right
+        else if(usRightState)
         {
-            // If no object are detected to the left or front
-            if(!usLeftState && !usFrontState)
-            {
-                // Stop turning right and start searching
-                sendCommand(CENTER_CAMERA);
-                sendCommand(MOVE_FORWARD);
-                state = STATE_SEARCHING;
-            }
+            sendCommand(TURN_LEFT); // Turn left to avoid object on right
+            setState(STATE_AVOIDING_LEFT); // Set state to avoiding object
         }
-        // If the robot is turning left to avoid an object
-        else if(state == STATE_AVOIDING_LEFT)
+        // If object detected to the left
+        else if(usLeftState)
         {
-            // If no object are detected to the right or front
-            if(!usRightState && !usFrontState)
-            {
-                // Stop turning left and start searching
-                sendCommand(CENTER_CAMERA);
-                sendCommand(MOVE_FORWARD);
-                state = STATE_SEARCHING;
-            }
+            sendCommand(TURN_RIGHT); // Turn right to avoid object on left
+            setState(STATE_AVOIDING_RIGHT); // Set state to avoiding object
+        }
+        
+        // If target color is detected by the camera on the servos
+        if(vision && vision->x != -1 && vision->y != -1 && vision->source == 0)
+        {
+            sendCommand(STOP);  // Stop
+            
+            // Lock on to the color that was found, and only search around it while aiming
+            lockedColor = vision->color;
+            setState(STATE_TARGETING);  // Set state to targeting
+            turningToTarget = false;
+            
+            // Aim at the new target from scratch
+            aimController.reset();
+            lastFrameTime = vision->frameTime;
+        }
+        // If only the wide camera sees the target, turn toward it until the camera on the
+        // servos sees it too
+        else if(vision && vision->x != -1 && state == STATE_SEARCHING)
+        {
+            sendCommand(vision->x < wideCenterX ? TURN_LEFT : TURN_RIGHT);
+            turningToTarget = true;
+        }
+        // If the wide camera lost the target before the camera on the servos saw it
+        else if(vision && turningToTarget && state == STATE_SEARCHING)
+        {
+            sendCommand(MOVE_FORWARD);
+            turningToTarget = false;
+        }
+    }
+    // If the robot is turning right to avoid an object
+    else if(state == STATE_AVOIDING_RIGHT)
+    {
+        // If no object are detected to the left or front
+        if(!usLeftState && !usFrontState)
+        {
+            // Stop turning right and start searching
+            sendCommand(CENTER_CAMERA);
+            sendCommand(MOVE_FORWARD);
+            setState(STATE_SEARCHING);
+        }
+    }
+    // If the robot is turning left to avoid an object
+    else if(state == STATE_AVOIDING_LEFT)
+    {
+        // If no object are detected to the right or front
+        if(!usRightState && !usFrontState)
+        {
+            // Stop turning left and start searching
+            sendCommand(CENTER_CAMERA);
+            sendCommand(MOVE_FORWARD);
+            setState(STATE_SEARCHING);
+        }
+    }
+    // If the robot is aiming at a target and a new frame was searched
+    else if(state == STATE_TARGETING && vision)
+    {
+        // If no object is detected
+        if(vision->x == -1 && vision->y == -1)
+        {
+            // tell the robot to start searching again
+            setState(STATE_SEARCHING);
+            sendCommand(CENTER_CAMERA);
+            sendCommand(STOP_FIRING);
+            sendCommand(MOVE_FORWARD);
         }
-        // If the robot is aiming at a target
-        else if(state == STATE_TARGETING)
+        // if an object is detected
+        else
         {
-            // Look for target color
-            cd->findColorFromCam(x, y);
-            //cout << "tx:" << targetArea.x << " tw:" << targetArea.width << " x:" << x << endl;
+            int x = vision->x, y = vision->y;
+            
+            // The target flags are set if the x and y of the target are within the
+            // target area
+            xTargeted = x >= targetArea.x && x <= targetArea.x + targetArea.width;
+            yTargeted = y >= targetArea.y && y <= targetArea.y + targetArea.height;
 
-            // If no object is detected
-            if(x == -1 && y == -1)
-            {
-                // tell the robot to start searching again
-                state = STATE_SEARCHING;
-                sendCommand(CENTER_CAMERA);
-                sendCommand(STOP_FIRING);
-                sendCommand(MOVE_FORWARD);
-            }
-            // if an object is detected
+            // Turn the camera by as many steps as the target is away from the middle of
+            // the view, timed by the frames instead of one step a frame
+            aimController.update(targetArea.x + targetArea.width / 2 - x,
+                targetArea.y + targetArea.height / 2 - y, vision->frameTime - lastFrameTime,
+                yawSteps, pitchSteps);
+            lastFrameTime = vision->frameTime;
+            sendSteps(yawSteps, LOOK_LEFT, LOOK_RIGHT);
+            sendSteps(pitchSteps, LOOK_UP, LOOK_DOWN);
+
+            // If both target x and y are in the target area
+            if(xTargeted && yTargeted)
+                sendCommand(START_FIRING);  // fire at target
+            // target x and y are not in the target area
             else
-            {
-                // Clear the target flags. They are set if below if the x and y of
-                // the target is within the target area.
-                xTargeted = false;
-                yTargeted = false;
-
-                // If the target x is to the left of the target area
-                if(x < targetArea.x)
-                    sendCommand(LOOK_LEFT);
-                // If the target x is to the right of the target area
-                else if(x > targetArea.x + targetArea.width)
-                    sendCommand(LOOK_RIGHT);
-                // target x is in the target area
-                else
-                    xTargeted = true;
-
-                // If the target y is above the target area
-                if(y < targetArea.y)
-                    sendCommand(LOOK_UP);
-                // If the target y is below the target area
-                else if(y > targetArea.y + targetArea.height)
-                    sendCommand(LOOK_DOWN);
-                // target y is in the target area
-                else
-                    yTargeted = true;
-
-                // If both target x and y are in the target area
-                if(xTargeted && yTargeted)
-                    sendCommand(START_FIRING);  // fire at target
-                // target x and y are not in the target area
-                else
-                    sendCommand(STOP_FIRING);  // stop firing
-            }
+                sendCommand(STOP_FIRING);  // stop firing
         }
-    	
-    	if(waitKey(30) == 27) break;  // wait for the user to press the escape key
+    }
+}
+
+/** SensorStage Class
+ * Purpose: Reads the ultrasonic sensors and hands their states to the control stage. On its
+ * own thread it waits on the pins' edges, or reads the pins every millisecond, and only
+ * hands over changes, so an object is seen without waiting for a frame to be searched.
+ */
+class SensorStage : public PipelineStage
+{
+private:
+    bool published;  // have the states been handed over yet
+
+public:
+    /** Constructor to create a SensorStage object
+     * @param idleWait microseconds to sleep after a read that found no change
+     */
+    SensorStage(int idleWait) : PipelineStage("sensors", idleWait)
+    {
+        this->published = false;
+    }
+
+protected:
+    int step()
+    {
+        SensorStates last = sensedStates;  // the states handed over last
+        
+        if(!readUltrasonicStates(pipelined ? SENSOR_WAIT : 0))
+            return STEP_FINISHED;
+        
+        // Passes run in order hand over every read, the way the old loop recorded them
+        if(pipelined && published && last.left == sensedStates.left &&
+            last.right == sensedStates.right && last.front == sensedStates.front)
+            return STEP_IDLE;
+        
+        sensorCell.publish(sensedStates);
+        published = true;
+        return STEP_WORKED;
+    }
+};
+
+/** VisionStage Class
+ * Purpose: Searches each frame for what the control stage asked for, and hands what it found
+ * to the control stage. Only this stage uses the color detector once the stages start.
+ */
+class VisionStage : public PipelineStage
+{
+private:
+    VisionRequest request;  // what to look for
+    int x, y;  // where the target was last seen. A frame that can't be read leaves them as they were.
+
+public:
+    /** Constructor to create a VisionStage object that looks for nothing */
+    VisionStage() : PipelineStage("vision", VISION_IDLE_WAIT)
+    {
+        this->request.mode = VISION_IDLE;
+        this->request.color = -1;
+        this->request.generation = 0;
+        this->x = -1;
+        this->y = -1;
+    }
+
+protected:
+    int step()
+    {
+        VisionRequest newRequest;
+        VisionResult result;
+        
+        if(requestCell.take(newRequest))
+        {
+            request = newRequest;
+            if(request.mode == VISION_TRACK)
+                cd->setColor(request.color);
+            cd->setTrackingWindow(request.mode == VISION_TRACK);
+        }
+        if(request.mode == VISION_IDLE)
+            return STEP_IDLE;
+        
+        // Look for every target color, or for the locked color near where it was last seen
+        int error;
+        if(request.mode == VISION_SEARCH)
+            error = findTarget(x, y, result.source, result.color);
+        else
+        {
+            error = cd->findColorFromCam(x, y);
+            result.color = request.color;
+            result.source = 0;
+        }
+        
+        // Without a new frame the old target would go out again as if it were new, and the
+        // control stage would turn the camera toward it a second time
+        if(error == ColorDetector::ERROR_CANNOT_READ_CAMERA)
+            return grabber && !grabber->isRunning() ? STEP_FINISHED : STEP_IDLE;
+        
+        result.x = x;
+        result.y = y;
+        result.frameTime = getFrameTime();
+        result.generation = request.generation;
+        visionCell.publish(result);
+        
+        // The robot can't go on once the camera stops
+        return grabber && !grabber->isRunning() ? STEP_FINISHED : STEP_WORKED;
+    }
+};
+
+/** ControlStage Class
+ * Purpose: Runs the state machine whenever the sensor or vision stage hands over something
+ * new, and sends the commands. The commands are posted to the command sender, which writes
+ * them on its own thread.
+ */
+class ControlStage : public PipelineStage
+{
+private:
+    std::atomic<long> staleResults;  // the vision results dropped because they were for an old state
+
+public:
+    /** Constructor to create a ControlStage object */
+    ControlStage() : PipelineStage("control", CONTROL_IDLE_WAIT)
+    {
+        this->staleResults = 0;
+    }
+
+    /** Gets the number of vision results dropped because the state changed while the frame
+     * was being searched
+     * @return the number of stale results
+     */
+    long getStaleResults() { return staleResults; }
+
+protected:
+    int step()
+    {
+        SensorStates states;
+        VisionResult vision;
+        bool sensed = sensorCell.take(states);
+        bool seen = visionCell.take(vision);
+        
+        if(sensed)
+        {
+            usLeftState = states.left;
+            usRightState = states.right;
+            usFrontState = states.front;
+            if(recorder.isOpen())
+                recorder.recordSensors(usLeftState, usRightState, usFrontState);
+        }
+        if(seen && vision.generation != visionGeneration)
+        {
+            ++staleResults;
+            seen = false;
+        }
+        if(!sensed && !seen)
+            return STEP_IDLE;
+        
+        updateState(seen ? &vision : NULL);
+        return STEP_WORKED;
+    }
+};
+
+SensorStage *sensorStage;  // reads the ultrasonic sensors
+VisionStage *visionStage;  // searches the frames
+ControlStage *controlStage;  // runs the state machine and sends the commands
+
+/** Runs one pass of each stage in order on the main thread, the way the loop ran before the
+ * stages had their own threads. The vision stage only runs in the states that look at frames.
+ * @return false once the replayed log or the camera runs out
+ */
+bool runStagesInOrder()
+{
+    if(sensorStage->runOnce() == PipelineStage::STEP_FINISHED)
+        return false;
+    
+    bool finished = false;  // did the frames run out
+    if(state == STATE_SEARCHING || state == STATE_TARGETING)
+        finished = visionStage->runOnce() == PipelineStage::STEP_FINISHED;
+    
+    controlStage->runOnce();
+    return !finished;
+}
+
+/** Prints how many passes of each stage did something, how often, and how busy they kept
+ * their threads
+ * @param seconds how long the stages ran
+ */
+void printStageCounters(double seconds)
+{
+    PipelineStage *stages[] = { sensorStage, visionStage, controlStage };
+    
+    cout << fixed << setprecision(1);
+    for(int i = 0; i < 3; ++i)
+        cout << "Stage " << stages[i]->getName() << ": " << stages[i]->getUpdates()
+            << " updates, " << stages[i]->getUpdates() / seconds << " per second, "
+            << stages[i]->getBusyTime() * 100 / seconds << "% busy." << endl;
+    cout << "Snapshots: " << sensorCell.getOverwritten() << " sensor states and "
+        << visionCell.getOverwritten() << " vision results replaced before they were used, "
+        << controlStage->getStaleResults() << " vision results for an old state." << endl;
+    if(v4l2Capture)
+        cout << "V4L2: " << v4l2Capture->getFramesReleased() << " frames searched in place, "
+            << v4l2Capture->getBytesNotCopied() / max(v4l2Capture->getFramesReleased(), 1L)
+            << " bytes not copied per frame, " << v4l2Capture->getAverageLatency() * 1000
+            << " ms on average from capture until searched." << endl;
+    if(mjpegSource)
+        cout << "MJPEG: " << mjpegSource->getFramesDecoded() << " frames decoded at 1/"
+            << mjpegSource->getScale() << " size, " << mjpegSource->getDecodeErrors()
+            << " could not be decoded." << endl;
+    if(detectorGroup)
+        cout << "Detector group: " << detectorGroup->getFramesSearched() << " frames searched on "
+            << detectorGroup->getThreadCount() << " threads." << endl;
+}
+
+/** Asks the main loop to write the trace file. Called on SIGUSR1.
+ * @param signal the signal number
+ */
+void requestTrace(int signal)
+{
+    traceRequested = 1;
+}
+
+/** Asks the main loop to stop the stages and the robot. Called on SIGINT and SIGTERM.
+ * @param signal the signal number
+ */
+void requestStop(int signal)
+{
+    stopRequested = 1;
+}
+
+/** Turns on tracing if the SNIPERBOT_TRACE environment variable names a trace file. The
+ * trace is written when the program ends, or any time the program gets SIGUSR1.
+ */
+void setupTrace()
+{
+    traceFile = getenv("SNIPERBOT_TRACE");
+    if(!traceFile)
+        return;
+    
+    Tracer::setEnabled(true);
+    signal(SIGUSR1, requestTrace);
+}
+
+/** Writes the trace file if tracing is on */
+void writeTrace()
+{
+    if(traceFile && Tracer::dump(traceFile) != Tracer::ERROR_NONE)
+        cout << "Error: Could not write the trace to " << traceFile << endl;
+}
+
+/** The program's starting point.
+ * With "--record <log file>", writes the frames, sensor states, state changes and commands
+ * to a session log.
+ * With "--replay <log file>", runs the session in the log instead of the camera, sensors and
+ * Arduino, and checks that the same commands and state changes come out. Add "--realtime"
+ * to play it at the pace it was recorded at instead of as fast as possible.
+ * With "--serial <device>", sends commands to the Arduino as packets over the serial port
+ * instead of on the data pins. Without it, the camera turns at most PIN_MAX_STEPS steps on
+ * each axis in a frame.
+ * With "--dead-zone <pixels>", sets how close to the middle of the view the target has to be
+ * for the camera to stop turning.
+ * With "--wide-camera <device>", also searches a fixed wide angle camera, and turns the robot
+ * toward targets only it sees. Not used when recording or replaying.
+ * With "--mjpeg <width>", reads MJPEG from the camera and decodes it at close to the width
+ * instead of at full size, then searches it at the width. Not used when recording, since the
+ * replay sizes the target area from the recorded frames.
+ * With "--v4l2 <device>", reads the camera's own buffers from the video device instead of
+ * copying each frame through VideoCapture. The frames are YUYV, or MJPEG with "--mjpeg".
+ * YUYV frames are classified straight from YUV with a lookup table.
+ */
+int main(int argc, char **argv)
+{
+    int targetColor = ColorDetector::GREEN;
+    string recordFile, replayFile;  // the session logs to write and read, empty if not used
+    string serialDevice;  // the serial port to the Arduino, empty to use the data pins
+    string wideDevice;  // the wide camera, empty if there is none
+    bool realTime = false;  // should the replay run at the pace it was recorded at
+    
+    for(int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if(arg == "--record" && i + 1 < argc)
+            recordFile = argv[++i];
+        else if(arg == "--replay" && i + 1 < argc)
+            replayFile = argv[++i];
+        else if(arg == "--realtime")
+            realTime = true;
+        else if(arg == "--serial" && i + 1 < argc)
+            serialDevice = argv[++i];
+        else if(arg == "--dead-zone" && i + 1 < argc)
+            aimController.setDeadZone(atof(argv[++i]));
+        else if(arg == "--wide-camera" && i + 1 < argc)
+            wideDevice = argv[++i];
+        else if(arg == "--mjpeg" && i + 1 < argc)
+            mjpegWidth = atol(argv[++i]);
+        else if(arg == "--v4l2" && i + 1 < argc)
+            v4l2Device = argv[++i];
+    }
+    
+    // Each step is its own command on the data pins, so keep the bursts short. Packets fold
+    // the steps into one angle. Set from the arguments so a replay caps the same way.
+    if(serialDevice.empty())
+        aimController.setMaxSteps(PIN_MAX_STEPS);
+    
+    cd = new ColorDetector(cap, targetColor);
+    cd->setTargetColors(vector<int>(targetColors,
+        targetColors + sizeof(targetColors) / sizeof(targetColors[0])));
+    cd->setBlobMode(true);  // aim at one object instead of between two of the same color
+    cd->setYuvClasses(true);  // classify YUYV frames without converting them to BGR
+    setupTrace();  // Start tracing if a trace file was given
+    
+    if(!recordFile.empty() && recorder.open(recordFile) != SessionRecorder::ERROR_NONE)
+    {
+        cout << "Error: Could not create the session log " << recordFile << endl;
+        return 1;
+    }
+    if(recorder.isOpen())
+        mjpegWidth = 0;
+    
+    if(!replayFile.empty())
+    {
+        // Replay the log in place of the camera, sensors and Arduino
+        if(setupReplay(replayFile, realTime))
+        {
+            cout << "Error: Could not replay the session log " << replayFile << endl;
+            return 1;
+        }
+    }
+    else
+    {
+        setupGPIO();  // Setup the GPIO pins
+        
+        if(!serialDevice.empty() && commandLink.open(serialDevice) != SerialLink::ERROR_NONE)
+        {
+            cout << "Error: Could not open the serial port " << serialDevice << endl;
+            return 1;
+        }
+        
+        // Only the serial link can point the camera at an exact angle
+        if(commandLink.isOpen())
+            commandOutput = new SerialCommandOutput(commandLink);
+        else
+            commandOutput = new PinCommandOutput();
+        commandSender = new CommandSender(*commandOutput, commandLink.isOpen(),
+            commandLink.isOpen() ? 0 : PIN_COMMAND_GAP);
+        commandSender->start();
         
-        return 0;  // return no error and end the program
+        int camError = setupCamera();  // Setup the camera and target area
+        
+        // if the camera could not be setup, show an error message and end the program
+        if(camError)
+        {
+            cout << "Error: There was a problem setting up the camera." << endl;
+            return 1;
+        }
+        
+        // The session log only holds one camera's frames, so the wide camera is live only
+        if(!wideDevice.empty() && !recorder.isOpen() && setupWideCamera(wideDevice))
+        {
+            cout << "Error: There was a problem setting up the wide camera " << wideDevice << endl;
+            return 1;
+        }
+    }
+    
+    sendCommand(MOVE_FORWARD);  // Start the robot by telling it to move forward
+    setState(STATE_SEARCHING);  // set state to looking for target
+    
+    // Ctrl+C and kill stop the stages and the robot instead of ending the program mid command
+    signal(SIGINT, requestStop);
+    signal(SIGTERM, requestStop);
+    
+    // A recorded session runs the stages in order, so its replay runs them the same way
+    pipelined = !recorder.isOpen() && !replaySource;
+    sensorStage = new SensorStage(usEdges.getFd() >= 0 ? 0 : SENSOR_POLL_INTERVAL);
+    visionStage = new VisionStage();
+    controlStage = new ControlStage();
+    chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+    
+    if(pipelined)
+    {
+        sensorStage->start();
+        visionStage->start();
+        controlStage->start();
     }
+    
+    // main robot logic loop
+    while(!stopRequested)
+    {
+        TRACE_SPAN("loop iteration");
+        
+        // The stages run on their own threads, so this thread only watches for the end
+        if(pipelined)
+        {
+            if(!sensorStage->isRunning() || !visionStage->isRunning() || !controlStage->isRunning())
+                break;
+        }
+        // Run each stage once. This only fails when the replay or the camera is over.
+        else if(!runStagesInOrder())
+            break;
+    	
+        // Write the trace if it was asked for
+        if(traceRequested)
+        {
+            traceRequested = 0;
+            writeTrace();
+        }
+    	
+        // The replay is over once the frames run out. Otherwise wait for the user to press
+        // the escape key.
+        if(replaySource)
+        {
+            if(replaySource->isFinished())
+                break;
+        }
+        else if(!pipelined && usEdges.getFd() >= 0)
+        {
+            // Wait on the ultrasonic pins instead of sleeping, so an obstacle ends the wait
+            // as soon as it is seen
+            applyUltrasonicEdges(30);
+            
+            TRACE_SPAN("waitKey");
+            if(waitKey(1) == 27) break;  // check if the user pressed the escape key
+        }
+        else
+        {
+            TRACE_SPAN("waitKey");
+            if(waitKey(30) == 27) break;  // wait for the user to press the escape key
+        }
+    }
+    
+    // Stop the control stage first so nothing new is sent, then the stages feeding it
+    controlStage->stop();
+    visionStage->stop();
+    sensorStage->stop();
+    if(detectorGroup)
+        detectorGroup->stop();
+    printStageCounters(chrono::duration<double>(chrono::steady_clock::now() - startTime).count());
+    
+    if(commandSender)
+    {
+        // Leave the robot stopped with the laser off. These are not recorded, since the
+        // replay ends with the log.
+        commandSender->post((uint8_t)STOP);
+        commandSender->post((uint8_t)STOP_FIRING);
+        commandSender->stop();  // send what is still queued
+        cout << "Commands: " << commandSender->getSent() << " sent, "
+            << commandSender->getSuppressed() << " suppressed, " << commandSender->getDropped()
+            << " dropped." << endl;
+    }
+    
+    writeTrace();
+    recorder.close();
+    
+    if(replaySource)
+    {
+        cout << "Replay checked " << replayedOutputs << " commands and state changes: "
+            << replayMismatches << " differed from the log, " << replayExtras
+            << " came after the end of the log." << endl;
+        return replayMismatches || replayExtras ? 1 : 0;
+    }
+    
+    return 0;  // return no error and end the program
 }
\ No newline at end of file
@@ -0,0 +1,159 @@
+#ifndef ARDUINO_H
+#define	ARDUINO_H
+
+/* The parts of the Arduino core that SniperBot.cpp uses, for building the firmware on Linux
+ * against the simulated Arduino in ArduinoSim.cpp. Time only passes on the simulation's
+ * virtual clock, so a sketch runs as fast as the host can run it.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+const uint8_t LOW = 0;
+const uint8_t HIGH = 1;
+
+const uint8_t INPUT = 0;
+const uint8_t OUTPUT = 1;
+const uint8_t INPUT_PULLUP = 2;
+
+const int CHANGE = 1;
+const int FALLING = 2;
+const int RISING = 3;
+
+const int DEC = 10;
+const int HEX = 16;
+
+const double PI = 3.1415926535897932384626433832795;
+
+// The registers SniperBot.cpp sets up, and their bits
+extern volatile uint8_t PCICR;  // pin change interrupt control
+extern volatile uint8_t PCMSK0;  // the pins of pin change interrupt 0
+extern volatile uint8_t TCCR4A;  // timer 4 control A
+extern volatile uint8_t TCCR4B;  // timer 4 control B
+extern volatile uint8_t TIMSK4;  // timer 4 interrupt mask
+extern volatile uint16_t OCR4A;  // timer 4 compare A
+
+const uint8_t PCIE0 = 0;
+const uint8_t CS40 = 0;
+const uint8_t CS41 = 1;
+const uint8_t CS42 = 2;
+const uint8_t WGM42 = 3;
+const uint8_t OCIE4A = 1;
+
+#define _BV(bit) (1 << (bit))
+
+// The interrupt vectors an ISR can be defined for, after the 6 external interrupts
+const int PCINT0_vect = 6;
+const int TIMER4_COMPA_vect = 7;
+
+/** IsrRegistration Struct
+ * Purpose: Connects a handler defined with ISR to its vector before setup runs.
+ */
+struct IsrRegistration
+{
+    IsrRegistration(int vector, void (*handler)());
+};
+
+/** Defines the handler of an interrupt vector, like avr-libc's ISR macro */
+#define ISR(vector) \
+    static void vector##_handler(); \
+    static IsrRegistration vector##_registration(vector, vector##_handler); \
+    static void vector##_handler()
+
+/** Limits a value to a range, like the Arduino's constrain macro
+ * @param value the value
+ * @param low the smallest value
+ * @param high the largest value
+ * @return the value inside the range
+ */
+template<class T, class L, class H> T constrain(T value, L low, H high)
+{
+    return value < low ? (T)low : value > high ? (T)high : value;
+}
+
+/** Gets the smaller of two values, like the Arduino's min macro
+ * @param a the first value
+ * @param b the second value
+ * @return the smaller value
+ */
+template<class T> T min(T a, T b)
+{
+    return a < b ? a : b;
+}
+
+/** Gets the larger of two values, like the Arduino's max macro
+ * @param a the first value
+ * @param b the second value
+ * @return the larger value
+ */
+template<class T> T max(T a, T b)
+{
+    return a > b ? a : b;
+}
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout = 1000000L);
+void attachInterrupt(uint8_t interrupt, void (*handler)(), int mode);
+void detachInterrupt(uint8_t interrupt);
+uint8_t digitalPinToInterrupt(uint8_t pin);
+uint8_t digitalPinToPCMSKbit(uint8_t pin);
+void interrupts();
+void noInterrupts();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+unsigned long millis();
+unsigned long micros();
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration = 0);
+void noTone(uint8_t pin);
+
+/** HardwareSerial Class
+ * Purpose: One of the Mega's UARTs. Bytes written go out at the baud rate through a 64 byte
+ * buffer, and bytes sent to the Arduino wait in a 64 byte receive buffer.
+ */
+class HardwareSerial
+{
+private:
+    int port;  // the UART's number
+
+public:
+    HardwareSerial(int port) { this->port = port; }
+
+    void begin(unsigned long baud);
+    void end();
+    int available();
+    int peek();
+    int read();
+    void flush();
+    size_t write(uint8_t value);
+    size_t write(const uint8_t *buffer, size_t size);
+    size_t print(const char *text);
+    size_t print(char value);
+    size_t print(unsigned char value, int base = DEC);
+    size_t print(int value, int base = DEC);
+    size_t print(unsigned int value, int base = DEC);
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(double value, int digits = 2);
+    size_t println();
+
+    /** Prints a value and ends the line
+     * @param value the value
+     * @return the number of bytes written
+     */
+    template<class T> size_t println(T value) { return print(value) + println(); }
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+extern HardwareSerial Serial3;
+
+#endif	/* ARDUINO_H */
@@ -0,0 +1,704 @@
+#include "Arduino.h"
+#include "Servo.h"
+#include "ArduinoSim.h"
+#include <stdio.h>
+#include <queue>
+
+using namespace std;
+using namespace SniperBot;
+
+// Roughly what each call takes on a 16 MHz Mega, in microseconds
+static const int DIGITAL_IO_TIME = 4;  // pinMode, digitalRead and digitalWrite
+static const int ISR_ENTRY_TIME = 3;  // saving registers and finding the attached handler
+static const int SERVO_WRITE_TIME = 8;  // Servo.write's math and its interrupts-off update
+static const int SERIAL_CALL_TIME = 2;  // available, read, and queueing one byte to send
+static const int LOOP_TIME = 1;  // the core's loop around the sketch's loop
+static const int ECHO_HOLDOFF = 750;  // microseconds a Ping sensor waits before its echo pulse
+static const int NO_ECHO_TIME = 18500;  // microseconds a Ping sensor's echo pulse lasts with no object
+static const int CYCLES_PER_US = 16;  // the Mega's clock
+
+static const int INTERRUPT_PINS[ArduinoSim::NUM_INTERRUPTS] = { 2, 3, 21, 20, 19, 18 };  // the Mega's pin of each external interrupt
+
+static const int EVENT_PIN = 0;  // a scheduled pin change
+static const int EVENT_SERIAL = 1;  // a scheduled serial byte
+static const int EVENT_ECHO = 2;  // a scheduled move of the object in front of a sensor
+
+/** SimEvent Struct
+ * Purpose: Holds something the outside world does at a virtual time.
+ */
+struct SimEvent
+{
+    long long time;  // when it happens, in microseconds
+    long long order;  // breaks ties so events at the same time happen in the order scheduled
+    int type;  // EVENT_PIN, EVENT_SERIAL or EVENT_ECHO
+    int target;  // the pin or UART
+    int value;  // the level, byte or distance
+};
+
+/** Orders events so the earliest is at the top of a priority queue */
+struct LaterEvent
+{
+    bool operator()(const SimEvent &a, const SimEvent &b) const
+    {
+        return a.time != b.time ? a.time > b.time : a.order > b.order;
+    }
+};
+
+/** SerialPort Struct
+ * Purpose: Holds the state of one simulated UART.
+ */
+struct SerialPort
+{
+    long baud;  // the baud rate, 0 if not started
+    deque<uint8_t> received;  // the receive buffer
+    long overflows;  // bytes lost to a full receive buffer
+    long long wireFreeAt;  // when the last byte sent to the Arduino finishes arriving
+    long long sendFreeAt;  // when the last byte the Arduino sent finishes going out
+    vector<SerialByte> output;  // the bytes the Arduino sent
+};
+
+static long long simClock;  // the virtual time in microseconds
+static long long eventOrder;  // the order of the next scheduled event
+static priority_queue<SimEvent, vector<SimEvent>, LaterEvent> events;  // what the outside world does next
+static bool pinLevels[ArduinoSim::NUM_PINS];  // the level of each pin
+static bool sensors[ArduinoSim::NUM_PINS];  // is there an ultrasonic sensor on each pin
+static int echoes[ArduinoSim::NUM_PINS];  // the echo distance of each ultrasonic pin in cm, 0 for none
+static int noiseEvery[ArduinoSim::NUM_PINS];  // pings per stray echo of each ultrasonic pin, 0 for none
+static int noiseEchoes[ArduinoSim::NUM_PINS];  // the distance of each ultrasonic pin's stray echoes in cm
+static long pings[ArduinoSim::NUM_PINS];  // the pings each ultrasonic pin has had
+static void (*handlers[ArduinoSim::NUM_VECTORS])();  // the attached interrupt handlers
+static void (*isrHandlers[ArduinoSim::NUM_VECTORS])();  // the handlers defined with ISR, which outlive reset
+static int modes[ArduinoSim::NUM_INTERRUPTS];  // the edge each interrupt fires on
+static bool pending[ArduinoSim::NUM_VECTORS];  // the interrupt flags
+static long long pendingEdge[ArduinoSim::NUM_VECTORS];  // when each flag was set
+static long long nextTimerTick;  // when timer 4 next matches compare A, -1 if it is stopped
+static bool enabled;  // are interrupts on
+static bool inIsr;  // is a handler running
+static vector<IsrRecord> isrRecords;  // every handler run
+static vector<ServoWrite> servoWrites;  // every servo change
+static long lostEdges;  // edges lost to a flag that was already set
+static long long isrTime;  // microseconds spent in handlers
+static long isrDelays;  // delays called in handlers
+static long long longestLoop;  // microseconds of the longest loop
+static SerialPort ports[ArduinoSim::NUM_PORTS];  // the UARTs
+
+volatile uint8_t PCICR;
+volatile uint8_t PCMSK0;
+volatile uint8_t TCCR4A;
+volatile uint8_t TCCR4B;
+volatile uint8_t TIMSK4;
+volatile uint16_t OCR4A;
+
+// Constructor
+IsrRegistration::IsrRegistration(int vector, void (*handler)())
+{
+    if(vector >= ArduinoSim::NUM_INTERRUPTS && vector < ArduinoSim::NUM_VECTORS)
+        isrHandlers[vector] = handler;
+}
+
+/** Flags an interrupt, or counts the lost edge if an external interrupt's flag is already set.
+ * A pin change handler reads the pins itself, so changes that share its flag are not counted.
+ * @param vector the interrupt's vector
+ */
+static void flag(int vector)
+{
+    // The AVR keeps one flag per interrupt, so a second edge before the handler runs is lost
+    if(pending[vector])
+    {
+        if(vector < ArduinoSim::NUM_INTERRUPTS)
+            ++lostEdges;
+        return;
+    }
+    pending[vector] = true;
+    pendingEdge[vector] = simClock;
+}
+
+/** Runs the handlers of the set interrupt flags, lowest number first like the AVR, if
+ * interrupts are on and no handler is running
+ */
+static void dispatch()
+{
+    while(enabled && !inIsr)
+    {
+        int interrupt = -1;
+        for(int i = 0; i < ArduinoSim::NUM_VECTORS && interrupt < 0; ++i)
+            if(pending[i])
+                interrupt = i;
+        if(interrupt < 0)
+            return;
+
+        IsrRecord record;
+        record.interrupt = interrupt;
+        record.edge = pendingEdge[interrupt];
+        record.start = simClock;
+        pending[interrupt] = false;
+
+        inIsr = true;
+        ArduinoSim::advance(ISR_ENTRY_TIME);
+        if(handlers[interrupt])
+            handlers[interrupt]();
+        inIsr = false;
+
+        record.end = simClock;
+        isrTime += record.end - record.start;
+        isrRecords.push_back(record);
+    }
+}
+
+/** Changes a pin's level and sets the flag of an interrupt watching it for that edge
+ * @param pin the pin
+ * @param value the new level
+ */
+static void setPin(int pin, bool value)
+{
+    bool old = pinLevels[pin];
+
+    pinLevels[pin] = value;
+    for(int i = 0; i < ArduinoSim::NUM_INTERRUPTS; ++i)
+    {
+        if(INTERRUPT_PINS[i] != pin || !handlers[i])
+            continue;
+        if(!(modes[i] == CHANGE && old != value) && !(modes[i] == RISING && !old && value) &&
+                !(modes[i] == FALLING && old && !value))
+            continue;
+        flag(i);
+    }
+
+    // Pin change interrupt 0 fires on either edge of the pins set in PCMSK0
+    uint8_t bit = digitalPinToPCMSKbit((uint8_t)pin);
+    if(old != value && bit < 8 && (PCMSK0 & _BV(bit)) && (PCICR & _BV(PCIE0)) &&
+            handlers[PCINT0_vect])
+        flag(PCINT0_vect);
+
+    dispatch();
+}
+
+/** Starts an ultrasonic sensor's echo pulse, after the sketch's trigger pulse on its pin
+ * @param pin the sensor's pin
+ */
+static void ping(int pin)
+{
+    int cm = echoes[pin];
+
+    ++pings[pin];
+    if(noiseEvery[pin] && pings[pin] % noiseEvery[pin] == 0)
+        cm = noiseEchoes[pin];
+
+    long long rise = simClock + ECHO_HOLDOFF;
+    ArduinoSim::schedulePin(rise, pin, true);
+    ArduinoSim::schedulePin(rise + (cm ? cm * 58LL : NO_ECHO_TIME), pin, false);  // the round trip at the speed of sound
+}
+
+/** Gets the microseconds between timer 4's compare matches, from its prescaler and OCR4A
+ * @return the microseconds between matches, 0 if the timer or its interrupt is off
+ */
+static long long timerPeriod()
+{
+    static const int PRESCALERS[] = { 0, 1, 8, 64, 256, 1024, 0, 0 };  // by the CS4 bits
+    int prescaler = PRESCALERS[TCCR4B & 7];
+
+    if(!prescaler || !(TIMSK4 & _BV(OCIE4A)) || !handlers[TIMER4_COMPA_vect])
+        return 0;
+
+    long long period = (OCR4A + 1LL) * prescaler / CYCLES_PER_US;
+    return period > 0 ? period : 1;
+}
+
+/** Gets the microseconds one byte takes on a UART, with a start and stop bit
+ * @param port the UART
+ * @return the microseconds per byte
+ */
+static long long byteTime(int port)
+{
+    long baud = ports[port].baud ? ports[port].baud : 9600;
+    return (10000000LL + baud - 1) / baud;
+}
+
+namespace SniperBot
+{
+    void ArduinoSim::reset()
+    {
+        simClock = 0;
+        eventOrder = 0;
+        events = priority_queue<SimEvent, vector<SimEvent>, LaterEvent>();
+        for(int i = 0; i < NUM_PINS; ++i)
+        {
+            pinLevels[i] = false;
+            sensors[i] = false;
+            echoes[i] = 0;
+            noiseEvery[i] = 0;
+            pings[i] = 0;
+        }
+        for(int i = 0; i < NUM_VECTORS; ++i)
+        {
+            handlers[i] = isrHandlers[i];
+            pending[i] = false;
+        }
+        PCICR = 0;
+        PCMSK0 = 0;
+        TCCR4A = 0;
+        TCCR4B = 0;
+        TIMSK4 = 0;
+        OCR4A = 0;
+        nextTimerTick = -1;
+        enabled = true;
+        inIsr = false;
+        isrRecords.clear();
+        servoWrites.clear();
+        lostEdges = 0;
+        isrTime = 0;
+        isrDelays = 0;
+        longestLoop = 0;
+        for(int i = 0; i < NUM_PORTS; ++i)
+        {
+            ports[i].baud = 0;
+            ports[i].received.clear();
+            ports[i].overflows = 0;
+            ports[i].wireFreeAt = 0;
+            ports[i].sendFreeAt = 0;
+            ports[i].output.clear();
+        }
+    }
+
+    void ArduinoSim::run(long long time)
+    {
+        while(simClock < time)
+        {
+            long long start = simClock;
+            loop();
+            advance(LOOP_TIME);
+            if(simClock - start > longestLoop)
+                longestLoop = simClock - start;
+        }
+    }
+
+    // now function
+    long long ArduinoSim::now() { return simClock; }
+
+    void ArduinoSim::advance(long long us)
+    {
+        long long target = simClock + us;
+
+        while(true)
+        {
+            // Timer 4 starts counting once the sketch sets it up, and stops if it is turned off
+            long long period = timerPeriod();
+            if(!period)
+                nextTimerTick = -1;
+            else if(nextTimerTick < 0)
+                nextTimerTick = simClock + period;
+
+            bool tick = nextTimerTick >= 0 && nextTimerTick <= target &&
+                (events.empty() || nextTimerTick < events.top().time);
+            if(tick)
+            {
+                if(nextTimerTick > simClock)
+                    simClock = nextTimerTick;
+                nextTimerTick += period;
+                flag(TIMER4_COMPA_vect);
+                dispatch();
+                continue;
+            }
+            if(events.empty() || events.top().time > target)
+                break;
+
+            SimEvent event = events.top();
+            events.pop();
+            if(event.time > simClock)
+                simClock = event.time;
+
+            if(event.type == EVENT_PIN)
+                setPin(event.target, event.value != 0);
+            else if(event.type == EVENT_ECHO)
+                echoes[event.target] = event.value;
+            else if((int)ports[event.target].received.size() < SERIAL_BUFFER_SIZE)
+                ports[event.target].received.push_back((uint8_t)event.value);
+            else
+                ++ports[event.target].overflows;
+        }
+
+        // A handler may have run past the target
+        if(simClock < target)
+            simClock = target;
+    }
+
+    void ArduinoSim::schedulePin(long long time, int pin, bool value)
+    {
+        SimEvent event = { time, eventOrder++, EVENT_PIN, pin, value ? 1 : 0 };
+        events.push(event);
+    }
+
+    long long ArduinoSim::scheduleSerial(long long time, int port, const uint8_t *data, int length)
+    {
+        SerialPort &serial = ports[port];
+        long long arrival = time > serial.wireFreeAt ? time : serial.wireFreeAt;
+
+        for(int i = 0; i < length; ++i)
+        {
+            arrival += byteTime(port);
+            SimEvent event = { arrival, eventOrder++, EVENT_SERIAL, port, data[i] };
+            events.push(event);
+        }
+        serial.wireFreeAt = arrival;
+
+        return arrival;
+    }
+
+    void ArduinoSim::setEcho(int pin, int cm)
+    {
+        sensors[pin] = true;
+        echoes[pin] = cm;
+    }
+
+    void ArduinoSim::scheduleEcho(long long time, int pin, int cm)
+    {
+        sensors[pin] = true;
+        SimEvent event = { time, eventOrder++, EVENT_ECHO, pin, cm };
+        events.push(event);
+    }
+
+    void ArduinoSim::setEchoNoise(int pin, int every, int cm)
+    {
+        noiseEvery[pin] = every;
+        noiseEchoes[pin] = cm;
+    }
+
+    // getPin function
+    bool ArduinoSim::getPin(int pin) { return pinLevels[pin]; }
+
+    // getIsrRecords function
+    const vector<IsrRecord> &ArduinoSim::getIsrRecords() { return isrRecords; }
+
+    // getServoWrites function
+    const vector<ServoWrite> &ArduinoSim::getServoWrites() { return servoWrites; }
+
+    // getSerialOutput function
+    const vector<SerialByte> &ArduinoSim::getSerialOutput(int port) { return ports[port].output; }
+
+    // getLostEdges function
+    long ArduinoSim::getLostEdges() { return lostEdges; }
+
+    // getIsrTime function
+    long long ArduinoSim::getIsrTime() { return isrTime; }
+
+    // getIsrDelays function
+    long ArduinoSim::getIsrDelays() { return isrDelays; }
+
+    // getSerialOverflows function
+    long ArduinoSim::getSerialOverflows(int port) { return ports[port].overflows; }
+
+    // getLongestLoop function
+    long long ArduinoSim::getLongestLoop() { return longestLoop; }
+
+    // inInterrupt function
+    bool ArduinoSim::inInterrupt() { return inIsr; }
+
+    // Constructor
+    SimLineGroup::SimLineGroup(const vector<int> &pins)
+    {
+        this->pins = pins;
+        this->values = 0;
+        this->time = 0;
+    }
+
+    // setTime function
+    void SimLineGroup::setTime(long long time) { this->time = time; }
+
+    // getTime function
+    long long SimLineGroup::getTime() { return time; }
+
+    int SimLineGroup::setValues(unsigned long long values, unsigned long long mask)
+    {
+        // Every line changes at the same moment, like one ioctl on the Pi
+        for(size_t i = 0; i < pins.size(); ++i)
+        {
+            unsigned long long bit = 1ULL << i;
+            if((mask & bit) && ((this->values ^ values) & bit))
+                ArduinoSim::schedulePin(time, pins[i], (values & bit) != 0);
+        }
+        this->values = (this->values & ~mask) | (values & mask);
+        time += SET_TIME;
+
+        return ERROR_NONE;
+    }
+
+    int SimLineGroup::getValues(unsigned long long &values, unsigned long long mask)
+    {
+        values = 0;
+        for(size_t i = 0; i < pins.size(); ++i)
+            if((mask & (1ULL << i)) && ArduinoSim::getPin(pins[i]))
+                values |= 1ULL << i;
+
+        return ERROR_NONE;
+    }
+
+    // wait function
+    void SimLineGroup::wait(int micros) { time += micros; }
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    (void)pin;
+    (void)mode;
+    ArduinoSim::advance(DIGITAL_IO_TIME);
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    ArduinoSim::advance(DIGITAL_IO_TIME);
+    if(pin >= ArduinoSim::NUM_PINS || pinLevels[pin] == (value != LOW))
+        return;
+
+    // The end of a trigger pulse pings a sensor
+    bool trigger = sensors[pin] && value == LOW;
+    setPin(pin, value != LOW);
+    if(trigger)
+        ping(pin);
+}
+
+int digitalRead(uint8_t pin)
+{
+    ArduinoSim::advance(DIGITAL_IO_TIME);
+    return pin < ArduinoSim::NUM_PINS && pinLevels[pin] ? HIGH : LOW;
+}
+
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout)
+{
+    long long end = simClock + timeout;
+    bool level = state != LOW;
+
+    if(pin >= ArduinoSim::NUM_PINS)
+    {
+        ArduinoSim::advance(timeout);
+        return 0;
+    }
+
+    // Wait for any pulse already going to end, then for the pulse to start and end, a
+    // microsecond at a time like the core's counting loop
+    while(pinLevels[pin] == level && simClock < end)
+        ArduinoSim::advance(1);
+    while(pinLevels[pin] != level && simClock < end)
+        ArduinoSim::advance(1);
+    long long start = simClock;
+    while(pinLevels[pin] == level && simClock < end)
+        ArduinoSim::advance(1);
+
+    return simClock < end ? (unsigned long)(simClock - start) : 0;
+}
+
+void attachInterrupt(uint8_t interrupt, void (*handler)(), int mode)
+{
+    if(interrupt >= ArduinoSim::NUM_INTERRUPTS)
+        return;
+    handlers[interrupt] = handler;
+    modes[interrupt] = mode;
+    pending[interrupt] = false;
+}
+
+void detachInterrupt(uint8_t interrupt)
+{
+    if(interrupt < ArduinoSim::NUM_INTERRUPTS)
+        handlers[interrupt] = NULL;
+}
+
+uint8_t digitalPinToPCMSKbit(uint8_t pin)
+{
+    // Only port B's pins, which are on pin change interrupt 0
+    if(pin >= 50 && pin <= 53)
+        return (uint8_t)(53 - pin);
+    if(pin >= 10 && pin <= 13)
+        return (uint8_t)(pin - 6);
+    return 0xFF;
+}
+
+uint8_t digitalPinToInterrupt(uint8_t pin)
+{
+    for(int i = 0; i < ArduinoSim::NUM_INTERRUPTS; ++i)
+        if(INTERRUPT_PINS[i] == pin)
+            return (uint8_t)i;
+    return 0xFF;
+}
+
+void interrupts()
+{
+    enabled = true;
+    dispatch();  // run whatever was flagged while they were off
+}
+
+void noInterrupts() { enabled = false; }
+
+void delay(unsigned long ms)
+{
+    if(inIsr)
+        ++isrDelays;
+    ArduinoSim::advance(ms * 1000LL);
+}
+
+void delayMicroseconds(unsigned int us) { ArduinoSim::advance(us); }
+
+unsigned long millis() { return (unsigned long)(simClock / 1000); }
+
+unsigned long micros() { return (unsigned long)simClock; }
+
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration)
+{
+    (void)frequency;
+    (void)duration;
+    digitalWrite(pin, HIGH);
+}
+
+void noTone(uint8_t pin) { digitalWrite(pin, LOW); }
+
+HardwareSerial Serial(0);
+HardwareSerial Serial1(1);
+HardwareSerial Serial2(2);
+HardwareSerial Serial3(3);
+
+void HardwareSerial::begin(unsigned long baud) { ports[port].baud = (long)baud; }
+
+void HardwareSerial::end() { ports[port].baud = 0; }
+
+int HardwareSerial::available()
+{
+    ArduinoSim::advance(SERIAL_CALL_TIME);
+    return (int)ports[port].received.size();
+}
+
+int HardwareSerial::peek()
+{
+    return ports[port].received.empty() ? -1 : ports[port].received.front();
+}
+
+int HardwareSerial::read()
+{
+    ArduinoSim::advance(SERIAL_CALL_TIME);
+    if(ports[port].received.empty())
+        return -1;
+
+    int value = ports[port].received.front();
+    ports[port].received.pop_front();
+    return value;
+}
+
+void HardwareSerial::flush()
+{
+    if(ports[port].sendFreeAt > simClock)
+        ArduinoSim::advance(ports[port].sendFreeAt - simClock);
+}
+
+size_t HardwareSerial::write(uint8_t value)
+{
+    SerialPort &serial = ports[port];
+    long long perByte = byteTime(port);
+
+    ArduinoSim::advance(SERIAL_CALL_TIME);
+
+    // With the send buffer full, wait for a byte to go out, even inside a handler
+    long long queued = serial.sendFreeAt > simClock ? (serial.sendFreeAt - simClock) / perByte : 0;
+    if(queued >= ArduinoSim::SERIAL_BUFFER_SIZE)
+        ArduinoSim::advance(serial.sendFreeAt - (ArduinoSim::SERIAL_BUFFER_SIZE - 1) * perByte - simClock);
+
+    serial.sendFreeAt = (serial.sendFreeAt > simClock ? serial.sendFreeAt : simClock) + perByte;
+    SerialByte sent = { serial.sendFreeAt, value };
+    serial.output.push_back(sent);
+
+    return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+    for(size_t i = 0; i < size; ++i)
+        write(buffer[i]);
+    return size;
+}
+
+size_t HardwareSerial::print(const char *text)
+{
+    size_t count = 0;
+    while(text[count])
+        write((uint8_t)text[count++]);
+    return count;
+}
+
+size_t HardwareSerial::print(char value) { return write((uint8_t)value); }
+
+size_t HardwareSerial::print(unsigned char value, int base) { return print((unsigned long)value, base); }
+
+size_t HardwareSerial::print(int value, int base) { return print((long)value, base); }
+
+size_t HardwareSerial::print(unsigned int value, int base) { return print((unsigned long)value, base); }
+
+size_t HardwareSerial::print(long value, int base)
+{
+    if(value < 0 && base == DEC)
+        return print('-') + print((unsigned long)-value, base);
+    return print((unsigned long)value, base);
+}
+
+size_t HardwareSerial::print(unsigned long value, int base)
+{
+    char text[33];
+    snprintf(text, sizeof(text), base == HEX ? "%lX" : "%lu", value);
+    return print(text);
+}
+
+size_t HardwareSerial::print(double value, int digits)
+{
+    char text[64];
+    snprintf(text, sizeof(text), "%.*f", digits, value);
+    return print(text);
+}
+
+size_t HardwareSerial::println() { return print("\r\n"); }
+
+// Constructor
+Servo::Servo()
+{
+    this->pin = -1;
+    this->angle = 90;
+}
+
+uint8_t Servo::attach(int pin)
+{
+    this->pin = pin;
+    return 1;
+}
+
+uint8_t Servo::attach(int pin, int min, int max)
+{
+    (void)min;
+    (void)max;
+    return attach(pin);
+}
+
+void Servo::detach() { pin = -1; }
+
+void Servo::write(int angle)
+{
+    // Values past 180 are pulse widths in microseconds, like the real library
+    if(angle >= 544)
+    {
+        writeMicroseconds(angle);
+        return;
+    }
+
+    angle = constrain(angle, 0, 180);
+    ArduinoSim::advance(SERVO_WRITE_TIME);
+    if(angle == this->angle)
+        return;
+
+    this->angle = angle;
+    ServoWrite change = { ArduinoSim::now(), pin, angle };
+    servoWrites.push_back(change);
+}
+
+void Servo::writeMicroseconds(int us)
+{
+    write((int)((constrain(us, 544, 2400) - 544) * 180L / (2400 - 544)));
+}
+
+// read function
+int Servo::read() { return angle; }
+
+// attached function
+bool Servo::attached() { return pin >= 0; }
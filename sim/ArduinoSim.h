@@ -0,0 +1,231 @@
+#ifndef ARDUINOSIM_H
+#define	ARDUINOSIM_H
+
+#include "GPIOLineGroup.h"
+#include <stdint.h>
+#include <vector>
+
+/** The sketch's entry points, defined in SniperBot.cpp */
+void setup();
+void loop();
+
+namespace SniperBot
+{
+    /** IsrRecord Struct
+     * Purpose: Holds one run of an interrupt handler.
+     */
+    struct IsrRecord
+    {
+        int interrupt;  // the interrupt's number
+        long long edge;  // when the edge that set the interrupt's flag happened, in microseconds
+        long long start;  // when the handler started, in microseconds
+        long long end;  // when the handler returned, in microseconds
+    };
+
+    /** ServoWrite Struct
+     * Purpose: Holds one change of a servo's angle.
+     */
+    struct ServoWrite
+    {
+        long long time;  // when the servo was written, in microseconds
+        int pin;  // the servo's pin
+        int angle;  // the new angle
+    };
+
+    /** SerialByte Struct
+     * Purpose: Holds one byte sent by the Arduino.
+     */
+    struct SerialByte
+    {
+        long long time;  // when the byte finished going out on the wire, in microseconds
+        uint8_t value;  // the byte
+    };
+
+    /** ArduinoSim Class
+     * Purpose: Runs a sketch against a simulated Arduino Mega with a virtual clock. Time only
+     * moves when the sketch calls into the core, by roughly what each call takes on a 16 MHz
+     * Mega, or when it waits with delay or pulseIn. Pin changes and serial bytes from the
+     * outside world are scheduled at virtual times and happen once the clock reaches them.
+     * External interrupts act like the AVR's: each has one flag, an edge that comes while
+     * the flag is still set is lost, and no handler runs while another one is running or
+     * interrupts are off. Pin change interrupt 0 and timer 4's compare interrupt can also be
+     * handled with ISR, and run after the external interrupts when several are flagged.
+     */
+    class ArduinoSim
+    {
+    public:
+        /** The number of digital pins on the Mega */
+        static const int NUM_PINS = 70;
+
+        /** The number of external interrupts on the Mega */
+        static const int NUM_INTERRUPTS = 6;
+
+        /** The number of interrupt vectors simulated: the external interrupts, then
+         * PCINT0_vect and TIMER4_COMPA_vect
+         */
+        static const int NUM_VECTORS = 8;
+
+        /** The number of UARTs on the Mega */
+        static const int NUM_PORTS = 4;
+
+        /** The bytes each UART's receive and transmit buffers hold */
+        static const int SERIAL_BUFFER_SIZE = 64;
+
+        /** Resets the Arduino: the clock goes to 0, pins go low, and every log is cleared */
+        static void reset();
+
+        /** Runs the sketch's loop until the clock reaches a time
+         * @param time the time to run until, in microseconds
+         */
+        static void run(long long time);
+
+        /** Gets the virtual time
+         * @return the virtual time in microseconds
+         */
+        static long long now();
+
+        /** Moves the clock forward, handling whatever was scheduled on the way
+         * @param us the microseconds to move
+         */
+        static void advance(long long us);
+
+        /** Schedules the outside world setting an input pin
+         * @param time when the pin changes, in microseconds
+         * @param pin the pin
+         * @param value the new level
+         */
+        static void schedulePin(long long time, int pin, bool value);
+
+        /** Schedules bytes to arrive on a UART, one after another at its baud rate
+         * @param time when the first byte starts on the wire, in microseconds. The bytes wait
+         * for any bytes still going out on the wire before them.
+         * @param port the UART
+         * @param data the bytes
+         * @param length the number of bytes
+         * @return when the last byte arrives, in microseconds
+         */
+        static long long scheduleSerial(long long time, int port, const uint8_t *data, int length);
+
+        /** Puts a Ping ultrasonic sensor on a pin and sets the echo it sends back. After the
+         * sketch pulses the pin high, the sensor waits, then holds the pin high for as long
+         * as the sound takes to come back.
+         * @param pin the sensor's pin
+         * @param cm the distance to the object in centimeters, 0 for no object
+         */
+        static void setEcho(int pin, int cm);
+
+        /** Schedules the object in front of an ultrasonic sensor moving
+         * @param time when it moves, in microseconds
+         * @param pin the sensor's pin
+         * @param cm the new distance to the object in centimeters, 0 for no object
+         */
+        static void scheduleEcho(long long time, int pin, int cm);
+
+        /** Makes an ultrasonic sensor pick up a stray echo now and then, like one from another
+         * sensor pinged at the same time
+         * @param pin the sensor's pin
+         * @param every how many pings there are for each stray echo, 0 for none
+         * @param cm the distance the stray echo reads as in centimeters
+         */
+        static void setEchoNoise(int pin, int every, int cm);
+
+        /** Gets the level of a pin
+         * @param pin the pin
+         * @return the level of the pin
+         */
+        static bool getPin(int pin);
+
+        /** Gets every run of an interrupt handler so far
+         * @return the runs, oldest first
+         */
+        static const std::vector<IsrRecord> &getIsrRecords();
+
+        /** Gets every change of a servo's angle so far
+         * @return the changes, oldest first
+         */
+        static const std::vector<ServoWrite> &getServoWrites();
+
+        /** Gets the bytes the Arduino has sent on a UART
+         * @param port the UART
+         * @return the bytes, oldest first
+         */
+        static const std::vector<SerialByte> &getSerialOutput(int port);
+
+        /** Gets the number of edges lost because the interrupt's flag was already set
+         * @return the number of lost edges
+         */
+        static long getLostEdges();
+
+        /** Gets the microseconds spent in interrupt handlers
+         * @return the microseconds spent in interrupt handlers
+         */
+        static long long getIsrTime();
+
+        /** Gets the number of times delay was called inside an interrupt handler, which hangs
+         * or misbehaves on a real Arduino
+         * @return the number of delays in interrupt handlers
+         */
+        static long getIsrDelays();
+
+        /** Gets the number of bytes lost because a UART's receive buffer was full
+         * @param port the UART
+         * @return the number of bytes lost
+         */
+        static long getSerialOverflows(int port);
+
+        /** Gets the longest one run of the sketch's loop took, including the handlers that
+         * interrupted it
+         * @return the microseconds of the longest loop
+         */
+        static long long getLongestLoop();
+
+        /** Gets if an interrupt handler is running
+         * @return if an interrupt handler is running
+         */
+        static bool inInterrupt();
+    };
+
+    /** SimLineGroup Class
+     * Purpose: Connects the Raspberry Pi's side of the robot to the simulated Arduino. Line i
+     * of the group drives one of the Arduino's pins, and every change is scheduled on the
+     * Arduino at the Pi's own time.
+     */
+    class SimLineGroup : public GPIOLineGroup
+    {
+    public:
+        /** The microseconds the Pi takes to change the lines once */
+        static const int SET_TIME = 2;
+
+    private:
+        std::vector<int> pins;  // the Arduino pin of each line
+        unsigned long long values;  // the values of the lines
+        long long time;  // the Pi's time, in microseconds
+
+    public:
+
+        /** Constructor to create a SimLineGroup object
+         * @param pins the Arduino pin of each line, in the order of the group
+         */
+        SimLineGroup(const std::vector<int> &pins);
+
+        /** Sets the Pi's time. The next change happens at this time.
+         * @param time the time in microseconds
+         */
+        void setTime(long long time);
+
+        /** Gets the Pi's time, which moves forward with each change
+         * @return the time in microseconds
+         */
+        long long getTime();
+
+        int setValues(unsigned long long values, unsigned long long mask);
+        int getValues(unsigned long long &values, unsigned long long mask);
+
+        /** Moves the Pi's time forward instead of sleeping
+         * @param micros the microseconds to wait
+         */
+        void wait(int micros);
+    };
+}
+
+#endif	/* ARDUINOSIM_H */
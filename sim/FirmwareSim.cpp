@@ -0,0 +1,533 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <stdlib.h>
+#include "ArduinoSim.h"
+#include "CommandProtocol.h"
+
+using namespace std;
+using namespace SniperBot;
+
+extern PacketDecoder commandDecoder;  // the sketch's decoder for Serial1
+extern int cameraVelocity[2];  // hundredths of a degree each camera servo turned in the last update
+
+// The sketch's pins, from SniperBot.cpp
+const int DATA_PINS[] = { 40, 41, 42, 43 };  // the 4 data bits
+const int TRIG_PIN = 3;  // the trigger, on interrupt 1
+const int TRIG_INTERRUPT = 1;  // the trigger's interrupt
+const int YAW_SERVO_PIN = 4;  // the camera yaw servo
+const int PITCH_SERVO_PIN = 2;  // the camera pitch servo
+const int LEFT_WHEEL_PIN = 7;  // the left wheel servo
+const int RIGHT_WHEEL_PIN = 52;  // the right wheel servo
+const int WHEEL_STOP = 90;  // the wheel servos' angle that stops them
+const int LASER_PIN = 9;  // the laser
+const int DEBUG_PORT = 0;  // the UART the sketch prints to
+const int COMMAND_PORT = 1;  // the UART the Pi sends packets on
+const int SENSOR_PINS[] = { 50, 51, 53 };  // the left, right and front ultrasonic sensors
+const int SENSOR_DATA_PINS[] = { 30, 31, 32 };  // the pins telling the Pi about each sensor's object
+const int NUM_SENSORS = 3;
+const int CAMERA_PERIOD = 5;  // milliseconds between camera servo updates
+
+const long long SETTLE_TIME = 10000;  // microseconds the sketch runs before the first command
+const long long DRAIN_TIME = 500000;  // microseconds the sketch runs after the last command
+const long long COMMAND_GAP = 50;  // the Pi's fewest microseconds between the starts of two commands, PIN_COMMAND_GAP in main.cpp
+
+/** Gets a percentile of a sorted list of values
+ * @param values the values, sorted
+ * @param p the percentile, from 0 to 100
+ * @return the value at the percentile
+ */
+double percentile(const vector<double> &values, double p)
+{
+    if(values.empty())
+        return 0;
+    size_t index = (size_t)(p / 100 * (values.size() - 1) + 0.5);
+    return values[index];
+}
+
+/** Prints the p50, p99 and largest of some times
+ * @param name what the times are
+ * @param times the times
+ * @param unit the unit of the times
+ */
+void printTimes(const string &name, vector<double> times, const string &unit = "us")
+{
+    sort(times.begin(), times.end());
+    cout << name << ": p50 " << percentile(times, 50) << " " << unit << ", p99 "
+        << percentile(times, 99) << " " << unit << ", max " << (times.empty() ? 0 : times.back())
+        << " " << unit << endl;
+}
+
+/** Splits what the sketch printed into lines
+ * @param port the UART
+ * @return the lines, without their line endings
+ */
+vector<string> getPrintedLines(int port)
+{
+    const vector<SerialByte> &output = ArduinoSim::getSerialOutput(port);
+    vector<string> lines(1);
+
+    for(size_t i = 0; i < output.size(); ++i)
+    {
+        if(output[i].value == '\n')
+            lines.push_back("");
+        else if(output[i].value != '\r')
+            lines.back() += (char)output[i].value;
+    }
+    if(lines.back().empty())
+        lines.pop_back();
+
+    return lines;
+}
+
+/** Gets the angle a servo was last written to
+ * @param pin the servo's pin
+ * @return the angle, -1 if the servo was never written
+ */
+int lastServoAngle(int pin)
+{
+    const vector<ServoWrite> &writes = ArduinoSim::getServoWrites();
+
+    for(size_t i = writes.size(); i > 0; --i)
+        if(writes[i - 1].pin == pin)
+            return writes[i - 1].angle;
+
+    return -1;
+}
+
+/** Prints how much of the run was spent in interrupt handlers and how fast it ran
+ * @param wallSeconds the real seconds the run took
+ */
+void printRunStats(double wallSeconds)
+{
+    double simSeconds = ArduinoSim::now() / 1e6;
+    long long longest = 0;
+    const vector<IsrRecord> &records = ArduinoSim::getIsrRecords();
+
+    for(size_t i = 0; i < records.size(); ++i)
+        longest = max(longest, records[i].end - records[i].start);
+
+    cout << "Interrupt handlers: " << records.size() << " runs, "
+        << 100.0 * ArduinoSim::getIsrTime() / ArduinoSim::now() << "% of the time, longest "
+        << longest << " us, " << ArduinoSim::getIsrDelays() << " delays inside a handler" << endl;
+    cout << setprecision(3) << "Simulated " << simSeconds << " s in " << wallSeconds << " s ("
+        << setprecision(0) << simSeconds / wallSeconds << "x real time)" << setprecision(1)
+        << endl;
+}
+
+/** Sends bursts of commands on the 4 bit command bus, like the main loop does each frame,
+ * and checks which ones the sketch's interrupt handler ran and with what data. A last burst
+ * stops the wheels and starts firing, and the wheels must stay stopped and the laser must
+ * flash after it.
+ * @param frameTime microseconds between bursts
+ * @param frames the number of bursts
+ * @param gap microseconds between the starts of the commands of a burst. A command still
+ * takes as long as its strobe, which holds the trigger for GPIOLineGroup::STROBE_HOLD.
+ * @return error code, if any
+ */
+int simulatePins(long long frameTime, int frames, long long gap)
+{
+    // The commands of each frame, taken from what the main loop sends while searching and aiming
+    const int bursts[][3] = {
+        { OP_CENTER_CAMERA, OP_MOVE_FORWARD, -1 },
+        { OP_STOP, -1, -1 },
+        { OP_LOOK_LEFT, OP_LOOK_UP, OP_STOP_FIRING },
+        { OP_LOOK_RIGHT, OP_STOP_FIRING, -1 },
+        { OP_START_FIRING, -1, -1 }
+    };
+    const int lastBurst[3] = { OP_STOP, OP_START_FIRING, -1 };  // checked on the wheels and laser
+    int numBursts = sizeof(bursts) / sizeof(bursts[0]);
+    vector<int> pins(DATA_PINS, DATA_PINS + 4);
+    pins.push_back(TRIG_PIN);
+    SimLineGroup bus(pins);
+    map<long long, int> strobes;  // the index of the command strobed at each time
+    vector<int> sent;  // every command sent
+
+    ArduinoSim::reset();
+    setup();
+
+    // Schedule every command, each one the gap after the last one started, or as soon as its
+    // strobe is done
+    for(int frame = 0; frame <= frames; ++frame)
+    {
+        const int *burst = frame < frames ? bursts[frame % numBursts] : lastBurst;
+        bus.setTime(SETTLE_TIME + frame * frameTime);
+        for(int c = 0; c < 3 && burst[c] >= 0; ++c)
+        {
+            int command = burst[c];
+            long long commandStart = bus.getTime();
+            strobes[commandStart + SimLineGroup::SET_TIME] = (int)sent.size();  // the data changes, then the trigger rises
+            bus.strobe(command, 0xF, 4);
+            sent.push_back(command);
+            bus.setTime(max(bus.getTime(), commandStart + gap));
+        }
+    }
+
+    // Watch the laser every millisecond after the last burst
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    ArduinoSim::run(SETTLE_TIME + frames * frameTime);
+    bool laserFlashed = false;
+    for(long long time = 1000; time <= DRAIN_TIME; time += 1000)
+    {
+        ArduinoSim::run(SETTLE_TIME + frames * frameTime + time);
+        laserFlashed = laserFlashed || ArduinoSim::getPin(LASER_PIN);
+    }
+    double wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    bool wheelsStopped = lastServoAngle(LEFT_WHEEL_PIN) == WHEEL_STOP &&
+        lastServoAngle(RIGHT_WHEEL_PIN) == WHEEL_STOP;
+
+    // The sketch prints each command it runs, and the overflow count when it changes
+    vector<string> lines = getPrintedLines(DEBUG_PORT);
+    vector<string> ran;
+    long overflows = 0;
+    for(size_t i = 0; i < lines.size(); ++i)
+    {
+        if(lines[i].compare(0, 9, "Command: ") == 0)
+            ran.push_back(lines[i].substr(9));
+        else if(lines[i].compare(0, 19, "Command overflows: ") == 0)
+            overflows = atol(lines[i].substr(19).c_str());
+    }
+
+    // Match each handler run to its strobe
+    const vector<IsrRecord> &records = ArduinoSim::getIsrRecords();
+    vector<double> latencies, waits;
+    vector<string> expected;  // the commands strobed for each handler run
+    for(size_t i = 0; i < records.size(); ++i)
+    {
+        if(records[i].interrupt != TRIG_INTERRUPT)
+            continue;
+        map<long long, int>::iterator strobe = strobes.find(records[i].edge);
+        if(strobe == strobes.end())
+            continue;
+
+        waits.push_back((double)(records[i].start - records[i].edge));
+        latencies.push_back((double)(records[i].end - records[i].edge));
+        expected.push_back(to_string(sent[strobe->second]));
+    }
+    int handled = (int)expected.size();
+
+    // The commands run must be the strobed ones in order, less any the queue dropped
+    int wrongData = 0;
+    size_t next = 0;  // the next strobed command a run command can match
+    for(size_t i = 0; i < ran.size(); ++i)
+    {
+        size_t match = next;
+        while(match < expected.size() && expected[match] != ran[i])
+            ++match;
+        if(match == expected.size())
+            ++wrongData;
+        else
+            next = match + 1;
+    }
+
+    cout << fixed << setprecision(1);
+    cout << "Spacing: " << gap << " us between command starts, trigger held for "
+        << GPIOLineGroup::STROBE_HOLD << " us" << endl;
+    cout << "Commands: " << sent.size() << " sent, " << handled << " handled, " << ran.size()
+        << " run, " << sent.size() - handled + overflows << " dropped (" << ArduinoSim::getLostEdges()
+        << " trigger edges lost, " << overflows << " queue overflows), " << wrongData
+        << " read the wrong data" << endl;
+    printTimes("Trigger to handler start", waits);
+    printTimes("Trigger to handler done", latencies);
+    cout << "After the last stop and start firing: wheels " << (wheelsStopped ? "stopped" :
+        "MOVING") << ", laser " << (laserFlashed ? "flashing" : "NEVER ON") << endl;
+    printRunStats(wallSeconds);
+
+    return wheelsStopped && laserFlashed ? 0 : 1;
+}
+
+/** Sends aiming packets over Serial1 with a ping in every tenth one, and measures how long
+ * the ping takes to come back. The second to last packet sets the speed scale to half and
+ * drives backwards, and the last one drives backwards at full speed, and the wheels must
+ * hold each of them.
+ * @param packetTime microseconds between packets
+ * @param packets the number of packets
+ * @return error code, if any
+ */
+int simulateSerial(long long packetTime, int packets)
+{
+    vector<long long> sendTimes;  // when each packet starts on the wire
+
+    ArduinoSim::reset();
+    setup();
+
+    for(int i = 0; i < packets; ++i)
+    {
+        PacketBuilder packet;
+        int yaw = 60 + (i % 30) * 2;  // a new angle every packet, so every packet turns the servo
+
+        packet.add(OP_SET_CAMERA, (int16_t)(yaw * 10), 900);
+        if(i == packets - 2)
+        {
+            packet.add(OP_SET_SPEED_SCALE, 50);
+            packet.add(OP_MOVE_BACKWARDS);
+        }
+        else if(i == packets - 1)
+            packet.add(OP_DRIVE, 0, -100);
+        else
+            packet.add(OP_DRIVE, 0, 50);
+        if(i % 10 == 0)
+            packet.add(OP_PING, (int16_t)i);
+
+        long long time = SETTLE_TIME + i * packetTime;
+        ArduinoSim::scheduleSerial(time, COMMAND_PORT, packet.finish((uint8_t)i), packet.size());
+        sendTimes.push_back(time);
+    }
+
+    // Check the wheels just before the last packet comes in, and again at the end. Backwards
+    // at half speed is 135 on the right wheel and 45 on the left, and at full speed 180 and 0.
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    bool scaleHeld = true, driveHeld = true;
+    if(packets >= 2)
+    {
+        ArduinoSim::run(sendTimes[packets - 1]);
+        scaleHeld = lastServoAngle(RIGHT_WHEEL_PIN) == 135 && lastServoAngle(LEFT_WHEEL_PIN) == 45;
+    }
+    ArduinoSim::run(SETTLE_TIME + packets * packetTime + DRAIN_TIME);
+    if(packets >= 2)
+        driveHeld = lastServoAngle(RIGHT_WHEEL_PIN) == 180 && lastServoAngle(LEFT_WHEEL_PIN) == 0;
+    double wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // Decode the pongs the sketch sent back
+    const vector<SerialByte> &output = ArduinoSim::getSerialOutput(COMMAND_PORT);
+    PacketDecoder replies;
+    vector<double> roundTrips;
+    for(size_t i = 0; i < output.size(); ++i)
+    {
+        if(!replies.push(output[i].value))
+            continue;
+
+        Command command;
+        int offset = 0;
+        while((offset = readCommand(replies.getPayload(), replies.getLength(), offset,
+                command)) >= 0)
+            if(command.opcode == OP_PONG && command.a >= 0 && command.a < packets)
+                roundTrips.push_back((double)(output[i].time - sendTimes[command.a]));
+    }
+
+    cout << fixed << setprecision(1);
+    cout << "Packets: " << packets << " sent, " << commandDecoder.getPackets() << " decoded, "
+        << commandDecoder.getErrors() << " bad, " << ArduinoSim::getSerialOverflows(COMMAND_PORT)
+        << " bytes lost to a full receive buffer" << endl;
+    cout << roundTrips.size() << " of " << (packets + 9) / 10 << " pings answered" << endl;
+    printTimes("Ping round trip", roundTrips);
+    cout << "Wheels: speed scale " << (scaleHeld ? "held" : "NOT HELD") << ", drive "
+        << (driveHeld ? "held" : "NOT HELD") << endl;
+    printRunStats(wallSeconds);
+
+    return scaleHeld && driveHeld ? 0 : 1;
+}
+
+/** Sends one packet for each camera move, and measures how long the servos take to start
+ * turning and to settle on the new angle, and how fast they turn
+ * @param moves the number of moves
+ * @param moveTime microseconds between moves
+ * @return error code, if any
+ */
+int simulateCamera(int moves, long long moveTime)
+{
+    const int pins[] = { YAW_SERVO_PIN, PITCH_SERVO_PIN };
+    vector<long long> sendTimes;  // when each packet starts on the wire
+    vector<int> targets[2];  // the yaw and pitch each move asks for, in degrees
+    vector<int> distances;  // the degrees the yaw turns for each move
+
+    ArduinoSim::reset();
+    setup();
+
+    int lastYaw = 90;
+    for(int i = 0; i < moves; ++i)
+    {
+        // Moves of 1 to 90 degrees, in both directions
+        int yaw = 45 + (i * 37) % 91;
+        int pitch = 45 + (i * 53) % 91;
+        PacketBuilder packet;
+        packet.add(OP_SET_CAMERA, (int16_t)(yaw * 10), (int16_t)(pitch * 10));
+
+        long long time = SETTLE_TIME + i * moveTime;
+        ArduinoSim::scheduleSerial(time, COMMAND_PORT, packet.finish((uint8_t)i), packet.size());
+        sendTimes.push_back(time);
+        targets[0].push_back(yaw);
+        targets[1].push_back(pitch);
+        distances.push_back(abs(yaw - lastYaw));
+        lastYaw = yaw;
+    }
+
+    // Watch the speed along each servo's profile every millisecond. The servo writes are in whole
+    // degrees, so the time between two of them says little about the speed.
+    long long end = SETTLE_TIME + moves * moveTime;
+    int peakVelocity = 0;  // hundredths of a degree in one update
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(long long time = 1000; time <= end; time += 1000)
+    {
+        ArduinoSim::run(time);
+        peakVelocity = max(peakVelocity, max(abs(cameraVelocity[0]), abs(cameraVelocity[1])));
+    }
+    double wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double peakSpeed = peakVelocity * 10.0 / CAMERA_PERIOD;  // degrees a second
+
+    // Go through each servo's writes during each move
+    const vector<ServoWrite> &writes = ArduinoSim::getServoWrites();
+    vector<double> startTimes, settleTimes;
+    int overshoot = 0, missed = 0;
+    double longestMove = 0;  // the settle time of the largest yaw move, in ms
+    int largest = 0;
+    for(int axis = 0; axis < 2; ++axis)
+    {
+        size_t w = 0;
+        const ServoWrite *last = NULL;  // the servo's last write
+        for(int i = 0; i < moves; ++i)
+        {
+            long long end = i + 1 < moves ? sendTimes[i + 1] : ArduinoSim::now();
+            int from = last ? last->angle : 90;
+            int target = targets[axis][i];
+            const ServoWrite *first = NULL;
+
+            for(; w < writes.size() && writes[w].time < end; ++w)
+            {
+                if(writes[w].pin != pins[axis] || writes[w].time < sendTimes[i])
+                    continue;
+                if(!first)
+                    first = &writes[w];
+                if((target - from) * (writes[w].angle - target) > 0)
+                    overshoot = max(overshoot, abs(writes[w].angle - target));
+                last = &writes[w];
+            }
+
+            if(from == target)
+                continue;
+            if(!first || last->angle != target)
+            {
+                ++missed;
+                continue;
+            }
+            startTimes.push_back((double)(first->time - sendTimes[i]) / 1000);
+            settleTimes.push_back((double)(last->time - sendTimes[i]) / 1000);
+            if(axis == 0 && distances[i] > largest)
+            {
+                largest = distances[i];
+                longestMove = settleTimes.back();
+            }
+        }
+    }
+
+    cout << fixed << setprecision(1);
+    cout << "Moves: " << moves << " packets, " << settleTimes.size() << " servo moves settled, "
+        << missed << " did not reach the angle" << endl;
+    printTimes("Packet sent to servo turning", startTimes, "ms");
+    printTimes("Packet sent to servo settled", settleTimes, "ms");
+    cout << "Largest yaw move: " << largest << " degrees in " << longestMove << " ms" << endl;
+    cout << "Peak speed: " << peakSpeed << " degrees/s, overshoot " << overshoot << " degrees"
+        << endl;
+    printRunStats(wallSeconds);
+
+    return 0;
+}
+
+/** Moves objects in and out of range of the ultrasonic sensors one at a time, and measures
+ * how long the sketch takes to set and clear each sensor's data pin
+ * @param objects the number of objects
+ * @param noise how many pings there are for each stray echo, 0 for none
+ * @return error code, if any
+ */
+int simulateRanging(int objects, int noise)
+{
+    const int NEAR = 10;  // cm, inside the sketch's collision distance
+    const int FAR = 40;  // cm, outside it
+    const int STRAY = 5;  // cm, what a stray echo reads as
+    const long long HOLD_TIME = 300000;  // microseconds each object stays, and then stays away
+    const long long STEP = 100;  // microseconds between looks at the data pins
+    vector<long long> arrivals;  // when each object comes into range
+
+    ArduinoSim::reset();
+    for(int i = 0; i < NUM_SENSORS; ++i)
+    {
+        ArduinoSim::setEcho(SENSOR_PINS[i], FAR);
+        ArduinoSim::setEchoNoise(SENSOR_PINS[i], noise, STRAY);
+    }
+    setup();
+
+    for(int i = 0; i < objects; ++i)
+    {
+        long long time = SETTLE_TIME + i * 2 * HOLD_TIME;
+        ArduinoSim::scheduleEcho(time, SENSOR_PINS[i % NUM_SENSORS], NEAR);
+        ArduinoSim::scheduleEcho(time + HOLD_TIME, SENSOR_PINS[i % NUM_SENSORS], FAR);
+        arrivals.push_back(time);
+    }
+
+    // Watch the data pins, and match each change to the object that should cause it
+    long long end = SETTLE_TIME + objects * 2 * HOLD_TIME;
+    bool levels[NUM_SENSORS] = { false, false, false };
+    vector<double> setTimes, clearTimes;
+    int falseAlarms = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(long long time = STEP; time <= end; time += STEP)
+    {
+        ArduinoSim::run(time);
+
+        for(int i = 0; i < NUM_SENSORS; ++i)
+        {
+            bool level = ArduinoSim::getPin(SENSOR_DATA_PINS[i]);
+            if(level == levels[i])
+                continue;
+            levels[i] = level;
+
+            // The object in front of this sensor now or most recently
+            int object = (int)((time - SETTLE_TIME) / (2 * HOLD_TIME));
+            bool matched = time >= SETTLE_TIME && object < objects && object % NUM_SENSORS == i;
+            if(!matched)
+                ++falseAlarms;
+            else if(level)
+                setTimes.push_back((double)(time - arrivals[object]) / 1000);
+            else
+                clearTimes.push_back((double)(time - arrivals[object] - HOLD_TIME) / 1000);
+        }
+    }
+    double wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << fixed << setprecision(1);
+    cout << "Objects: " << objects << " moved in front of a sensor, " << setTimes.size()
+        << " seen, " << clearTimes.size() << " cleared, " << falseAlarms
+        << " data pin changes with no object" << endl;
+    printTimes("Object in range to data pin set", setTimes, "ms");
+    printTimes("Object gone to data pin cleared", clearTimes, "ms");
+    cout << "Longest loop: " << ArduinoSim::getLongestLoop() << " us" << endl;
+    printRunStats(wallSeconds);
+
+    return 0;
+}
+
+/** Runs SniperBot.cpp against the simulated Arduino.
+ * With "pins [frame us] [frames] [gap us]", sends bursts of commands on the 4 bit command
+ * bus, starting the commands of a burst the gap apart like the Pi's command sender, and
+ * reports the commands handled, dropped and misread, the latency and the time spent in the
+ * interrupt handler. Exits with 1 if the wheels do not stay stopped or the laser does not
+ * flash after the last burst.
+ * With "serial [packet us] [packets]", sends aiming packets over Serial1 and reports the
+ * ping round trip. Exits with 1 if the wheels do not hold the last speed scale and drive.
+ * With "camera [moves] [move us]", turns the camera to a new angle with each packet and
+ * reports how long the servos take to settle and how fast they turn.
+ * With "ranging [objects] [noise]", moves objects in front of the ultrasonic sensors, with a
+ * stray echo every noise pings, and reports how long the sketch takes to see them.
+ */
+int main(int argc, char **argv)
+{
+    string mode = argc >= 2 ? argv[1] : "pins";
+
+    if(mode == "pins")
+        return simulatePins(argc >= 3 ? atoll(argv[2]) : 33333, argc >= 4 ? atoi(argv[3]) : 300,
+            argc >= 5 ? atoll(argv[4]) : COMMAND_GAP);
+    if(mode == "serial")
+        return simulateSerial(argc >= 3 ? atoll(argv[2]) : 10000, argc >= 4 ? atoi(argv[3]) : 1000);
+    if(mode == "camera")
+        return simulateCamera(argc >= 3 ? atoi(argv[2]) : 100, argc >= 4 ? atoll(argv[3]) : 500000);
+    if(mode == "ranging")
+        return simulateRanging(argc >= 3 ? atoi(argv[2]) : 30, argc >= 4 ? atoi(argv[3]) : 0);
+
+    cout << "Usage: firmware_sim pins [frame us] [frames] [gap us] | serial [packet us] [packets]"
+        " | camera [moves] [move us] | ranging [objects] [noise]" << endl;
+    return 1;
+}
@@ -0,0 +1,27 @@
+#ifndef SERVO_H
+#define	SERVO_H
+
+#include "Arduino.h"
+
+/** Servo Class
+ * Purpose: The Arduino Servo library for the simulated Arduino. Each change of a servo's angle
+ * is logged with the virtual time so the simulation can see when a command took effect.
+ */
+class Servo
+{
+private:
+    int pin;  // the servo's pin, -1 if not attached
+    int angle;  // the last angle written
+
+public:
+    Servo();
+    uint8_t attach(int pin);
+    uint8_t attach(int pin, int min, int max);
+    void detach();
+    void write(int angle);
+    void writeMicroseconds(int us);
+    int read();
+    bool attached();
+};
+
+#endif	/* SERVO_H */